@@ -257,7 +257,9 @@ void max_filter_square(float *output, float *dem, float *tmp, uint8_t width,
    @brief Fills sinks in a digital elevation model
 
    @details
-   Uses an algorithm based on grayscale morphological reconstruction.
+   Uses an algorithm based on grayscale morphological reconstruction
+   by erosion. The input DEM is only read, so it is safe to fill the
+   same DEM from several threads at once.
 
    @param[out] output The filled DEM
    @parblock
@@ -290,7 +292,46 @@ void max_filter_square(float *output, float *dem, float *tmp, uint8_t width,
    @endparblock
  */
 TOPOTOOLBOX_API
-void fillsinks(float *output, float *dem, uint8_t *bc, ptrdiff_t dims[2]);
+void fillsinks(float *output, const float *dem, uint8_t *bc,
+               ptrdiff_t dims[2]);
+
+/**
+   @brief Fills sinks in a digital elevation model of type `double`
+
+   @copydetails fillsinks()
+ */
+TOPOTOOLBOX_API
+void fillsinks_f64(double *output, const double *dem, uint8_t *bc,
+                   ptrdiff_t dims[2]);
+
+/**
+   @brief Fills sinks in a digital elevation model of type `int16_t`
+
+   @copydetails fillsinks()
+
+   Pixels that cannot be drained are set to INT16_MAX instead of
+   INFINITY. The same value marks missing data, which is handled like
+   NaN in the floating point variants. Other nodata values, such as
+   the common -32768, are treated as valid elevations and must be
+   replaced by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void fillsinks_i16(int16_t *output, const int16_t *dem, uint8_t *bc,
+                   ptrdiff_t dims[2]);
+
+/**
+   @brief Fills sinks in a digital elevation model of type `uint16_t`
+
+   @copydetails fillsinks()
+
+   Pixels that cannot be drained are set to UINT16_MAX instead of
+   INFINITY. The same value marks missing data, which is handled like
+   NaN in the floating point variants. Other nodata values are treated
+   as valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void fillsinks_u16(uint16_t *output, const uint16_t *dem, uint8_t *bc,
+                   ptrdiff_t dims[2]);
 
 /**
    @brief Fills sinks in a digital elevation model
@@ -299,7 +340,8 @@ void fillsinks(float *output, float *dem, uint8_t *bc, ptrdiff_t dims[2]);
    Uses an algorithm based on grayscale morphological
    reconstruction. Uses the hybrid algorithm of Vincent (1993) for
    higher performance than fillsinks(), but requires additional memory
-   allocation for a FIFO queue.
+   allocation for a FIFO queue. Like fillsinks(), it does not modify
+   the input DEM.
 
    # References
 
@@ -348,44 +390,77 @@ void fillsinks(float *output, float *dem, uint8_t *bc, ptrdiff_t dims[2]);
    @endparblock
  */
 TOPOTOOLBOX_API
-void fillsinks_hybrid(float *output, ptrdiff_t *queue, float *dem, uint8_t *bc,
-                      ptrdiff_t dims[2]);
+void fillsinks_hybrid(float *output, ptrdiff_t *queue, const float *dem,
+                      uint8_t *bc, ptrdiff_t dims[2]);
 
 /**
-   @brief Labels flat, sill and presill pixels in the provided DEM
+   @brief Fills sinks in a digital elevation model of type `double` using
+   the hybrid algorithm
+
+   @copydetails fillsinks_hybrid()
+ */
+TOPOTOOLBOX_API
+void fillsinks_hybrid_f64(double *output, ptrdiff_t *queue, const double *dem,
+                          uint8_t *bc, ptrdiff_t dims[2]);
+
+/**
+   @brief Fills sinks in a digital elevation model of type `int16_t` using
+   the hybrid algorithm
+
+   @copydetails fillsinks_hybrid()
+
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void fillsinks_hybrid_i16(int16_t *output, ptrdiff_t *queue, const int16_t *dem,
+                          uint8_t *bc, ptrdiff_t dims[2]);
+
+/**
+   @brief Fills sinks in a digital elevation model of type `uint16_t` using
+   the hybrid algorithm
+
+   @copydetails fillsinks_hybrid()
+
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void fillsinks_hybrid_u16(uint16_t *output, ptrdiff_t *queue,
+                          const uint16_t *dem, uint8_t *bc, ptrdiff_t dims[2]);
+
+/**
+   @brief Fills sinks in a digital elevation model using multiple threads
 
    @details
-   A flat pixel is one surrounded by pixels with the same or higher
-   elevations. A sill pixel has the same elevation as a neighboring
-   flat pixel but borders a pixel with a lower elevation. A presill
-   pixel is a flat pixel that borders a sill pixel.
+   The DEM is divided into tiles that are filled independently and in
+   parallel with a priority flood that treats every pixel on the
+   perimeter of a tile as a potential outlet. Each of these perimeter
+   pixels starts its own watershed. The lowest elevations at which
+   water can spill between adjacent watersheds, both within and
+   between tiles, form a small spill graph that is solved
+   sequentially. Finally, every tile is raised to the spill elevations
+   of its watersheds in a second parallel pass.
 
-   The pixels are labeled with a bit field:
+   The result is identical to that of fillsinks().
 
-   - Bit 0: Set if pixel is a flat
-   - Bit 1: Set if pixel is a sill
-   - Bit 2: Set if pixel is a presill
+   The tiles, labels and spill graph are allocated internally. If
+   these allocations fail, fillsinks_parallel() falls back to
+   fillsinks().
 
-   Since all presill pixels are also flats, bits 0 and 2 are both set
-   for presill pixels. In other words presill pixels have a value of 5
-   in the output array. This allows one to test the identity of pixels
-   with bitwise operations:
+   # References
 
-   ```
-   if (output[pixel] & 1) {
-     // Pixel is a flat
-   }
-   if (output[pixel] & 2) {
-     // Pixel is a sill
-   }
-   if (output[pixel] & 4) {
-     // Pixel is a presill
-   }
-   ```
+   Barnes, Richard. (2016). Parallel priority-flood depression filling
+   for trillion cell digital elevation models on desktops or clusters.
+   Computers & Geosciences, Vol. 96.
+   https://doi.org/10.1016/j.cageo.2016.07.001
 
-   @param[out] output The pixel labels
+   @param[out] output The filled DEM
    @parblock
-   A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
    @param[in] dem The input DEM
@@ -393,6 +468,18 @@ void fillsinks_hybrid(float *output, ptrdiff_t *queue, float *dem, uint8_t *bc,
    A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
+   @param[in] bc Array used to set boundary conditions
+   @parblock
+   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
+
+   `bc` is used to control which pixels get filled. Pixels that are
+   set equal to 1 are fixed to their value in the input DEM while
+   pixels equal to 0 are filled. For the standard fillsinks operation,
+   bc equals 1 on the boundaries of the DEM and 0 on the interior. Set
+   bc equal to 1 for NaN pixels to ensure that they are treated as
+   sinks.
+   @endparblock
+
    @param[in] dims The dimensions of the arrays
    @parblock
    A pointer to a `ptrdiff_t` array of size 2
@@ -400,56 +487,79 @@ void fillsinks_hybrid(float *output, ptrdiff_t *queue, float *dem, uint8_t *bc,
    The fastest changing dimension should be provided first. For column-major
    arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
+
+   @param[in] tile_dims The dimensions of the tiles
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 2 in the same order as
+   `dims`.
+
+   If `tile_dims` is NULL or one of its elements is not positive, a
+   tile size of 512 pixels is used along that dimension.
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
  */
 TOPOTOOLBOX_API
-ptrdiff_t identifyflats(int32_t *output, float *dem, ptrdiff_t dims[2]);
+void fillsinks_parallel(float *output, const float *dem, uint8_t *bc,
+                        ptrdiff_t dims[2], ptrdiff_t tile_dims[2],
+                        int num_threads);
 
 /**
-   @brief Compute costs for the gray-weighted distance transform
+   @brief Fills sinks in a digital elevation model using a priority flood
 
    @details
-   The costs used to route flow over flat regions with the
-   gray-weighted distance transform are based on the difference between
-   original and filled DEMs at each pixel. This difference is
-   subtracted from the maximum difference over the flat region to which
-   the pixel belongs. It is then squared and a small constant
-   (currently set to 0.1) is added.
+   Floods the DEM inward from the pixels where `bc` equals 1 in order
+   of increasing elevation. Pixels that lie below the current water
+   level are filled and processed in FIFO order without going through
+   the priority queue, which is only used for pixels that are not in
+   a pit (Barnes et al., 2014).
 
-   This function identifies the connected components of flat pixels,
-   provided in the `flats` array, computes the maximum difference
-   between the `original_dem` and the `filled_dem` over each connected
-   component and then computes the cost for each flat pixel. The
-   `costs` are returned, as are the connected components labels
-   (`conncomps`). These labels are the linear index of the pixel in the
-   connected component with the maximum difference between the filled
-   and the output DEMs.
+   Unlike fillsinks() and fillsinks_hybrid(), the running time does not
+   depend on the shape of the depressions: every pixel is visited
+   exactly once and the algorithm always runs to completion. The
+   result is identical to that of fillsinks().
 
-   @param[out] costs The gray-weighted distance transform costs
+   # References
+
+   Barnes, Richard, Lehman, Clarence, and Mulla, David. (2014).
+   Priority-flood: An optimal depression-filling and watershed-labeling
+   algorithm for digital elevation models. Computers & Geosciences,
+   Vol. 62. https://doi.org/10.1016/j.cageo.2013.04.024
+
+   @param[out] output The filled DEM
    @parblock
    A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[out] conncomps Labeled connected components for each flat pixel
+   @param queue A pixel queue
    @parblock
    A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
-   @endparblock
-
-   @param[in] flats Array identifying the flat pixels
-   @parblock
-   A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
 
-   The flat pixels must be identified as they are by identifyflats() such that
-   `flats[pixels] & 1` is nonzero for any flat pixel.
+   This array is used internally as the backing store for the priority
+   queue and the FIFO pit queue. It does not need to be initialized
+   and can be freed once fillsinks_priorityflood() returns.
    @endparblock
 
-   @param[in] original_dem The DEM prior to sink filling
+   @param[in] dem The input DEM
    @parblock
    A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] filled_dem The DEM after sink filling
+   @param[in] bc Array used to set boundary conditions
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
+
+   `bc` is used to control which pixels get filled. Pixels that are
+   set equal to 1 are fixed to their value in the input DEM while
+   pixels equal to 0 are filled. For the standard fillsinks operation,
+   bc equals 1 on the boundaries of the DEM and 0 on the interior. Set
+   bc equal to 1 for NaN pixels to ensure that they are treated as
+   sinks.
    @endparblock
 
    @param[in] dims The dimensions of the arrays
@@ -461,66 +571,78 @@ ptrdiff_t identifyflats(int32_t *output, float *dem, ptrdiff_t dims[2]);
    @endparblock
  */
 TOPOTOOLBOX_API
-void gwdt_computecosts(float *costs, ptrdiff_t *conncomps, int32_t *flats,
-                       float *original_dem, float *filled_dem,
-                       ptrdiff_t dims[2]);
+void fillsinks_priorityflood(float *output, ptrdiff_t *queue,
+                             const float *dem, uint8_t *bc, ptrdiff_t dims[2]);
 
 /**
-   @brief Compute the gray-weighted distance transform
+   @brief Updates a filled DEM after local changes to the DEM
 
    @details
-   This gray-weighted distance transform uses Dijkstra's algorithm to
-   compute the geodesic time of Soille (1994) using the provided
-   costs raster. The `flats` array, which could be generated by
-   identifyflats(), controls which pixels are considered in the
-   distance transform. Any pixel such that `(flats[pixel] & 1) != 0`
-   is considered by the algorithm, and the algorithm starts at source
-   pixels where `(flats[pixel] & 4) != 0`. All other pixels are
-   considered barriers through which paths cannot pass.
-
-   Chamfer weights are multiplied by the cost for each edge based on a
-   Euclidean metric: corner pixels are multiplied by sqrt(2).
-
-   # References
-
-   Soille, Pierre (1994). Generalized geodesy via geodesic
-   time. Pattern Recognition Letters 15, 1235-1240.
-
-   @param[out] dist The computed gray-weighted distance transform
+   When a few pixels of a DEM are edited, for example to add a levee,
+   a culvert or a road embankment, only the depressions whose spill
+   paths pass through the edited pixels need to be filled again.
+   fillsinks_incremental() takes the filled DEM computed for the DEM
+   before the edit and the list of changed pixels and repairs the fill
+   in place.
+
+   Starting from the changed pixels, the pixels whose old fill may
+   have depended on them are visited in order of increasing fill and
+   reset. These pixels, together with any pixels that can now drain
+   through a lowered pixel, are then filled again with
+   reconstruct_erosion_seeded(). The cost is roughly proportional to
+   the size of the affected depressions and their upstream areas
+   rather than to the size of the DEM.
+
+   The result is identical to that of running fillsinks() on the
+   edited DEM.
+
+   @param[in,out] output The filled DEM
    @parblock
    A pointer to a `float` array of size `dims[0]` x `dims[1]`
+
+   On input, the result of fillsinks() or any of its variants for the
+   DEM before the edit with the same boundary conditions. On output,
+   the filled DEM for the edited DEM.
    @endparblock
 
-   @param[out] prev Backlinks along the geodesic path
+   @param queue A pixel queue
    @parblock
    A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
 
-   If backlinks are not required, a null pointer can be passed here: it is
-   checked for NULL before being accessed.
+   This array is used internally as the backing store for the priority
+   queue and the pixel queue. It does not need to be initialized.
    @endparblock
 
-   @param[in] costs The input costs computed by gwdt_computecosts()
+   @param flags Pixel states
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
+
+   All elements must be zero on input and are zero again when
+   fillsinks_incremental() returns, so the same array can be reused
+   for subsequent edits without clearing it.
    @endparblock
 
-   @param[in] flats Array identifying the flat pixels
+   @param[in] dem The edited DEM
    @parblock
-   A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
-
-   The flat pixels must be identified as they are by identifyflats().
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param heap Storage for the priority queue
+   @param[in] bc Array used to set boundary conditions
    @parblock
-   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
+
+   See fillsinks(). Pixels whose boundary condition changed must be
+   listed in `changed`.
    @endparblock
 
-   @param back Storage for the priority queue
+   @param[in] changed The linear indices of the changed pixels
    @parblock
-   A pointer to a `ptrdiff_t` array of indices `dims[0]` x `dims[1]`
+   A pointer to a `ptrdiff_t` array of size `changed_count`. Duplicate
+   indices are allowed.
    @endparblock
 
+   @param[in] changed_count The number of changed pixels
+
    @param[in] dims The dimensions of the arrays
    @parblock
    A pointer to a `ptrdiff_t` array of size 2
@@ -528,74 +650,167 @@ void gwdt_computecosts(float *costs, ptrdiff_t *conncomps, int32_t *flats,
    The fastest changing dimension should be provided first. For column-major
    arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
+
+   @return The number of pixels that were filled again
  */
 TOPOTOOLBOX_API
-void gwdt(float *dist, ptrdiff_t *prev, float *costs, int32_t *flats,
-          ptrdiff_t *heap, ptrdiff_t *back, ptrdiff_t dims[2]);
+ptrdiff_t fillsinks_incremental(float *output, ptrdiff_t *queue,
+                                uint8_t *flags, const float *dem, uint8_t *bc,
+                                ptrdiff_t *changed, ptrdiff_t changed_count,
+                                ptrdiff_t dims[2]);
 
 /**
-   @brief Compute excess topography with 2D varying threshold slopes
-   using the fast sweeping method
+   @brief Updates a filled DEM after changes to the DEM within a
+   rectangle
 
    @details
-   The excess topography (Blöthe et al. 2015) is computed by solving an
-   eikonal equation (Anand et al. 2023) constrained to lie below the
-   original DEM. Where the slope of the DEM is greater than the
-   threshold slope, the eikonal solver limits the output topography to
-   that slope, but where the slope of the DEM is lower that the
-   threshold slope, the output follows the DEM.
+   Same as fillsinks_incremental(), but the changed pixels are given
+   as a rectangle: all pixels with a first index in `[rect[0],
+   rect[1])` and a second index in `[rect[2], rect[3])` are treated as
+   changed. The rectangle is clipped to the DEM.
+
+   @param[in,out] output The filled DEM, see fillsinks_incremental()
+   @param queue A pixel queue, see fillsinks_incremental()
+   @param flags Pixel states, see fillsinks_incremental()
+   @param[in] dem The edited DEM
+   @param[in] bc Array used to set boundary conditions
+   @param[in] rect The bounds of the changed rectangle
+   @param[in] dims The dimensions of the arrays
 
-   The eikonal equation is solved using the fast sweeping method (Zhao
-   2004), which iterates over the DEM in alternating directions and
-   updates the topography according to an upwind discretization of the
-   gradient. To constrain the solution by the original DEM, the
-   output topography is initiated with the DEM and only updates lower than the
-   DEM are accepted.
+   @return The number of pixels that were filled again
+ */
+TOPOTOOLBOX_API
+ptrdiff_t fillsinks_incremental_rect(float *output, ptrdiff_t *queue,
+                                     uint8_t *flags, const float *dem,
+                                     uint8_t *bc, ptrdiff_t rect[4],
+                                     ptrdiff_t dims[2]);
 
-   The fast sweeping method is simpler than the fast marching method
-   (excesstopography_fmm2d()), requires less memory, and can be faster,
-   particularly when the threshold slopes are constant or change
-   infrequently across the domain.
+/**
+   @brief Maximum number of nodes in the depression hierarchy of a DEM
 
-   # References
+   @details
+   Counts the local minima of the DEM to bound the number of
+   depressions found by depression_hierarchy(). Use the result to
+   size the per-depression arrays passed to depression_hierarchy().
 
-   Anand, Shashank Kumar, Matteo B. Bertagni, Arvind Singh and Amilcare
-   Porporato (2023). Eikonal equation reproduces natural landscapes with
-   threshold hillslopes. Geophysical Research Letters, 50, 21.
+   @param[in] dem The input DEM
+   @parblock
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   @endparblock
 
-   Blöthe, Jan Henrik, Oliver Korup and Wolfgang Schwanghart
-   (2015). Large landslides lie low: Excess topography in the
-   Himalaya-Karakoram ranges. Geology, 43, 6, 523-526.
+   @param[in] bc Array used to set boundary conditions, see fillsinks()
 
-   Zhao, Hongkai (2004). A fast sweeping method for eikonal
-   equations. Mathematics of Computation, 74, 250, 603-627.
+   @param[in] dims The dimensions of the arrays
 
-   @param[out] excess The solution of the constrained eikonal equation
+   @return The maximum number of nodes, including the outlet node 0
+ */
+TOPOTOOLBOX_API
+ptrdiff_t depression_hierarchy_size(const float *dem, uint8_t *bc,
+                                    ptrdiff_t dims[2]);
+
+/**
+   @brief Fills sinks and computes the depression hierarchy in a single
+   priority-flood pass
+
+   @details
+   Every pit seeds a leaf depression, and the pixels with `bc == 1`
+   form the outlet, node 0. A pit is a connected group of pixels of
+   equal elevation none of which has a lower neighbor or a neighbor
+   with `bc == 1`; flats that drain, e.g. the bottom of a valley
+   that continues downhill, do not seed a depression. A priority
+   flood from all seeds labels the watershed of each leaf and records
+   where adjacent watersheds spill into each other. When two depressions
+   fill up to their common spill point, they merge into a new parent
+   depression; when a depression fills up to the outlet, it becomes a
+   child of node 0 (Barnes et al., 2020).
+
+   Leaf depressions are numbered from 1 in the order of their first
+   pixel in memory, and merged depressions follow them in the order
+   in which they form, so a parent always has a larger index than its
+   children. Depressions that never reach the outlet, for example
+   because they are enclosed by NaNs, have no parent and are filled
+   to INFINITY.
+
+   The cell count, volume and maximum depth of a depression refer to
+   the pixels that are flooded when it is filled up to its pour point,
+   including those of its children. The filled DEM is identical to the
+   result of fillsinks().
+
+   # References
+
+   Barnes, Richard, Callaghan, Kerry L., and Wickert, Andrew D. (2020).
+   Computing water flow through complex landscapes - Part 2: Finding
+   hierarchies in depressions and morphological segmentations. Earth
+   Surface Dynamics, Vol. 8. https://doi.org/10.5194/esurf-8-431-2020
+
+   @param[out] filled The filled DEM
    @parblock
    A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   @endparblock
 
-   To compute the excess topography, subtract this array elementwise from the
-   DEM.
+   @param[out] labels The leaf watershed of each pixel
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+
+   The label of the leaf depression whose watershed contains the
+   pixel, as assigned by the priority flood. This is not necessarily
+   the smallest depression containing the pixel once it is filled:
+   a pixel above the pour point of its leaf belongs to one of the
+   leaf's ancestors, which can be found by following `parent`.
+   Pixels in the watershed of the outlet are labeled 0 and NaNs are
+   labeled -1.
    @endparblock
 
-   @param[in] dem The input digital elevation model.
+   @param queue A pixel queue
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+
+   Used as the backing store of the priority queue. It does not need
+   to be initialized.
    @endparblock
 
-   @param[in] threshold_slopes The threshold slopes at each grid cell.
+   @param[out] pour_point The pour point of each depression
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   A pointer to a `ptrdiff_t` array with at least as many elements as
+   returned by depression_hierarchy_size()
+
+   The linear index of the pixel over which the depression spills into
+   its neighbor, or -1 if the depression does not spill.
    @endparblock
 
-   @param[in] cellsize The spacing between grid cells
+   @param[out] parent The parent of each depression
    @parblock
-   A `float`
+   A pointer to a `ptrdiff_t` array of the same size as `pour_point`
 
-   The spacing is assumed to be constant and identical in the x- and y-
-   directions.
+   0 if the depression drains to the outlet and -1 for the outlet and
+   depressions that do not spill.
    @endparblock
 
+   @param[out] cell_count The number of pixels in each depression
+   @parblock
+   A pointer to a `ptrdiff_t` array of the same size as `pour_point`
+   @endparblock
+
+   @param[out] volume The volume of each depression
+   @parblock
+   A pointer to a `double` array of the same size as `pour_point`
+
+   The volume is given in units of elevation times pixels. Multiply it
+   by the pixel area to obtain a physical volume.
+   @endparblock
+
+   @param[out] max_depth The maximum depth of each depression
+   @parblock
+   A pointer to a `float` array of the same size as `pour_point`
+   @endparblock
+
+   @param[in] dem The input DEM
+   @parblock
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   @endparblock
+
+   @param[in] bc Array used to set boundary conditions, see fillsinks()
+
    @param[in] dims The dimensions of the arrays
    @parblock
    A pointer to a `ptrdiff_t` array of size 2
@@ -603,83 +818,150 @@ void gwdt(float *dist, ptrdiff_t *prev, float *costs, int32_t *flats,
    The fastest changing dimension should be provided first. For column-major
    arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
+
+   @return The number of nodes in the hierarchy including the outlet,
+   or -1 if memory could not be allocated
  */
 TOPOTOOLBOX_API
-void excesstopography_fsm2d(float *excess, float *dem, float *threshold_slopes,
-                            float cellsize, ptrdiff_t dims[2]);
+ptrdiff_t depression_hierarchy(float *filled, ptrdiff_t *labels,
+                               ptrdiff_t *queue, ptrdiff_t *pour_point,
+                               ptrdiff_t *parent, ptrdiff_t *cell_count,
+                               double *volume, float *max_depth,
+                               const float *dem, uint8_t *bc,
+                               ptrdiff_t dims[2]);
 
 /**
-   @brief Compute excess topography with 2D varying threshold slopes
-   using the fast marching method
+   @brief Read a tile of a DEM for fillsinks_outofcore()
+
+   @param[out] dem A `float` array of size `tile_dims[0]` x `tile_dims[1]`
+   that receives the elevations of the tile
+   @param[out] bc A `uint8_t` array of size `tile_dims[0]` x `tile_dims[1]`
+   that receives the boundary conditions of the tile
+   @param[in] offset The global index of the first pixel of the tile
+   @param[in] tile_dims The dimensions of the tile
+   @param context The pointer passed to fillsinks_outofcore()
+   @return 0 if successful. Any other value stops fillsinks_outofcore().
+ */
+typedef int (*fillsinks_read_tile)(float *dem, uint8_t *bc,
+                                   ptrdiff_t offset[2], ptrdiff_t tile_dims[2],
+                                   void *context);
 
-   @details
-   The excess topography (Blöthe et al. 2015) is computed by solving an
-   eikonal equation (Anand et al. 2023) constrained to lie below the
-   original DEM. Where the slope of the DEM is greater than the
-   threshold slope, the eikonal solver limits the output topography to
-   that slope, but where the slope of the DEM is lower that the
-   threshold slope, the output follows the DEM.
+/**
+   @brief Write a tile of the filled DEM for fillsinks_outofcore()
+
+   @param[in] output A `float` array of size `tile_dims[0]` x `tile_dims[1]`
+   holding the filled elevations of the tile
+   @param[in] offset The global index of the first pixel of the tile
+   @param[in] tile_dims The dimensions of the tile
+   @param context The pointer passed to fillsinks_outofcore()
+   @return 0 if successful. Any other value stops fillsinks_outofcore().
+ */
+typedef int (*fillsinks_write_tile)(float *output, ptrdiff_t offset[2],
+                                    ptrdiff_t tile_dims[2], void *context);
 
-   The eikonal equation is solved using the fast marching method
-   (Sethian 1996), which uses a priority queue to propagate slopes from
-   the lowest elevation pixels to the highest according to an upwind
-   discretization of the gradient. To constrain the solution by the
-   original DEM, the output topography is initiated with the DEM and
-   only updates lower than the DEM are accepted.
+/**
+   @brief Fills sinks in a DEM that does not fit in memory
 
-   The fast marching method is more complicated than the fast sweeping
-   method (excesstopography_fmm2d()) and requires pre-allocated memory
-   for the priority queue. It is faster than the fast sweeping method
-   when the threshold slopes change frequently.
+   @details
+   The DEM is processed in square tiles that are read and written
+   through the `read_tile` and `write_tile` callbacks, so the caller
+   decides how the data is stored, e.g. in memory-mapped files or in
+   tiled rasters on disk. The tile size is chosen so that the working
+   memory needed to fill a single tile fits in `memory_budget` bytes.
+
+   Every tile is read twice. The first pass fills each tile with a
+   priority flood and keeps only the elevations and watershed labels
+   of its perimeter pixels and the spill elevations between its
+   watersheds. The spill elevations of all watersheds are then
+   computed from this graph and the second pass floods each tile again,
+   raises it to the spill elevations and passes it to `write_tile`
+   (Barnes, 2016). Tiles are written in order and exactly once.
+
+   The budget includes the spill edges that are recorded while a tile
+   is flooded. The perimeter information and the deduplicated spill
+   graph stay resident. They grow with the total length of the tile
+   perimeters and are not counted in `memory_budget`.
+
+   The result is identical to that of fillsinks().
 
    # References
 
-   Anand, Shashank Kumar, Matteo B. Bertagni, Arvind Singh and Amilcare
-   Porporato (2023). Eikonal equation reproduces natural landscapes with
-   threshold hillslopes. Geophysical Research Letters, 50, 21.
+   Barnes, Richard. (2016). Parallel priority-flood depression filling
+   for trillion cell digital elevation models on desktops or clusters.
+   Computers & Geosciences, Vol. 96.
+   https://doi.org/10.1016/j.cageo.2016.07.001
 
-   Blöthe, Jan Henrik, Oliver Korup and Wolfgang Schwanghart
-   (2015). Large landslides lie low: Excess topography in the
-   Himalaya-Karakoram ranges. Geology, 43, 6, 523-526.
+   @param[in] read_tile Callback that reads a tile of the DEM and the
+   boundary conditions. See fillsinks_read_tile.
 
-   Sethian, James (1996). A fast marching level set method for
-   monotonically advancing fronts. Proceedings of the National Academy
-   of Sciences, 93, 4, 1591-1595.
+   @param[in] write_tile Callback that receives a tile of the filled
+   DEM. See fillsinks_write_tile.
 
-   @param[out] excess The solution of the constrained eikonal equation
+   @param context A pointer that is passed unchanged to the callbacks
+
+   @param[in] dims The dimensions of the DEM
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   A pointer to a `ptrdiff_t` array of size 2
 
-   To compute the excess topography, subtract this array elementwise from the
-   DEM.
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
+   The offsets and tile dimensions passed to the callbacks use the same
+   order.
    @endparblock
 
-   @param heap Storage for the priority queue
-   @parblock
-   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
-   @endparblock
+   @param[in] memory_budget The working memory available for a single
+   tile in bytes
 
-   @param back Storage for the priority queue
-   @parblock
-   A pointer to a `ptrdiff_t` array of indices `dims[0]` x `dims[1]`
-   @endparblock
+   @return 0 if successful, -1 if `memory_budget` is too small to hold
+   a single pixel or if memory could not be allocated and -2 if a
+   callback failed. No tile is written if the first pass fails, and no
+   callback is called after one has failed.
+ */
+TOPOTOOLBOX_API
+int fillsinks_outofcore(fillsinks_read_tile read_tile,
+                        fillsinks_write_tile write_tile, void *context,
+                        ptrdiff_t dims[2], size_t memory_budget);
 
-   @param[in] dem The input digital elevation model.
-   @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
-   @endparblock
+/**
+   @brief Labels flat, sill and presill pixels in the provided DEM
 
-   @param[in] threshold_slopes The threshold slopes at each grid cell.
+   @details
+   A flat pixel is one surrounded by pixels with the same or higher
+   elevations. A sill pixel has the same elevation as a neighboring
+   flat pixel but borders a pixel with a lower elevation. A presill
+   pixel is a flat pixel that borders a sill pixel.
+
+   The pixels are labeled with a bit field:
+
+   - Bit 0: Set if pixel is a flat
+   - Bit 1: Set if pixel is a sill
+   - Bit 2: Set if pixel is a presill
+
+   Since all presill pixels are also flats, bits 0 and 2 are both set
+   for presill pixels. In other words presill pixels have a value of 5
+   in the output array. This allows one to test the identity of pixels
+   with bitwise operations:
+
+   ```
+   if (output[pixel] & 1) {
+     // Pixel is a flat
+   }
+   if (output[pixel] & 2) {
+     // Pixel is a sill
+   }
+   if (output[pixel] & 4) {
+     // Pixel is a presill
+   }
+   ```
+
+   @param[out] output The pixel labels
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] cellsize The spacing between grid cells
+   @param[in] dem The input DEM
    @parblock
-   A `float`
-
-   The spacing is assumed to be constant and identical in the x- and y-
-   directions.
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
    @param[in] dims The dimensions of the arrays
@@ -689,265 +971,331 @@ void excesstopography_fsm2d(float *excess, float *dem, float *threshold_slopes,
    The fastest changing dimension should be provided first. For column-major
    arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
-
  */
 TOPOTOOLBOX_API
-void excesstopography_fmm2d(float *excess, ptrdiff_t *heap, ptrdiff_t *back,
-                            float *dem, float *threshold_slopes, float cellsize,
-                            ptrdiff_t dims[2]);
+ptrdiff_t identifyflats(int32_t *output, const float *dem, ptrdiff_t dims[2]);
 
 /**
-   @brief Compute excess topography with three-dimensionally variable
-   lithology using the fast marching method
+   @brief Labels flat, sill and presill pixels in the provided DEM
+   using multiple threads
 
    @details
-   The excess topography is computed by solving an eikonal equation with
-   the fast marching method (see excesstopography_fmm2d() for more
-   information). The threshold slope at a grid cell is computed from
-   that cell's position within the three-dimensional lithology.
+   The columns (rows for row-major arrays) of the DEM are divided into
+   one block per thread. The blocks are labeled independently with the
+   same single sweep as identifyflats(), and the flats in the columns
+   bordering each block are recomputed rather than shared between
+   threads.
 
-   The lithology consists of a set of discrete layers, each of which has
-   its own threshold slope, which is specified by the caller in the
-   `threshold_slopes` array from the bottom layer to the top layer. The
-   layer geometry is provided by the caller in the `lithstack` array,
-   which holds the elevation of the top surface of each layer at each
-   grid cell.
-
-   The algorithm proceeds similarly to the regular fast marching method,
-   using a priority queue to update grid cells from bottom to
-   top. Whenever a cell is updated, the eikonal solver is used to
-   propose a new elevation using the threshold slopes from each layer
-   from bottom to top. The first elevation that is proposed that lies
-   below the top surface of the layer whose slope is used in the
-   proposal is accepted as the provisional height for that grid cell.
-
-   @param[out] excess The solution of the constrained eikonal equation
-   @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   The output and the returned number of flats are identical to those
+   of identifyflats().
 
-   To compute the excess topography, subtract this array elementwise from the
-   DEM.
-   @endparblock
+   @copydetails identifyflats()
 
-   @param heap Storage for the priority queue
+   @param[in] num_threads The number of threads to use
    @parblock
-   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
    @endparblock
+ */
+TOPOTOOLBOX_API
+ptrdiff_t identifyflats_parallel(int32_t *output, const float *dem,
+                                 ptrdiff_t dims[2], int num_threads);
 
-   @param back Storage for the priority queue
-   @parblock
-   A pointer to a `ptrdiff_t` array of indices `dims[0]` x `dims[1]`
-   @endparblock
+/**
+   @brief Identifies flats and sills in a DEM of type `double`
 
-   @param[in] dem The input digital elevation model
-   @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
-   @endparblock
+   @copydetails identifyflats()
+ */
+TOPOTOOLBOX_API
+ptrdiff_t identifyflats_f64(int32_t *output, const double *dem,
+                            ptrdiff_t dims[2]);
 
-   @param[in] lithstack The input lithology.
-   @parblock
-   A pointer to a `float` array of size `nlayers` x `dims[0]` x `dims[1]`
+/**
+   @brief Identifies flats and sills in a DEM of type `int16_t`
 
-   The value of `lithstack[layer,row,col]` is the elevation of the top
-   surface of the given layer.  Note that the first dimension is the
-   layer, so that the layers of each cell are stored contiguously.
-   @endparblock
+   @copydetails identifyflats()
 
-   @param[in] threshold_slopes The threshold slopes for each layer
-   @parblock
-   A pointer to a `float` array of size `nlayers`
-   @endparblock
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+ptrdiff_t identifyflats_i16(int32_t *output, const int16_t *dem,
+                            ptrdiff_t dims[2]);
 
-   @param[in] cellsize The spacing between grid cells
-   @parblock
-   A `float`
+/**
+   @brief Identifies flats and sills in a DEM of type `uint16_t`
 
-   The spacing is assumed to be constant and identical in the x- and y-
-   directions.
-   @endparblock
+   @copydetails identifyflats()
 
-   @param[in] dims The horizontal dimensions of the arrays
-   @parblock
-   A pointer to a `ptrdiff_t` array of size 2
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+ptrdiff_t identifyflats_u16(int32_t *output, const uint16_t *dem,
+                            ptrdiff_t dims[2]);
 
-   The fastest changing dimension should be provided first. For column-major
-   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
-   @endparblock
-   @param[in] nlayers The number of layers in lithstack and threshold_slopes
+/**
+   @brief Identifies flats and sills in a DEM of type `double` using
+   multiple threads
 
+   @copydetails identifyflats_parallel()
  */
 TOPOTOOLBOX_API
-void excesstopography_fmm3d(float *excess, ptrdiff_t *heap, ptrdiff_t *back,
-                            float *dem, float *lithstack,
-                            float *threshold_slopes, float cellsize,
-                            ptrdiff_t dims[2], ptrdiff_t nlayers);
+ptrdiff_t identifyflats_parallel_f64(int32_t *output, const double *dem,
+                                     ptrdiff_t dims[2], int num_threads);
 
 /**
-   @brief Route flow over the DEM using the D8 method
+   @brief Identifies flats and sills in a DEM of type `int16_t` using
+   multiple threads
 
-   @details
-   The flow routing is solved using a D8 steepest descent
-   algorithm. Flat regions, which are identified in the `flats` array
-   using the indexing scheme of identifyflats(), are routed by carving
-   using the auxiliary topography provided in the `dist` array, which
-   can be generated by gwdt().
+   @copydetails identifyflats_parallel()
 
-   @param[out] node Nodes of the flow graph in topological order
-   @parblock
-   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+ptrdiff_t identifyflats_parallel_i16(int32_t *output, const int16_t *dem,
+                                     ptrdiff_t dims[2], int num_threads);
 
-   The pixels of the dem are sorted topologically that every pixel
-   that drains to pixel v comes before v in the array.
-   @endparblock
+/**
+   @brief Identifies flats and sills in a DEM of type `uint16_t` using
+   multiple threads
 
-   @param[out] direction The flow directions as a bit field.
-   @parblock
-   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
+   @copydetails identifyflats_parallel()
 
-   The 8 bits (0-7) identify the downstream neighbor of pixel `(i,j)`
-   as follows:
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+ptrdiff_t identifyflats_parallel_u16(int32_t *output, const uint16_t *dem,
+                                     ptrdiff_t dims[2], int num_threads);
 
-   ```
-   --- | j-1 | j | j+1|
-   ----+-----+---+----|
-   i-1 | 5   | 6 | 7  |
-   i   | 4   |   | 0  |
-   i+1 | 3   | 2 | 1  |
-   ```
+/**
+   @brief Compute costs for the gray-weighted distance transform
 
-   For example, a pixel with its downstream neighbor at `(i+1,j-1)`
-   has a value in the direction array of `0b00001000 = 8`. A value of
-   0 indicates that the pixel has no downstream neighbors and is
-   either a sink or an outlet. A value of 255 (all bits set) is used
-   internally as a sentinel value and its presence in output data is a
-   sign of an error.
-   @endparblock
+   @details
+   The costs used to route flow over flat regions with the
+   gray-weighted distance transform are based on the difference between
+   original and filled DEMs at each pixel. This difference is
+   subtracted from the maximum difference over the flat region to which
+   the pixel belongs. It is then squared and a small constant
+   (currently set to 0.1) is added.
 
-   @param[in] dem The input digital elevation model
+   This function identifies the connected components of flat pixels,
+   provided in the `flats` array, computes the maximum difference
+   between the `original_dem` and the `filled_dem` over each connected
+   component and then computes the cost for each flat pixel. The
+   `costs` are returned, as are the connected components labels
+   (`conncomps`). These labels are the linear index of the pixel in the
+   connected component with the maximum difference between the filled
+   and the output DEMs. If several pixels share the maximum
+   difference, the one with the smallest linear index is used.
+
+   @param[out] costs The gray-weighted distance transform costs
    @parblock
    A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] dist The auxiliary topography for routing over floats
+   @param[out] conncomps Labeled connected components for each flat pixel
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
-
-   This will typically be generated by gwdt() as the output `dist`.
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
    @endparblock
 
    @param[in] flats Array identifying the flat pixels
    @parblock
    A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
 
-   The flat pixels must be identified as they are by identifyflats().
+   The flat pixels must be identified as they are by identifyflats() such that
+   `flats[pixels] & 1` is nonzero for any flat pixel.
    @endparblock
 
-   @param[in] dims The dimensions of the arrays
+   @param[in] original_dem The DEM prior to sink filling
    @parblock
-   A pointer to a `ptrdiff_t` array of size 2
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   @endparblock
+
+   @param[in] filled_dem The DEM after sink filling
+   @parblock
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   @endparblock
+
+   @param[in] dims The dimensions of the arrays
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 2
 
    The fastest changing dimension should be provided first. For column-major
    arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
+ */
+TOPOTOOLBOX_API
+void gwdt_computecosts(float *costs, ptrdiff_t *conncomps, int32_t *flats,
+                       float *original_dem, float *filled_dem,
+                       ptrdiff_t dims[2]);
 
-   @param[in] order The memory order of the underlying array
-   @parblock
-   0 for column-major, 1 for row-major
+/**
+   @brief Compute costs for the gray-weighted distance transform using
+   multiple threads
+
+   @details
+   The connected components of flat pixels are labeled independently
+   in blocks of columns (rows for row-major arrays), one per thread.
+   Components that cross the seams between the blocks are relabeled
+   sequentially in the order of gwdt_computecosts(), so flats that
+   span several blocks limit the speedup.
 
+   The `costs` and `conncomps` are identical to those of
+   gwdt_computecosts().
+
+   @copydetails gwdt_computecosts()
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
    @endparblock
  */
 TOPOTOOLBOX_API
-void flow_routing_d8_carve(ptrdiff_t *node, uint8_t *direction, float *dem,
-                           float *dist, int32_t *flats, ptrdiff_t dims[2],
-                           unsigned int order);
+void gwdt_computecosts_parallel(float *costs, ptrdiff_t *conncomps,
+                                int32_t *flats, float *original_dem,
+                                float *filled_dem, ptrdiff_t dims[2],
+                                int num_threads);
 
 /**
-   @brief Compute downstream pixel indices from flow directions
+   @brief Compute the gray-weighted distance transform
 
-   The `node` and `direction` outputs from flow_routing_d8_carve()
-   form a topologically sorted adjacency list representation of the
-   flow graph. This function constructs an edge list stores it in the
-   `source` and `target` arrays.
+   @details
+   This gray-weighted distance transform uses Dijkstra's algorithm to
+   compute the geodesic time of Soille (1994) using the provided
+   costs raster. The `flats` array, which could be generated by
+   identifyflats(), controls which pixels are considered in the
+   distance transform. Any pixel such that `(flats[pixel] & 1) != 0`
+   is considered by the algorithm, and the algorithm starts at source
+   pixels where `(flats[pixel] & 4) != 0`. All other pixels are
+   considered barriers through which paths cannot pass.
 
-   @param[out] source The source pixel for each edge
+   Chamfer weights are multiplied by the cost for each edge based on a
+   Euclidean metric: corner pixels are multiplied by sqrt(2).
+
+   # References
+
+   Soille, Pierre (1994). Generalized geodesy via geodesic
+   time. Pattern Recognition Letters 15, 1235-1240.
+
+   @param[out] dist The computed gray-weighted distance transform
    @parblock
-   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[out] target The target pixel for each edge
+   @param[out] prev Backlinks along the geodesic path
    @parblock
    A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+
+   If backlinks are not required, a null pointer can be passed here: it is
+   checked for NULL before being accessed.
    @endparblock
 
-   @param[in] node Nodes of the flow graph in topological order
+   @param[in] costs The input costs computed by gwdt_computecosts()
    @parblock
-   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] direction The flow directions as a bit field
+   @param[in] flats Array identifying the flat pixels
    @parblock
-   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
+   A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
 
-   The flow directions should be encoded as they are in flow_routing_d8_carve().
+   The flat pixels must be identified as they are by identifyflats().
    @endparblock
 
-   @param[in] dims The dimensions of the arrays
+   @param heap Storage for the priority queue
    @parblock
-   A pointer to a `ptrdiff_t` array of size 2
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   @endparblock
 
-   The fastest changing dimension should be provided first. For column-major
-   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
+   @param back Storage for the priority queue
+   @parblock
+   A pointer to a `ptrdiff_t` array of indices `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] order The memory order of the underlying array
+   @param[in] dims The dimensions of the arrays
    @parblock
-   0 for column-major, 1 for row-major
+   A pointer to a `ptrdiff_t` array of size 2
 
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
-
-   @return The number of valid edges contained in the `source` and `target`
-   arrays
  */
 TOPOTOOLBOX_API
-ptrdiff_t flow_routing_d8_edgelist(ptrdiff_t *source, ptrdiff_t *target,
-                                   ptrdiff_t *node, uint8_t *direction,
-                                   ptrdiff_t dims[2], unsigned int order);
+void gwdt(float *dist, ptrdiff_t *prev, float *costs, int32_t *flats,
+          ptrdiff_t *heap, ptrdiff_t *back, ptrdiff_t dims[2]);
 
 /**
-   @brief Compute flow accumulation
+   @brief Compute the gray-weighted distance transform using a bucket
+   queue
 
-   Accumulates flow by summing contributing areas along flow paths. Uses the
-   `source` and `direction` outputs of flow_routing_d8_carve().
+   @details
+   The distances removed from the priority queue in Dijkstra's
+   algorithm never decrease and every edge weight is at least the
+   smallest cost of a flat pixel. gwdt_bucketed() exploits this by
+   replacing the binary heap of gwdt() with a circular bucket queue
+   (Dial, 1969) whose operations take constant time. At most one
+   bucket per flat pixel is allocated. If the costs span too wide a
+   range for that, the buckets are widened and the pixels of each
+   bucket are removed in the order of their distances.
+
+   The distances agree with those of gwdt() up to floating point
+   rounding. Where several paths to a pixel have the same distance,
+   the backlinks in `prev` may differ.
+
+   The buckets are allocated internally. If the costs of the flat
+   pixels are not all positive and finite or the allocation fails,
+   gwdt_bucketed() falls back to gwdt().
 
-   @param[out] acc The computed flow accumulation
+   # References
+
+   Dial, R. B. (1969). Algorithm 360: Shortest-path forest with
+   topological ordering. Communications of the ACM, 12(11), 632-633.
+
+   @param[out] dist The computed gray-weighted distance transform
    @parblock
    A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] source The source pixel for each edge
+   @param[out] prev Backlinks along the geodesic path
    @parblock
    A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
 
-   The source pixels must be in a topological order.
+   If backlinks are not required, a null pointer can be passed here: it is
+   checked for NULL before being accessed.
    @endparblock
 
-   @param[in] direction The flow directions as a bit field
+   @param[in] costs The input costs computed by gwdt_computecosts()
    @parblock
-   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
-
-   The flow directions should be encoded as they are in flow_routing_d8_carve().
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] weights Initial water depths
+   @param[in] flats Array identifying the flat pixels
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
 
-   The initial weights can be used to represent spatially variable
-   precipitation.
+   The flat pixels must be identified as they are by identifyflats().
+   @endparblock
 
-   If a null pointer is passed, a default weight of 1.0 for every
-   pixel is used. In this case the resulting flow accumulation is the
-   upstream area in number of pixels.
+   @param heap Storage for the bucket queue
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   @endparblock
+
+   @param back Storage for the bucket queue
+   @parblock
+   A pointer to a `ptrdiff_t` array of indices `dims[0]` x `dims[1]`
    @endparblock
 
    @param[in] dims The dimensions of the arrays
@@ -957,56 +1305,78 @@ ptrdiff_t flow_routing_d8_edgelist(ptrdiff_t *source, ptrdiff_t *target,
    The fastest changing dimension should be provided first. For column-major
    arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
+
+   @param[out] counters Queue operation counts
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 4 or NULL
+
+   If it is not NULL, `counters` receives the number of insertions
+   into the queue, including moves between buckets, the number of
+   pixels removed from the queue, the number of empty buckets that
+   were skipped and the number of pixels whose distance was decreased
+   after they were removed from the queue. Insertions and removals
+   correspond to the decrease-key and delete-min operations of the
+   binary heap used by gwdt(). The last count is zero unless
+   rounding interferes. All counts are zero if gwdt_bucketed() falls
+   back to gwdt().
+   @endparblock
  */
 TOPOTOOLBOX_API
-void flow_accumulation(float *acc, ptrdiff_t *source, uint8_t *direction,
-                       float *weights, ptrdiff_t dims[2]);
+void gwdt_bucketed(float *dist, ptrdiff_t *prev, float *costs, int32_t *flats,
+                   ptrdiff_t *heap, ptrdiff_t *back, ptrdiff_t dims[2],
+                   ptrdiff_t counters[4]);
 
 /**
-   @brief Compute flow accumulation based on a weighted edge list
+   @brief Compute the gray-weighted distance transform of each flat
+   independently using multiple threads
 
-   Accumulates flow by summing contributing areas along flow paths.
+   @details
+   The connected components of flat pixels identified by
+   gwdt_computecosts() do not interact in the gray-weighted distance
+   transform. gwdt_parallel() solves each of them with its own
+   priority queue in a workspace sized to the component and
+   distributes the components over the threads, largest first. The
+   workspaces need about 28 bytes per pixel of the largest component
+   handled by each thread instead of the `heap` and `back` arrays of
+   gwdt(), which have 16 bytes for every pixel of the DEM.
+
+   The distances are identical to those of gwdt(). Where several
+   paths to a pixel have the same distance, the backlinks in `prev`
+   may differ.
 
-   @param[out] acc The computed flow accumulation
+   @param[out] dist The computed gray-weighted distance transform
    @parblock
    A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] source The source pixel for each edge
+   @param[out] prev Backlinks along the geodesic path
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
 
-   The source pixels must be in a topological order.
+   If backlinks are not required, a null pointer can be passed here: it is
+   checked for NULL before being accessed.
    @endparblock
 
-   @param[in] target The target pixel for each edge
+   @param[in] costs The input costs computed by gwdt_computecosts()
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] fraction The fraction of flow transported along each edge
+   @param[in] flats Array identifying the flat pixels
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
 
-   The fraction for each edge should be a value between zero and one,
-   and the fractions for every edge with the same source pixel should
-   sum to one.
+   The flat pixels must be identified as they are by identifyflats().
    @endparblock
 
-   @param[in] weights Initial water depths
+   @param[in] conncomps Labeled connected components for each flat pixel
    @parblock
-   A pointer to a `float` array of size `dims[0]` x `dims[1]`
-
-   The initial weights can be used to represent spatially variable
-   precipitation.
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
 
-   If a null pointer is passed, a default weight of 1.0 for every
-   pixel is used. In this case the resulting flow accumulation is the
-   upstream area in number of pixels.
+   The labels must be computed by gwdt_computecosts() or
+   gwdt_computecosts_parallel() from the same `flats`.
    @endparblock
 
-   @param[in] edge_count The number of edges in the edge list
-
    @param[in] dims The dimensions of the arrays
    @parblock
    A pointer to a `ptrdiff_t` array of size 2
@@ -1014,1284 +1384,4557 @@ void flow_accumulation(float *acc, ptrdiff_t *source, uint8_t *direction,
    The fastest changing dimension should be provided first. For column-major
    arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+
+   @return 0 on success or -1 if a workspace could not be allocated
+   or a component has more than `INT32_MAX` pixels. The contents of
+   `dist` are undefined if the function fails.
  */
 TOPOTOOLBOX_API
-void flow_accumulation_edgelist(float *acc, ptrdiff_t *source,
-                                ptrdiff_t *target, float *fraction,
-                                float *weights, ptrdiff_t edge_count,
-                                ptrdiff_t dims[2]);
+int gwdt_parallel(float *dist, ptrdiff_t *prev, float *costs, int32_t *flats,
+                  ptrdiff_t *conncomps, ptrdiff_t dims[2], int num_threads);
 
 /**
-   @brief Compute  the gradient for each cell in the provided DEM array.
-   The gradient is calculated as the maximum slope between the cell and its
-   8 neighboring cells. The result can be output in different units based on the
-   `unit` parameter, and the computation can be parallelized using OpenMP.
+   @brief Compute excess topography with 2D varying threshold slopes
+   using the fast sweeping method
 
-   @param[out] output: Array to store the computed gradient values for each
-   cell. It should have the same dimensions as the DEM.
-   @param[in]  dem: Input digital elevation model as a 2D array flattened into a
-   1D array. This array represents the elevation values of each cell.
-   @param[in]  cellsize: The spatial resolution of the DEM (i.e., the size of
-   each cell).
-   @param[in]  use_mp: If set to 1, enables parallel processing using OpenMP.
-                       If set to 0, the function runs on a single thread.
-   @param[in]  dims: An array specifying the dimensions of the DEM.
-                     It should contain two values: [rows, columns].
-*/
-TOPOTOOLBOX_API
-void gradient8(float *output, float *dem, float cellsize, int use_mp,
-               ptrdiff_t dims[2]);
+   @details
+   The excess topography (Blöthe et al. 2015) is computed by solving an
+   eikonal equation (Anand et al. 2023) constrained to lie below the
+   original DEM. Where the slope of the DEM is greater than the
+   threshold slope, the eikonal solver limits the output topography to
+   that slope, but where the slope of the DEM is lower that the
+   threshold slope, the output follows the DEM.
 
-/**
-   @brief Performs a grayscale reconstruction of the `mask` image by the
-   `marker` image using the sequential reconstruction algorithm of Vincent
-   (1993).
+   The eikonal equation is solved using the fast sweeping method (Zhao
+   2004), which iterates over the DEM in alternating directions and
+   updates the topography according to an upwind discretization of the
+   gradient. To constrain the solution by the original DEM, the
+   output topography is initiated with the DEM and only updates lower than the
+   DEM are accepted.
 
-   @param[out] marker: The marker array is updated with the result in-place.
-   @param[in]  mask: The array holding the mask (for example dem).
-   @param[in]  dims: An array specifying the dimensions of both used arrays.
-                     It should contain two values: [rows, columns].
-*/
-TOPOTOOLBOX_API
-void reconstruct(float *marker, float *mask, ptrdiff_t dims[2]);
+   The fast sweeping method is simpler than the fast marching method
+   (excesstopography_fmm2d()), requires less memory, and can be faster,
+   particularly when the threshold slopes are constant or change
+   infrequently across the domain.
 
-/**
-   @brief Performs a ggrayscale reconstruction using the hybrid
-   algorithm of Vincent(1993).
+   # References
 
-   @param[out] marker: The marker array is updated with the result in-place.
-   @param[in]  queue: A ptrdiff_t array of the same size as the marker and mask
-   arrays.
-   @param[in]  mask: The array holding the mask (for example dem).
-   @param[in]  dims: An array specifying the dimensions of all used arrays.
-                     It should contain two values: [rows, columns].
-*/
-TOPOTOOLBOX_API
-int reconstruct_hybrid(float *marker, ptrdiff_t *queue, float *mask,
-                       ptrdiff_t dims[2]);
+   Anand, Shashank Kumar, Matteo B. Bertagni, Arvind Singh and Amilcare
+   Porporato (2023). Eikonal equation reproduces natural landscapes with
+   threshold hillslopes. Geophysical Research Letters, 50, 21.
 
-/**
-   @brief Integrate a `float` quantity over a stream network using
-   trapezoidal integration.
+   Blöthe, Jan Henrik, Oliver Korup and Wolfgang Schwanghart
+   (2015). Large landslides lie low: Excess topography in the
+   Himalaya-Karakoram ranges. Geology, 43, 6, 523-526.
 
-   @param[out] integral The integrated output
+   Zhao, Hongkai (2004). A fast sweeping method for eikonal
+   equations. Mathematics of Computation, 74, 250, 603-627.
+
+   @param[out] excess The solution of the constrained eikonal equation
    @parblock
-   A pointer to a `float` array representing a node attribute list
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
 
-   If the stream network has N nodes, this array should have a length
-   N. This value must not be less than the largest value in either the
-   `source` or `target` arrays.
+   To compute the excess topography, subtract this array elementwise from the
+   DEM.
    @endparblock
 
-   @param[in] integrand The quantity to be integrated
+   @param[in] dem The input digital elevation model.
    @parblock
-   A pointer to a `float` array representing a node attribute list
-
-   If the stream network has N nodes, this array should have a length
-   N. This value must not be less than the largest value in either the
-   `source` or `target` arrays.
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] threshold_slopes The threshold slopes at each grid cell.
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
-
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the nodes in the
-   node-attribute lists `integral` and `integrand`.
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] cellsize The spacing between grid cells
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A `float`
 
-   The labels must correspond to the 0-based indices of the nodes in
-   the node-attribute lists `integral` and `integrand`.
+   The spacing is assumed to be constant and identical in the x- and y-
+   directions.
    @endparblock
 
-   @param[in] weight The weight assigned to each edge in the stream network
+   @param[in] dims The dimensions of the arrays
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size 2
 
-   For most applications of integration along the stream network, this
-   will be the geometric distance between the source and target pixels
-   in the desired units.
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
-
-   @param[in] edge_count The number of edges in the stream network
  */
 TOPOTOOLBOX_API
-void streamquad_trapz_f32(float *integral, float *integrand, ptrdiff_t *source,
-                          ptrdiff_t *target, float *weight,
-                          ptrdiff_t edge_count);
-
-TOPOTOOLBOX_API
-void streamquad_trapz_f64(double *integral, double *integrand,
-                          ptrdiff_t *source, ptrdiff_t *target, float *weight,
-                          ptrdiff_t edge_count);
+void excesstopography_fsm2d(float *excess, float *dem, float *threshold_slopes,
+                            float cellsize, ptrdiff_t dims[2]);
 
 /**
-   @brief Upstream traversal in the (or, and) semiring
+   @brief Compute excess topography with 2D varying threshold slopes
+   using the fast marching method
 
-   Traverses the stream network in the upstream direction,
-   accumulating the values in `output` with edge weights given by the
-   `weights` array. The weights are applied with a bitwise and and
-   accumulated with a bitwise or.
+   @details
+   The excess topography (Blöthe et al. 2015) is computed by solving an
+   eikonal equation (Anand et al. 2023) constrained to lie below the
+   original DEM. Where the slope of the DEM is greater than the
+   threshold slope, the eikonal solver limits the output topography to
+   that slope, but where the slope of the DEM is lower that the
+   threshold slope, the output follows the DEM.
 
-   ```
-   for (e = (u,v) in edges:
-     output[u] = output[u] | (output[v] & input[e]);
-   ```
+   The eikonal equation is solved using the fast marching method
+   (Sethian 1996), which uses a priority queue to propagate slopes from
+   the lowest elevation pixels to the highest according to an upwind
+   discretization of the gradient. To constrain the solution by the
+   original DEM, the output topography is initiated with the DEM and
+   only updates lower than the DEM are accepted.
 
-   @param[out] output The accumulated output
+   The fast marching method is more complicated than the fast sweeping
+   method (excesstopography_fmm2d()) and requires pre-allocated memory
+   for the priority queue. It is faster than the fast sweeping method
+   when the threshold slopes change frequently.
+
+   # References
+
+   Anand, Shashank Kumar, Matteo B. Bertagni, Arvind Singh and Amilcare
+   Porporato (2023). Eikonal equation reproduces natural landscapes with
+   threshold hillslopes. Geophysical Research Letters, 50, 21.
+
+   Blöthe, Jan Henrik, Oliver Korup and Wolfgang Schwanghart
+   (2015). Large landslides lie low: Excess topography in the
+   Himalaya-Karakoram ranges. Geology, 43, 6, 523-526.
+
+   Sethian, James (1996). A fast marching level set method for
+   monotonically advancing fronts. Proceedings of the National Academy
+   of Sciences, 93, 4, 1591-1595.
+
+   @param[out] excess The solution of the constrained eikonal equation
    @parblock
-   A pointer to a `uint32_t` array representing a node attribute list
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   To compute the excess topography, subtract this array elementwise from the
+   DEM.
    @endparblock
 
-   @param[in] weights The edge weights
+   @param heap Storage for the priority queue
    @parblock
-   A pointer to a `uint32_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param back Storage for the priority queue
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of indices `dims[0]` x `dims[1]`
+   @endparblock
 
-   This array should have length `edge_count`.
+   @param[in] dem The input digital elevation model.
+   @parblock
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   @endparblock
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`
+   @param[in] threshold_slopes The threshold slopes at each grid cell.
+   @parblock
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] cellsize The spacing between grid cells
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A `float`
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute lists `output`
+   The spacing is assumed to be constant and identical in the x- and y-
+   directions.
+   @endparblock
+
+   @param[in] dims The dimensions of the arrays
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 2
+
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
 
-   @param[in] edge_count The number of edges in the stream network
  */
 TOPOTOOLBOX_API
-void traverse_up_u32_or_and(uint32_t *output, uint32_t *weights,
-                            ptrdiff_t *source, ptrdiff_t *target,
-                            ptrdiff_t edge_count);
+void excesstopography_fmm2d(float *excess, ptrdiff_t *heap, ptrdiff_t *back,
+                            float *dem, float *threshold_slopes, float cellsize,
+                            ptrdiff_t dims[2]);
 
 /**
-   @brief Downstream traversal in the Boolean ({0,1}, or, and) semiring
+   @brief Compute excess topography with three-dimensionally variable
+   lithology using the fast marching method
 
-   Accumulates the input node attribute list downstream using bitwise or
-   with multiplication given by bitwise and:
+   @details
+   The excess topography is computed by solving an eikonal equation with
+   the fast marching method (see excesstopography_fmm2d() for more
+   information). The threshold slope at a grid cell is computed from
+   that cell's position within the three-dimensional lithology.
 
-   for e = (u=>v) in edges:
-     output[v] = output[v] | output[u] & input[e];
+   The lithology consists of a set of discrete layers, each of which has
+   its own threshold slope, which is specified by the caller in the
+   `threshold_slopes` array from the bottom layer to the top layer. The
+   layer geometry is provided by the caller in the `lithstack` array,
+   which holds the elevation of the top surface of each layer at each
+   grid cell.
 
-   @param[out] output The accumulated output
+   The algorithm proceeds similarly to the regular fast marching method,
+   using a priority queue to update grid cells from bottom to
+   top. Whenever a cell is updated, the eikonal solver is used to
+   propose a new elevation using the threshold slopes from each layer
+   from bottom to top. The first elevation that is proposed that lies
+   below the top surface of the layer whose slope is used in the
+   proposal is accepted as the provisional height for that grid cell.
+
+   @param[out] excess The solution of the constrained eikonal equation
    @parblock
-   A pointer to a `uint32_t` array representing a node attribute list
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   To compute the excess topography, subtract this array elementwise from the
+   DEM.
    @endparblock
 
-   @param[in] input The edge weights
+   @param heap Storage for the priority queue
    @parblock
-   A pointer to a `uint32_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param back Storage for the priority queue
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
-
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   A pointer to a `ptrdiff_t` array of indices `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] dem The input digital elevation model
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
-
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] edge_count The number of edges in the stream network
- */
-TOPOTOOLBOX_API
-void traverse_down_u32_or_and(uint32_t *output, uint32_t *input,
-                              ptrdiff_t *source, ptrdiff_t *target,
-                              ptrdiff_t edge_count);
-
-/**
-   @brief Upstream traversal in the (or, and) semiring
-
-   Traverses the stream network in the upstream direction,
-   accumulating the values in `output` with edge weights given by the
-   `weights` array. The weights are applied with a bitwise and and
-   accumulated with a bitwise or.
-
-   ```
-   for (e = (u,v) in edges:
-     output[u] = output[u] | (output[v] & input[e]);
-   ```
-
-   @param[out] output The accumulated output
+   @param[in] lithstack The input lithology.
    @parblock
-   A pointer to a `uint8_t` array representing a node attribute list
+   A pointer to a `float` array of size `nlayers` x `dims[0]` x `dims[1]`
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   The value of `lithstack[layer,row,col]` is the elevation of the top
+   surface of the given layer.  Note that the first dimension is the
+   layer, so that the layers of each cell are stored contiguously.
    @endparblock
 
-   @param[in] weights The edge weights
+   @param[in] threshold_slopes The threshold slopes for each layer
    @parblock
-   A pointer to a `uint8_t` array of size `edge_count`
+   A pointer to a `float` array of size `nlayers`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] cellsize The spacing between grid cells
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
-
-   This array should have length `edge_count`.
+   A `float`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`
+   The spacing is assumed to be constant and identical in the x- and y-
+   directions.
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] dims The horizontal dimensions of the arrays
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size 2
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute lists `output`
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
+   @param[in] nlayers The number of layers in lithstack and threshold_slopes
 
-   @param[in] edge_count The number of edges in the stream network
  */
 TOPOTOOLBOX_API
-void traverse_up_u8_or_and(uint8_t *output, uint8_t *weights, ptrdiff_t *source,
-                           ptrdiff_t *target, ptrdiff_t edge_count);
+void excesstopography_fmm3d(float *excess, ptrdiff_t *heap, ptrdiff_t *back,
+                            float *dem, float *lithstack,
+                            float *threshold_slopes, float cellsize,
+                            ptrdiff_t dims[2], ptrdiff_t nlayers);
 
 /**
-   @brief Downstream traversal in the Boolean ({0,1}, or, and) semiring
-
-   Accumulates the input node attribute list downstream using bitwise or
-   with multiplication given by bitwise and:
+   @brief Route flow over the DEM using the D8 method
 
-   for e = (u=>v) in edges:
-     output[v] = output[v] | output[u] & input[e];
+   @details
+   The flow routing is solved using a D8 steepest descent
+   algorithm. Flat regions, which are identified in the `flats` array
+   using the indexing scheme of identifyflats(), are routed by carving
+   using the auxiliary topography provided in the `dist` array, which
+   can be generated by gwdt().
 
-   @param[out] output The accumulated output
+   @param[out] node Nodes of the flow graph in topological order
    @parblock
-   A pointer to a `uint8_t` array representing a node attribute list
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   The pixels of the dem are sorted topologically that every pixel
+   that drains to pixel v comes before v in the array.
    @endparblock
 
-   @param[in] input The edge weights
+   @param[out] direction The flow directions as a bit field.
    @parblock
-   A pointer to a `uint8_t` array of size `edge_count`
-   @endparblock
+   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
 
-   @param[in] source The source node of each edge in the stream
-                     network
-   @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   The 8 bits (0-7) identify the downstream neighbor of pixel `(i,j)`
+   as follows:
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
+   ```
+   --- | j-1 | j | j+1|
+   ----+-----+---+----|
+   i-1 | 5   | 6 | 7  |
+   i   | 4   |   | 0  |
+   i+1 | 3   | 2 | 1  |
+   ```
 
-   `output`.
+   For example, a pixel with its downstream neighbor at `(i+1,j-1)`
+   has a value in the direction array of `0b00001000 = 8`. A value of
+   0 indicates that the pixel has no downstream neighbors and is
+   either a sink or an outlet. A value of 255 (all bits set) is used
+   internally as a sentinel value and its presence in output data is a
+   sign of an error.
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] dem The input digital elevation model
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
-
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] edge_count The number of edges in the stream network
- */
-TOPOTOOLBOX_API
-void traverse_down_u8_or_and(uint8_t *output, uint8_t *input, ptrdiff_t *source,
-                             ptrdiff_t *target, ptrdiff_t edge_count);
-
-/**
-   @brief Downstream traversal with max-plus
-
-   Accumulates the edge weights in the `input` edge attribute list
-   using a max-plus update:
-
-   for (e = (u,v)) in edges:
-     output[v] = max(output[v], output[u] + input[e]);
-
-   With input giving the length of each edge and output initialized to
-   zero, this will compute the longest path from the outlet to a
-   source node.
-
-   @param[out] output The accumulated output
+   @param[in] dist The auxiliary topography for routing over floats
    @parblock
-   A pointer to a `float` array representing a node attribute list
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   This will typically be generated by gwdt() as the output `dist`.
    @endparblock
 
-   @param[in] input The edge weights
+   @param[in] flats Array identifying the flat pixels
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   A pointer to an `int32_t` array of size `dims[0]` x `dims[1]`
+
+   The flat pixels must be identified as they are by identifyflats().
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] dims The dimensions of the arrays
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size 2
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] order The memory order of the underlying array
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   0 for column-major, 1 for row-major
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
    @endparblock
-
-   @param[in] edge_count The number of edges in the stream network
  */
 TOPOTOOLBOX_API
-void traverse_down_f32_max_add(float *output, float *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count);
+void flow_routing_d8_carve(ptrdiff_t *node, uint8_t *direction,
+                           const float *dem, float *dist, int32_t *flats,
+                           ptrdiff_t dims[2], unsigned int order);
 
 /**
-   @brief Upstream traversal with max-plus
-
-   Accumulates the edge weights in the `input` edge attribute list
-   using a max-plus update.
+   @brief Compute flow directions and a topological ordering of the
+   pixels using multiple threads
 
-   With input giving the length of each edge and output initialized to
-   zero, this will compute the longest path from the outlet to a
-   source node.
+   @details
+   The flow direction of each pixel is computed independently in
+   parallel, after which the pixels are sorted topologically by a
+   single sequential pass that follows the flow paths.
 
-   @param[out] output The accumulated output
-   @parblock
-   A pointer to a `float` array representing a node attribute list
+   The `node` and `direction` outputs are identical to those of
+   flow_routing_d8_carve().
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
-   @endparblock
+   @copydetails flow_routing_d8_carve()
 
-   @param[in] input The edge weights
+   @param[in] num_threads The number of threads to use
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
    @endparblock
+ */
+TOPOTOOLBOX_API
+void flow_routing_d8_carve_parallel(ptrdiff_t *node, uint8_t *direction,
+                                    const float *dem, float *dist,
+                                    int32_t *flats, ptrdiff_t dims[2],
+                                    unsigned int order, int num_threads);
 
-   @param[in] source The source node of each edge in the stream
-                     network
-   @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+/**
+   @brief Compute flow directions of a DEM of type `double`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
-   @endparblock
+   @copydetails flow_routing_d8_carve()
+ */
+TOPOTOOLBOX_API
+void flow_routing_d8_carve_f64(ptrdiff_t *node, uint8_t *direction,
+                               const double *dem, float *dist, int32_t *flats,
+                               ptrdiff_t dims[2], unsigned int order);
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
-   @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+/**
+   @brief Compute flow directions of a DEM of type `int16_t`
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
-   @endparblock
+   @copydetails flow_routing_d8_carve()
 
-   @param[in] edge_count The number of edges in the stream network
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
  */
 TOPOTOOLBOX_API
-void traverse_up_f32_max_add(float *output, float *input, ptrdiff_t *source,
-                             ptrdiff_t *target, ptrdiff_t edge_count);
+void flow_routing_d8_carve_i16(ptrdiff_t *node, uint8_t *direction,
+                               const int16_t *dem, float *dist, int32_t *flats,
+                               ptrdiff_t dims[2], unsigned int order);
 
 /**
-   @brief Downstream traversal with max-mul
+   @brief Compute flow directions of a DEM of type `uint16_t`
 
-   Accumulates the edge weights in the `input` edge attribute list
-   using a max-mul update.
+   @copydetails flow_routing_d8_carve()
 
-   @param[out] output The accumulated output
-   @parblock
-   A pointer to a `float` array representing a node attribute list
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void flow_routing_d8_carve_u16(ptrdiff_t *node, uint8_t *direction,
+                               const uint16_t *dem, float *dist, int32_t *flats,
+                               ptrdiff_t dims[2], unsigned int order);
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
-   @endparblock
+/**
+   @brief Compute flow directions of a DEM of type `double` using
+   multiple threads
 
-   @param[in] input The edge weights
-   @parblock
-   A pointer to a `float` array of size `edge_count`
-   @endparblock
+   @copydetails flow_routing_d8_carve_parallel()
+ */
+TOPOTOOLBOX_API
+void flow_routing_d8_carve_parallel_f64(ptrdiff_t *node, uint8_t *direction,
+                                        const double *dem, float *dist,
+                                        int32_t *flats, ptrdiff_t dims[2],
+                                        unsigned int order, int num_threads);
 
-   @param[in] source The source node of each edge in the stream
-                     network
-   @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+/**
+   @brief Compute flow directions of a DEM of type `int16_t` using
+   multiple threads
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
-   @endparblock
+   @copydetails flow_routing_d8_carve_parallel()
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
-   @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void flow_routing_d8_carve_parallel_i16(ptrdiff_t *node, uint8_t *direction,
+                                        const int16_t *dem, float *dist,
+                                        int32_t *flats, ptrdiff_t dims[2],
+                                        unsigned int order, int num_threads);
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
-   @endparblock
+/**
+   @brief Compute flow directions of a DEM of type `uint16_t` using
+   multiple threads
 
-   @param[in] edge_count The number of edges in the stream network
+   @copydetails flow_routing_d8_carve_parallel()
+
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
  */
 TOPOTOOLBOX_API
-void traverse_down_f32_max_mul(float *output, float *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count);
+void flow_routing_d8_carve_parallel_u16(ptrdiff_t *node, uint8_t *direction,
+                                        const uint16_t *dem, float *dist,
+                                        int32_t *flats, ptrdiff_t dims[2],
+                                        unsigned int order, int num_threads);
 
 /**
-   @brief Downstream traversal with max-mul and maximum tracking
-
-   Accumulates the edge weights in the `input` edge attribute list
-   using a max-mul update.
+   @brief Compute downstream pixel indices from flow directions
 
-   The idx array can be used to track the index of the maximum
-   value. It should be initialized with the index of each node in the
-   array. If the upstream value multiplied by the input is greater
-   than the downstream value, the upstream index is copied into the
-   downstream index.
+   The `node` and `direction` outputs from flow_routing_d8_carve()
+   form a topologically sorted adjacency list representation of the
+   flow graph. This function constructs an edge list stores it in the
+   `source` and `target` arrays.
 
-   @param[out] output The accumulated output
+   @param[out] source The source pixel for each edge
    @parblock
-   A pointer to a `float` array representing a node attribute list
-
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[out] idx The index of the maximum value
+   @param[out] target The target pixel for each edge
    @parblock
-   A pointer to an `int64_t` array representing a node attribute list
-
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] input The edge weights
+   @param[in] node Nodes of the flow graph in topological order
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] direction The flow directions as a bit field
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   The flow directions should be encoded as they are in flow_routing_d8_carve().
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] dims The dimensions of the arrays
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size 2
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
 
-   @param[in] edge_count The number of edges in the stream network
- */
-TOPOTOOLBOX_API
-void traverse_down_f32_max_mul_arg(float *output, int64_t *idx, float *input,
-                                   ptrdiff_t *source, ptrdiff_t *target,
-                                   ptrdiff_t edge_count);
+   @param[in] order The memory order of the underlying array
+   @parblock
+   0 for column-major, 1 for row-major
+
+   @endparblock
+
+   @return The number of valid edges contained in the `source` and `target`
+   arrays
+ */
+TOPOTOOLBOX_API
+ptrdiff_t flow_routing_d8_edgelist(ptrdiff_t *source, ptrdiff_t *target,
+                                   ptrdiff_t *node, uint8_t *direction,
+                                   ptrdiff_t dims[2], unsigned int order);
 
 /**
-   @brief Upstream traversal with max-mul
+   @brief flow_routing_d8_edgelist() with 32-bit node indices
 
-   Accumulates the edge weights in the `input` edge attribute list
-   using a max-mul update.
+   @details
+   The `source`, `target` and `node` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
 
-   @param[out] output The accumulated output
+   @copydetails flow_routing_d8_edgelist()
+ */
+TOPOTOOLBOX_API
+ptrdiff_t flow_routing_d8_edgelist_idx32(uint32_t *source, uint32_t *target,
+                                         uint32_t *node, uint8_t *direction,
+                                         ptrdiff_t dims[2], unsigned int order);
+
+/**
+   @brief Compute downstream pixel indices from flow directions using
+   multiple threads
+
+   @details
+   The node array is split into blocks. The edges of every block are
+   counted in parallel, an exclusive scan of the counts yields the
+   position of the first edge of each block, and the edges are then
+   written in parallel. The output is identical to that of
+   flow_routing_d8_edgelist(). If the temporary array of block offsets
+   cannot be allocated, -1 is returned and no edges are written.
+
+   @copydetails flow_routing_d8_edgelist()
+
+   @param[in] num_threads The number of threads to use
    @parblock
-   A pointer to a `float` array representing a node attribute list
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+ptrdiff_t flow_routing_d8_edgelist_parallel(ptrdiff_t *source,
+                                            ptrdiff_t *target, ptrdiff_t *node,
+                                            uint8_t *direction,
+                                            ptrdiff_t dims[2],
+                                            unsigned int order,
+                                            int num_threads);
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+/**
+   @brief Compute flow accumulation
+
+   Accumulates flow by summing contributing areas along flow paths. Uses the
+   `source` and `direction` outputs of flow_routing_d8_carve().
+
+   @param[out] acc The computed flow accumulation
+   @parblock
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
    @endparblock
 
-   @param[in] input The edge weights
+   @param[in] source The source pixel for each edge
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+
+   The source pixels must be in a topological order.
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] direction The flow directions as a bit field
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   The flow directions should be encoded as they are in flow_routing_d8_carve().
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] weights Initial water depths
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   The initial weights can be used to represent spatially variable
+   precipitation.
+
+   If a null pointer is passed, a default weight of 1.0 for every
+   pixel is used. In this case the resulting flow accumulation is the
+   upstream area in number of pixels.
    @endparblock
 
-   @param[in] edge_count The number of edges in the stream network
+   @param[in] dims The dimensions of the arrays
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 2
+
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
+   @endparblock
  */
 TOPOTOOLBOX_API
-void traverse_up_f32_max_mul(float *output, float *input, ptrdiff_t *source,
-                             ptrdiff_t *target, ptrdiff_t edge_count);
+void flow_accumulation(float *acc, ptrdiff_t *source, uint8_t *direction,
+                       float *weights, ptrdiff_t dims[2]);
 
 /**
-   @brief Upstream traversal with max-mul and maximum tracking
+   @brief Compute flow accumulation based on a weighted edge list
 
-   Accumulates the edge weights in the `input` edge attribute list
-   using a max-mul update.
+   Accumulates flow by summing contributing areas along flow paths.
 
-   The idx array can be used to track the index of the maximum
-   value. It should be initialized with the index of each node in the
-   array. If the upstream value multiplied by the input is greater
-   than the downstream value, the upstream index is copied into the
-   downstream index.
+   @param[out] acc The computed flow accumulation
+   @parblock
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+   @endparblock
 
-   @param[out] output The accumulated output
+   @param[in] source The source pixel for each edge
    @parblock
-   A pointer to a `float` array representing a node attribute list
+   A pointer to a `ptrdiff_t` array of size `edge_count`
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   The source pixels must be in a topological order.
    @endparblock
 
-   @param[out] idx The index of the maximum value
+   @param[in] target The target pixel for each edge
    @parblock
-   A pointer to an `int64_t` array representing a node attribute list
-
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   A pointer to a `ptrdiff_t` array of size `edge_count`
    @endparblock
 
-   @param[in] input The edge weights
+   @param[in] fraction The fraction of flow transported along each edge
    @parblock
    A pointer to a `float` array of size `edge_count`
+
+   The fraction for each edge should be a value between zero and one,
+   and the fractions for every edge with the same source pixel should
+   sum to one.
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] weights Initial water depths
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   The initial weights can be used to represent spatially variable
+   precipitation.
+
+   If a null pointer is passed, a default weight of 1.0 for every
+   pixel is used. In this case the resulting flow accumulation is the
+   upstream area in number of pixels.
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] edge_count The number of edges in the edge list
+
+   @param[in] dims The dimensions of the arrays
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size 2
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
-
-   @param[in] edge_count The number of edges in the stream network
  */
 TOPOTOOLBOX_API
-void traverse_up_f32_max_mul_arg(float *output, int64_t *idx, float *input,
-                                 ptrdiff_t *source, ptrdiff_t *target,
-                                 ptrdiff_t edge_count);
+void flow_accumulation_edgelist(float *acc, ptrdiff_t *source,
+                                ptrdiff_t *target, float *fraction,
+                                float *weights, ptrdiff_t edge_count,
+                                ptrdiff_t dims[2]);
 
 /**
-   @brief Downstream traversal with min-plus
+   @brief flow_accumulation_edgelist() with 32-bit node indices
 
-   Accumulates the edge weights in the `input` edge attribute list
-   using a min-plus update:
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
 
-   for (e = (u,v)) in edges:
-     output[v] = min(output[v], output[u] + input[e]);
+   @copydetails flow_accumulation_edgelist()
+ */
+TOPOTOOLBOX_API
+void flow_accumulation_edgelist_idx32(float *acc, uint32_t *source,
+                                      uint32_t *target, float *fraction,
+                                      float *weights, ptrdiff_t edge_count,
+                                      ptrdiff_t dims[2]);
 
-   With input giving the length of each edge and output initialized to
-   zero, this will compute the shortest path from the outlet to a
-   source node.
+/**
+   @brief Compute the receiver of each pixel from D8 flow directions
 
-   @param[out] output The accumulated output
+   @details
+   A single flow direction network can be represented by a receiver
+   array, where receiver[u] is the pixel that u drains to, together
+   with the topologically sorted `node` array produced by
+   flow_routing_d8_carve(). This representation needs neither the
+   `source`, `target` nor `fraction` arrays of the edge list, and the
+   *_receivers kernels traverse it without decoding flow directions.
+
+   @param[out] receiver The receiver of each pixel
    @parblock
-   A pointer to a `float` array representing a node attribute list
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   Sinks are their own receivers.
    @endparblock
 
-   @param[in] input The edge weights
+   @param[in] direction The flow directions as a bit field
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   A pointer to a `uint8_t` array of size `dims[0]` x `dims[1]`
+
+   The flow directions should be encoded as they are in
+   flow_routing_d8_carve().
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] dims The dimensions of the arrays
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size 2
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] order The memory order of the underlying array
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
-
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   0 for column-major, 1 for row-major
    @endparblock
-
-   @param[in] edge_count The number of edges in the stream network
  */
 TOPOTOOLBOX_API
-void traverse_down_f32_min_add(float *output, float *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count);
+void flow_routing_d8_receivers(ptrdiff_t *receiver, uint8_t *direction,
+                               ptrdiff_t dims[2], unsigned int order);
 
 /**
-   @brief Downstream traversal with multiply-add
+   @brief flow_routing_d8_receivers() with 32-bit node indices
 
-   Accumulates the edge weights in the `input` edge attribute list
-   using a multiply-add update:
+   @details
+   The `receiver` array holds
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
 
-   for (e = (u,v)) in edges:
-     output[v] = output[v] + output[u] * input[e];
+   @copydetails flow_routing_d8_receivers()
+ */
+TOPOTOOLBOX_API
+void flow_routing_d8_receivers_idx32(uint32_t *receiver, uint8_t *direction,
+                                     ptrdiff_t dims[2], unsigned int order);
 
-   With input giving the flow fraction of each edge and output
-   initialized to ones, this will compute the flow accumulation.
+/**
+   @brief Compute flow accumulation on a receiver array
 
-   @param[out] output The accumulated output
-   @parblock
-   A pointer to a `float` array representing a node attribute list
+   @details
+   The result is identical to that of flow_accumulation() and of
+   flow_accumulation_edgelist() with unit fractions on the same flow
+   network.
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   @param[out] acc The computed flow accumulation
+   @parblock
+   A pointer to a `float` array of size `node_count`
    @endparblock
 
-   @param[in] input The edge weights
+   @param[in] receiver The receiver of each pixel
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
+
+   receiver[u] is the pixel that u drains to, or u itself if u is a
+   sink. It is computed by flow_routing_d8_receivers().
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] node The pixels in topological order
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   This will typically be the `node` output of flow_routing_d8_carve().
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] node_count The number of pixels, `dims[0]` x `dims[1]`
+
+   @param[in] weights Initial water depths
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `float` array of size `node_count`
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   If a null pointer is passed, a default weight of 1.0 for every
+   pixel is used.
    @endparblock
-
-   @param[in] edge_count The number of edges in the stream network
  */
 TOPOTOOLBOX_API
-void traverse_down_f32_add_mul(float *output, float *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count);
+void flow_accumulation_receivers(float *acc, ptrdiff_t *receiver,
+                                 ptrdiff_t *node, float *weights,
+                                 ptrdiff_t node_count);
 
 /**
-   @brief Downstream traversal with multiply-add
+   @brief flow_accumulation_receivers() with 32-bit node indices
 
-   Accumulates the edge weights in the `input` edge attribute list
-   using a multiply-add update:
+   @details
+   The `receiver` and `node` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
 
-   for (e = (u,v)) in edges:
-     output[v] = output[v] + output[u] * input[e];
+   @copydetails flow_accumulation_receivers()
+ */
+TOPOTOOLBOX_API
+void flow_accumulation_receivers_idx32(float *acc, uint32_t *receiver,
+                                       uint32_t *node, float *weights,
+                                       ptrdiff_t node_count);
 
-   With input giving the flow fraction of each edge and output
-   initialized to ones, this will compute the flow accumulation.
+/**
+   @brief Label drainage basins on a receiver array
 
-   @param[out] output The accumulated output
-   @parblock
-   A pointer to a `double` array representing a node attribute list
-
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
-   @endparblock
+   @details
+   The labels are identical to those assigned by drainagebasins() on
+   the edge list of the same flow network. Sinks without any upstream
+   pixels are labeled 0.
 
-   @param[in] input The edge weights
+   @param[out] basins The drainage basin label of each pixel
    @parblock
-   A pointer to a `double` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] receiver The receiver of each pixel
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   receiver[u] is the pixel that u drains to, or u itself if u is a
+   sink. It is computed by flow_routing_d8_receivers().
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] node The pixels in topological order
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   This will typically be the `node` output of flow_routing_d8_carve().
    @endparblock
 
-   @param[in] edge_count The number of edges in the stream network
+   @param[in] node_count The number of pixels, `dims[0]` x `dims[1]`
  */
 TOPOTOOLBOX_API
-void traverse_down_f64_add_mul(double *output, double *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count);
+void drainagebasins_receivers(ptrdiff_t *basins, ptrdiff_t *receiver,
+                              ptrdiff_t *node, ptrdiff_t node_count);
 
 /**
-   @brief Compute the in- and outdegrees of each node in a graph
+   @brief drainagebasins_receivers() with 32-bit node indices
 
-   @param[out] indegree The indegree of each node in the stream network
-   @parblock
-   A pointer to a `uint8_t` array representing a node attribute list
+   @details
+   The `basins`, `receiver` and `node` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
-   @endparblock
+   @copydetails drainagebasins_receivers()
+ */
+TOPOTOOLBOX_API
+void drainagebasins_receivers_idx32(uint32_t *basins, uint32_t *receiver,
+                                    uint32_t *node, ptrdiff_t node_count);
 
-   @param[out] outdegree The outdegree of each node in the stream network
-   @parblock
-   A pointer to a `uint8_t` array representing a node attribute list
+/**
+   @brief Propagate the values of the outlets upstream on a receiver
+   array
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   @details
+   Every pixel receives the value of the sink it drains to.
+
+   @param[in,out] data The values to propagate
+   @parblock
+   A pointer to a `float` array of size `node_count`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] receiver The receiver of each pixel
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `indegree` and `outdegree`.
+   receiver[u] is the pixel that u drains to, or u itself if u is a
+   sink. It is computed by flow_routing_d8_receivers().
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] node The pixels in topological order
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute lists `indegree` and `outdegree`.
+   This will typically be the `node` output of flow_routing_d8_carve().
    @endparblock
 
-   @param[in] node_count The number of nodes in the stream network
-   @param[in] edge_count The number of edges in the stream network
+   @param[in] node_count The number of pixels, `dims[0]` x `dims[1]`
  */
 TOPOTOOLBOX_API
-void edgelist_degree(uint8_t *indegree, uint8_t *outdegree, ptrdiff_t *source,
-                     ptrdiff_t *target, ptrdiff_t node_count,
-                     ptrdiff_t edge_count);
+void propagatevaluesupstream_f32_receivers(float *data, ptrdiff_t *receiver,
+                                           ptrdiff_t *node,
+                                           ptrdiff_t node_count);
 
 /**
-   @brief Compute stream order of Stream Object using Strahler method
+   @brief propagatevaluesupstream_f32_receivers() with 32-bit node indices
 
-   Accumulates the edge weights in the `input` edge attribute list
-   using a multiply-add update:
+   @details
+   The `receiver` and `node` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
 
-   for (e = (u,v)) in edges:
-     output[v] = output[v] + output[u] * input[e];
+   @copydetails propagatevaluesupstream_f32_receivers()
+ */
+TOPOTOOLBOX_API
+void propagatevaluesupstream_f32_receivers_idx32(float *data,
+                                                 uint32_t *receiver,
+                                                 uint32_t *node,
+                                                 ptrdiff_t node_count);
 
-   With input giving the flow fraction of each edge and output
-   initialized to ones, this will compute the flow accumulation.
+/**
+   @brief Accumulate a quantity upstream from the outlets on a
+   receiver array
 
-   @param[out] output The accumulated output
-   @parblock
-   A pointer to a `float` array representing a node attribute list
+   @details
+   For every pixel u that is not a sink, in reverse topological order,
 
-   This array should have a length equal to the number of nodes in the
-   stream network.  This value must not be less than the largest value
-   in either the `source` or `target` arrays.
+   output[u] = output[receiver[u]] + input[u]
+
+   With the outlets of `output` initialized to zero and `input` set to
+   the distance from each pixel to its receiver, the result is the
+   flow distance to the outlet.
+
+   @param[in,out] output The accumulated quantity
+   @parblock
+   A pointer to a `float` array of size `node_count`
    @endparblock
 
-   @param[in] input The edge weights
+   @param[in] input The increment along the edge leaving each pixel
    @parblock
-   A pointer to a `float` array of size `edge_count`
+   A pointer to a `float` array of size `node_count`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] receiver The receiver of each pixel
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `output`.
+   receiver[u] is the pixel that u drains to, or u itself if u is a
+   sink. It is computed by flow_routing_d8_receivers().
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] node The pixels in topological order
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `output`.
+   This will typically be the `node` output of flow_routing_d8_carve().
    @endparblock
 
-   @param[in] edge_count The number of edges in the stream network
+   @param[in] node_count The number of pixels, `dims[0]` x `dims[1]`
  */
+TOPOTOOLBOX_API
+void traverse_up_f32_add_receivers(float *output, float *input,
+                                   ptrdiff_t *receiver, ptrdiff_t *node,
+                                   ptrdiff_t node_count);
 
+/**
+   @brief traverse_up_f32_add_receivers() with 32-bit node indices
+
+   @details
+   The `receiver` and `node` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_up_f32_add_receivers()
+ */
 TOPOTOOLBOX_API
-void traverse_down_f32_strahler(float *output, float *input, ptrdiff_t *source,
-                                ptrdiff_t *target, ptrdiff_t edge_count);
+void traverse_up_f32_add_receivers_idx32(float *output, float *input,
+                                         uint32_t *receiver, uint32_t *node,
+                                         ptrdiff_t node_count);
 
 /**
-   @brief Propagate `float` values upstream
+   @brief Compute the maximum of a quantity accumulated downstream on a
+   receiver array
 
-   The values in the `data` node attribute list are copied to their
-   upstream neighbors according to the edges contained in the `source`
-   and `target` arrays.
+   @details
+   For every pixel u that is not a sink, in topological order,
 
-   Nodes with no downstream neighbors should be initialized in the
-   `data` array with the values to be propagated upstream. The
-   upstream values will be overwritten.
+   output[v] = max(output[v], output[u] + input[u])
 
-   @param[in, out] data The data array
+   where v is the receiver of u. With `output` initialized to zero and
+   `input` set to the distance from each pixel to its receiver, the
+   result is the longest flow distance from the channel heads.
+
+   @param[in,out] output The accumulated quantity
    @parblock
-   A pointer to an array of the desired type representing a node attribute list.
+   A pointer to a `float` array of size `node_count`
+   @endparblock
 
-   This must be at least as large as the largest index in either the
-   `source` or `target` arrays.
+   @param[in] input The increment along the edge leaving each pixel
+   @parblock
+   A pointer to a `float` array of size `node_count`
    @endparblock
 
-   @param[in] source The source node of each edge in the stream
-                     network
+   @param[in] receiver The receiver of each pixel
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The source nodes must be in topological order. The labels must
-   correspond to the 0-based indices of the node-attribute list
-   `data`.
+   receiver[u] is the pixel that u drains to, or u itself if u is a
+   sink. It is computed by flow_routing_d8_receivers().
    @endparblock
 
-   @param[in] target The target nodes of each edge in the stream
-                     network
+   @param[in] node The pixels in topological order
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `ptrdiff_t` array of size `node_count`
 
-   The labels must correspond to the 0-based indices of the
-   node-attribute list `data`.
+   This will typically be the `node` output of flow_routing_d8_carve().
    @endparblock
 
-   @param[in] edge_count The number of edges in the stream network
+   @param[in] node_count The number of pixels, `dims[0]` x `dims[1]`
  */
-TOPOTOOLBOX_API void propagatevaluesupstream_f32(float *data, ptrdiff_t *source,
-                                                 ptrdiff_t *target,
-                                                 ptrdiff_t edge_count);
+TOPOTOOLBOX_API
+void traverse_down_f32_max_add_receivers(float *output, float *input,
+                                         ptrdiff_t *receiver, ptrdiff_t *node,
+                                         ptrdiff_t node_count);
 
 /**
-   @brief Propagate `double` values upstream
-
-   @copydetails propagatevaluesupstream_f32()
- */
-TOPOTOOLBOX_API void propagatevaluesupstream_f64(double *data,
-                                                 ptrdiff_t *source,
-                                                 ptrdiff_t *target,
-                                                 ptrdiff_t edge_count);
+   @brief traverse_down_f32_max_add_receivers() with 32-bit node indices
 
-/**
-   @brief Propagate `uint8_t` values upstream
+   @details
+   The `receiver` and `node` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
 
-   @copydetails propagatevaluesupstream_f32()
+   @copydetails traverse_down_f32_max_add_receivers()
  */
-TOPOTOOLBOX_API void propagatevaluesupstream_u8(uint8_t *data,
-                                                ptrdiff_t *source,
-                                                ptrdiff_t *target,
-                                                ptrdiff_t edge_count);
+TOPOTOOLBOX_API
+void traverse_down_f32_max_add_receivers_idx32(float *output, float *input,
+                                               uint32_t *receiver,
+                                               uint32_t *node,
+                                               ptrdiff_t node_count);
 
 /**
-   @brief Propagate `uint32_t` values upstream
+   @brief Compute  the gradient for each cell in the provided DEM array.
+   The gradient is calculated as the maximum slope between the cell and its
+   8 neighboring cells. The result can be output in different units based on the
+   `unit` parameter, and the computation can be parallelized using OpenMP.
 
-   @copydetails propagatevaluesupstream_f32()
- */
-TOPOTOOLBOX_API void propagatevaluesupstream_u32(uint32_t *data,
-                                                 ptrdiff_t *source,
-                                                 ptrdiff_t *target,
-                                                 ptrdiff_t edge_count);
+   @param[out] output: Array to store the computed gradient values for each
+   cell. It should have the same dimensions as the DEM.
+   @param[in]  dem: Input digital elevation model as a 2D array flattened into a
+   1D array. This array represents the elevation values of each cell.
+   @param[in]  cellsize: The spatial resolution of the DEM (i.e., the size of
+   each cell).
+   @param[in]  use_mp: If set to 1, enables parallel processing using OpenMP.
+                       If set to 0, the function runs on a single thread.
+   @param[in]  dims: An array specifying the dimensions of the DEM.
+                     It should contain two values: [rows, columns].
+*/
+TOPOTOOLBOX_API
+void gradient8(float *output, const float *dem, float cellsize, int use_mp,
+               ptrdiff_t dims[2]);
 
 /**
-   @brief Propagate `uint64_t` values upstream
+   @brief Computes the gradient of a digital elevation model of type `double`
 
-   @copydetails propagatevaluesupstream_f32()
+   @copydetails gradient8()
  */
-TOPOTOOLBOX_API void propagatevaluesupstream_u64(uint64_t *data,
-                                                 ptrdiff_t *source,
-                                                 ptrdiff_t *target,
-                                                 ptrdiff_t edge_count);
+TOPOTOOLBOX_API
+void gradient8_f64(float *output, const double *dem, float cellsize, int use_mp,
+                   ptrdiff_t dims[2]);
 
 /**
-   @brief Propagate `int8_t` values upstream
+   @brief Computes the gradient of a digital elevation model of type `int16_t`
 
-   @copydetails propagatevaluesupstream_f32()
+   @copydetails gradient8()
+
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
  */
-TOPOTOOLBOX_API void propagatevaluesupstream_i8(int8_t *data, ptrdiff_t *source,
-                                                ptrdiff_t *target,
-                                                ptrdiff_t edge_count);
+TOPOTOOLBOX_API
+void gradient8_i16(float *output, const int16_t *dem, float cellsize,
+                   int use_mp, ptrdiff_t dims[2]);
 
 /**
-   @brief Propagate `int32_t` values upstream
+   @brief Computes the gradient of a digital elevation model of type `uint16_t`
 
-   @copydetails propagatevaluesupstream_f32()
+   @copydetails gradient8()
+
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
  */
-TOPOTOOLBOX_API void propagatevaluesupstream_i32(int32_t *data,
-                                                 ptrdiff_t *source,
-                                                 ptrdiff_t *target,
-                                                 ptrdiff_t edge_count);
+TOPOTOOLBOX_API
+void gradient8_u16(float *output, const uint16_t *dem, float cellsize,
+                   int use_mp, ptrdiff_t dims[2]);
 
 /**
-   @brief Propagate `int64_t` values upstream
+   @brief Performs a grayscale reconstruction of the `mask` image by the
+   `marker` image using the sequential reconstruction algorithm of Vincent
+   (1993).
 
-   @copydetails propagatevaluesupstream_f32()
- */
-TOPOTOOLBOX_API void propagatevaluesupstream_i64(int64_t *data,
-                                                 ptrdiff_t *source,
-                                                 ptrdiff_t *target,
-                                                 ptrdiff_t edge_count);
-/*
-  Graphflood
-*/
+   @param[out] marker: The marker array is updated with the result in-place.
+   @param[in]  mask: The array holding the mask (for example dem).
+   @param[in]  dims: An array specifying the dimensions of both used arrays.
+                     It should contain two values: [rows, columns].
 
-#define GF_UINT size_t
-#define GF_INT ptrdiff_t
-#define GF_FLOAT double
+   @return The number of forward and backward scan passes that were
+   performed. The scans stop after 1000 passes, so a return value of
+   1000 indicates that the reconstruction may not have converged.
+*/
+TOPOTOOLBOX_API
+int32_t reconstruct(float *marker, float *mask, ptrdiff_t dims[2]);
 
 /**
-   @brief Computes a single flow graph:
-   Receivers/Donors using the steepest descent method and topological
-   ordering following a modified Braun and Willett (2013)
+   @brief Performs a ggrayscale reconstruction using the hybrid
+   algorithm of Vincent(1993).
 
-   @param[in]  topo: the topographic surface
-   @param[out] Sreceivers: array of steepest receiver vectorised index
-   @param[out] distToReceivers: array of distance to steepest receiver
-   vectorised index
-   @param[out] Sdonors: array of donors to steepest receiver vectorised
-   index (index * (8 or 4) + 0:NSdonors[index] to get them)
-   @param[out] NSdonors: array of number of steepest donors (nodes having
-   this one as steepest receivers)
-   @param[out] Stack: topologically ordered list of nodes, from the
-   baselevel to the sources
-   @param[in]  BCs: codes for boundary conditions and no data management,
-   see gf_utils.h or examples for the meaning
-   @param[in]  dim: [rows,columns] if row major and [columns, rows] if
-   column major
-   @param[in]  dx: spatial step
-   @param[in]  D8: true for topology including cardinals + diagonals, false
-   for cardinals only
+   @param[out] marker: The marker array is updated with the result in-place.
+   @param[in]  queue: A ptrdiff_t array of the same size as the marker and mask
+   arrays.
+   @param[in]  mask: The array holding the mask (for example dem).
+   @param[in]  dims: An array specifying the dimensions of all used arrays.
+                     It should contain two values: [rows, columns].
 */
 TOPOTOOLBOX_API
-void compute_sfgraph(GF_FLOAT *topo, GF_UINT *Sreceivers,
-                     GF_FLOAT *distToReceivers, GF_UINT *Sdonors,
-                     uint8_t *NSdonors, GF_UINT *Stack, uint8_t *BCs,
-                     GF_UINT *dim, GF_FLOAT dx, bool D8);
+int reconstruct_hybrid(float *marker, ptrdiff_t *queue, float *mask,
+                       ptrdiff_t dims[2]);
 
 /**
-   @brief Compute the graphflood single flow graph and fills local minima using
-Priority Floods - Barnes 2014 (see compute_sfgraph for details)
-*/
+   @brief Performs a grayscale reconstruction by erosion of the `mask`
+   image by the `marker` image.
+
+   @details
+   This is the dual of reconstruct(): the marker is lowered towards
+   the mask instead of being raised. It is used by fillsinks() to fill
+   a DEM without negating it. The mask is not modified.
+
+   @param[out] marker: The marker array is updated with the result in-place.
+   @param[in]  mask: The array holding the mask (for example dem).
+   @param[in]  dims: An array specifying the dimensions of both used arrays.
+                     It should contain two values: [rows, columns].
+
+   @return The number of forward and backward scan passes that were
+   performed.
+*/
 TOPOTOOLBOX_API
-void compute_sfgraph_priority_flood(GF_FLOAT *topo, GF_UINT *Sreceivers,
-                                    GF_FLOAT *distToReceivers, GF_UINT *Sdonors,
-                                    uint8_t *NSdonors, GF_UINT *Stack,
-                                    uint8_t *BCs, GF_UINT *dim, GF_FLOAT dx,
-                                    bool D8, GF_FLOAT step);
+int32_t reconstruct_erosion(float *marker, const float *mask,
+                            ptrdiff_t dims[2]);
 
 /**
-   @brief Fills the depressions in place in the topography using Priority
-   Floods Barnes (2014, modified to impose a minimal slope)
+   @brief Performs a grayscale reconstruction by erosion of images of
+   type `double`
 
-   @param[inout]  topo: array of surface elevation
-   @param[in]     BCs: codes for boundary conditions and no data
-   management, see gf_utils.h or examples for the meaning
-   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
-   column major
-   @param[in]     D8: true for topology including cardinals + diagonals,
-   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
-   flats, false for cardinals only
-*/
+   @copydetails reconstruct_erosion()
+ */
 TOPOTOOLBOX_API
-void compute_priority_flood(GF_FLOAT *topo, uint8_t *BCs, GF_UINT *dim, bool D8,
-                            GF_FLOAT step);
+int32_t reconstruct_erosion_f64(double *marker, const double *mask,
+                                ptrdiff_t dims[2]);
 
 /**
-   @brief Fills the depressions in place in the topography using Priority
-   Floods Barnes (2014, modified to impose a minimal slope) This variant
-   computes the topological order on the go (slightly slower as it uses a
-   priority queue for all the nodes including in depressions)
+   @brief Performs a grayscale reconstruction by erosion of images of
+   type `int16_t`
 
-   @param[inout]  topo: array of surface elevation
-   @param[in]  Stack: topologically ordered list of nodes, from the
-   baselevel to the sources
-   @param[in]     BCs: codes for boundary conditions and no data
-   management, see gf_utils.h or examples for the meaning
-   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
-   column major
-   @param[in]     D8: true for topology including cardinals + diagonals,
-   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
-   flats, false for cardinals only
+   @copydetails reconstruct_erosion()
+
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+int32_t reconstruct_erosion_i16(int16_t *marker, const int16_t *mask,
+                                ptrdiff_t dims[2]);
+
+/**
+   @brief Performs a grayscale reconstruction by erosion of images of
+   type `uint16_t`
+
+   @copydetails reconstruct_erosion()
+
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+int32_t reconstruct_erosion_u16(uint16_t *marker, const uint16_t *mask,
+                                ptrdiff_t dims[2]);
+
+/**
+   @brief Performs a grayscale reconstruction by erosion using the
+   hybrid algorithm of Vincent(1993).
+
+   @details
+   This is the dual of reconstruct_hybrid(). The mask is not modified.
+
+   @param[out] marker: The marker array is updated with the result in-place.
+   @param[in]  queue: A ptrdiff_t array of the same size as the marker and mask
+   arrays.
+   @param[in]  mask: The array holding the mask (for example dem).
+   @param[in]  dims: An array specifying the dimensions of all used arrays.
+                     It should contain two values: [rows, columns].
 */
 TOPOTOOLBOX_API
-void compute_priority_flood_plus_topological_ordering(GF_FLOAT *topo,
-                                                      GF_UINT *Stack,
-                                                      uint8_t *BCs,
-                                                      GF_UINT *dim, bool D8,
-                                                      GF_FLOAT step);
+int reconstruct_erosion_hybrid(float *marker, ptrdiff_t *queue,
+                               const float *mask, ptrdiff_t dims[2]);
 
 /**
-   @brief Accumulate single flow drainage area downstream from a calculated
-   graphflood single flow graph
-   @param[out] output: the field of drainage area
-   @param[in]  Sreceivers: array of steepest receiver vectorised index
-   @param[in]  Stack: topologically ordered list of nodes, from the
-   baselevel to the sources
-   @param[in]  dim: [rows,columns] if row major and [columns, rows] if
-   column major
-   @param[in]  dx: spatial step
+   @brief Performs a hybrid grayscale reconstruction by erosion of
+   images of type `double`
+
+   @copydetails reconstruct_erosion_hybrid()
+ */
+TOPOTOOLBOX_API
+int reconstruct_erosion_hybrid_f64(double *marker, ptrdiff_t *queue,
+                                   const double *mask, ptrdiff_t dims[2]);
+
+/**
+   @brief Performs a hybrid grayscale reconstruction by erosion of
+   images of type `int16_t`
+
+   @copydetails reconstruct_erosion_hybrid()
+
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+int reconstruct_erosion_hybrid_i16(int16_t *marker, ptrdiff_t *queue,
+                                   const int16_t *mask, ptrdiff_t dims[2]);
+
+/**
+   @brief Performs a hybrid grayscale reconstruction by erosion of
+   images of type `uint16_t`
+
+   @copydetails reconstruct_erosion_hybrid()
+
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+int reconstruct_erosion_hybrid_u16(uint16_t *marker, ptrdiff_t *queue,
+                                   const uint16_t *mask, ptrdiff_t dims[2]);
+
+/**
+   @brief Completes a grayscale reconstruction by erosion from a set of
+   seed pixels.
+
+   @details
+   Each seed is lowered as far as its neighbors allow and the changes
+   are propagated to the rest of the image with a breadth-first
+   search. Only the seed pixels and the pixels they lower are visited,
+   so the cost depends on the size of the changed region rather than
+   on the size of the image. Every pixel that is not a seed must
+   already satisfy `marker[p] <= max(mask[p], marker[q])` for all of
+   its neighbors `q` that are not seeds. This is the case, for example, if
+   the marker is the result of a previous reconstruction and only the
+   seeds have been changed. Used by fillsinks_incremental().
+
+   @param[out] marker: The marker array is updated with the result in-place.
+   @param[in]  queue: A ptrdiff_t array of the same size as the marker and mask
+   arrays. Its first `seed_count` elements are the linear indices of the
+   seeds.
+   @param[in]  seed_count: The number of seeds.
+   @param[in]  mask: The array holding the mask (for example dem).
+   @param[in]  dims: An array specifying the dimensions of all used arrays.
+                     It should contain two values: [rows, columns].
 */
 TOPOTOOLBOX_API
-void compute_drainage_area_single_flow(GF_FLOAT *output, GF_UINT *Sreceivers,
-                                       GF_UINT *Stack, GF_UINT *dim,
-                                       GF_FLOAT dx);
+void reconstruct_erosion_seeded(float *marker, ptrdiff_t *queue,
+                                ptrdiff_t seed_count, const float *mask,
+                                ptrdiff_t dims[2]);
+
+/**
+   @brief Completes a grayscale reconstruction by erosion of images of
+   type `double` from a set of seed pixels
+
+   @copydetails reconstruct_erosion_seeded()
+ */
+TOPOTOOLBOX_API
+void reconstruct_erosion_seeded_f64(double *marker, ptrdiff_t *queue,
+                                    ptrdiff_t seed_count, const double *mask,
+                                    ptrdiff_t dims[2]);
+
+/**
+   @brief Completes a grayscale reconstruction by erosion of images of
+   type `int16_t` from a set of seed pixels
+
+   @copydetails reconstruct_erosion_seeded()
+
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void reconstruct_erosion_seeded_i16(int16_t *marker, ptrdiff_t *queue,
+                                    ptrdiff_t seed_count, const int16_t *mask,
+                                    ptrdiff_t dims[2]);
+
+/**
+   @brief Completes a grayscale reconstruction by erosion of images of
+   type `uint16_t` from a set of seed pixels
+
+   @copydetails reconstruct_erosion_seeded()
+
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void reconstruct_erosion_seeded_u16(uint16_t *marker, ptrdiff_t *queue,
+                                    ptrdiff_t seed_count, const uint16_t *mask,
+                                    ptrdiff_t dims[2]);
+
+/**
+   @brief Integrate a `float` quantity over a stream network using
+   trapezoidal integration.
+
+   @param[out] integral The integrated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   If the stream network has N nodes, this array should have a length
+   N. This value must not be less than the largest value in either the
+   `source` or `target` arrays.
+   @endparblock
+
+   @param[in] integrand The quantity to be integrated
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   If the stream network has N nodes, this array should have a length
+   N. This value must not be less than the largest value in either the
+   `source` or `target` arrays.
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the nodes in the
+   node-attribute lists `integral` and `integrand`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the nodes in
+   the node-attribute lists `integral` and `integrand`.
+   @endparblock
+
+   @param[in] weight The weight assigned to each edge in the stream network
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+
+   For most applications of integration along the stream network, this
+   will be the geometric distance between the source and target pixels
+   in the desired units.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void streamquad_trapz_f32(float *integral, float *integrand, ptrdiff_t *source,
+                          ptrdiff_t *target, float *weight,
+                          ptrdiff_t edge_count);
+
+/**
+   @brief streamquad_trapz_f32() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails streamquad_trapz_f32()
+ */
+TOPOTOOLBOX_API
+void streamquad_trapz_f32_idx32(float *integral, float *integrand,
+                                uint32_t *source, uint32_t *target,
+                                float *weight, ptrdiff_t edge_count);
+
+TOPOTOOLBOX_API
+void streamquad_trapz_f64(double *integral, double *integrand,
+                          ptrdiff_t *source, ptrdiff_t *target, float *weight,
+                          ptrdiff_t edge_count);
+
+/**
+   @brief streamquad_trapz_f64() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails streamquad_trapz_f32()
+ */
+TOPOTOOLBOX_API
+void streamquad_trapz_f64_idx32(double *integral, double *integrand,
+                                uint32_t *source, uint32_t *target,
+                                float *weight, ptrdiff_t edge_count);
+
+/**
+   @brief Upstream traversal in the (or, and) semiring
+
+   Traverses the stream network in the upstream direction,
+   accumulating the values in `output` with edge weights given by the
+   `weights` array. The weights are applied with a bitwise and and
+   accumulated with a bitwise or.
+
+   ```
+   for (e = (u,v) in edges:
+     output[u] = output[u] | (output[v] & input[e]);
+   ```
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `uint32_t` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] weights The edge weights
+   @parblock
+   A pointer to a `uint32_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   This array should have length `edge_count`.
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute lists `output`
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_up_u32_or_and(uint32_t *output, uint32_t *weights,
+                            ptrdiff_t *source, ptrdiff_t *target,
+                            ptrdiff_t edge_count);
+
+/**
+   @brief traverse_up_u32_or_and() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_up_u32_or_and()
+ */
+TOPOTOOLBOX_API
+void traverse_up_u32_or_and_idx32(uint32_t *output, uint32_t *input,
+                                  uint32_t *source, uint32_t *target,
+                                  ptrdiff_t edge_count);
+
+/**
+   @brief Downstream traversal in the Boolean ({0,1}, or, and) semiring
+
+   Accumulates the input node attribute list downstream using bitwise or
+   with multiplication given by bitwise and:
+
+   for e = (u=>v) in edges:
+     output[v] = output[v] | output[u] & input[e];
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `uint32_t` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `uint32_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_down_u32_or_and(uint32_t *output, uint32_t *input,
+                              ptrdiff_t *source, ptrdiff_t *target,
+                              ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_u32_or_and() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_u32_or_and()
+ */
+TOPOTOOLBOX_API
+void traverse_down_u32_or_and_idx32(uint32_t *output, uint32_t *input,
+                                    uint32_t *source, uint32_t *target,
+                                    ptrdiff_t edge_count);
+
+/**
+   @brief Upstream traversal in the (or, and) semiring
+
+   Traverses the stream network in the upstream direction,
+   accumulating the values in `output` with edge weights given by the
+   `weights` array. The weights are applied with a bitwise and and
+   accumulated with a bitwise or.
+
+   ```
+   for (e = (u,v) in edges:
+     output[u] = output[u] | (output[v] & input[e]);
+   ```
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `uint8_t` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] weights The edge weights
+   @parblock
+   A pointer to a `uint8_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   This array should have length `edge_count`.
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute lists `output`
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_up_u8_or_and(uint8_t *output, uint8_t *weights, ptrdiff_t *source,
+                           ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_up_u8_or_and() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_up_u8_or_and()
+ */
+TOPOTOOLBOX_API
+void traverse_up_u8_or_and_idx32(uint8_t *output, uint8_t *input,
+                                 uint32_t *source, uint32_t *target,
+                                 ptrdiff_t edge_count);
+
+/**
+   @brief Downstream traversal in the Boolean ({0,1}, or, and) semiring
+
+   Accumulates the input node attribute list downstream using bitwise or
+   with multiplication given by bitwise and:
+
+   for e = (u=>v) in edges:
+     output[v] = output[v] | output[u] & input[e];
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `uint8_t` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `uint8_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_down_u8_or_and(uint8_t *output, uint8_t *input, ptrdiff_t *source,
+                             ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_u8_or_and() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_u8_or_and()
+ */
+TOPOTOOLBOX_API
+void traverse_down_u8_or_and_idx32(uint8_t *output, uint8_t *input,
+                                   uint32_t *source, uint32_t *target,
+                                   ptrdiff_t edge_count);
+
+/**
+   @brief Downstream traversal with max-plus
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a max-plus update:
+
+   for (e = (u,v)) in edges:
+     output[v] = max(output[v], output[u] + input[e]);
+
+   With input giving the length of each edge and output initialized to
+   zero, this will compute the longest path from the outlet to a
+   source node.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_max_add(float *output, float *input, ptrdiff_t *source,
+                               ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_f32_max_add() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_f32_max_add()
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_max_add_idx32(float *output, float *input,
+                                     uint32_t *source, uint32_t *target,
+                                     ptrdiff_t edge_count);
+
+/**
+   @brief Upstream traversal with max-plus
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a max-plus update.
+
+   With input giving the length of each edge and output initialized to
+   zero, this will compute the longest path from the outlet to a
+   source node.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_up_f32_max_add(float *output, float *input, ptrdiff_t *source,
+                             ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_up_f32_max_add() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_up_f32_max_add()
+ */
+TOPOTOOLBOX_API
+void traverse_up_f32_max_add_idx32(float *output, float *input,
+                                   uint32_t *source, uint32_t *target,
+                                   ptrdiff_t edge_count);
+
+/**
+   @brief Downstream traversal with max-mul
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a max-mul update.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_max_mul(float *output, float *input, ptrdiff_t *source,
+                               ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_f32_max_mul() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_f32_max_mul()
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_max_mul_idx32(float *output, float *input,
+                                     uint32_t *source, uint32_t *target,
+                                     ptrdiff_t edge_count);
+
+/**
+   @brief Downstream traversal with max-mul and maximum tracking
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a max-mul update.
+
+   The idx array can be used to track the index of the maximum
+   value. It should be initialized with the index of each node in the
+   array. If the upstream value multiplied by the input is greater
+   than the downstream value, the upstream index is copied into the
+   downstream index.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[out] idx The index of the maximum value
+   @parblock
+   A pointer to an `int64_t` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_max_mul_arg(float *output, int64_t *idx, float *input,
+                                   ptrdiff_t *source, ptrdiff_t *target,
+                                   ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_f32_max_mul_arg() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_f32_max_mul_arg()
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_max_mul_arg_idx32(float *output, int64_t *idx,
+                                         float *input, uint32_t *source,
+                                         uint32_t *target,
+                                         ptrdiff_t edge_count);
+
+/**
+   @brief Upstream traversal with max-mul
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a max-mul update.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_up_f32_max_mul(float *output, float *input, ptrdiff_t *source,
+                             ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_up_f32_max_mul() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_up_f32_max_mul()
+ */
+TOPOTOOLBOX_API
+void traverse_up_f32_max_mul_idx32(float *output, float *input,
+                                   uint32_t *source, uint32_t *target,
+                                   ptrdiff_t edge_count);
+
+/**
+   @brief Upstream traversal with max-mul and maximum tracking
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a max-mul update.
+
+   The idx array can be used to track the index of the maximum
+   value. It should be initialized with the index of each node in the
+   array. If the upstream value multiplied by the input is greater
+   than the downstream value, the upstream index is copied into the
+   downstream index.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[out] idx The index of the maximum value
+   @parblock
+   A pointer to an `int64_t` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_up_f32_max_mul_arg(float *output, int64_t *idx, float *input,
+                                 ptrdiff_t *source, ptrdiff_t *target,
+                                 ptrdiff_t edge_count);
+
+/**
+   @brief traverse_up_f32_max_mul_arg() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_up_f32_max_mul_arg()
+ */
+TOPOTOOLBOX_API
+void traverse_up_f32_max_mul_arg_idx32(float *output, int64_t *idx,
+                                       float *input, uint32_t *source,
+                                       uint32_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief Downstream traversal with min-plus
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a min-plus update:
+
+   for (e = (u,v)) in edges:
+     output[v] = min(output[v], output[u] + input[e]);
+
+   With input giving the length of each edge and output initialized to
+   zero, this will compute the shortest path from the outlet to a
+   source node.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_min_add(float *output, float *input, ptrdiff_t *source,
+                               ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_f32_min_add() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_f32_min_add()
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_min_add_idx32(float *output, float *input,
+                                     uint32_t *source, uint32_t *target,
+                                     ptrdiff_t edge_count);
+
+/**
+   @brief Downstream traversal with multiply-add
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a multiply-add update:
+
+   for (e = (u,v)) in edges:
+     output[v] = output[v] + output[u] * input[e];
+
+   With input giving the flow fraction of each edge and output
+   initialized to ones, this will compute the flow accumulation.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_add_mul(float *output, float *input, ptrdiff_t *source,
+                               ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_f32_add_mul() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_f32_add_mul()
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_add_mul_idx32(float *output, float *input,
+                                     uint32_t *source, uint32_t *target,
+                                     ptrdiff_t edge_count);
+
+/**
+   @brief Downstream traversal with multiply-add
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a multiply-add update:
+
+   for (e = (u,v)) in edges:
+     output[v] = output[v] + output[u] * input[e];
+
+   With input giving the flow fraction of each edge and output
+   initialized to ones, this will compute the flow accumulation.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `double` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `double` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void traverse_down_f64_add_mul(double *output, double *input, ptrdiff_t *source,
+                               ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_f64_add_mul() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_f64_add_mul()
+ */
+TOPOTOOLBOX_API
+void traverse_down_f64_add_mul_idx32(double *output, double *input,
+                                     uint32_t *source, uint32_t *target,
+                                     ptrdiff_t edge_count);
+
+/**
+   @brief Compute the in- and outdegrees of each node in a graph
+
+   @param[out] indegree The indegree of each node in the stream network
+   @parblock
+   A pointer to a `uint8_t` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[out] outdegree The outdegree of each node in the stream network
+   @parblock
+   A pointer to a `uint8_t` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `indegree` and `outdegree`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute lists `indegree` and `outdegree`.
+   @endparblock
+
+   @param[in] node_count The number of nodes in the stream network
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API
+void edgelist_degree(uint8_t *indegree, uint8_t *outdegree, ptrdiff_t *source,
+                     ptrdiff_t *target, ptrdiff_t node_count,
+                     ptrdiff_t edge_count);
+
+/**
+   @brief Compute stream order of Stream Object using Strahler method
+
+   Accumulates the edge weights in the `input` edge attribute list
+   using a multiply-add update:
+
+   for (e = (u,v)) in edges:
+     output[v] = output[v] + output[u] * input[e];
+
+   With input giving the flow fraction of each edge and output
+   initialized to ones, this will compute the flow accumulation.
+
+   @param[out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+
+   This array should have a length equal to the number of nodes in the
+   stream network.  This value must not be less than the largest value
+   in either the `source` or `target` arrays.
+   @endparblock
+
+   @param[in] input The edge weights
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `output`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `output`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+
+TOPOTOOLBOX_API
+void traverse_down_f32_strahler(float *output, float *input, ptrdiff_t *source,
+                                ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief traverse_down_f32_strahler() with 32-bit node indices
+
+   @details
+   The `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails traverse_down_f32_strahler()
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_strahler_idx32(float *output, float *input,
+                                      uint32_t *source, uint32_t *target,
+                                      ptrdiff_t edge_count);
+
+/**
+   @brief Propagate `float` values upstream
+
+   The values in the `data` node attribute list are copied to their
+   upstream neighbors according to the edges contained in the `source`
+   and `target` arrays.
+
+   Nodes with no downstream neighbors should be initialized in the
+   `data` array with the values to be propagated upstream. The
+   upstream values will be overwritten.
+
+   @param[in, out] data The data array
+   @parblock
+   A pointer to an array of the desired type representing a node attribute list.
+
+   This must be at least as large as the largest index in either the
+   `source` or `target` arrays.
+   @endparblock
+
+   @param[in] source The source node of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in topological order. The labels must
+   correspond to the 0-based indices of the node-attribute list
+   `data`.
+   @endparblock
+
+   @param[in] target The target nodes of each edge in the stream
+                     network
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The labels must correspond to the 0-based indices of the
+   node-attribute list `data`.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the stream network
+ */
+TOPOTOOLBOX_API void propagatevaluesupstream_f32(float *data, ptrdiff_t *source,
+                                                 ptrdiff_t *target,
+                                                 ptrdiff_t edge_count);
+
+/**
+   @brief Propagate `double` values upstream
+
+   @copydetails propagatevaluesupstream_f32()
+ */
+TOPOTOOLBOX_API void propagatevaluesupstream_f64(double *data,
+                                                 ptrdiff_t *source,
+                                                 ptrdiff_t *target,
+                                                 ptrdiff_t edge_count);
+
+/**
+   @brief Propagate `uint8_t` values upstream
+
+   @copydetails propagatevaluesupstream_f32()
+ */
+TOPOTOOLBOX_API void propagatevaluesupstream_u8(uint8_t *data,
+                                                ptrdiff_t *source,
+                                                ptrdiff_t *target,
+                                                ptrdiff_t edge_count);
+
+/**
+   @brief Propagate `uint32_t` values upstream
+
+   @copydetails propagatevaluesupstream_f32()
+ */
+TOPOTOOLBOX_API void propagatevaluesupstream_u32(uint32_t *data,
+                                                 ptrdiff_t *source,
+                                                 ptrdiff_t *target,
+                                                 ptrdiff_t edge_count);
+
+/**
+   @brief Propagate `uint64_t` values upstream
+
+   @copydetails propagatevaluesupstream_f32()
+ */
+TOPOTOOLBOX_API void propagatevaluesupstream_u64(uint64_t *data,
+                                                 ptrdiff_t *source,
+                                                 ptrdiff_t *target,
+                                                 ptrdiff_t edge_count);
+
+/**
+   @brief Propagate `int8_t` values upstream
+
+   @copydetails propagatevaluesupstream_f32()
+ */
+TOPOTOOLBOX_API void propagatevaluesupstream_i8(int8_t *data, ptrdiff_t *source,
+                                                ptrdiff_t *target,
+                                                ptrdiff_t edge_count);
+
+/**
+   @brief Propagate `int32_t` values upstream
+
+   @copydetails propagatevaluesupstream_f32()
+ */
+TOPOTOOLBOX_API void propagatevaluesupstream_i32(int32_t *data,
+                                                 ptrdiff_t *source,
+                                                 ptrdiff_t *target,
+                                                 ptrdiff_t edge_count);
+
+/**
+   @brief Propagate `int64_t` values upstream
+
+   @copydetails propagatevaluesupstream_f32()
+ */
+TOPOTOOLBOX_API void propagatevaluesupstream_i64(int64_t *data,
+                                                 ptrdiff_t *source,
+                                                 ptrdiff_t *target,
+                                                 ptrdiff_t edge_count);
+/*
+  Graphflood
+*/
+
+#define GF_UINT size_t
+#define GF_INT ptrdiff_t
+#define GF_FLOAT double
+
+/**
+   @brief Computes a single flow graph:
+   Receivers/Donors using the steepest descent method and topological
+   ordering following a modified Braun and Willett (2013)
+
+   @param[in]  topo: the topographic surface
+   @param[out] Sreceivers: array of steepest receiver vectorised index
+   @param[out] distToReceivers: array of distance to steepest receiver
+   vectorised index
+   @param[out] Sdonors: array of donors to steepest receiver vectorised
+   index (index * (8 or 4) + 0:NSdonors[index] to get them)
+   @param[out] NSdonors: array of number of steepest donors (nodes having
+   this one as steepest receivers)
+   @param[out] Stack: topologically ordered list of nodes, from the
+   baselevel to the sources
+   @param[in]  BCs: codes for boundary conditions and no data management,
+   see gf_utils.h or examples for the meaning
+   @param[in]  dim: [rows,columns] if row major and [columns, rows] if
+   column major
+   @param[in]  dx: spatial step
+   @param[in]  D8: true for topology including cardinals + diagonals, false
+   for cardinals only
+*/
+TOPOTOOLBOX_API
+void compute_sfgraph(GF_FLOAT *topo, GF_UINT *Sreceivers,
+                     GF_FLOAT *distToReceivers, GF_UINT *Sdonors,
+                     uint8_t *NSdonors, GF_UINT *Stack, uint8_t *BCs,
+                     GF_UINT *dim, GF_FLOAT dx, bool D8);
+
+/**
+   @brief Compute the graphflood single flow graph and fills local minima using
+Priority Floods - Barnes 2014 (see compute_sfgraph for details)
+*/
+TOPOTOOLBOX_API
+void compute_sfgraph_priority_flood(GF_FLOAT *topo, GF_UINT *Sreceivers,
+                                    GF_FLOAT *distToReceivers, GF_UINT *Sdonors,
+                                    uint8_t *NSdonors, GF_UINT *Stack,
+                                    uint8_t *BCs, GF_UINT *dim, GF_FLOAT dx,
+                                    bool D8, GF_FLOAT step);
+
+/**
+   @brief Fills the depressions in place in the topography using Priority
+   Floods Barnes (2014, modified to impose a minimal slope)
+
+   @param[inout]  topo: array of surface elevation
+   @param[in]     BCs: codes for boundary conditions and no data
+   management, see gf_utils.h or examples for the meaning
+   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
+   column major
+   @param[in]     D8: true for topology including cardinals + diagonals,
+   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
+   flats, false for cardinals only
+*/
+TOPOTOOLBOX_API
+void compute_priority_flood(GF_FLOAT *topo, uint8_t *BCs, GF_UINT *dim, bool D8,
+                            GF_FLOAT step);
+
+/**
+   @brief Fills the depressions in place in the topography using Priority
+   Floods Barnes (2014, modified to impose a minimal slope) This variant
+   computes the topological order on the go (slightly slower as it uses a
+   priority queue for all the nodes including in depressions)
+
+   @param[inout]  topo: array of surface elevation
+   @param[in]  Stack: topologically ordered list of nodes, from the
+   baselevel to the sources
+   @param[in]     BCs: codes for boundary conditions and no data
+   management, see gf_utils.h or examples for the meaning
+   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
+   column major
+   @param[in]     D8: true for topology including cardinals + diagonals,
+   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
+   flats, false for cardinals only
+*/
+TOPOTOOLBOX_API
+void compute_priority_flood_plus_topological_ordering(GF_FLOAT *topo,
+                                                      GF_UINT *Stack,
+                                                      uint8_t *BCs,
+                                                      GF_UINT *dim, bool D8,
+                                                      GF_FLOAT step);
+
+/**
+   @brief Accumulate single flow drainage area downstream from a calculated
+   graphflood single flow graph
+   @param[out] output: the field of drainage area
+   @param[in]  Sreceivers: array of steepest receiver vectorised index
+   @param[in]  Stack: topologically ordered list of nodes, from the
+   baselevel to the sources
+   @param[in]  dim: [rows,columns] if row major and [columns, rows] if
+   column major
+   @param[in]  dx: spatial step
+*/
+TOPOTOOLBOX_API
+void compute_drainage_area_single_flow(GF_FLOAT *output, GF_UINT *Sreceivers,
+                                       GF_UINT *Stack, GF_UINT *dim,
+                                       GF_FLOAT dx);
+
+/**
+   @brief Accumulate single flow drainage area downstream from a calculated
+   graphflood single flow graph weighted by an arbitrary input (e.g.
+   Precipitation rates to get effective discharge)
+   @param[out] output: the field of drainage area
+   @param[in]  weights: node-wise weights
+   @param[in]  Sreceivers: array of steepest receiver vectorised index
+   @param[in]  Stack: topologically ordered list of nodes, from the
+   baselevel to the sources
+   @param[in]  dim: [rows,columns] if row major and [columns, rows] if
+   column major
+   @param[in]  dx: spatial step
+*/
+TOPOTOOLBOX_API
+void compute_weighted_drainage_area_single_flow(GF_FLOAT *output,
+                                                GF_FLOAT *weights,
+                                                GF_UINT *Sreceivers,
+                                                GF_UINT *Stack, GF_UINT *dim,
+                                                GF_FLOAT dx);
+
+/**
+   @brief Run N iteration of graphflood as described in Gailleton et al.,
+   2024. From an input field of topography, optional original flow depth,
+   mannings friction coefficient and precipitation rates, calculates the field
+   of flow depth following a steady flow assumption.
+
+   @param[in]     Z: surface topography
+   @param[inout]  hw: field of flow depth
+   @param[in]     BCs: codes for boundary conditions and no data
+   management, see gf_utils.h or examples for the meaning
+   @param[in]     Precipitations: Precipitation rates
+   @param[in]     manning: friction coefficient
+   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
+   column major
+   @param[in]     dt: time step
+   @param[in]     dx: spatial step
+   @param[in]     SFD: single flow direction if True, multiple flow if
+   false
+   @param[in]     D8: true for topology including cardinals + diagonals,
+   false for cardinals only
+   @param[in]     N_iterations: number of iterations of the flooding algorithm
+   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
+   flats, false for cardinals only
+*/
+TOPOTOOLBOX_API
+void graphflood_full(GF_FLOAT *Z, GF_FLOAT *hw, uint8_t *BCs,
+                     GF_FLOAT *Precipitations, GF_FLOAT *manning, GF_UINT *dim,
+                     GF_FLOAT dt, GF_FLOAT dx, bool SFD, bool D8,
+                     GF_UINT N_iterations, GF_FLOAT step);
+
+/**
+   @brief Calculate steady-state flow metrics from topography and water depths
+   using the GraphFlood algorithm as described in Gailleton et al., 2024.
+   From input fields of topography, water depth, Manning's friction coefficient
+   and precipitation rates, computes various flow metrics assuming steady-state
+   conditions with multiple flow direction routing.
+
+   @param[in]     Z: surface topography [m]
+   @param[in]     hw: field of water depth [m]
+   @param[in]     BCs: codes for boundary conditions and no data management,
+                  see gf_utils.h or examples for the meaning
+   @param[in]     Precipitations: precipitation rates [m/s]
+   @param[in]     manning: Manning's friction coefficient [s/m^(1/3)]
+   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
+                  column major
+   @param[in]     dx: spatial step [m]
+   @param[in]     D8: true for topology including cardinals + diagonals,
+                  false for cardinals only
+   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
+                  flats during priority flooding
+   @param[out]    Qi: input discharge based on drainage area accumulation [m³/s]
+   @param[out]    Qo: output discharge calculated from Manning's equation [m³/s]
+   @param[out]    qo: discharge per unit width [m²/s]
+   @param[out]    u: flow velocity [m/s]
+   @param[out]    Sw: water surface slope [-]
+
+   @note At convergence, Qi should approximately equal Qo (mass conservation).
+   Differences may indicate numerical issues, local instabilities, or physical
+   processes such as ponding in lakes or depressions.
+*/
+TOPOTOOLBOX_API
+void graphflood_metrics(GF_FLOAT *Z, GF_FLOAT *hw, uint8_t *BCs,
+                        GF_FLOAT *Precipitations, GF_FLOAT *manning,
+                        GF_UINT *dim, GF_FLOAT dx, bool D8, GF_FLOAT step,
+                        GF_FLOAT *Qi, GF_FLOAT *Qo, GF_FLOAT *qo, GF_FLOAT *u,
+                        GF_FLOAT *Sw);
+
+/**
+   @brief Run dynamic induced graph flood simulation using wavefront propagation
+   from specified input discharge locations. Processes cells in descending
+   hydraulic elevation order, dynamically building the flow graph as it
+   propagates downstream.
+
+   @param[in]     Z: surface topography [m]
+   @param[inout]  hw: field of water depth [m]
+   @param[in]     BCs: codes for boundary conditions and no data management
+   @param[in]     Precipitations: precipitation rates [m/s]
+   @param[in]     manning: Manning's friction coefficient [s/m^(1/3)]
+   @param[in]     input_Qw: input discharge at specific cells [m³/s]
+                  (cells with value > 0 are used as starting points)
+   @param[inout]  Qwin: accumulated input discharge array [m³/s]
+                  (pre-allocated array of size dim[0] * dim[1], reinitialized
+   each iteration)
+   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
+                  column major
+   @param[in]     dt: time step [s]
+   @param[in]     dx: spatial step [m]
+   @param[in]     D8: true for topology including cardinals + diagonals,
+                  false for cardinals only
+   @param[in]     N_iterations: number of iterations of the flooding algorithm
+*/
+TOPOTOOLBOX_API
+void graphflood_dynamic_graph(GF_FLOAT *Z, GF_FLOAT *hw, uint8_t *BCs,
+                              GF_FLOAT *Precipitations, GF_FLOAT *manning,
+                              GF_FLOAT *input_Qw, GF_FLOAT *Qwin, GF_UINT *dim,
+                              GF_FLOAT dt, GF_FLOAT dx, bool D8,
+                              GF_UINT N_iterations);
+
+/**
+   @brief Compute input discharge array for dynamic graph from drainage area
+   threshold. Identifies channel heads where drainage area crosses a threshold
+   and assigns precipitation-weighted discharge at those entry points.
+
+   @param[out]    input_Qw: input discharge array to fill [m³/s]
+                  (pre-allocated array of size dim[0] * dim[1])
+   @param[in]     Z: surface topography [m]
+   @param[in]     hw: field of water depth [m]
+   @param[in]     BCs: codes for boundary conditions and no data management
+   @param[in]     Precipitations: precipitation rates [m/s]
+   @param[in]     area_threshold: drainage area threshold for entry points [m²]
+   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
+                  column major
+   @param[in]     dx: spatial step [m]
+   @param[in]     D8: true for topology including cardinals + diagonals,
+                  false for cardinals only
+   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
+                  flats during priority flooding
+*/
+TOPOTOOLBOX_API
+void compute_input_Qw_from_area_threshold(GF_FLOAT *input_Qw, GF_FLOAT *Z,
+                                          GF_FLOAT *hw, uint8_t *BCs,
+                                          GF_FLOAT *Precipitations,
+                                          GF_FLOAT area_threshold, GF_UINT *dim,
+                                          GF_FLOAT dx, bool D8, GF_FLOAT step);
+
+/**
+   @brief Label drainage basins based on the flow directions provided
+   by a topologically sorted edge list.
+
+   @param[out] basins The drainage basin label
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   @endparblock
+
+   @param[out] source The source pixel for each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] target The target pixel for each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] edge_count The number of edges in the flow network
+   @parblock
+   A ptrdiff_t representing the length of the `source` and `target` arrays
+   @endparblock
+
+   @param[in] dims The dimensions of the arrays
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 2
+
+   The fastest changing dimension should be provided first. For column-major
+   arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void drainagebasins(ptrdiff_t *basins, ptrdiff_t *source, ptrdiff_t *target,
+                    ptrdiff_t edge_count, ptrdiff_t dims[2]);
+
+/**
+   @brief drainagebasins() with 32-bit node indices
+
+   @details
+   The `basins`, `source` and `target` arrays hold
+   `uint32_t` instead of `ptrdiff_t` indices, so the grid must have
+   fewer than 2^32 pixels.
+
+   @copydetails drainagebasins()
+ */
+TOPOTOOLBOX_API
+void drainagebasins_idx32(uint32_t *basins, uint32_t *source, uint32_t *target,
+                          ptrdiff_t edge_count, ptrdiff_t dims[2]);
+
+/**
+   @brief Partition a topologically sorted edge list by drainage basin
+
+   @details
+   Reorders the edges into one contiguous segment per drainage basin
+   so that the *_parallel traversal kernels can process the basins
+   independently. The segments are sorted by decreasing number of
+   edges, and the relative order of the edges within each segment is
+   preserved, so every segment remains topologically sorted.
+
+   The edge list may describe a single or a multiple flow network. In
+   a multiple flow network, the basins are the weakly connected
+   components of the network: two nodes share a basin if they are
+   joined by a chain of edges regardless of their direction, so that
+   no two segments ever write to the same node.
+
+   @param[out] segment_offsets The first edge of each segment
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count + 1`
+
+   The edges of segment s are `segment_offsets[s]` to
+   `segment_offsets[s + 1] - 1`. Only the first `segment_count + 1`
+   elements are written.
+   @endparblock
+
+   @param[out] permutation The original index of each partitioned edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   Edge attributes are reordered with
+   `partitioned[e] = original[permutation[e]]`.
+   @endparblock
+
+   @param[out] partitioned_source The source node of each partitioned edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[out] partitioned_target The target node of each partitioned edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[out] basins The drainage basin label of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+
+   For a single flow network, the labels are identical to those
+   computed by drainagebasins(). Nodes without any edges are labeled
+   0.
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The edges must be in topological order.
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] edge_count The number of edges
+
+   @param[in] node_count The number of nodes
+
+   @return The number of segments, which equals the number of drainage
+   basins, or -1 if memory could not be allocated.
+ */
+TOPOTOOLBOX_API
+ptrdiff_t edgelist_partition_basins(ptrdiff_t *segment_offsets,
+                                    ptrdiff_t *permutation,
+                                    ptrdiff_t *partitioned_source,
+                                    ptrdiff_t *partitioned_target,
+                                    ptrdiff_t *basins, ptrdiff_t *source,
+                                    ptrdiff_t *target, ptrdiff_t edge_count,
+                                    ptrdiff_t node_count);
+
+/**
+   @brief Compute flow accumulation on a basin-partitioned edge list
+   using multiple threads
+
+   @details
+   The basin segments are processed in parallel, each by a single
+   thread. The `fraction` array must be in the order of the
+   partitioned edge list, which can be obtained by gathering it
+   through the `permutation` output of edgelist_partition_basins().
+   The result is identical to that of flow_accumulation_edgelist().
+
+   @param[out] acc The computed flow accumulation
+   @parblock
+   A pointer to a `float` array of size `node_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_source` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_target` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] fraction The fraction of flow transported along each edge
+   @parblock
+   A pointer to a `float` array of size `segment_offsets[segment_count]`
+   @endparblock
+
+   @param[in] weights Initial water depths
+   @parblock
+   A pointer to a `float` array of size `node_count`
+
+   If a null pointer is passed, a default weight of 1.0 for every
+   node is used.
+   @endparblock
+
+   @param[in] segment_offsets The first edge of each basin segment
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_count + 1`
+
+   As produced by edgelist_partition_basins(). The edges of segment s
+   are `segment_offsets[s]` to `segment_offsets[s + 1] - 1`.
+   @endparblock
+
+   @param[in] segment_count The number of segments
+   @parblock
+   The value returned by edgelist_partition_basins().
+   @endparblock
+
+   @param[in] node_count The number of nodes
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void flow_accumulation_edgelist_parallel(
+    float *acc, ptrdiff_t *source, ptrdiff_t *target, float *fraction,
+    float *weights, ptrdiff_t *segment_offsets, ptrdiff_t segment_count,
+    ptrdiff_t node_count, int num_threads);
+
+/**
+   @brief Run streamquad_trapz_f32() on a basin-partitioned edge list
+   using multiple threads
+
+   @details
+   The basin segments are processed in parallel, each by a single
+   thread. Edge attributes must be in the order of the partitioned edge
+   list, which can be obtained by gathering them through the
+   `permutation` output of edgelist_partition_basins(). The result is
+   identical to that of streamquad_trapz_f32().
+
+   @param[out] integral The integrated quantity
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+   @endparblock
+
+   @param[in] integrand The quantity to be integrated
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+   @endparblock
+
+   @param[in] weight The weight assigned to each edge
+   @parblock
+   A pointer to a `float` array of size `segment_offsets[segment_count]`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_source` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_target` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] segment_offsets The first edge of each basin segment
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_count + 1`
+
+   As produced by edgelist_partition_basins(). The edges of segment s
+   are `segment_offsets[s]` to `segment_offsets[s + 1] - 1`.
+   @endparblock
+
+   @param[in] segment_count The number of segments
+   @parblock
+   The value returned by edgelist_partition_basins().
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void streamquad_trapz_f32_parallel(float *integral, float *integrand,
+                                   ptrdiff_t *source, ptrdiff_t *target,
+                                   float *weight, ptrdiff_t *segment_offsets,
+                                   ptrdiff_t segment_count, int num_threads);
+
+/**
+   @brief Run traverse_down_f32_max_add() on a basin-partitioned edge list
+   using multiple threads
+
+   @details
+   The basin segments are processed in parallel, each by a single
+   thread. Edge attributes must be in the order of the partitioned edge
+   list, which can be obtained by gathering them through the
+   `permutation` output of edgelist_partition_basins(). The result is
+   identical to that of traverse_down_f32_max_add().
+
+   @param[in,out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+   @endparblock
+
+   @param[in] input The edge attribute list
+   @parblock
+   A pointer to a `float` array of size `segment_offsets[segment_count]`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_source` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_target` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] segment_offsets The first edge of each basin segment
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_count + 1`
+
+   As produced by edgelist_partition_basins(). The edges of segment s
+   are `segment_offsets[s]` to `segment_offsets[s + 1] - 1`.
+   @endparblock
+
+   @param[in] segment_count The number of segments
+   @parblock
+   The value returned by edgelist_partition_basins().
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_max_add_parallel(float *output, float *input,
+                                        ptrdiff_t *source, ptrdiff_t *target,
+                                        ptrdiff_t *segment_offsets,
+                                        ptrdiff_t segment_count,
+                                        int num_threads);
+
+/**
+   @brief Run traverse_up_f32_max_add() on a basin-partitioned edge list
+   using multiple threads
+
+   @details
+   The basin segments are processed in parallel, each by a single
+   thread. Edge attributes must be in the order of the partitioned edge
+   list, which can be obtained by gathering them through the
+   `permutation` output of edgelist_partition_basins(). The result is
+   identical to that of traverse_up_f32_max_add().
+
+   @param[in,out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+   @endparblock
+
+   @param[in] input The edge attribute list
+   @parblock
+   A pointer to a `float` array of size `segment_offsets[segment_count]`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_source` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_target` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] segment_offsets The first edge of each basin segment
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_count + 1`
+
+   As produced by edgelist_partition_basins(). The edges of segment s
+   are `segment_offsets[s]` to `segment_offsets[s + 1] - 1`.
+   @endparblock
+
+   @param[in] segment_count The number of segments
+   @parblock
+   The value returned by edgelist_partition_basins().
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void traverse_up_f32_max_add_parallel(float *output, float *input,
+                                      ptrdiff_t *source, ptrdiff_t *target,
+                                      ptrdiff_t *segment_offsets,
+                                      ptrdiff_t segment_count,
+                                      int num_threads);
+
+/**
+   @brief Run traverse_down_f32_add_mul() on a basin-partitioned edge list
+   using multiple threads
+
+   @details
+   The basin segments are processed in parallel, each by a single
+   thread. Edge attributes must be in the order of the partitioned edge
+   list, which can be obtained by gathering them through the
+   `permutation` output of edgelist_partition_basins(). The result is
+   identical to that of traverse_down_f32_add_mul().
+
+   @param[in,out] output The accumulated output
+   @parblock
+   A pointer to a `float` array representing a node attribute list
+   @endparblock
+
+   @param[in] input The edge attribute list
+   @parblock
+   A pointer to a `float` array of size `segment_offsets[segment_count]`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_source` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_offsets[segment_count]`
+
+   The `partitioned_target` output of edgelist_partition_basins().
+   @endparblock
+
+   @param[in] segment_offsets The first edge of each basin segment
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `segment_count + 1`
+
+   As produced by edgelist_partition_basins(). The edges of segment s
+   are `segment_offsets[s]` to `segment_offsets[s + 1] - 1`.
+   @endparblock
+
+   @param[in] segment_count The number of segments
+   @parblock
+   The value returned by edgelist_partition_basins().
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_add_mul_parallel(float *output, float *input,
+                                        ptrdiff_t *source, ptrdiff_t *target,
+                                        ptrdiff_t *segment_offsets,
+                                        ptrdiff_t segment_count,
+                                        int num_threads);
+
+/**
+   @brief Compute a level schedule for parallel traversals of an edge
+   list
+
+   @details
+   Groups the nodes into levels such that every node depends only on
+   nodes of lower levels. For downstream traversals (`upstream = 0`),
+   the level of a node is the number of edges on the longest path that
+   reaches it from a node without incoming edges. For upstream
+   traversals (`upstream = 1`), it is the number of edges on the
+   longest path from the node to an outlet. Only nodes with at least
+   one incoming (downstream) or outgoing (upstream) edge are
+   scheduled.
+
+   The edges are additionally grouped by the node that gathers along
+   them, the target for downstream and the source for upstream
+   traversals, preserving their relative order. This lets the
+   *_levels kernels update every node of a level independently while
+   performing the same floating point operations in the same order as
+   the serial kernels.
+
+   Level scheduling exposes parallelism within a single large basin,
+   where edgelist_partition_basins() cannot.
+
+   @param[out] level_offsets The first node of each level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count + 1`
+
+   The nodes of level l are `level_nodes[level_offsets[l]]` to
+   `level_nodes[level_offsets[l + 1] - 1]`. Only the first
+   `level_count + 1` elements are written.
+   @endparblock
+
+   @param[out] level_nodes The scheduled nodes grouped by level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[out] edge_offsets The first edge of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count + 1`
+
+   The edges of node u are `edges[edge_offsets[u]]` to
+   `edges[edge_offsets[u + 1] - 1]`.
+   @endparblock
+
+   @param[out] edges The edges grouped by gathering node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The edges must be in topological order.
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] edge_count The number of edges
+
+   @param[in] node_count The number of nodes
+
+   @param[in] upstream 0 for downstream traversals, 1 for upstream
+   traversals
+
+   @return The number of levels, or -1 if memory could not be
+   allocated.
+ */
+TOPOTOOLBOX_API
+ptrdiff_t edgelist_level_schedule(ptrdiff_t *level_offsets,
+                                  ptrdiff_t *level_nodes,
+                                  ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+                                  ptrdiff_t *source, ptrdiff_t *target,
+                                  ptrdiff_t edge_count, ptrdiff_t node_count,
+                                  unsigned int upstream);
+
+/**
+   @brief Compute flow accumulation using a level schedule
+
+   @details
+   The nodes of each level are updated in parallel using a schedule
+   computed by edgelist_level_schedule() with `upstream = 0`. The
+   result is identical to that of flow_accumulation_edgelist() for any number of
+   threads.
+
+   @param[out] acc The computed flow accumulation
+   @parblock
+   A pointer to a `float` array of size `node_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] fraction The fraction of flow transported along each edge
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] weights Initial water depths
+   @parblock
+   A pointer to a `float` array of size `node_count`
+
+   If a null pointer is passed, a default weight of 1.0 for every
+   node is used.
+   @endparblock
+
+   @param[in] level_offsets The first node of each level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `level_count + 1`
+   @endparblock
+
+   @param[in] level_nodes The scheduled nodes grouped by level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[in] edge_offsets The first edge of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count + 1`
+   @endparblock
+
+   @param[in] edges The edges of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_count The number of levels
+   @parblock
+   The value returned by edgelist_level_schedule().
+   @endparblock
+
+   @param[in] node_count The number of nodes
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void flow_accumulation_edgelist_levels(
+    float *acc, ptrdiff_t *source, float *fraction, float *weights,
+    ptrdiff_t *level_offsets, ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets,
+    ptrdiff_t *edges, ptrdiff_t level_count, ptrdiff_t node_count,
+    int num_threads);
+
+/**
+   @brief Run traverse_down_f32_max_add() using a level schedule
+
+   @details
+   The nodes of each level are updated in parallel using a schedule
+   computed by edgelist_level_schedule() with `upstream = 0`. The
+   result is identical to that of traverse_down_f32_max_add() for any number of
+   threads.
+
+   @param[in,out] output The node attribute list to update
+   @parblock
+   A pointer to a `float` array of size `node_count`
+   @endparblock
+
+   @param[in] input The edge attribute list
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_offsets The first node of each level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `level_count + 1`
+   @endparblock
+
+   @param[in] level_nodes The scheduled nodes grouped by level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[in] edge_offsets The first edge of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count + 1`
+   @endparblock
+
+   @param[in] edges The edges of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_count The number of levels
+   @parblock
+   The value returned by edgelist_level_schedule().
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_max_add_levels(
+    float *output, float *input, ptrdiff_t *source, ptrdiff_t *level_offsets,
+    ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+    ptrdiff_t level_count, int num_threads);
+
+/**
+   @brief Run traverse_down_f32_min_add() using a level schedule
+
+   @details
+   The nodes of each level are updated in parallel using a schedule
+   computed by edgelist_level_schedule() with `upstream = 0`. The
+   result is identical to that of traverse_down_f32_min_add() for any number of
+   threads.
+
+   @param[in,out] output The node attribute list to update
+   @parblock
+   A pointer to a `float` array of size `node_count`
+   @endparblock
+
+   @param[in] input The edge attribute list
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_offsets The first node of each level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `level_count + 1`
+   @endparblock
+
+   @param[in] level_nodes The scheduled nodes grouped by level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[in] edge_offsets The first edge of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count + 1`
+   @endparblock
+
+   @param[in] edges The edges of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_count The number of levels
+   @parblock
+   The value returned by edgelist_level_schedule().
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_min_add_levels(
+    float *output, float *input, ptrdiff_t *source, ptrdiff_t *level_offsets,
+    ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+    ptrdiff_t level_count, int num_threads);
+
+/**
+   @brief Run traverse_down_f32_strahler() using a level schedule
+
+   @details
+   The nodes of each level are updated in parallel using a schedule
+   computed by edgelist_level_schedule() with `upstream = 0`. The
+   result is identical to that of traverse_down_f32_strahler() for any number of
+   threads.
+
+   @param[in,out] output The node attribute list to update
+   @parblock
+   A pointer to a `float` array of size `node_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_offsets The first node of each level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `level_count + 1`
+   @endparblock
+
+   @param[in] level_nodes The scheduled nodes grouped by level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[in] edge_offsets The first edge of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count + 1`
+   @endparblock
+
+   @param[in] edges The edges of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_count The number of levels
+   @parblock
+   The value returned by edgelist_level_schedule().
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_strahler_levels(
+    float *output, ptrdiff_t *source, ptrdiff_t *level_offsets,
+    ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+    ptrdiff_t level_count, int num_threads);
+
+/**
+   @brief Run traverse_up_f32_max_add() using a level schedule
+
+   @details
+   The nodes of each level are updated in parallel using a schedule
+   computed by edgelist_level_schedule() with `upstream = 1`. The
+   result is identical to that of traverse_up_f32_max_add() for any number of
+   threads.
+
+   @param[in,out] output The node attribute list to update
+   @parblock
+   A pointer to a `float` array of size `node_count`
+   @endparblock
+
+   @param[in] input The edge attribute list
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_offsets The first node of each level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `level_count + 1`
+   @endparblock
+
+   @param[in] level_nodes The scheduled nodes grouped by level
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[in] edge_offsets The first edge of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count + 1`
+   @endparblock
+
+   @param[in] edges The edges of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] level_count The number of levels
+   @parblock
+   The value returned by edgelist_level_schedule().
+   @endparblock
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
+TOPOTOOLBOX_API
+void traverse_up_f32_max_add_levels(
+    float *output, float *input, ptrdiff_t *target, ptrdiff_t *level_offsets,
+    ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+    ptrdiff_t level_count, int num_threads);
+
+/**
+   @brief Renumber the nodes of a flow network for cache locality
+
+   @details
+   The traversal kernels visit the edges in topological order, so
+   node attributes indexed by raster position are accessed in an
+   essentially random order. This function computes a new numbering of
+   the nodes in which these accesses are nearly sequential, and
+   rewrites the edge list accordingly. The order of the edges is
+   unchanged, so the renumbered edge list is still topologically
+   sorted and can be passed to any of the traversal kernels along with
+   node attributes gathered with permute_gather_f32() and related
+   functions.
+
+   The grid is divided into square blocks of `block_size` x
+   `block_size` pixels, which are visited along a Morton (Z-order)
+   curve. Within each block, the nodes are numbered in the order in
+   which the edge list first refers to them, followed by the nodes
+   without edges in raster order. A `block_size` at least as large as
+   both dimensions yields a purely topological numbering, a
+   `block_size` of 1 a purely spatial Morton numbering. For the
+   traversal kernels alone, the purely topological numbering is
+   usually fastest. Smaller blocks trade some of its locality for
+   locality in the grid.
+
+   @param[out] new_to_old The original index of each renumbered node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   @endparblock
+
+   @param[out] old_to_new The new index of each original node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+   @endparblock
+
+   @param[out] new_source The renumbered source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[out] new_target The renumbered target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] edge_count The number of edges
+
+   @param[in] dims The dimensions of the grid
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 2
+   @endparblock
+
+   @param[in] block_size The side length of the blocks in pixels
+   @parblock
+   Values smaller than 1 are treated as 1.
+   @endparblock
+
+   @return 0 on success, or -1 if memory could not be allocated.
+ */
+TOPOTOOLBOX_API
+int edgelist_renumber(ptrdiff_t *new_to_old, ptrdiff_t *old_to_new,
+                      ptrdiff_t *new_source, ptrdiff_t *new_target,
+                      ptrdiff_t *source, ptrdiff_t *target,
+                      ptrdiff_t edge_count, ptrdiff_t dims[2],
+                      ptrdiff_t block_size);
+
+/**
+   @brief Gather a node attribute list into a renumbered network
+
+   @details
+   Computes `output[k] = input[new_to_old[k]]` for every node k.
+
+   @param[out] output The attribute in the renumbered network
+   @parblock
+   A pointer to a `float` array of size `count`
+   @endparblock
+
+   @param[in] input The attribute in the original numbering
+   @parblock
+   A pointer to a `float` array of size `count`
+   @endparblock
+
+   @param[in] new_to_old The `new_to_old` output of edgelist_renumber()
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `count`
+   @endparblock
+
+   @param[in] count The number of nodes
+ */
+TOPOTOOLBOX_API
+void permute_gather_f32(float *output, float *input, ptrdiff_t *new_to_old,
+                        ptrdiff_t count);
+
+/**
+   @brief Scatter a node attribute list from a renumbered network
+
+   @details
+   Computes `output[new_to_old[k]] = input[k]` for every node k,
+   which reverses permute_gather_f32().
+
+   @param[out] output The attribute in the original numbering
+   @parblock
+   A pointer to a `float` array of size `count`
+   @endparblock
+
+   @param[in] input The attribute in the renumbered network
+   @parblock
+   A pointer to a `float` array of size `count`
+   @endparblock
+
+   @param[in] new_to_old The `new_to_old` output of edgelist_renumber()
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `count`
+   @endparblock
+
+   @param[in] count The number of nodes
+ */
+TOPOTOOLBOX_API
+void permute_scatter_f32(float *output, float *input, ptrdiff_t *new_to_old,
+                         ptrdiff_t count);
+
+/**
+   @brief permute_gather_f32() for `double` attributes
+
+   @copydetails permute_gather_f32()
+ */
+TOPOTOOLBOX_API
+void permute_gather_f64(double *output, double *input, ptrdiff_t *new_to_old,
+                        ptrdiff_t count);
+
+/**
+   @brief permute_scatter_f32() for `double` attributes
+
+   @copydetails permute_scatter_f32()
+ */
+TOPOTOOLBOX_API
+void permute_scatter_f64(double *output, double *input, ptrdiff_t *new_to_old,
+                         ptrdiff_t count);
+
+/**
+   @brief permute_gather_f32() for `uint8_t` attributes
+
+   @copydetails permute_gather_f32()
+ */
+TOPOTOOLBOX_API
+void permute_gather_u8(uint8_t *output, uint8_t *input, ptrdiff_t *new_to_old,
+                       ptrdiff_t count);
+
+/**
+   @brief permute_scatter_f32() for `uint8_t` attributes
+
+   @copydetails permute_scatter_f32()
+ */
+TOPOTOOLBOX_API
+void permute_scatter_u8(uint8_t *output, uint8_t *input,
+                        ptrdiff_t *new_to_old, ptrdiff_t count);
+
+/**
+   @brief permute_gather_f32() for `uint32_t` attributes
+
+   @copydetails permute_gather_f32()
+ */
+TOPOTOOLBOX_API
+void permute_gather_u32(uint32_t *output, uint32_t *input,
+                        ptrdiff_t *new_to_old, ptrdiff_t count);
+
+/**
+   @brief permute_scatter_f32() for `uint32_t` attributes
+
+   @copydetails permute_scatter_f32()
+ */
+TOPOTOOLBOX_API
+void permute_scatter_u32(uint32_t *output, uint32_t *input,
+                         ptrdiff_t *new_to_old, ptrdiff_t count);
+
+/**
+   @brief Compute flow accumulation for several weight grids at once
+
+   @details
+   Equivalent to calling flow_accumulation_edgelist() once for each of
+   `plane_count` weight grids, but reads the edge list only once. The
+   results may differ from those of the unbatched function in the last
+   few bits depending on whether the compiler fuses multiply-adds. The
+   weights and the results are stored in interleaved layout: the
+   `plane_count` values of node u are stored contiguously starting at
+   index `u * plane_count`. Separate grids can be converted to this
+   layout with interleave_planes_f32().
+
+   @param[out] acc The computed flow accumulation
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   in interleaved layout
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The source nodes must be in a topological order.
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] fraction The fraction of flow transported along each edge
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+
+   The fractions are shared by all planes.
+   @endparblock
+
+   @param[in] weights Initial water depths
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   in interleaved layout
+
+   If a null pointer is passed, a default weight of 1.0 is used for
+   every node and plane.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the edge list
+
+   @param[in] node_count The number of nodes
+
+   @param[in] plane_count The number of weight grids
+ */
+TOPOTOOLBOX_API
+void flow_accumulation_edgelist_batch(float *acc, ptrdiff_t *source,
+                                      ptrdiff_t *target, float *fraction,
+                                      float *weights, ptrdiff_t edge_count,
+                                      ptrdiff_t node_count,
+                                      ptrdiff_t plane_count);
+
+/**
+   @brief Integrate several node attributes upstream at once
+
+   @details
+   Equivalent to calling streamquad_trapz_f32() once for each of
+   `plane_count` integrands, but reads the edge list only once. The
+   integrands and integrals are stored in interleaved layout: the
+   `plane_count` values of node u are stored contiguously starting at
+   index `u * plane_count`.
+
+   @param[in,out] integral The integrated quantity
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   in interleaved layout
+   @endparblock
+
+   @param[in] integrand The quantity to be integrated
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   in interleaved layout
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] weight The weight assigned to each edge
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+
+   The weights are shared by all planes.
+   @endparblock
+
+   @param[in] edge_count The number of edges in the edge list
+
+   @param[in] plane_count The number of attributes
+ */
+TOPOTOOLBOX_API
+void streamquad_trapz_f32_batch(float *integral, float *integrand,
+                                ptrdiff_t *source, ptrdiff_t *target,
+                                float *weight, ptrdiff_t edge_count,
+                                ptrdiff_t plane_count);
+
+/**
+   @brief Run traverse_down_f32_add_mul() on several node attributes
+   at once
+
+   @details
+   Equivalent to calling traverse_down_f32_add_mul() once for each of
+   `plane_count` node attributes with the same edge attribute, but
+   reads the edge list only once. The node attributes are stored in
+   interleaved layout: the `plane_count` values of node u are stored
+   contiguously starting at index `u * plane_count`.
+
+   @param[in,out] output The node attributes
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   in interleaved layout
+   @endparblock
+
+   @param[in] input The edge attribute
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+
+   The edge attribute is shared by all planes.
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] edge_count The number of edges in the edge list
+
+   @param[in] plane_count The number of node attributes
+ */
+TOPOTOOLBOX_API
+void traverse_down_f32_add_mul_batch(float *output, float *input,
+                                     ptrdiff_t *source, ptrdiff_t *target,
+                                     ptrdiff_t edge_count,
+                                     ptrdiff_t plane_count);
+
+/**
+   @brief Convert separate node attribute lists to interleaved layout
+
+   @details
+   Computes `output[u * plane_count + k] = input[k * node_count + u]`,
+   so that the `plane_count` values of each node become contiguous, as
+   required by the batched kernels such as
+   flow_accumulation_edgelist_batch().
+
+   @param[out] output The attributes in interleaved layout
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   @endparblock
+
+   @param[in] input The attributes as consecutive node attribute lists
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   @endparblock
+
+   @param[in] node_count The number of nodes
+
+   @param[in] plane_count The number of attributes
+ */
+TOPOTOOLBOX_API
+void interleave_planes_f32(float *output, float *input, ptrdiff_t node_count,
+                           ptrdiff_t plane_count);
+
+/**
+   @brief Convert interleaved node attributes to separate lists
+
+   @details
+   Computes `output[k * node_count + u] = input[u * plane_count + k]`,
+   which reverses interleave_planes_f32().
+
+   @param[out] output The attributes as consecutive node attribute lists
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   @endparblock
+
+   @param[in] input The attributes in interleaved layout
+   @parblock
+   A pointer to a `float` array of size `node_count` x `plane_count`
+   @endparblock
+
+   @param[in] node_count The number of nodes
+
+   @param[in] plane_count The number of attributes
+ */
+TOPOTOOLBOX_API
+void deinterleave_planes_f32(float *output, float *input,
+                             ptrdiff_t node_count, ptrdiff_t plane_count);
+
+/**
+   @brief Combinators for traverse_down_fused() and traverse_up_fused()
+
+   @details
+   Each combinator updates the node that gathers along an edge (the
+   target in downstream traversals, the source in upstream traversals)
+   from the node at the other end of the edge and an edge attribute.
+   Writing g for the gathering node, s for the other node and e for the
+   edge:
+
+   - TRAVERSE_ADD_MUL: `output[g] = output[g] + output[s] * input[e]`,
+     as in traverse_down_f32_add_mul(). `float` attributes. If the edge
+     attribute is a null pointer, every edge has a weight of 1.
+   - TRAVERSE_MAX_ADD: `output[g] = max(output[g], output[s] + input[e])`,
+     as in traverse_down_f32_max_add() and traverse_up_f32_max_add().
+     `float` attributes.
+   - TRAVERSE_MIN_ADD: `output[g] = min(output[g], output[s] + input[e])`,
+     as in traverse_down_f32_min_add(). `float` attributes.
+   - TRAVERSE_OR_AND: `output[g] = output[g] | (output[s] & input[e])`,
+     as in traverse_down_u32_or_and() and traverse_up_u32_or_and().
+     `uint32_t` attributes.
+   - TRAVERSE_STRAHLER: the Strahler order update of
+     traverse_down_f32_strahler(). `float` attributes. The edge
+     attribute is ignored and may be a null pointer.
+ */
+enum {
+  TRAVERSE_ADD_MUL = 0,
+  TRAVERSE_MAX_ADD = 1,
+  TRAVERSE_MIN_ADD = 2,
+  TRAVERSE_OR_AND = 3,
+  TRAVERSE_STRAHLER = 4
+};
+
+/**
+   @brief Run several downstream traversals in a single pass over the
+   edge list
+
+   @details
+   Equivalent to running the traversal kernel corresponding to each of
+   the `op_count` combinators in `ops` one after the other, but the
+   edge list is read from memory only once. The edges are processed in
+   blocks that fit in cache, and every combinator runs over a block
+   before the next block is loaded. The combinators must be independent
+   of each other: no output may be the input or the output of another
+   combinator.
+
+   The results are identical to those of the individual kernels.
+
+   @param[in,out] output The node attributes
+   @parblock
+   A pointer to an array of `op_count` pointers. `output[i]` points to
+   the node attribute list updated by combinator `ops[i]`, of the type
+   given in the description of the combinator. It must be initialized
+   as required by the corresponding traversal kernel.
+   @endparblock
+
+   @param[in] input The edge attributes
+   @parblock
+   A pointer to an array of `op_count` pointers. `input[i]` points to an
+   array of size `edge_count` holding the edge attribute of combinator
+   `ops[i]`, of the same type as `output[i]`.
+   @endparblock
+
+   @param[in] ops The combinators
+   @parblock
+   A pointer to a `uint8_t` array of size `op_count`
+
+   Each element is one of the TRAVERSE_* constants.
+   @endparblock
+
+   @param[in] op_count The number of combinators
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The edges must be in topological order.
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] edge_count The number of edges
+
+   @return 0 on success, or -1 if a combinator is unknown or lacks a
+   required edge attribute. Nothing is computed in that case.
+ */
+TOPOTOOLBOX_API
+int traverse_down_fused(void **output, void **input, uint8_t *ops,
+                        ptrdiff_t op_count, ptrdiff_t *source,
+                        ptrdiff_t *target, ptrdiff_t edge_count);
+
+/**
+   @brief Run several upstream traversals in a single pass over the
+   edge list
+
+   @details
+   The upstream counterpart of traverse_down_fused(). The edges are
+   visited in reverse topological order and each combinator updates
+   the source node of every edge from its target node, as in
+   traverse_up_f32_max_add().
+
+   @copydetails traverse_down_fused()
+ */
+TOPOTOOLBOX_API
+int traverse_up_fused(void **output, void **input, uint8_t *ops,
+                      ptrdiff_t op_count, ptrdiff_t *source, ptrdiff_t *target,
+                      ptrdiff_t edge_count);
+
+/**
+   @brief Compute the size of a flow network container
+
+   @details
+   Returns the number of bytes required by flow_network_write() to
+   store a flow network with the given number of edges and nodes.
+
+   @param[in] edge_count The number of edges
+   @param[in] node_count The number of nodes in the topological order
+   @param[in] index32 Nonzero to store 32-bit instead of 64-bit indices
+
+   @return The size of the container in bytes
+ */
+TOPOTOOLBOX_API
+ptrdiff_t flow_network_size(ptrdiff_t edge_count, ptrdiff_t node_count,
+                            unsigned int index32);
+
+/**
+   @brief Store a flow network in a binary container
+
+   @details
+   The container holds a versioned header followed by the source,
+   target, fraction and node arrays, each aligned to 64 bytes. The
+   library does not access the file system: `buffer` is typically a
+   writable memory mapping of the output file, sized with
+   flow_network_size(). The container can later be opened without
+   copying the arrays with flow_network_read().
+
+   Containers are written in the byte order of the machine and can only
+   be read on machines with the same byte order.
+
+   @param[out] buffer The container
+   @parblock
+   A pointer to at least `buffer_size` bytes, aligned to 8 bytes
+   @endparblock
+
+   @param[in] buffer_size The size of `buffer` in bytes
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] fraction The fraction of flow transported along each edge
+   @parblock
+   A pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[in] node The nodes in topological order
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`, e.g. the
+   `node` output of flow_routing_d8_carve()
+   @endparblock
+
+   @param[in] edge_count The number of edges
+
+   @param[in] node_count The number of nodes in `node`
+
+   @param[in] dims The dimensions of the grid
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 2
+   @endparblock
+
+   @param[in] index32 Nonzero to store 32-bit indices
+   @parblock
+   32-bit indices halve the size of the index arrays, which can then be
+   used directly with the `_idx32` kernels. The grid must have fewer
+   than 2^32 pixels.
+   @endparblock
+
+   @return 0 on success, -1 if `buffer` is too small or misaligned, or
+   -2 if `node_count` is not the number of pixels in a grid of size
+   `dims` or 32-bit indices were requested for a grid that is too
+   large.
+ */
+TOPOTOOLBOX_API
+int flow_network_write(void *buffer, ptrdiff_t buffer_size, ptrdiff_t *source,
+                       ptrdiff_t *target, float *fraction, ptrdiff_t *node,
+                       ptrdiff_t edge_count, ptrdiff_t node_count,
+                       ptrdiff_t dims[2], unsigned int index32);
+
+/**
+   @brief Open a flow network container
+
+   @details
+   Validates the header of a container written by flow_network_write()
+   and returns pointers to its arrays inside `buffer`. Nothing is
+   copied, so the pointers are valid as long as the buffer, typically a
+   memory-mapped file, and can be passed directly to the traversal
+   kernels.
+
+   @param[out] source The source node of each edge
+   @parblock
+   Receives a pointer to a `ptrdiff_t` array, or to a `uint32_t` array
+   if `index32` is set, of size `edge_count`
+   @endparblock
+
+   @param[out] target The target node of each edge
+   @parblock
+   Receives a pointer to an array of the same type as `source` and of
+   size `edge_count`
+   @endparblock
+
+   @param[out] fraction The fraction of flow transported along each edge
+   @parblock
+   Receives a pointer to a `float` array of size `edge_count`
+   @endparblock
+
+   @param[out] node The nodes in topological order
+   @parblock
+   Receives a pointer to an array of the same type as `source` and of
+   size `node_count`
+   @endparblock
+
+   @param[out] edge_count Receives the number of edges
+
+   @param[out] node_count Receives the number of nodes in `node`
+
+   @param[out] dims Receives the dimensions of the grid
+   @parblock
+   A pointer to a `ptrdiff_t` array of size 2
+   @endparblock
+
+   @param[out] index32 Receives 1 if the container holds 32-bit indices
+   and 0 otherwise
+
+   @param[in] buffer The container
+   @parblock
+   A pointer to `buffer_size` bytes, aligned to 8 bytes
+   @endparblock
+
+   @param[in] buffer_size The size of `buffer` in bytes
+
+   @return 0 on success, -1 if `buffer` does not hold a flow network
+   container in the byte order of this machine, -2 if the container
+   version is not supported, -3 if the container is truncated,
+   misaligned or inconsistent, for example if the stored node count is
+   not the number of pixels in the grid, or -4 if it holds 64-bit
+   indices and `ptrdiff_t` is not 64 bits wide. The outputs are only
+   written on success.
+ */
+TOPOTOOLBOX_API
+int flow_network_read(void **source, void **target, float **fraction,
+                      void **node, ptrdiff_t *edge_count,
+                      ptrdiff_t *node_count, ptrdiff_t dims[2],
+                      unsigned int *index32, void *buffer,
+                      ptrdiff_t buffer_size);
+
+/**
+   @brief Extract the subgraph of a flow network induced by a node mask
+
+   @details
+   Selects the nodes for which `mask` is nonzero, e.g. the pixels whose
+   flow accumulation exceeds a threshold, and the edges whose source
+   and target are both selected. The selected nodes are numbered
+   densely in increasing order of their original index, and the edges
+   keep their relative order, so the subgraph edge list is still
+   topologically sorted and can be passed to the traversal kernels
+   with node attribute lists of `subgraph_node_count` elements.
+
+   Nodes and edges are compacted in parallel with a prefix sum over
+   blocks. The result does not depend on the number of threads.
+
+   @param[out] subgraph_source The source node of each subgraph edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`, of which the
+   first `subgraph_edge_count` elements are written
+   @endparblock
+
+   @param[out] subgraph_target The target node of each subgraph edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`, of which the
+   first `subgraph_edge_count` elements are written
+   @endparblock
+
+   @param[out] edge_map The original edge of each subgraph edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`, or a null
+   pointer if the map is not needed. Edge attributes of the subgraph
+   are obtained by gathering the original attributes through this map.
+   @endparblock
+
+   @param[out] node_map The original node of each subgraph node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`, of which the
+   first `subgraph_node_count` elements are written
+   @endparblock
+
+   @param[out] node_index The subgraph node of each original node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`. Nodes that
+   are not selected receive -1.
+   @endparblock
+
+   @param[out] subgraph_edge_count Receives the number of subgraph edges
+
+   @param[in] mask Nonzero for the selected nodes
+   @parblock
+   A pointer to a `uint8_t` array of size `node_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
+
+   @param[in] edge_count The number of edges
+
+   @param[in] node_count The number of nodes, e.g. `dims[0] * dims[1]`
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+
+   @return The number of subgraph nodes, or -1 if memory could not be
+   allocated.
+ */
+TOPOTOOLBOX_API
+ptrdiff_t edgelist_extract_subgraph(ptrdiff_t *subgraph_source,
+                                    ptrdiff_t *subgraph_target,
+                                    ptrdiff_t *edge_map, ptrdiff_t *node_map,
+                                    ptrdiff_t *node_index,
+                                    ptrdiff_t *subgraph_edge_count,
+                                    uint8_t *mask, ptrdiff_t *source,
+                                    ptrdiff_t *target, ptrdiff_t edge_count,
+                                    ptrdiff_t node_count, int num_threads);
+
+/**
+   @brief Build an interval index of a single flow direction network
+
+   @details
+   Numbers the nodes in depth-first preorder of the upstream trees of
+   the outlets. Node u is upstream of node v, or equal to it, if and
+   only if
+
+   `preorder[v] <= preorder[u] < preorder[v] + subtree_size[v]`
+
+   and the catchment of v consists of the nodes
+   `order[preorder[v]]` to `order[preorder[v] + subtree_size[v] - 1]`.
+   The index is built in two traversals of the edge list and answers
+   upstream queries with upstream_index_query() and catchment queries
+   with upstream_index_catchment() without traversing the network
+   again.
+
+   @param[out] preorder The preorder position of each node
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[out] subtree_size The number of nodes in the catchment of
+   each node, including the node itself
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[out] order The node at each preorder position
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `node_count`
+   @endparblock
+
+   @param[in] source The source node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+
+   The edges must be in topological order, and every node may be the
+   source of at most one edge.
+   @endparblock
+
+   @param[in] target The target node of each edge
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `edge_count`
+   @endparblock
 
-/**
-   @brief Accumulate single flow drainage area downstream from a calculated
-   graphflood single flow graph weighted by an arbitrary input (e.g.
-   Precipitation rates to get effective discharge)
-   @param[out] output: the field of drainage area
-   @param[in]  weights: node-wise weights
-   @param[in]  Sreceivers: array of steepest receiver vectorised index
-   @param[in]  Stack: topologically ordered list of nodes, from the
-   baselevel to the sources
-   @param[in]  dim: [rows,columns] if row major and [columns, rows] if
-   column major
-   @param[in]  dx: spatial step
-*/
-TOPOTOOLBOX_API
-void compute_weighted_drainage_area_single_flow(GF_FLOAT *output,
-                                                GF_FLOAT *weights,
-                                                GF_UINT *Sreceivers,
-                                                GF_UINT *Stack, GF_UINT *dim,
-                                                GF_FLOAT dx);
+   @param[in] edge_count The number of edges
 
-/**
-   @brief Run N iteration of graphflood as described in Gailleton et al.,
-   2024. From an input field of topography, optional original flow depth,
-   mannings friction coefficient and precipitation rates, calculates the field
-   of flow depth following a steady flow assumption.
+   @param[in] node_count The number of nodes
 
-   @param[in]     Z: surface topography
-   @param[inout]  hw: field of flow depth
-   @param[in]     BCs: codes for boundary conditions and no data
-   management, see gf_utils.h or examples for the meaning
-   @param[in]     Precipitations: Precipitation rates
-   @param[in]     manning: friction coefficient
-   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
-   column major
-   @param[in]     dt: time step
-   @param[in]     dx: spatial step
-   @param[in]     SFD: single flow direction if True, multiple flow if
-   false
-   @param[in]     D8: true for topology including cardinals + diagonals,
-   false for cardinals only
-   @param[in]     N_iterations: number of iterations of the flooding algorithm
-   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
-   flats, false for cardinals only
-*/
+   @return 0 on success, or -1 if a node is the source of more than
+   one edge. The output arrays are invalid in the latter case.
+ */
 TOPOTOOLBOX_API
-void graphflood_full(GF_FLOAT *Z, GF_FLOAT *hw, uint8_t *BCs,
-                     GF_FLOAT *Precipitations, GF_FLOAT *manning, GF_UINT *dim,
-                     GF_FLOAT dt, GF_FLOAT dx, bool SFD, bool D8,
-                     GF_UINT N_iterations, GF_FLOAT step);
+int upstream_index(ptrdiff_t *preorder, ptrdiff_t *subtree_size,
+                   ptrdiff_t *order, ptrdiff_t *source, ptrdiff_t *target,
+                   ptrdiff_t edge_count, ptrdiff_t node_count);
 
 /**
-   @brief Calculate steady-state flow metrics from topography and water depths
-   using the GraphFlood algorithm as described in Gailleton et al., 2024.
-   From input fields of topography, water depth, Manning's friction coefficient
-   and precipitation rates, computes various flow metrics assuming steady-state
-   conditions with multiple flow direction routing.
+   @brief Test whether nodes are upstream of other nodes
 
-   @param[in]     Z: surface topography [m]
-   @param[in]     hw: field of water depth [m]
-   @param[in]     BCs: codes for boundary conditions and no data management,
-                  see gf_utils.h or examples for the meaning
-   @param[in]     Precipitations: precipitation rates [m/s]
-   @param[in]     manning: Manning's friction coefficient [s/m^(1/3)]
-   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
-                  column major
-   @param[in]     dx: spatial step [m]
-   @param[in]     D8: true for topology including cardinals + diagonals,
-                  false for cardinals only
-   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
-                  flats during priority flooding
-   @param[out]    Qi: input discharge based on drainage area accumulation [m³/s]
-   @param[out]    Qo: output discharge calculated from Manning's equation [m³/s]
-   @param[out]    qo: discharge per unit width [m²/s]
-   @param[out]    u: flow velocity [m/s]
-   @param[out]    Sw: water surface slope [-]
+   @details
+   For every query k, sets `upstream[k]` to 1 if `nodes[k]` is upstream
+   of or equal to `outlets[k]` and to 0 otherwise. Each query takes
+   constant time, and the queries are answered in parallel.
 
-   @note At convergence, Qi should approximately equal Qo (mass conservation).
-   Differences may indicate numerical issues, local instabilities, or physical
-   processes such as ponding in lakes or depressions.
-*/
-TOPOTOOLBOX_API
-void graphflood_metrics(GF_FLOAT *Z, GF_FLOAT *hw, uint8_t *BCs,
-                        GF_FLOAT *Precipitations, GF_FLOAT *manning,
-                        GF_UINT *dim, GF_FLOAT dx, bool D8, GF_FLOAT step,
-                        GF_FLOAT *Qi, GF_FLOAT *Qo, GF_FLOAT *qo, GF_FLOAT *u,
-                        GF_FLOAT *Sw);
+   @param[out] upstream The result of each query
+   @parblock
+   A pointer to a `uint8_t` array of size `query_count`
+   @endparblock
 
-/**
-   @brief Run dynamic induced graph flood simulation using wavefront propagation
-   from specified input discharge locations. Processes cells in descending
-   hydraulic elevation order, dynamically building the flow graph as it
-   propagates downstream.
+   @param[in] nodes The upstream node of each query
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `query_count`
+   @endparblock
 
-   @param[in]     Z: surface topography [m]
-   @param[inout]  hw: field of water depth [m]
-   @param[in]     BCs: codes for boundary conditions and no data management
-   @param[in]     Precipitations: precipitation rates [m/s]
-   @param[in]     manning: Manning's friction coefficient [s/m^(1/3)]
-   @param[in]     input_Qw: input discharge at specific cells [m³/s]
-                  (cells with value > 0 are used as starting points)
-   @param[inout]  Qwin: accumulated input discharge array [m³/s]
-                  (pre-allocated array of size dim[0] * dim[1], reinitialized
-   each iteration)
-   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
-                  column major
-   @param[in]     dt: time step [s]
-   @param[in]     dx: spatial step [m]
-   @param[in]     D8: true for topology including cardinals + diagonals,
-                  false for cardinals only
-   @param[in]     N_iterations: number of iterations of the flooding algorithm
-*/
+   @param[in] outlets The downstream node of each query
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `query_count`
+   @endparblock
+
+   @param[in] query_count The number of queries
+
+   @param[in] preorder The preorder positions computed by upstream_index()
+
+   @param[in] subtree_size The catchment sizes computed by upstream_index()
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+ */
 TOPOTOOLBOX_API
-void graphflood_dynamic_graph(GF_FLOAT *Z, GF_FLOAT *hw, uint8_t *BCs,
-                              GF_FLOAT *Precipitations, GF_FLOAT *manning,
-                              GF_FLOAT *input_Qw, GF_FLOAT *Qwin, GF_UINT *dim,
-                              GF_FLOAT dt, GF_FLOAT dx, bool D8,
-                              GF_UINT N_iterations);
+void upstream_index_query(uint8_t *upstream, ptrdiff_t *nodes,
+                          ptrdiff_t *outlets, ptrdiff_t query_count,
+                          ptrdiff_t *preorder, ptrdiff_t *subtree_size,
+                          int num_threads);
 
 /**
-   @brief Compute input discharge array for dynamic graph from drainage area
-   threshold. Identifies channel heads where drainage area crosses a threshold
-   and assigns precipitation-weighted discharge at those entry points.
+   @brief Extract the catchment of one or more outlets
 
-   @param[out]    input_Qw: input discharge array to fill [m³/s]
-                  (pre-allocated array of size dim[0] * dim[1])
-   @param[in]     Z: surface topography [m]
-   @param[in]     hw: field of water depth [m]
-   @param[in]     BCs: codes for boundary conditions and no data management
-   @param[in]     Precipitations: precipitation rates [m/s]
-   @param[in]     area_threshold: drainage area threshold for entry points [m²]
-   @param[in]     dim: [rows,columns] if row major and [columns, rows] if
-                  column major
-   @param[in]     dx: spatial step [m]
-   @param[in]     D8: true for topology including cardinals + diagonals,
-                  false for cardinals only
-   @param[in]     step: delta_Z to apply minimum elevation increase and avoid
-                  flats during priority flooding
-*/
+   @details
+   Writes the nodes upstream of any of the outlets, including the
+   outlets themselves, to `catchment`. Since the catchment of every
+   outlet is a contiguous range of the preorder permutation, only the
+   nodes of the catchment are visited. Nested catchments are reported
+   once, and the nodes are written in increasing preorder position.
+
+   The catchment of a single outlet v contains `subtree_size[v]` nodes.
+
+   @param[out] catchment The nodes of the catchment
+   @parblock
+   A pointer to a `ptrdiff_t` array large enough to hold the catchment,
+   at most `node_count` elements
+   @endparblock
+
+   @param[in] outlets The outlets
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `outlet_count`
+   @endparblock
+
+   @param[in] outlet_count The number of outlets
+
+   @param[in] preorder The preorder positions computed by upstream_index()
+
+   @param[in] subtree_size The catchment sizes computed by upstream_index()
+
+   @param[in] order The preorder permutation computed by upstream_index()
+
+   @return The number of nodes in the catchment, or -1 if memory could
+   not be allocated.
+ */
 TOPOTOOLBOX_API
-void compute_input_Qw_from_area_threshold(GF_FLOAT *input_Qw, GF_FLOAT *Z,
-                                          GF_FLOAT *hw, uint8_t *BCs,
-                                          GF_FLOAT *Precipitations,
-                                          GF_FLOAT area_threshold, GF_UINT *dim,
-                                          GF_FLOAT dx, bool D8, GF_FLOAT step);
+ptrdiff_t upstream_index_catchment(ptrdiff_t *catchment, ptrdiff_t *outlets,
+                                   ptrdiff_t outlet_count,
+                                   ptrdiff_t *preorder,
+                                   ptrdiff_t *subtree_size, ptrdiff_t *order);
 
 /**
-   @brief Label drainage basins based on the flow directions provided
-   by a topologically sorted edge list.
+   @brief Trace the downstream flow paths of many pixels
 
-   @param[out] basins The drainage basin label
+   @details
+   Follows the receivers from every starting pixel to its outlet. Each
+   path is traced only until it reaches a pixel visited by an earlier
+   path, so every pixel is stored once, and the total work is
+   proportional to the union of the paths rather than to the sum of
+   their lengths.
+
+   Path k starts with the pixels `path_nodes[path_offsets[k]]` to
+   `path_nodes[path_offsets[k + 1] - 1]`. If `path_junction[k]` is
+   not negative, the path continues with `path_nodes[path_junction[k]]`
+   to the end of the segment of path `path_parent[k]` and then with the
+   continuation of that path. Otherwise, the last pixel of the segment
+   is the outlet. A segment is empty if its starting pixel lies on an
+   earlier path.
+
+   @param[out] path_offsets The first position of each path segment
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `start_count + 1`
+   @endparblock
+
+   @param[out] path_nodes The pixels of the path segments
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`, of
+   which the first `path_offsets[start_count]` elements are written
+   @endparblock
+
+   @param[out] path_junction The position at which each path joins an
+   earlier one, or -1 if it ends at its own outlet
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `start_count`
+   @endparblock
+
+   @param[out] path_parent The path that each path joins, or -1
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `start_count`
+   @endparblock
+
+   @param[in,out] position The position of each pixel in `path_nodes`
    @parblock
    A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+
+   It must be -1 for every pixel on input. On output, it holds the
+   position of every traced pixel and is unchanged for all others, so
+   that it can be reset for another call by setting it back to -1 for
+   the pixels in `path_nodes` only.
    @endparblock
 
-   @param[out] source The source pixel for each edge
+   @param[out] distance The flow distance from each pixel in
+   `path_nodes` to its outlet
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`, indexed
+   by position in `path_nodes`
    @endparblock
 
-   @param[in] target The target pixel for each edge
+   @param[out] path_length The flow distance from each starting pixel
+   to its outlet
    @parblock
-   A pointer to a `ptrdiff_t` array of size `edge_count`
+   A pointer to a `float` array of size `start_count`, or a null pointer
+   if the lengths are not needed
    @endparblock
 
-   @param[in] edge_count The number of edges in the flow network
+   @param[out] path_drop The elevation difference between each
+   starting pixel and its outlet
    @parblock
-   A ptrdiff_t representing the length of the `source` and `target` arrays
+   A pointer to a `float` array of size `start_count`, or a null pointer
+   if the drops are not needed
+   @endparblock
+
+   @param[in] starts The starting pixels
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `start_count`
+   @endparblock
+
+   @param[in] start_count The number of starting pixels
+
+   @param[in] receiver The receiver of each pixel
+   @parblock
+   A pointer to a `ptrdiff_t` array of size `dims[0]` x `dims[1]`
+
+   receiver[u] is the pixel that u drains to, or u itself if u is a
+   sink. It is computed by flow_routing_d8_receivers().
+   @endparblock
+
+   @param[in] dem The elevations
+   @parblock
+   A pointer to a `float` array of size `dims[0]` x `dims[1]`
+
+   It is only used if `path_drop` is not a null pointer.
    @endparblock
 
+   @param[in] cellsize The spatial resolution of the grid
+
    @param[in] dims The dimensions of the arrays
    @parblock
    A pointer to a `ptrdiff_t` array of size 2
@@ -2299,10 +5942,17 @@ void compute_input_Qw_from_area_threshold(GF_FLOAT *input_Qw, GF_FLOAT *Z,
    The fastest changing dimension should be provided first. For column-major
    arrays, `dims = {nrows,ncols}`. For row-major arrays, `dims = {ncols,nrows}`.
    @endparblock
+
+   @return The number of pixels written to `path_nodes`
  */
 TOPOTOOLBOX_API
-void drainagebasins(ptrdiff_t *basins, ptrdiff_t *source, ptrdiff_t *target,
-                    ptrdiff_t edge_count, ptrdiff_t dims[2]);
+ptrdiff_t flowpaths_trace(ptrdiff_t *path_offsets, ptrdiff_t *path_nodes,
+                          ptrdiff_t *path_junction, ptrdiff_t *path_parent,
+                          ptrdiff_t *position, float *distance,
+                          float *path_length, float *path_drop,
+                          ptrdiff_t *starts, ptrdiff_t start_count,
+                          ptrdiff_t *receiver, float *dem, float cellsize,
+                          ptrdiff_t dims[2]);
 
 /**
    @brief Compute the gradient of a DEM using a second-order finite difference
@@ -2446,8 +6096,44 @@ void hillshade(float *output, float *dx, float *dy, float *dem, float azimuth,
    @endparblock
  */
 TOPOTOOLBOX_API
-void hillshade_fused(float *output, float *dem, float azimuth, float altitude,
-                     float cellsize, ptrdiff_t dims[2]);
+void hillshade_fused(float *output, const float *dem, float azimuth,
+                     float altitude, float cellsize, ptrdiff_t dims[2]);
+
+/**
+   @brief Computes the hillshade of a digital elevation model of type `double`
+
+   @copydetails hillshade_fused()
+ */
+TOPOTOOLBOX_API
+void hillshade_fused_f64(float *output, const double *dem, float azimuth,
+                         float altitude, float cellsize, ptrdiff_t dims[2]);
+
+/**
+   @brief Computes the hillshade of a digital elevation model of type `int16_t`
+
+   @copydetails hillshade_fused()
+
+   Missing data must be marked by INT16_MAX and is handled like NaN in
+   the floating point variants. Other nodata values, such as the
+   common -32768, are treated as valid elevations and must be replaced
+   by INT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void hillshade_fused_i16(float *output, const int16_t *dem, float azimuth,
+                         float altitude, float cellsize, ptrdiff_t dims[2]);
+
+/**
+   @brief Computes the hillshade of a digital elevation model of type `uint16_t`
+
+   @copydetails hillshade_fused()
+
+   Missing data must be marked by UINT16_MAX and is handled like NaN
+   in the floating point variants. Other nodata values are treated as
+   valid elevations and must be replaced by UINT16_MAX first.
+ */
+TOPOTOOLBOX_API
+void hillshade_fused_u16(float *output, const uint16_t *dem, float azimuth,
+                         float altitude, float cellsize, ptrdiff_t dims[2]);
 
 /**
    @brief Compute the lower convex envelope of a stream profile
@@ -2935,6 +6621,94 @@ TOPOTOOLBOX_API
 ptrdiff_t edgeset_merge(float *w0, ptrdiff_t *s0, uint8_t *b1, float *w1,
                         uint8_t *b2, float *w2, ptrdiff_t dims[2]);
 
+/**
+   @brief Count edges in a bitmap edge set using multiple threads
+
+   @details The bitmap is split into blocks that are counted in
+   parallel, eight pixels at a time. The result is identical to that
+   of edgeset_count().
+
+   @copydetails edgeset_count()
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+*/
+TOPOTOOLBOX_API
+ptrdiff_t edgeset_count_parallel(uint8_t *bitmap, ptrdiff_t dims[2],
+                                 int num_threads);
+
+/**
+   @brief Determine edge weight offsets in a bitmap edge set using
+   multiple threads
+
+   @details The bitmap is split into blocks. The edges of every block
+   are counted in parallel, an exclusive scan of the counts yields the
+   offset of the first edge of each block, and the offsets of the
+   pixels are then computed in parallel. The result is identical to
+   that of edgeset_scan(). If the temporary array of block offsets
+   cannot be allocated, -1 is returned.
+
+   @copydetails edgeset_scan()
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+*/
+TOPOTOOLBOX_API
+ptrdiff_t edgeset_scan_parallel(ptrdiff_t *scan, uint8_t *bitmap,
+                                ptrdiff_t dims[2], int num_threads);
+
+/**
+   @brief Count edges in a merged bitmap edge set using multiple
+   threads
+
+   @details The result is identical to that of edgeset_count_merged().
+
+   @copydetails edgeset_count_merged()
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+*/
+TOPOTOOLBOX_API
+ptrdiff_t edgeset_count_merged_parallel(uint8_t *b1, uint8_t *b2,
+                                        ptrdiff_t dims[2], int num_threads);
+
+/**
+   @brief Merge two bitmap edge sets using multiple threads
+
+   @details The bitmaps are split into blocks. The edges of the merged
+   set and of both input sets are counted for every block in parallel,
+   exclusive scans of the counts yield the offsets of the first edge of
+   each block in all three weight arrays, and the blocks are then
+   merged in parallel. The result is identical to that of
+   edgeset_merge(). If the temporary arrays of block offsets cannot be
+   allocated, -1 is returned and the inputs are left unchanged.
+
+   @copydetails edgeset_merge()
+
+   @param[in] num_threads The number of threads to use
+   @parblock
+   If `num_threads` is not positive, the default number of OpenMP
+   threads is used. It is ignored if libtopotoolbox is built without
+   OpenMP.
+   @endparblock
+*/
+TOPOTOOLBOX_API
+ptrdiff_t edgeset_merge_parallel(float *w0, ptrdiff_t *s0, uint8_t *b1,
+                                 float *w1, uint8_t *b2, float *w2,
+                                 ptrdiff_t dims[2], int num_threads);
+
 /**
    @brief Topologically sort a set of edges
 
@@ -0,0 +1,170 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+#include "helpers/hillshade.h"
+#include "helpers/math_constants.h"
+#include "helpers/parallel.h"
+#include "helpers/pixel_queue.h"
+#include "topotoolbox.h"
+
+#define PI_2 1.57079632679489661923f
+
+/*
+  The core DEM routines for DEMs stored as 32-bit and 64-bit floats
+  and as 16-bit integers, so that such DEMs can be processed without
+  first converting them to single precision.
+
+  All variants, including the single precision ones, are generated
+  from the kernels in helpers/dem_kernels.h. Other types can be added
+  by defining the macros described there and including the file once
+  more. The helpers below do not depend on the type of the DEM and are
+  shared by all variants.
+ */
+
+/*
+  Flow routing is split into two stages.
+
+  The first stage computes the flow direction of every pixel
+  independently, which can be done in parallel. Until the second
+  stage visits a pixel, its direction is stored complemented. A valid
+  direction has at most one bit set, while its complement has at
+  least seven, so unvisited pixels can be recognized without any
+  additional memory. Unvisited sinks hold 0xff, the sentinel value
+  documented for flow_routing_d8_carve.
+
+  The second stage sorts the pixels topologically by a depth first
+  traversal of the flow graph, as described in
+  flow_routing_d8_carve. Because every pixel has at most one
+  downstream neighbor, the traversal from an unvisited pixel simply
+  follows the flow path until it reaches a sink or a visited
+  pixel. The order is identical to that obtained by computing the
+  flow directions during the traversal.
+ */
+static int32_t is_visited(uint8_t direction) {
+  return (direction & (direction - 1)) == 0;
+}
+
+static void carve_topological_sort(ptrdiff_t *node, uint8_t *direction,
+                                   ptrdiff_t dims[2], unsigned int order) {
+  // node contains an array of dims[0] * dims[1] linear pixel indices
+  // into dem. These indices are sorted topologically, so that if
+  // there is an edge from node u to node v, u comes before v in the
+  // array.
+  //
+  // To construct a topological ordering of the flow graph, we conduct
+  // a depth first traversal of the flow graph. The topological order
+  // is given by a reversed postorder of the nodes encountered during
+  // the traversal. As a result, the node array fills up from the
+  // bottom.
+  //
+  // Use node[--next] = u to append vertex u onto the node list.
+  ptrdiff_t next = dims[0] * dims[1];
+
+  // The stack of pixels along the current flow path can only hold up
+  // to as many vertices as have not yet been assigned to the node
+  // list, so it is kept at the top of the node array.
+  ptrdiff_t stack_top = 0;
+
+  ptrdiff_t strides[2] = {0};
+  if (order & 1) {
+    // row-major
+    strides[0] = dims[0];
+    strides[1] = 1;
+  } else {
+    strides[0] = 1;
+    strides[1] = dims[0];
+  }
+
+  ptrdiff_t offsets[8] = {strides[1],  strides[0] + strides[1],
+                          strides[0],  strides[0] - strides[1],
+                          -strides[1], -strides[0] - strides[1],
+                          -strides[0], -strides[0] + strides[1]};
+
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t u = j * dims[0] + i;
+
+      // Follow the flow path downstream until reaching a sink or a
+      // visited pixel
+      while (!is_visited(direction[u])) {
+        // If there were a cycle, the stack would eventually overrun
+        // the node list.
+        assert(stack_top < next);
+        node[stack_top++] = u;
+
+        uint8_t flowdir = (uint8_t)~direction[u];
+        if (flowdir == 0) {
+          // This node is a sink/outlet
+          break;
+        }
+        // flowdir is not an index, but 1<<index
+        // Compute the index
+        uint8_t d = flowdir;
+        uint8_t r = 0;
+        while (d >>= 1) {
+          r++;
+        }
+        u += offsets[r];
+      }
+
+      // Visit the path in reverse, prepending each node to the node
+      // list.
+      while (stack_top > 0) {
+        ptrdiff_t v = node[--stack_top];
+        direction[v] = (uint8_t)~direction[v];
+        assert(next > stack_top);
+        node[--next] = v;
+      }
+    }
+  }
+}
+
+// Minimum of two integer elevations. Missing data is the largest
+// value of the type, so it is ignored like a NaN by fminf.
+#define DEM_IMIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define DEM_T float
+#define DEM_NAME(name) name
+#define DEM_ACC float
+#define DEM_MAX INFINITY
+#define DEM_FMIN fminf
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEM_SIMD_F32
+#endif
+#include "helpers/dem_kernels.h"
+
+#define DEM_T double
+#define DEM_NAME(name) name##_f64
+#define DEM_ACC double
+#define DEM_MAX INFINITY
+#define DEM_FMIN fmin
+#include "helpers/dem_kernels.h"
+
+// Integer DEMs mark missing data with the largest value of the type,
+// which also fills undrained pixels like INFINITY. Other nodata values,
+// such as -32768, must be recoded by the caller.
+#define DEM_T int16_t
+#define DEM_NAME(name) name##_i16
+#define DEM_ACC float
+#define DEM_MAX INT16_MAX
+#define DEM_FMIN DEM_IMIN
+#define DEM_NODATA INT16_MAX
+#include "helpers/dem_kernels.h"
+
+#define DEM_T uint16_t
+#define DEM_NAME(name) name##_u16
+#define DEM_ACC float
+#define DEM_MAX UINT16_MAX
+#define DEM_FMIN DEM_IMIN
+#define DEM_NODATA UINT16_MAX
+#include "helpers/dem_kernels.h"
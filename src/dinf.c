@@ -7,7 +7,6 @@
 
 #include "topotoolbox.h"
 
-#define SQRT2 1.41421356237309504880f
 #define PI 3.14159265358979323846f
 
 static float replicate_boundaries(float *dem, ptrdiff_t i, ptrdiff_t j,
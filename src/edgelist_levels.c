@@ -0,0 +1,240 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "helpers/parallel.h"
+#include "topotoolbox.h"
+
+/*
+  Level-scheduled edge list traversals
+
+  Basin partitioning cannot balance a network that is dominated by a
+  single basin. Instead, the nodes are grouped into levels so that
+  every node depends only on nodes of lower levels. For downstream
+  traversals, the level of a node is its height above the channel
+  heads: the number of edges on the longest path reaching it. For
+  upstream traversals, it is its depth below the outlet: the number
+  of edges on the longest path leaving it.
+
+  The kernels pull rather than push: each node of a level gathers
+  the contributions of its incoming (downstream traversals) or
+  outgoing (upstream traversals) edges, so no two threads ever write
+  the same node. The edges of each node are visited in the same
+  order as in the serial kernels, so the floating point operations
+  are performed in the same order and the results are bitwise
+  identical for any number of threads.
+
+  Nodes without any edges in the relevant direction are never
+  updated by the serial kernels and are not scheduled.
+ */
+
+TOPOTOOLBOX_API
+ptrdiff_t edgelist_level_schedule(ptrdiff_t *level_offsets,
+                                  ptrdiff_t *level_nodes,
+                                  ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+                                  ptrdiff_t *source, ptrdiff_t *target,
+                                  ptrdiff_t edge_count, ptrdiff_t node_count,
+                                  unsigned int upstream) {
+  // The node that gathers along each edge
+  ptrdiff_t *gather = upstream ? source : target;
+  ptrdiff_t *scatter = upstream ? target : source;
+
+  ptrdiff_t *level = (ptrdiff_t *)malloc(node_count * sizeof(ptrdiff_t));
+  if (level == NULL) {
+    return -1;
+  }
+
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    level[u] = 0;
+  }
+
+  // Longest path lengths, visiting the edges in the order of the
+  // traversal
+  ptrdiff_t level_count = 0;
+  for (ptrdiff_t k = 0; k < edge_count; k++) {
+    ptrdiff_t e = upstream ? edge_count - 1 - k : k;
+    ptrdiff_t u = scatter[e];
+    ptrdiff_t v = gather[e];
+    if (level[v] < level[u] + 1) {
+      level[v] = level[u] + 1;
+      if (level[v] > level_count) {
+        level_count = level[v];
+      }
+    }
+  }
+
+  // Group the edges by gathering node with a stable counting sort
+  for (ptrdiff_t u = 0; u <= node_count; u++) {
+    edge_offsets[u] = 0;
+  }
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    edge_offsets[gather[e] + 1]++;
+  }
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    edge_offsets[u + 1] += edge_offsets[u];
+  }
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    edges[edge_offsets[gather[e]]++] = e;
+  }
+  for (ptrdiff_t u = node_count; u > 0; u--) {
+    edge_offsets[u] = edge_offsets[u - 1];
+  }
+  edge_offsets[0] = 0;
+
+  // Group the scheduled nodes by level, also with a counting
+  // sort. Level l of the schedule holds the nodes of level l + 1.
+  for (ptrdiff_t l = 0; l <= level_count; l++) {
+    level_offsets[l] = 0;
+  }
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    if (level[u] > 0) {
+      level_offsets[level[u]]++;
+    }
+  }
+  for (ptrdiff_t l = 0; l < level_count; l++) {
+    level_offsets[l + 1] += level_offsets[l];
+  }
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    if (level[u] > 0) {
+      level_nodes[level_offsets[level[u] - 1]++] = u;
+    }
+  }
+  for (ptrdiff_t l = level_count; l > 0; l--) {
+    level_offsets[l] = level_offsets[l - 1];
+  }
+  level_offsets[0] = 0;
+
+  free(level);
+  return level_count;
+}
+
+TOPOTOOLBOX_API
+void flow_accumulation_edgelist_levels(
+    float *acc, ptrdiff_t *source, float *fraction, float *weights,
+    ptrdiff_t *level_offsets, ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets,
+    ptrdiff_t *edges, ptrdiff_t level_count, ptrdiff_t node_count,
+    int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+#pragma omp parallel num_threads(num_threads)
+  {
+    ptrdiff_t k;
+#pragma omp for schedule(static)
+    for (k = 0; k < node_count; k++) {
+      acc[k] = (weights == NULL) ? 1.0f : weights[k];
+    }
+
+    for (ptrdiff_t l = 0; l < level_count; l++) {
+#pragma omp for schedule(static)
+      for (k = level_offsets[l]; k < level_offsets[l + 1]; k++) {
+        ptrdiff_t v = level_nodes[k];
+        float a = acc[v];
+        for (ptrdiff_t i = edge_offsets[v]; i < edge_offsets[v + 1]; i++) {
+          ptrdiff_t e = edges[i];
+          a += fraction[e] * acc[source[e]];
+        }
+        acc[v] = a;
+      }
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void traverse_down_f32_max_add_levels(
+    float *output, float *input, ptrdiff_t *source, ptrdiff_t *level_offsets,
+    ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+    ptrdiff_t level_count, int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+#pragma omp parallel num_threads(num_threads)
+  for (ptrdiff_t l = 0; l < level_count; l++) {
+    ptrdiff_t k;
+#pragma omp for schedule(static)
+    for (k = level_offsets[l]; k < level_offsets[l + 1]; k++) {
+      ptrdiff_t v = level_nodes[k];
+      float a = output[v];
+      for (ptrdiff_t i = edge_offsets[v]; i < edge_offsets[v + 1]; i++) {
+        ptrdiff_t e = edges[i];
+        a = fmaxf(a, output[source[e]] + input[e]);
+      }
+      output[v] = a;
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void traverse_down_f32_min_add_levels(
+    float *output, float *input, ptrdiff_t *source, ptrdiff_t *level_offsets,
+    ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+    ptrdiff_t level_count, int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+#pragma omp parallel num_threads(num_threads)
+  for (ptrdiff_t l = 0; l < level_count; l++) {
+    ptrdiff_t k;
+#pragma omp for schedule(static)
+    for (k = level_offsets[l]; k < level_offsets[l + 1]; k++) {
+      ptrdiff_t v = level_nodes[k];
+      float a = output[v];
+      for (ptrdiff_t i = edge_offsets[v]; i < edge_offsets[v + 1]; i++) {
+        ptrdiff_t e = edges[i];
+        a = fminf(a, output[source[e]] + input[e]);
+      }
+      output[v] = a;
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void traverse_down_f32_strahler_levels(
+    float *output, ptrdiff_t *source, ptrdiff_t *level_offsets,
+    ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+    ptrdiff_t level_count, int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+#pragma omp parallel num_threads(num_threads)
+  for (ptrdiff_t l = 0; l < level_count; l++) {
+    ptrdiff_t k;
+#pragma omp for schedule(static)
+    for (k = level_offsets[l]; k < level_offsets[l + 1]; k++) {
+      ptrdiff_t v = level_nodes[k];
+      float a = output[v];
+      for (ptrdiff_t i = edge_offsets[v]; i < edge_offsets[v + 1]; i++) {
+        float b = output[source[edges[i]]];
+        if (b == a) {
+          a = a + 1;
+        } else if (b > a) {
+          a = b;
+        }
+      }
+      output[v] = a;
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void traverse_up_f32_max_add_levels(
+    float *output, float *input, ptrdiff_t *target, ptrdiff_t *level_offsets,
+    ptrdiff_t *level_nodes, ptrdiff_t *edge_offsets, ptrdiff_t *edges,
+    ptrdiff_t level_count, int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+#pragma omp parallel num_threads(num_threads)
+  for (ptrdiff_t l = 0; l < level_count; l++) {
+    ptrdiff_t k;
+#pragma omp for schedule(static)
+    for (k = level_offsets[l]; k < level_offsets[l + 1]; k++) {
+      ptrdiff_t u = level_nodes[k];
+      float a = output[u];
+      // The serial kernel visits the edges in reverse order
+      for (ptrdiff_t i = edge_offsets[u + 1] - 1; i >= edge_offsets[u]; i--) {
+        ptrdiff_t e = edges[i];
+        a = fmaxf(a, output[target[e]] + input[e]);
+      }
+      output[u] = a;
+    }
+  }
+}
@@ -0,0 +1,240 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "helpers/parallel.h"
+#include "helpers/union_find.h"
+#include "topotoolbox.h"
+
+/*
+  Basin-partitioned edge lists
+
+  Edges in different drainage basins never share a node, so the
+  traversal kernels can process every basin independently. In a
+  multiple flow network, a node can drain into several basins that
+  are only joined further downstream, so the basins are the weakly
+  connected components of the flow network. They are found with a
+  union-find over the endpoints of every edge rather than by
+  propagating labels upstream as drainagebasins does, which is only
+  valid if every node has at most one receiver.
+  edgelist_partition_basins reorders a topologically sorted edge
+  list into one contiguous segment per basin. The order of the edges
+  within each segment is preserved, so every segment is itself
+  topologically sorted and the kernels below produce bitwise the same
+  results as their serial counterparts.
+
+  The segments are ordered by decreasing size and handed out to the
+  threads with a dynamic schedule, which balances the load when a
+  few large basins dominate, as in gwdt_parallel.
+ */
+typedef struct {
+  ptrdiff_t label;
+  ptrdiff_t size;
+} BasinSegment;
+
+static int basinsegment_compare(const void *x, const void *y) {
+  const BasinSegment *a = (const BasinSegment *)x;
+  const BasinSegment *b = (const BasinSegment *)y;
+  if (a->size != b->size) {
+    return a->size < b->size ? 1 : -1;
+  }
+  return (a->label > b->label) - (a->label < b->label);
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t edgelist_partition_basins(ptrdiff_t *segment_offsets,
+                                    ptrdiff_t *permutation,
+                                    ptrdiff_t *partitioned_source,
+                                    ptrdiff_t *partitioned_target,
+                                    ptrdiff_t *basins, ptrdiff_t *source,
+                                    ptrdiff_t *target, ptrdiff_t edge_count,
+                                    ptrdiff_t node_count) {
+  ptrdiff_t *parent = (ptrdiff_t *)malloc(node_count * sizeof(ptrdiff_t));
+  if (parent == NULL) {
+    return -1;
+  }
+
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    parent[u] = u;
+    basins[u] = 0;
+  }
+
+  // Merge the components of the two endpoints of every edge. The
+  // root with the larger index is attached to the other one.
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t a = union_find_root(parent, source[e]);
+    ptrdiff_t b = union_find_root(parent, target[e]);
+    if (a < b) {
+      parent[b] = a;
+    } else if (b < a) {
+      parent[a] = b;
+    }
+  }
+
+  // Number the components in the order in which drainagebasins
+  // encounters its outlets, so that the labels of a single flow
+  // network are identical to those of drainagebasins. Only the roots
+  // are labeled here.
+  ptrdiff_t basin_count = 0;
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t root = union_find_root(parent, target[e]);
+    if (basins[root] == 0) {
+      basins[root] = ++basin_count;
+    }
+  }
+
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    basins[u] = basins[union_find_root(parent, u)];
+  }
+  free(parent);
+
+  if (basin_count == 0) {
+    segment_offsets[0] = 0;
+    return 0;
+  }
+
+  BasinSegment *segments =
+      (BasinSegment *)malloc(basin_count * sizeof(BasinSegment));
+  if (segments == NULL) {
+    return -1;
+  }
+
+  for (ptrdiff_t b = 0; b < basin_count; b++) {
+    segments[b].label = b + 1;
+    segments[b].size = 0;
+  }
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    segments[basins[source[e]] - 1].size++;
+  }
+
+  qsort(segments, basin_count, sizeof(BasinSegment), basinsegment_compare);
+
+  // segment_offsets holds at least basin_count + 1 elements, so it
+  // is used to map each basin label to the next free position in its
+  // segment before it receives the final offsets.
+  ptrdiff_t offset = 0;
+  for (ptrdiff_t s = 0; s < basin_count; s++) {
+    segment_offsets[segments[s].label] = offset;
+    offset += segments[s].size;
+  }
+
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t position = segment_offsets[basins[source[e]]]++;
+    permutation[position] = e;
+    partitioned_source[position] = source[e];
+    partitioned_target[position] = target[e];
+  }
+
+  offset = 0;
+  for (ptrdiff_t s = 0; s < basin_count; s++) {
+    segment_offsets[s] = offset;
+    offset += segments[s].size;
+  }
+  segment_offsets[basin_count] = offset;
+
+  free(segments);
+  return basin_count;
+}
+
+TOPOTOOLBOX_API
+void flow_accumulation_edgelist_parallel(
+    float *acc, ptrdiff_t *source, ptrdiff_t *target, float *fraction,
+    float *weights, ptrdiff_t *segment_offsets, ptrdiff_t segment_count,
+    ptrdiff_t node_count, int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t u;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (u = 0; u < node_count; u++) {
+    acc[u] = (weights == NULL) ? 1.0f : weights[u];
+  }
+
+  ptrdiff_t s;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  for (s = 0; s < segment_count; s++) {
+    for (ptrdiff_t e = segment_offsets[s]; e < segment_offsets[s + 1]; e++) {
+      acc[target[e]] += fraction[e] * acc[source[e]];
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void streamquad_trapz_f32_parallel(float *integral, float *integrand,
+                                   ptrdiff_t *source, ptrdiff_t *target,
+                                   float *weight, ptrdiff_t *segment_offsets,
+                                   ptrdiff_t segment_count, int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t s;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  for (s = 0; s < segment_count; s++) {
+    for (ptrdiff_t e = segment_offsets[s + 1] - 1; e >= segment_offsets[s];
+         e--) {
+      ptrdiff_t u = source[e];
+      ptrdiff_t v = target[e];
+      integral[u] =
+          integral[v] + weight[e] * (integrand[u] + integrand[v]) / 2;
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void traverse_down_f32_max_add_parallel(float *output, float *input,
+                                        ptrdiff_t *source, ptrdiff_t *target,
+                                        ptrdiff_t *segment_offsets,
+                                        ptrdiff_t segment_count,
+                                        int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t s;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  for (s = 0; s < segment_count; s++) {
+    for (ptrdiff_t e = segment_offsets[s]; e < segment_offsets[s + 1]; e++) {
+      ptrdiff_t u = source[e];
+      ptrdiff_t v = target[e];
+      output[v] = fmaxf(output[v], output[u] + input[e]);
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void traverse_up_f32_max_add_parallel(float *output, float *input,
+                                      ptrdiff_t *source, ptrdiff_t *target,
+                                      ptrdiff_t *segment_offsets,
+                                      ptrdiff_t segment_count,
+                                      int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t s;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  for (s = 0; s < segment_count; s++) {
+    for (ptrdiff_t e = segment_offsets[s + 1] - 1; e >= segment_offsets[s];
+         e--) {
+      ptrdiff_t u = source[e];
+      ptrdiff_t v = target[e];
+      output[u] = fmaxf(output[u], output[v] + input[e]);
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void traverse_down_f32_add_mul_parallel(float *output, float *input,
+                                        ptrdiff_t *source, ptrdiff_t *target,
+                                        ptrdiff_t *segment_offsets,
+                                        ptrdiff_t segment_count,
+                                        int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t s;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  for (s = 0; s < segment_count; s++) {
+    for (ptrdiff_t e = segment_offsets[s]; e < segment_offsets[s + 1]; e++) {
+      ptrdiff_t u = source[e];
+      ptrdiff_t v = target[e];
+      output[v] = output[v] + output[u] * input[e];
+    }
+  }
+}
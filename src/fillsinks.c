@@ -3,75 +3,1523 @@
 #include <math.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "helpers/parallel.h"
+#include "helpers/priority_queue.h"
+#include "helpers/union_find.h"
 #include "topotoolbox.h"
 
 /*
-  Fill sinks in a digital elevation model.
+  Binary min-heap of pixel indices used by the priority-flood fills.
 
-  The arrays pointed to by `output` and `dem` should represent a two
-  dimensional array of size (nrows, ncols). The filled DEM is written
-  to the `output` array.
+  The heap only stores the pixel indices. The priority of a pixel is
+  its current value in the `z` array, which must not change while the
+  pixel is in the heap. NaNs are never inserted.
+ */
+typedef struct {
+  ptrdiff_t *heap;
+  const float *z;
+  ptrdiff_t count;
+} PixelHeap;
 
-  `dem` is modified during the processing, but the modifications are
-  reverted before the function returns. Be careful when accessing
-  `dem` concurrently with `fillsinks`.
+static void pixelheap_push(PixelHeap *h, ptrdiff_t p) {
+  ptrdiff_t position = h->count++;
+  float zp = h->z[p];
+  while (position > 0) {
+    ptrdiff_t parent = (position - 1) / 2;
+    if (h->z[h->heap[parent]] <= zp) {
+      break;
+    }
+    h->heap[position] = h->heap[parent];
+    position = parent;
+  }
+  h->heap[position] = p;
+}
+
+static ptrdiff_t pixelheap_pop(PixelHeap *h) {
+  ptrdiff_t root = h->heap[0];
+  ptrdiff_t last = h->heap[--h->count];
+  float zl = h->z[last];
+
+  ptrdiff_t position = 0;
+  while (2 * position + 1 < h->count) {
+    ptrdiff_t child = 2 * position + 1;
+    if (child + 1 < h->count &&
+        h->z[h->heap[child + 1]] < h->z[h->heap[child]]) {
+      child++;
+    }
+    if (zl <= h->z[h->heap[child]]) {
+      break;
+    }
+    h->heap[position] = h->heap[child];
+    position = child;
+  }
+  h->heap[position] = last;
+  return root;
+}
+
+/*
+  An undirected edge of the spill graph used by fillsinks_parallel and
+  fillsinks_outofcore.
+
+  `a` and `b` are watershed labels and `z` is the lowest elevation at
+  which water can pass between the two watersheds.
+ */
+typedef struct {
+  ptrdiff_t a;
+  ptrdiff_t b;
+  float z;
+} SpillEdge;
+
+typedef struct {
+  SpillEdge *edges;
+  ptrdiff_t count;
+  ptrdiff_t capacity;
+  // A bounded list is compacted in place when it is full, and it only
+  // grows if compacting frees less than half of its capacity.
+  int32_t bounded;
+} SpillEdgeList;
+
+static int spilledge_compare(const void *x, const void *y) {
+  const SpillEdge *e = (const SpillEdge *)x;
+  const SpillEdge *f = (const SpillEdge *)y;
+  if (e->a != f->a) {
+    return e->a < f->a ? -1 : 1;
+  }
+  if (e->b != f->b) {
+    return e->b < f->b ? -1 : 1;
+  }
+  return (e->z > f->z) - (e->z < f->z);
+}
+
+/*
+  Remove duplicate edges from the list, keeping the lowest spill
+  elevation between every pair of watersheds.
+
+  The flood records every adjacency between two watersheds, usually
+  from both sides, so the raw lists contain many duplicates.
+ */
+static void spilledge_compact(SpillEdgeList *list) {
+  if (list->count == 0) {
+    return;
+  }
+
+  for (ptrdiff_t e = 0; e < list->count; e++) {
+    if (list->edges[e].a > list->edges[e].b) {
+      ptrdiff_t a = list->edges[e].a;
+      list->edges[e].a = list->edges[e].b;
+      list->edges[e].b = a;
+    }
+  }
+
+  qsort(list->edges, list->count, sizeof(SpillEdge), spilledge_compare);
+
+  // The lowest elevation of every pair comes first after sorting
+  ptrdiff_t count = 0;
+  for (ptrdiff_t e = 0; e < list->count; e++) {
+    if (count == 0 || list->edges[e].a != list->edges[count - 1].a ||
+        list->edges[e].b != list->edges[count - 1].b) {
+      list->edges[count++] = list->edges[e];
+    }
+  }
+  list->count = count;
+}
+
+// Returns 1 if successful, 0 if the list could not be grown.
+static int32_t spilledge_add(SpillEdgeList *list, ptrdiff_t a, ptrdiff_t b,
+                             float z) {
+  if (list->count == list->capacity) {
+    if (list->bounded) {
+      spilledge_compact(list);
+    }
+    if (list->count == list->capacity || list->count > list->capacity / 2) {
+      ptrdiff_t capacity = list->capacity > 0 ? 2 * list->capacity : 64;
+      SpillEdge *edges =
+          (SpillEdge *)realloc(list->edges, capacity * sizeof(SpillEdge));
+      if (edges == NULL) {
+        return 0;
+      }
+      list->edges = edges;
+      list->capacity = capacity;
+    }
+  }
+  list->edges[list->count].a = a;
+  list->edges[list->count].b = b;
+  list->edges[list->count].z = z;
+  list->count++;
+  return 1;
+}
+
+/*
+  Tile layout for fillsinks_parallel and fillsinks_outofcore.
+
+  The DEM is cut into tiles of size tile_dims[0] x tile_dims[1], with
+  the tiles at the high end of each dimension possibly smaller. Tile
+  `t` covers the pixels with i in [i0, i1) and j in [j0, j1).
+ */
+typedef struct {
+  ptrdiff_t dims[2];
+  ptrdiff_t tile_dims[2];
+  ptrdiff_t count[2];
+  ptrdiff_t *base;  // First global watershed label of every tile
+} TileLayout;
+
+static void tile_bounds(TileLayout *layout, ptrdiff_t t, ptrdiff_t *i0,
+                        ptrdiff_t *i1, ptrdiff_t *j0, ptrdiff_t *j1) {
+  ptrdiff_t ti = t % layout->count[0];
+  ptrdiff_t tj = t / layout->count[0];
+
+  *i0 = ti * layout->tile_dims[0];
+  *i1 = *i0 + layout->tile_dims[0] < layout->dims[0]
+            ? *i0 + layout->tile_dims[0]
+            : layout->dims[0];
+  *j0 = tj * layout->tile_dims[1];
+  *j1 = *j0 + layout->tile_dims[1] < layout->dims[1]
+            ? *j0 + layout->tile_dims[1]
+            : layout->dims[1];
+}
+
+// Global watershed label of the tile-local label `label` in a tile
+// whose first global label is `base`.
+//
+// Label 0 is shared by every tile and is reserved for the watershed
+// of the pixels with bc == 1.
+static ptrdiff_t global_label(ptrdiff_t base, int32_t label) {
+  return label == 0 ? 0 : base + label - 1;
+}
+
+static ptrdiff_t tile_global_label(TileLayout *layout, ptrdiff_t t,
+                                   int32_t label) {
+  return global_label(layout->base[t], label);
+}
+
+/*
+  Fill a single tile with a priority flood.
+
+  The tile consists of the pixels with i in [bounds[0], bounds[1]) and
+  j in [bounds[2], bounds[3]) of arrays of size dims[0] x dims[1].
+
+  Every pixel on the perimeter of the tile is a seed of its own
+  watershed, and pixels with bc == 1 are seeds of the global outlet
+  watershed 0. The flood fills the tile as if water could leave it
+  through any of its perimeter pixels, labels each pixel with the
+  watershed of the seed that reached it first and records the spill
+  elevation between every pair of adjacent watersheds in `edges`
+  unless `edges` is NULL. Perimeter seeds are numbered in raster
+  order starting at the global label `base`, so flooding the same
+  tile twice produces the same labels.
+
+  `heap` must be large enough to hold every pixel in the tile.
+
+  Returns 1 if successful, 0 if the edge list could not be allocated.
+ */
+static int32_t fillsinks_tile_flood(float *output, int32_t *labels,
+                                    ptrdiff_t *heap, SpillEdgeList *edges,
+                                    const float *dem, uint8_t *bc,
+                                    ptrdiff_t dims[2], ptrdiff_t bounds[4],
+                                    ptrdiff_t base) {
+  ptrdiff_t i_offset[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  ptrdiff_t j_offset[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+  ptrdiff_t i0 = bounds[0];
+  ptrdiff_t i1 = bounds[1];
+  ptrdiff_t j0 = bounds[2];
+  ptrdiff_t j1 = bounds[3];
+
+  PixelHeap h = {0};
+  h.heap = heap;
+  h.z = output;
+
+  int32_t next_label = 1;
+  for (ptrdiff_t j = j0; j < j1; j++) {
+    for (ptrdiff_t i = i0; i < i1; i++) {
+      ptrdiff_t p = j * dims[0] + i;
+      labels[p] = -1;
+
+      if (isnan(dem[p])) {
+        // NaNs are never filled and block the flow of water
+        output[p] = dem[p];
+        continue;
+      }
+
+      if (bc[p] == 1) {
+        labels[p] = 0;
+      } else if (i == i0 || i == i1 - 1 || j == j0 || j == j1 - 1) {
+        labels[p] = next_label++;
+      } else {
+        // Pixels that are never reached by the flood cannot drain and
+        // are filled to infinity, as in fillsinks.
+        output[p] = INFINITY;
+        continue;
+      }
+      output[p] = dem[p];
+      pixelheap_push(&h, p);
+    }
+  }
+
+  while (h.count > 0) {
+    ptrdiff_t p = pixelheap_pop(&h);
+    ptrdiff_t i = p % dims[0];
+    ptrdiff_t j = p / dims[0];
+
+    for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+      if (neighbor_i < i0 || neighbor_i >= i1 || neighbor_j < j0 ||
+          neighbor_j >= j1) {
+        continue;
+      }
+
+      ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+      if (isnan(dem[q])) {
+        continue;
+      }
+
+      if (labels[q] == -1) {
+        labels[q] = labels[p];
+        output[q] = dem[q] > output[p] ? dem[q] : output[p];
+        pixelheap_push(&h, q);
+      } else if (edges && labels[q] != labels[p]) {
+        float z = output[q] > output[p] ? output[q] : output[p];
+        if (!spilledge_add(edges, global_label(base, labels[p]),
+                           global_label(base, labels[q]), z)) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/*
+  Record the spill edges between the perimeter pixels of tile `t` and
+  their neighbors in tiles with a larger index.
+
+  Returns 1 if successful, 0 if the edge list could not be allocated.
+ */
+static int32_t fillsinks_tile_seams(SpillEdgeList *edges, float *output,
+                                    int32_t *labels, TileLayout *layout,
+                                    ptrdiff_t t) {
+  ptrdiff_t i_offset[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  ptrdiff_t j_offset[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+  ptrdiff_t *dims = layout->dims;
+  ptrdiff_t i0, i1, j0, j1;
+  tile_bounds(layout, t, &i0, &i1, &j0, &j1);
+
+  for (ptrdiff_t j = j0; j < j1; j++) {
+    for (ptrdiff_t i = i0; i < i1; i++) {
+      if (i != i0 && i != i1 - 1 && j != j0 && j != j1 - 1) {
+        continue;
+      }
+
+      ptrdiff_t p = j * dims[0] + i;
+      if (labels[p] < 0) {
+        continue;
+      }
+
+      for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+        ptrdiff_t neighbor_i = i + i_offset[neighbor];
+        ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+        if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+            neighbor_j >= dims[1]) {
+          continue;
+        }
+
+        ptrdiff_t u = (neighbor_j / layout->tile_dims[1]) * layout->count[0] +
+                      neighbor_i / layout->tile_dims[0];
+        ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+        if (u <= t || labels[q] < 0) {
+          continue;
+        }
+
+        float z = output[q] > output[p] ? output[q] : output[p];
+        if (!spilledge_add(edges, tile_global_label(layout, t, labels[p]),
+                           tile_global_label(layout, u, labels[q]), z)) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/*
+  Compute the spill elevation of every watershed in the spill graph.
+
+  The spill elevation of a watershed is the lowest elevation at which
+  water in it can reach watershed 0. It is computed with a minimax
+  variant of Dijkstra's algorithm over the edges of all tiles.
+
+  Returns 1 if successful, 0 if memory could not be allocated.
+ */
+static int32_t fillsinks_spill_graph(float *spill, SpillEdgeList *lists,
+                                     ptrdiff_t list_count,
+                                     ptrdiff_t label_count) {
+  ptrdiff_t edge_count = 0;
+  for (ptrdiff_t t = 0; t < list_count; t++) {
+    edge_count += lists[t].count;
+  }
+
+  ptrdiff_t *offsets =
+      (ptrdiff_t *)calloc(label_count + 1, sizeof(ptrdiff_t));
+  ptrdiff_t *adjacent =
+      (ptrdiff_t *)malloc((2 * edge_count + 1) * sizeof(ptrdiff_t));
+  float *weights = (float *)malloc((2 * edge_count + 1) * sizeof(float));
+  ptrdiff_t *heap = (ptrdiff_t *)malloc(label_count * sizeof(ptrdiff_t));
+  ptrdiff_t *back = (ptrdiff_t *)malloc(label_count * sizeof(ptrdiff_t));
+  if (!offsets || !adjacent || !weights || !heap || !back) {
+    free(offsets);
+    free(adjacent);
+    free(weights);
+    free(heap);
+    free(back);
+    return 0;
+  }
+
+  // Build the adjacency lists of the spill graph in compressed sparse
+  // row format.
+  for (ptrdiff_t t = 0; t < list_count; t++) {
+    for (ptrdiff_t e = 0; e < lists[t].count; e++) {
+      offsets[lists[t].edges[e].a + 1]++;
+      offsets[lists[t].edges[e].b + 1]++;
+    }
+  }
+  for (ptrdiff_t v = 0; v < label_count; v++) {
+    offsets[v + 1] += offsets[v];
+  }
+  for (ptrdiff_t t = 0; t < list_count; t++) {
+    for (ptrdiff_t e = 0; e < lists[t].count; e++) {
+      SpillEdge edge = lists[t].edges[e];
+      ptrdiff_t ea = offsets[edge.a]++;
+      adjacent[ea] = edge.b;
+      weights[ea] = edge.z;
+      ptrdiff_t eb = offsets[edge.b]++;
+      adjacent[eb] = edge.a;
+      weights[eb] = edge.z;
+    }
+  }
+  // The previous loop shifted every offset by one position
+  for (ptrdiff_t v = label_count; v > 0; v--) {
+    offsets[v] = offsets[v - 1];
+  }
+  offsets[0] = 0;
+
+  for (ptrdiff_t v = 0; v < label_count; v++) {
+    spill[v] = INFINITY;
+    heap[v] = v;
+    back[v] = v;
+  }
+  spill[0] = -INFINITY;
+
+  PriorityQueue q = pq_create(label_count, heap, back, spill, 1);
+  while (!pq_isempty(&q)) {
+    ptrdiff_t u = pq_deletemin(&q);
+    float zu = pq_get_priority(&q, u);
+
+    for (ptrdiff_t e = offsets[u]; e < offsets[u + 1]; e++) {
+      ptrdiff_t v = adjacent[e];
+      if (back[v] < 0) {
+        // v has already been removed from the queue
+        continue;
+      }
+      float z = weights[e] > zu ? weights[e] : zu;
+      pq_decrease_key(&q, v, z);
+    }
+  }
+
+  free(offsets);
+  free(adjacent);
+  free(weights);
+  free(heap);
+  free(back);
+  return 1;
+}
 
-  Sinks are filled using grayscale morphological reconstruction.
-*/
 TOPOTOOLBOX_API
-void fillsinks(float *output, float *dem, uint8_t *bc, ptrdiff_t dims[2]) {
-  for (ptrdiff_t j = 0; j < dims[1]; j++) {
-    for (ptrdiff_t i = 0; i < dims[0]; i++) {
-      // Invert the DEM
-      dem[j * dims[0] + i] *= -1.0;
+void fillsinks_parallel(float *output, const float *dem, uint8_t *bc,
+                        ptrdiff_t dims[2], ptrdiff_t tile_dims[2],
+                        int num_threads) {
+  TileLayout layout = {0};
+  layout.dims[0] = dims[0];
+  layout.dims[1] = dims[1];
+  layout.tile_dims[0] = tile_dims && tile_dims[0] > 0 ? tile_dims[0] : 512;
+  layout.tile_dims[1] = tile_dims && tile_dims[1] > 0 ? tile_dims[1] : 512;
+
+  layout.count[0] = (dims[0] + layout.tile_dims[0] - 1) / layout.tile_dims[0];
+  layout.count[1] = (dims[1] + layout.tile_dims[1] - 1) / layout.tile_dims[1];
+  ptrdiff_t tile_count = layout.count[0] * layout.count[1];
+
+  if (tile_count == 0) {
+    return;
+  }
+
+  num_threads = resolve_threads(num_threads);
+
+  // Every perimeter pixel of a tile may start its own watershed.
+  // Label 0 is the outlet watershed.
+  layout.base = (ptrdiff_t *)malloc((tile_count + 1) * sizeof(ptrdiff_t));
+  int32_t *labels = (int32_t *)malloc(dims[0] * dims[1] * sizeof(int32_t));
+  SpillEdgeList *edges =
+      (SpillEdgeList *)calloc(tile_count, sizeof(SpillEdgeList));
+  float *spill = NULL;
+
+  int32_t success = layout.base && labels && edges;
+  ptrdiff_t failures = 0;
 
-      // Set the boundary pixels of the output equal to the DEM and
-      // the interior pixels equal to -INFINITY.
-      if (bc[j * dims[0] + i] == 1) {
-        output[j * dims[0] + i] = dem[j * dims[0] + i];
+  if (success) {
+    layout.base[0] = 1;
+    for (ptrdiff_t t = 0; t < tile_count; t++) {
+      ptrdiff_t i0, i1, j0, j1;
+      tile_bounds(&layout, t, &i0, &i1, &j0, &j1);
+      ptrdiff_t h = i1 - i0;
+      ptrdiff_t w = j1 - j0;
+      ptrdiff_t perimeter = h > 2 && w > 2 ? 2 * (h + w) - 4 : h * w;
+      layout.base[t + 1] = layout.base[t] + perimeter;
+    }
+  }
+
+  // Fill every tile independently
+  if (success) {
+    ptrdiff_t t;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (t = 0; t < tile_count; t++) {
+      ptrdiff_t bounds[4];
+      tile_bounds(&layout, t, &bounds[0], &bounds[1], &bounds[2], &bounds[3]);
+      ptrdiff_t tile_size = (bounds[1] - bounds[0]) * (bounds[3] - bounds[2]);
+      ptrdiff_t *heap = (ptrdiff_t *)malloc(tile_size * sizeof(ptrdiff_t));
+      if (!heap || !fillsinks_tile_flood(output, labels, heap, &edges[t], dem,
+                                         bc, dims, bounds, layout.base[t])) {
+#pragma omp atomic
+        failures++;
       } else {
-        output[j * dims[0] + i] = -INFINITY;
+        spilledge_compact(&edges[t]);
+      }
+      free(heap);
+    }
+    success = failures == 0;
+  }
+
+  // Connect the watersheds of neighboring tiles
+  if (success) {
+    ptrdiff_t t;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (t = 0; t < tile_count; t++) {
+      if (!fillsinks_tile_seams(&edges[t], output, labels, &layout, t)) {
+#pragma omp atomic
+        failures++;
       }
     }
+    success = failures == 0;
   }
 
-  reconstruct(output, dem, dims);
+  // Solve the spill graph
+  if (success) {
+    spill = (float *)malloc(layout.base[tile_count] * sizeof(float));
+    success = spill && fillsinks_spill_graph(spill, edges, tile_count,
+                                             layout.base[tile_count]);
+  }
 
-  // Revert the DEM and the output
-  for (ptrdiff_t j = 0; j < dims[1]; j++) {
-    for (ptrdiff_t i = 0; i < dims[0]; i++) {
-      dem[j * dims[0] + i] *= -1.0;
-      output[j * dims[0] + i] *= -1.0;
+  // Raise every pixel to the spill elevation of its watershed
+  if (success) {
+    ptrdiff_t t;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (t = 0; t < tile_count; t++) {
+      ptrdiff_t i0, i1, j0, j1;
+      tile_bounds(&layout, t, &i0, &i1, &j0, &j1);
+      for (ptrdiff_t j = j0; j < j1; j++) {
+        for (ptrdiff_t i = i0; i < i1; i++) {
+          ptrdiff_t p = j * dims[0] + i;
+          if (labels[p] >= 0) {
+            float z = spill[tile_global_label(&layout, t, labels[p])];
+            if (z > output[p]) {
+              output[p] = z;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (edges) {
+    for (ptrdiff_t t = 0; t < tile_count; t++) {
+      free(edges[t].edges);
     }
   }
+  free(edges);
+  free(labels);
+  free(layout.base);
+  free(spill);
+
+  if (!success) {
+    // Fall back to the sequential algorithm if we ran out of memory
+    fillsinks(output, dem, bc, dims);
+  }
 }
 
 TOPOTOOLBOX_API
-void fillsinks_hybrid(float *output, ptrdiff_t *queue, float *dem, uint8_t *bc,
-                      ptrdiff_t dims[2]) {
+void fillsinks_priorityflood(float *output, ptrdiff_t *queue,
+                             const float *dem, uint8_t *bc, ptrdiff_t dims[2]) {
+  ptrdiff_t i_offset[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  ptrdiff_t j_offset[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+  ptrdiff_t n = dims[0] * dims[1];
+
+  // The heap grows from the front of the queue buffer, while the pit
+  // queue is stored at the back. Every pixel enters one of them at
+  // most once, so they never overlap.
+  PixelHeap h = {0};
+  h.heap = queue;
+  h.z = output;
+
+  // The pit queue occupies queue[pit_tail .. pit_head). It is only
+  // ever filled while it is being emptied, so it can be reset to the
+  // end of the buffer whenever it becomes empty.
+  ptrdiff_t pit_head = n;
+  ptrdiff_t pit_tail = n;
+
+  // Pixels that have not yet been reached by the flood are marked
+  // with NaN in the output.
   for (ptrdiff_t j = 0; j < dims[1]; j++) {
     for (ptrdiff_t i = 0; i < dims[0]; i++) {
-      // Invert the DEM
-      dem[j * dims[0] + i] *= -1.0;
+      ptrdiff_t p = j * dims[0] + i;
+      if (isnan(dem[p])) {
+        output[p] = dem[p];
+      } else if (bc[p] == 1) {
+        output[p] = dem[p];
+        pixelheap_push(&h, p);
+      } else {
+        output[p] = NAN;
+      }
+    }
+  }
 
-      // Set the boundary pixels of the output equal to the DEM and
-      // the interior pixels equal to -INFINITY.
-      if (bc[j * dims[0] + i] == 1) {
-        output[j * dims[0] + i] = dem[j * dims[0] + i];
+  while (h.count > 0 || pit_head > pit_tail) {
+    ptrdiff_t p;
+    if (pit_head > pit_tail) {
+      p = queue[--pit_head];
+      if (pit_head == pit_tail) {
+        pit_head = n;
+        pit_tail = n;
+      }
+    } else {
+      p = pixelheap_pop(&h);
+    }
+
+    ptrdiff_t i = p % dims[0];
+    ptrdiff_t j = p / dims[0];
+
+    for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1]) {
+        continue;
+      }
+
+      ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+      if (isnan(dem[q]) || !isnan(output[q])) {
+        // q is a NaN or has already been reached
+        continue;
+      }
+
+      if (dem[q] <= output[p]) {
+        // q lies in a pit and is filled to the level of p. Pits are
+        // processed in FIFO order before any pixels in the heap.
+        output[q] = output[p];
+        queue[--pit_tail] = q;
       } else {
-        output[j * dims[0] + i] = -INFINITY;
+        output[q] = dem[q];
+        pixelheap_push(&h, q);
       }
     }
   }
 
-  reconstruct_hybrid(output, queue, dem, dims);
+  // Pixels that were never reached cannot drain and are filled to
+  // infinity, as in fillsinks.
+  for (ptrdiff_t p = 0; p < n; p++) {
+    if (isnan(output[p]) && !isnan(dem[p])) {
+      output[p] = INFINITY;
+    }
+  }
+}
+
+/*
+  Resident information about the perimeter of a tile used by
+  fillsinks_outofcore.
 
-  // Revert the DEM and the output
-  for (ptrdiff_t j = 0; j < dims[1]; j++) {
-    for (ptrdiff_t i = 0; i < dims[0]; i++) {
-      dem[j * dims[0] + i] *= -1.0;
-      output[j * dims[0] + i] *= -1.0;
+  The perimeter pixels of a tile of size h x w are stored in four
+  strips: the first column (j = 0, indexed by i) at [0, h), the last
+  column (j = w - 1) at [h, 2h), the first row (i = 0, indexed by j)
+  at [2h, 2h + w) and the last row (i = h - 1) at [2h + w, 2h + 2w).
+  Corner pixels appear in two strips.
+ */
+typedef struct {
+  ptrdiff_t *labels;  // Global watershed labels, -1 for NaNs
+  float *z;           // Elevations of the perimeter pixels
+} TilePerimeter;
+
+// Position of the perimeter pixel (i, j) of a tile of size h x w in
+// the strips of a TilePerimeter.
+static ptrdiff_t perimeter_position(ptrdiff_t i, ptrdiff_t j, ptrdiff_t h,
+                                    ptrdiff_t w) {
+  if (j == 0) {
+    return i;
+  } else if (j == w - 1) {
+    return h + i;
+  } else if (i == 0) {
+    return 2 * h + j;
+  } else {
+    return 2 * h + w + j;
+  }
+}
+
+/*
+  Record the spill edges between the perimeter of tile `t` and the
+  perimeters of neighboring tiles with a larger index using only the
+  resident perimeter information.
+
+  Returns 1 if successful, 0 if the edge list could not be allocated.
+ */
+static int32_t fillsinks_outofcore_seams(SpillEdgeList *edges,
+                                         TilePerimeter *perimeters,
+                                         TileLayout *layout, ptrdiff_t t) {
+  ptrdiff_t i_offset[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  ptrdiff_t j_offset[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+  ptrdiff_t *dims = layout->dims;
+  ptrdiff_t i0, i1, j0, j1;
+  tile_bounds(layout, t, &i0, &i1, &j0, &j1);
+
+  for (ptrdiff_t j = j0; j < j1; j++) {
+    for (ptrdiff_t i = i0; i < i1; i++) {
+      if (i != i0 && i != i1 - 1 && j != j0 && j != j1 - 1) {
+        continue;
+      }
+
+      ptrdiff_t pp = perimeter_position(i - i0, j - j0, i1 - i0, j1 - j0);
+      ptrdiff_t label = perimeters[t].labels[pp];
+      if (label < 0) {
+        continue;
+      }
+      float z = perimeters[t].z[pp];
+
+      for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+        ptrdiff_t neighbor_i = i + i_offset[neighbor];
+        ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+        if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+            neighbor_j >= dims[1]) {
+          continue;
+        }
+
+        ptrdiff_t u = (neighbor_j / layout->tile_dims[1]) * layout->count[0] +
+                      neighbor_i / layout->tile_dims[0];
+        if (u <= t) {
+          continue;
+        }
+
+        ptrdiff_t ui0, ui1, uj0, uj1;
+        tile_bounds(layout, u, &ui0, &ui1, &uj0, &uj1);
+        ptrdiff_t qp = perimeter_position(neighbor_i - ui0, neighbor_j - uj0,
+                                          ui1 - ui0, uj1 - uj0);
+        if (perimeters[u].labels[qp] < 0) {
+          continue;
+        }
+
+        float zq = perimeters[u].z[qp];
+        if (!spilledge_add(edges, label, perimeters[u].labels[qp],
+                           zq > z ? zq : z)) {
+          return 0;
+        }
+      }
     }
   }
+  return 1;
+}
+
+TOPOTOOLBOX_API
+int fillsinks_outofcore(fillsinks_read_tile read_tile,
+                        fillsinks_write_tile write_tile, void *context,
+                        ptrdiff_t dims[2], size_t memory_budget) {
+  // Working memory per pixel of a tile: DEM, boundary conditions,
+  // output, labels, heap and one slot of the raw spill edge list
+  size_t pixel_size = 2 * sizeof(float) + sizeof(uint8_t) + sizeof(int32_t) +
+                      sizeof(ptrdiff_t) + sizeof(SpillEdge);
+  ptrdiff_t side = (ptrdiff_t)sqrt((double)(memory_budget / pixel_size));
+  if (side < 1) {
+    return -1;
+  }
+
+  TileLayout layout = {0};
+  layout.dims[0] = dims[0];
+  layout.dims[1] = dims[1];
+  layout.tile_dims[0] = side < dims[0] ? side : dims[0];
+  layout.tile_dims[1] = side < dims[1] ? side : dims[1];
+
+  if (dims[0] <= 0 || dims[1] <= 0) {
+    return 0;
+  }
+
+  layout.count[0] = (dims[0] + layout.tile_dims[0] - 1) / layout.tile_dims[0];
+  layout.count[1] = (dims[1] + layout.tile_dims[1] - 1) / layout.tile_dims[1];
+  ptrdiff_t tile_count = layout.count[0] * layout.count[1];
+  ptrdiff_t tile_size = layout.tile_dims[0] * layout.tile_dims[1];
+
+  layout.base = (ptrdiff_t *)malloc((tile_count + 1) * sizeof(ptrdiff_t));
+  TilePerimeter *perimeters =
+      (TilePerimeter *)calloc(tile_count, sizeof(TilePerimeter));
+  SpillEdgeList *edges =
+      (SpillEdgeList *)calloc(tile_count, sizeof(SpillEdgeList));
+
+  float *dem = (float *)malloc(tile_size * sizeof(float));
+  uint8_t *bc = (uint8_t *)malloc(tile_size * sizeof(uint8_t));
+  float *output = (float *)malloc(tile_size * sizeof(float));
+  int32_t *labels = (int32_t *)malloc(tile_size * sizeof(int32_t));
+  ptrdiff_t *heap = (ptrdiff_t *)malloc(tile_size * sizeof(ptrdiff_t));
+  float *spill = NULL;
+
+  // The flood of a tile records its spill edges in `raw`, which is
+  // compacted whenever it fills up so that it stays within the
+  // budget. Only the compacted edges of every tile are kept.
+  SpillEdgeList raw = {0};
+  raw.edges = (SpillEdge *)malloc(tile_size * sizeof(SpillEdge));
+  raw.capacity = tile_size;
+  raw.bounded = 1;
+
+  int32_t success = layout.base && perimeters && edges && dem && bc &&
+                    output && labels && heap && raw.edges;
+  int32_t io_error = 0;
+
+  if (success) {
+    layout.base[0] = 1;
+    for (ptrdiff_t t = 0; t < tile_count; t++) {
+      ptrdiff_t i0, i1, j0, j1;
+      tile_bounds(&layout, t, &i0, &i1, &j0, &j1);
+      ptrdiff_t h = i1 - i0;
+      ptrdiff_t w = j1 - j0;
+      ptrdiff_t perimeter = h > 2 && w > 2 ? 2 * (h + w) - 4 : h * w;
+      layout.base[t + 1] = layout.base[t] + perimeter;
+
+      perimeters[t].labels =
+          (ptrdiff_t *)malloc(2 * (h + w) * sizeof(ptrdiff_t));
+      perimeters[t].z = (float *)malloc(2 * (h + w) * sizeof(float));
+      if (!perimeters[t].labels || !perimeters[t].z) {
+        success = 0;
+        break;
+      }
+    }
+  }
+
+  // Flood every tile and keep only its perimeter and spill edges
+  for (ptrdiff_t t = 0; success && t < tile_count; t++) {
+    ptrdiff_t bounds[4];
+    tile_bounds(&layout, t, &bounds[0], &bounds[1], &bounds[2], &bounds[3]);
+    ptrdiff_t offset[2] = {bounds[0], bounds[2]};
+    ptrdiff_t local_dims[2] = {bounds[1] - bounds[0], bounds[3] - bounds[2]};
+    ptrdiff_t local_bounds[4] = {0, local_dims[0], 0, local_dims[1]};
+
+    if (read_tile(dem, bc, offset, local_dims, context) != 0) {
+      io_error = 1;
+      success = 0;
+      break;
+    }
+    raw.count = 0;
+    if (!fillsinks_tile_flood(output, labels, heap, &raw, dem, bc, local_dims,
+                              local_bounds, layout.base[t])) {
+      success = 0;
+      break;
+    }
+    spilledge_compact(&raw);
+    if (raw.count > 0) {
+      edges[t].edges = (SpillEdge *)malloc(raw.count * sizeof(SpillEdge));
+      if (edges[t].edges == NULL) {
+        success = 0;
+        break;
+      }
+      memcpy(edges[t].edges, raw.edges, raw.count * sizeof(SpillEdge));
+      edges[t].count = edges[t].capacity = raw.count;
+    }
+
+    for (ptrdiff_t j = 0; j < local_dims[1]; j++) {
+      for (ptrdiff_t i = 0; i < local_dims[0]; i++) {
+        if (i != 0 && i != local_dims[0] - 1 && j != 0 &&
+            j != local_dims[1] - 1) {
+          continue;
+        }
+        ptrdiff_t p = j * local_dims[0] + i;
+        ptrdiff_t pp = perimeter_position(i, j, local_dims[0], local_dims[1]);
+        perimeters[t].labels[pp] =
+            labels[p] < 0 ? -1 : global_label(layout.base[t], labels[p]);
+        perimeters[t].z[pp] = output[p];
+      }
+    }
+  }
+
+  // Connect the watersheds of neighboring tiles
+  for (ptrdiff_t t = 0; success && t < tile_count; t++) {
+    if (!fillsinks_outofcore_seams(&edges[t], perimeters, &layout, t)) {
+      success = 0;
+      break;
+    }
+    spilledge_compact(&edges[t]);
+  }
+
+  // Solve the spill graph
+  if (success) {
+    spill = (float *)malloc(layout.base[tile_count] * sizeof(float));
+    success = spill && fillsinks_spill_graph(spill, edges, tile_count,
+                                             layout.base[tile_count]);
+  }
+
+  // Flood every tile again, which reproduces the same labels, and
+  // raise it to the spill elevations of its watersheds
+  for (ptrdiff_t t = 0; success && t < tile_count; t++) {
+    ptrdiff_t bounds[4];
+    tile_bounds(&layout, t, &bounds[0], &bounds[1], &bounds[2], &bounds[3]);
+    ptrdiff_t offset[2] = {bounds[0], bounds[2]};
+    ptrdiff_t local_dims[2] = {bounds[1] - bounds[0], bounds[3] - bounds[2]};
+    ptrdiff_t local_bounds[4] = {0, local_dims[0], 0, local_dims[1]};
+
+    if (read_tile(dem, bc, offset, local_dims, context) != 0) {
+      io_error = 1;
+      break;
+    }
+    fillsinks_tile_flood(output, labels, heap, NULL, dem, bc, local_dims,
+                         local_bounds, layout.base[t]);
+
+    for (ptrdiff_t p = 0; p < local_dims[0] * local_dims[1]; p++) {
+      if (labels[p] >= 0) {
+        float z = spill[global_label(layout.base[t], labels[p])];
+        if (z > output[p]) {
+          output[p] = z;
+        }
+      }
+    }
+
+    if (write_tile(output, offset, local_dims, context) != 0) {
+      io_error = 1;
+      break;
+    }
+  }
+
+  if (perimeters) {
+    for (ptrdiff_t t = 0; t < tile_count; t++) {
+      free(perimeters[t].labels);
+      free(perimeters[t].z);
+    }
+  }
+  if (edges) {
+    for (ptrdiff_t t = 0; t < tile_count; t++) {
+      free(edges[t].edges);
+    }
+  }
+  free(perimeters);
+  free(edges);
+  free(layout.base);
+  free(dem);
+  free(bc);
+  free(output);
+  free(labels);
+  free(heap);
+  free(spill);
+  free(raw.edges);
+
+  if (io_error) {
+    return -2;
+  }
+  return success ? 0 : -1;
+}
+
+// Pixel states used by fillsinks_incremental. Pixels that have not
+// been visited are 0.
+#define REFILL_CANDIDATE 1
+#define REFILL_INVALID 2
+#define REFILL_VALID 3
+
+/*
+  Queue the neighbors of the invalidated pixel `p` whose old fill
+  `output[q]` is at least `z` as candidates for invalidation. Only
+  these pixels can have drained through `p`.
+ */
+static void refill_candidates(PixelHeap *h, uint8_t *flags, float *output,
+                              ptrdiff_t p, float z, ptrdiff_t dims[2]) {
+  ptrdiff_t i_offset[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  ptrdiff_t j_offset[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+  ptrdiff_t i = p % dims[0];
+  ptrdiff_t j = p / dims[0];
+  for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+    ptrdiff_t neighbor_i = i + i_offset[neighbor];
+    ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+    if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+        neighbor_j >= dims[1]) {
+      continue;
+    }
+
+    ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+    // NaNs fail the comparison. Pixels that were filled to infinity
+    // cannot get any higher.
+    if (flags[q] || !(output[q] >= z) || output[q] == INFINITY) {
+      continue;
+    }
+    flags[q] = REFILL_CANDIDATE;
+    pixelheap_push(h, q);
+  }
+}
+
+/*
+  Repair the filled DEM `output` after the pixels stored in
+  queue[list_start, n) have changed.
+
+  The old fill of a pixel remains an upper bound for its new fill as
+  long as the pixel has a neighbor with a strictly lower fill whose
+  old fill is also still an upper bound. Starting from the changed
+  pixels, candidates are visited in order of increasing old fill and
+  every candidate without such a neighbor is invalidated and reset to
+  INFINITY. This covers all pixels whose spill path passed through a
+  changed pixel. The invalidated pixels are then lowered again by a
+  seeded erosion reconstruction, which also lowers any valid pixels
+  that now drain through a lowered pixel.
+
+  The heap grows from the front of `queue` and the list of invalidated
+  pixels grows from its back. Each pixel is in at most one of them, so
+  they never overlap.
+
+  Returns the number of invalidated pixels.
+ */
+static ptrdiff_t fillsinks_refill(float *output, ptrdiff_t *queue,
+                                  uint8_t *flags, const float *dem,
+                                  uint8_t *bc, ptrdiff_t list_start,
+                                  ptrdiff_t dims[2]) {
+  ptrdiff_t i_offset[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  ptrdiff_t j_offset[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+  ptrdiff_t n = dims[0] * dims[1];
+
+  PixelHeap h = {0};
+  h.heap = queue;
+  h.z = output;
+
+  // The changed pixels are always invalid
+  for (ptrdiff_t s = list_start; s < n; s++) {
+    ptrdiff_t p = queue[s];
+    float z = isnan(output[p]) ? -INFINITY : output[p];
+    output[p] = INFINITY;
+    refill_candidates(&h, flags, output, p, z, dims);
+  }
+
+  while (h.count > 0) {
+    ptrdiff_t p = pixelheap_pop(&h);
+    float z = output[p];
+    ptrdiff_t i = p % dims[0];
+    ptrdiff_t j = p / dims[0];
+
+    // All pixels with a lower fill than p have already been decided,
+    // and invalid pixels are at INFINITY.
+    int32_t valid = bc[p] == 1;
+    for (int32_t neighbor = 0; !valid && neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1]) {
+        continue;
+      }
+      valid = output[neighbor_j * dims[0] + neighbor_i] < z;
+    }
+
+    if (valid) {
+      flags[p] = REFILL_VALID;
+      continue;
+    }
+
+    flags[p] = REFILL_INVALID;
+    output[p] = INFINITY;
+    queue[--list_start] = p;
+    refill_candidates(&h, flags, output, p, z, dims);
+  }
+
+  // Every flagged pixel is invalid or a neighbor of an invalid pixel
+  for (ptrdiff_t s = list_start; s < n; s++) {
+    ptrdiff_t p = queue[s];
+    ptrdiff_t i = p % dims[0];
+    ptrdiff_t j = p / dims[0];
+    flags[p] = 0;
+    for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1]) {
+        continue;
+      }
+      flags[neighbor_j * dims[0] + neighbor_i] = 0;
+    }
+  }
+
+  // Move the invalid pixels to the front of the queue and reset them
+  // as in fillsinks
+  ptrdiff_t count = n - list_start;
+  for (ptrdiff_t s = 0; s < count; s++) {
+    ptrdiff_t p = queue[list_start + s];
+    queue[s] = p;
+    output[p] = bc[p] == 1 || isnan(dem[p]) ? dem[p] : INFINITY;
+  }
+
+  reconstruct_erosion_seeded(output, queue, count, dem, dims);
+
+  return count;
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t fillsinks_incremental(float *output, ptrdiff_t *queue,
+                                uint8_t *flags, const float *dem, uint8_t *bc,
+                                ptrdiff_t *changed, ptrdiff_t changed_count,
+                                ptrdiff_t dims[2]) {
+  ptrdiff_t list_start = dims[0] * dims[1];
+  for (ptrdiff_t k = 0; k < changed_count; k++) {
+    ptrdiff_t p = changed[k];
+    if (!flags[p]) {
+      flags[p] = REFILL_INVALID;
+      queue[--list_start] = p;
+    }
+  }
+  return fillsinks_refill(output, queue, flags, dem, bc, list_start, dims);
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t fillsinks_incremental_rect(float *output, ptrdiff_t *queue,
+                                     uint8_t *flags, const float *dem,
+                                     uint8_t *bc, ptrdiff_t rect[4],
+                                     ptrdiff_t dims[2]) {
+  ptrdiff_t i0 = rect[0] > 0 ? rect[0] : 0;
+  ptrdiff_t i1 = rect[1] < dims[0] ? rect[1] : dims[0];
+  ptrdiff_t j0 = rect[2] > 0 ? rect[2] : 0;
+  ptrdiff_t j1 = rect[3] < dims[1] ? rect[3] : dims[1];
+
+  ptrdiff_t list_start = dims[0] * dims[1];
+  for (ptrdiff_t j = j0; j < j1; j++) {
+    for (ptrdiff_t i = i0; i < i1; i++) {
+      ptrdiff_t p = j * dims[0] + i;
+      flags[p] = REFILL_INVALID;
+      queue[--list_start] = p;
+    }
+  }
+  return fillsinks_refill(output, queue, flags, dem, bc, list_start, dims);
+}
+
+/*
+  An edge between the watersheds of two depressions for
+  depression_hierarchy. `z` is the elevation at which water spills
+  from one watershed into the other, and `cell` is the pixel at that
+  elevation.
+ */
+typedef struct {
+  ptrdiff_t a, b;
+  float z;
+  ptrdiff_t cell;
+} DepressionEdge;
+
+typedef struct {
+  DepressionEdge *edges;
+  ptrdiff_t count;
+  ptrdiff_t capacity;
+} DepressionEdgeList;
+
+static int depressionedge_compare_pair(const void *x, const void *y) {
+  const DepressionEdge *e = (const DepressionEdge *)x;
+  const DepressionEdge *f = (const DepressionEdge *)y;
+  if (e->a != f->a) {
+    return e->a < f->a ? -1 : 1;
+  }
+  if (e->b != f->b) {
+    return e->b < f->b ? -1 : 1;
+  }
+  if (e->z != f->z) {
+    return e->z < f->z ? -1 : 1;
+  }
+  return (e->cell > f->cell) - (e->cell < f->cell);
+}
+
+static int depressionedge_compare_elevation(const void *x, const void *y) {
+  const DepressionEdge *e = (const DepressionEdge *)x;
+  const DepressionEdge *f = (const DepressionEdge *)y;
+  if (e->z != f->z) {
+    return e->z < f->z ? -1 : 1;
+  }
+  return depressionedge_compare_pair(x, y);
+}
+
+// Keep only the lowest edge between every pair of watersheds
+static void depressionedge_compact(DepressionEdgeList *list) {
+  if (list->count == 0) {
+    return;
+  }
+
+  qsort(list->edges, list->count, sizeof(DepressionEdge),
+        depressionedge_compare_pair);
+
+  ptrdiff_t count = 0;
+  for (ptrdiff_t e = 0; e < list->count; e++) {
+    if (count == 0 || list->edges[e].a != list->edges[count - 1].a ||
+        list->edges[e].b != list->edges[count - 1].b) {
+      list->edges[count++] = list->edges[e];
+    }
+  }
+  list->count = count;
+}
+
+/*
+  Add an edge to the list. Every pair of watersheds is seen many times
+  along their common boundary, so the list is compacted before it is
+  grown.
+
+  Returns 1 if successful, 0 if the list could not be grown.
+ */
+static int32_t depressionedge_add(DepressionEdgeList *list, ptrdiff_t a,
+                                  ptrdiff_t b, float z, ptrdiff_t cell) {
+  if (list->count == list->capacity) {
+    depressionedge_compact(list);
+  }
+  if (2 * list->count >= list->capacity) {
+    ptrdiff_t capacity = list->capacity > 0 ? 2 * list->capacity : 256;
+    DepressionEdge *edges = (DepressionEdge *)realloc(
+        list->edges, capacity * sizeof(DepressionEdge));
+    if (!edges) {
+      return 0;
+    }
+    list->edges = edges;
+    list->capacity = capacity;
+  }
+  list->edges[list->count].a = a < b ? a : b;
+  list->edges[list->count].b = a < b ? b : a;
+  list->edges[list->count].z = z;
+  list->edges[list->count].cell = cell;
+  list->count++;
+  return 1;
+}
+
+// A pixel can be the seed of a depression if it can be filled and has
+// no lower neighbor. It is only a pit if the flat containing it does
+// not drain either, which depression_hierarchy checks.
+static int32_t depression_is_minimum(const float *dem, uint8_t *bc,
+                                     ptrdiff_t p, ptrdiff_t dims[2]) {
+  ptrdiff_t i_offset[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  ptrdiff_t j_offset[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+  if (bc[p] == 1 || isnan(dem[p])) {
+    return 0;
+  }
+
+  ptrdiff_t i = p % dims[0];
+  ptrdiff_t j = p / dims[0];
+  for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+    ptrdiff_t neighbor_i = i + i_offset[neighbor];
+    ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+    if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+        neighbor_j >= dims[1]) {
+      continue;
+    }
+    if (dem[neighbor_j * dims[0] + neighbor_i] < dem[p]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t depression_hierarchy_size(const float *dem, uint8_t *bc,
+                                    ptrdiff_t dims[2]) {
+  ptrdiff_t minima = 0;
+  for (ptrdiff_t p = 0; p < dims[0] * dims[1]; p++) {
+    minima += depression_is_minimum(dem, bc, p, dims);
+  }
+  // Every merge of two depressions creates one more node. Node 0 is
+  // the outlet.
+  return minima > 0 ? 2 * minima : 1;
+}
+
+/*
+  Depression hierarchy after Barnes et al. (2020).
+
+  1. Every flat of connected pixels with the same elevation that has
+     no lower neighbor and no pixel with bc == 1 is a pit and seeds a
+     leaf depression. The pixels with bc == 1 seed the outlet, node 0.
+  2. A single priority flood from all seeds labels the watershed of
+     every leaf and records the lowest spill edge between every pair
+     of adjacent watersheds.
+  3. The edges are processed in order of increasing elevation. Two
+     depressions that meet form a new parent depression. A depression
+     that meets the outlet drains to it and becomes a child of node 0.
+  4. A linear pass over the pixels computes the filled DEM from the
+     spill elevation of the outermost depression of each pixel and
+     assigns every flooded pixel to the smallest depression containing
+     it. Cell counts and volumes are then accumulated up the tree.
+ */
+TOPOTOOLBOX_API
+ptrdiff_t depression_hierarchy(float *filled, ptrdiff_t *labels,
+                               ptrdiff_t *queue, ptrdiff_t *pour_point,
+                               ptrdiff_t *parent, ptrdiff_t *cell_count,
+                               double *volume, float *max_depth,
+                               const float *dem, uint8_t *bc,
+                               ptrdiff_t dims[2]) {
+  ptrdiff_t i_offset[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+  ptrdiff_t j_offset[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+  ptrdiff_t n = dims[0] * dims[1];
+
+  PixelHeap h = {0};
+  h.heap = queue;
+  h.z = dem;
+
+  DepressionEdgeList edges = {0};
+  ptrdiff_t *stack = NULL;
+  ptrdiff_t stack_capacity = 0;
+  int32_t success = 1;
+
+  // Seed the outlet and the leaf depressions
+  ptrdiff_t leaf_count = 0;
+  for (ptrdiff_t p = 0; p < n; p++) {
+    labels[p] = -1;
+  }
+  for (ptrdiff_t p = 0; p < n && success; p++) {
+    if (isnan(dem[p])) {
+      continue;
+    }
+    if (bc[p] == 1) {
+      labels[p] = 0;
+      pixelheap_push(&h, p);
+      continue;
+    }
+    if (labels[p] != -1 || !depression_is_minimum(dem, bc, p, dims)) {
+      continue;
+    }
+
+    // Collect the flat containing p. It is a pit unless one of its
+    // pixels has a lower neighbor or lies on the boundary, in which
+    // case its pixels are marked with -2 so that it is visited once.
+    ptrdiff_t stack_count = 0;
+    int32_t drains = 0;
+    labels[p] = -2;
+    if (stack_count == stack_capacity) {
+      stack_capacity = stack_capacity > 0 ? 2 * stack_capacity : 64;
+      ptrdiff_t *s =
+          (ptrdiff_t *)realloc(stack, stack_capacity * sizeof(ptrdiff_t));
+      if (!s) {
+        success = 0;
+        break;
+      }
+      stack = s;
+    }
+    stack[stack_count++] = p;
+
+    for (ptrdiff_t k = 0; k < stack_count && success; k++) {
+      ptrdiff_t s = stack[k];
+      if (!depression_is_minimum(dem, bc, s, dims)) {
+        drains = 1;
+      }
+      ptrdiff_t i = s % dims[0];
+      ptrdiff_t j = s / dims[0];
+      for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+        ptrdiff_t neighbor_i = i + i_offset[neighbor];
+        ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+        if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+            neighbor_j >= dims[1]) {
+          continue;
+        }
+
+        ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+        if (dem[q] != dem[p]) {
+          continue;
+        }
+        if (bc[q] == 1) {
+          drains = 1;
+          continue;
+        }
+        if (labels[q] != -1) {
+          continue;
+        }
+        labels[q] = -2;
+
+        if (stack_count == stack_capacity) {
+          stack_capacity *= 2;
+          ptrdiff_t *t =
+              (ptrdiff_t *)realloc(stack, stack_capacity * sizeof(ptrdiff_t));
+          if (!t) {
+            success = 0;
+            break;
+          }
+          stack = t;
+        }
+        stack[stack_count++] = q;
+      }
+    }
+
+    if (!drains && success) {
+      ptrdiff_t label = ++leaf_count;
+      for (ptrdiff_t k = 0; k < stack_count; k++) {
+        labels[stack[k]] = label;
+        pixelheap_push(&h, stack[k]);
+      }
+    }
+  }
+  for (ptrdiff_t p = 0; p < n; p++) {
+    if (labels[p] == -2) {
+      labels[p] = -1;
+    }
+  }
+  free(stack);
+
+  // Label the watersheds and record the spill edges between them
+  while (h.count > 0 && success) {
+    ptrdiff_t p = pixelheap_pop(&h);
+    ptrdiff_t i = p % dims[0];
+    ptrdiff_t j = p / dims[0];
+
+    for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1]) {
+        continue;
+      }
+
+      ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+      if (isnan(dem[q])) {
+        continue;
+      }
+
+      if (labels[q] == -1) {
+        labels[q] = labels[p];
+        pixelheap_push(&h, q);
+      } else if (labels[q] != labels[p]) {
+        ptrdiff_t cell = dem[q] > dem[p] ? q : p;
+        if (!depressionedge_add(&edges, labels[p], labels[q], dem[cell],
+                                cell)) {
+          success = 0;
+          break;
+        }
+      }
+    }
+  }
+
+  ptrdiff_t node_count = leaf_count + 1;
+  ptrdiff_t max_nodes = leaf_count > 0 ? 2 * leaf_count : 1;
+  ptrdiff_t *top = (ptrdiff_t *)malloc(max_nodes * sizeof(ptrdiff_t));
+  float *pour_elevation = (float *)malloc(max_nodes * sizeof(float));
+  float *level = (float *)malloc(max_nodes * sizeof(float));
+  success = success && top && pour_elevation && level;
+
+  if (success) {
+    depressionedge_compact(&edges);
+    if (edges.count > 0) {
+      qsort(edges.edges, edges.count, sizeof(DepressionEdge),
+            depressionedge_compare_elevation);
+    }
+
+    for (ptrdiff_t d = 0; d < max_nodes; d++) {
+      top[d] = d;
+      parent[d] = -1;
+      pour_point[d] = -1;
+      pour_elevation[d] = INFINITY;
+      max_depth[d] = INFINITY;
+    }
+
+    // Leaf minima
+    for (ptrdiff_t p = 0; p < n; p++) {
+      if (labels[p] > 0 && dem[p] < max_depth[labels[p]]) {
+        max_depth[labels[p]] = dem[p];
+      }
+    }
+
+    // Merge the depressions in order of increasing spill elevation
+    for (ptrdiff_t e = 0; e < edges.count; e++) {
+      DepressionEdge edge = edges.edges[e];
+      ptrdiff_t a = union_find_root(top, edge.a);
+      ptrdiff_t b = union_find_root(top, edge.b);
+      if (a == b) {
+        continue;
+      }
+
+      ptrdiff_t merged = 0;
+      if (a != 0 && b != 0) {
+        merged = node_count++;
+        // Minimum elevation of the new depression
+        max_depth[merged] =
+            max_depth[a] < max_depth[b] ? max_depth[a] : max_depth[b];
+      }
+
+      ptrdiff_t children[2] = {a, b};
+      for (int32_t c = 0; c < 2; c++) {
+        if (children[c] == 0) {
+          continue;
+        }
+        parent[children[c]] = merged;
+        pour_point[children[c]] = edge.cell;
+        pour_elevation[children[c]] = edge.z;
+        top[children[c]] = merged;
+      }
+    }
+
+    // Parents always have a larger index than their children, so
+    // every depression inherits the fill level of its parent.
+    for (ptrdiff_t d = node_count - 1; d > 0; d--) {
+      level[d] = parent[d] == 0    ? pour_elevation[d]
+                 : parent[d] == -1 ? INFINITY
+                                   : level[parent[d]];
+    }
+
+    for (ptrdiff_t d = 0; d < node_count; d++) {
+      cell_count[d] = 0;
+      volume[d] = 0.0;
+    }
+
+    // Fill the DEM and assign every flooded pixel to the smallest
+    // depression whose spill elevation lies above it
+    for (ptrdiff_t p = 0; p < n; p++) {
+      ptrdiff_t d = labels[p];
+      if (d <= 0) {
+        filled[p] = dem[p];
+        continue;
+      }
+      filled[p] = dem[p] > level[d] ? dem[p] : level[d];
+
+      while (d > 0 && pour_elevation[d] <= dem[p]) {
+        d = parent[d];
+      }
+      if (d > 0) {
+        cell_count[d]++;
+        volume[d] += dem[p];
+      }
+    }
+
+    // Accumulate cell counts and volumes up the hierarchy
+    for (ptrdiff_t d = 1; d < node_count; d++) {
+      if (parent[d] > 0) {
+        cell_count[parent[d]] += cell_count[d];
+        volume[parent[d]] += volume[d];
+      }
+      // volume[d] holds the sum of the elevations
+      volume[d] = pour_elevation[d] == INFINITY
+                      ? INFINITY
+                      : cell_count[d] * (double)pour_elevation[d] - volume[d];
+      max_depth[d] = pour_elevation[d] - max_depth[d];
+    }
+    max_depth[0] = 0.0f;
+  }
+
+  free(edges.edges);
+  free(top);
+  free(pour_elevation);
+  free(level);
+
+  return success ? node_count : -1;
 }
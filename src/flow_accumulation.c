@@ -6,28 +6,6 @@
 
 #include "topotoolbox.h"
 
-TOPOTOOLBOX_API
-void flow_accumulation_edgelist(float *acc, ptrdiff_t *source,
-                                ptrdiff_t *target, float *fraction,
-                                float *weights, ptrdiff_t edge_count,
-                                ptrdiff_t dims[2]) {
-  // Initialize with the weights
-  for (ptrdiff_t j = 0; j < dims[1]; j++) {
-    for (ptrdiff_t i = 0; i < dims[0]; i++) {
-      acc[j * dims[0] + i] =
-          (weights == NULL) ? 1.0f : weights[j * dims[0] + i];
-    }
-  }
-
-  for (ptrdiff_t edge = 0; edge < edge_count; edge++) {
-    ptrdiff_t src = source[edge];
-    ptrdiff_t tgt = target[edge];
-    float w = fraction[edge];
-
-    acc[tgt] += w * acc[src];
-  }
-}
-
 TOPOTOOLBOX_API
 void flow_accumulation(float *acc, ptrdiff_t *source, uint8_t *direction,
                        float *weights, ptrdiff_t dims[2]) {
@@ -0,0 +1,223 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "topotoolbox.h"
+
+/*
+  Binary container for flow networks
+
+  A flow network (the edge list, the edge fractions, the topologically
+  sorted nodes and the grid dimensions) is stored in a single
+  contiguous buffer, so that it can be written to a file once and
+  later memory-mapped and used by the traversal kernels without any
+  copies. As with fillsinks_outofcore, the library does not touch
+  the file system itself: the caller provides the buffer, which is
+  typically a memory-mapped file.
+
+  Layout, version 1, in the byte order of the machine that wrote it:
+
+  offset  size  field
+       0     8  magic "TTFLOWNW"
+       8     4  uint32 version
+      12     4  uint32 flags, bit 0 set for 32-bit indices
+      16     4  uint32 byte order mark 0x01020304
+      20     4  reserved, zero
+      24    16  int64 dims[2]
+      40     8  int64 edge_count
+      48     8  int64 node_count
+      56    32  uint64 offsets of the source, target, fraction and node
+                sections from the start of the buffer
+
+  The sections follow the header in this order, each starting at a
+  multiple of FLOW_NETWORK_ALIGNMENT bytes. source, target and node
+  hold int64 or, with 32-bit indices, uint32 values. fraction holds
+  float values.
+ */
+
+#define FLOW_NETWORK_VERSION 1
+#define FLOW_NETWORK_ALIGNMENT 64
+#define FLOW_NETWORK_INDEX32 1
+#define FLOW_NETWORK_BYTE_ORDER 0x01020304u
+
+static const char flow_network_magic[8] = {'T', 'T', 'F', 'L',
+                                           'O', 'W', 'N', 'W'};
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t byte_order;
+  uint32_t reserved;
+  int64_t dims[2];
+  int64_t edge_count;
+  int64_t node_count;
+  uint64_t offsets[4];
+} FlowNetworkHeader;
+
+static ptrdiff_t align_up(ptrdiff_t offset) {
+  return (offset + FLOW_NETWORK_ALIGNMENT - 1) / FLOW_NETWORK_ALIGNMENT *
+         FLOW_NETWORK_ALIGNMENT;
+}
+
+// Compute the section offsets and return the total size in bytes
+static ptrdiff_t flow_network_layout(uint64_t offsets[4], ptrdiff_t edge_count,
+                                     ptrdiff_t node_count,
+                                     unsigned int index32) {
+  ptrdiff_t index_size = index32 ? sizeof(uint32_t) : sizeof(int64_t);
+  ptrdiff_t section_sizes[4] = {edge_count * index_size,
+                                edge_count * index_size,
+                                edge_count * (ptrdiff_t)sizeof(float),
+                                node_count * index_size};
+
+  ptrdiff_t offset = align_up(sizeof(FlowNetworkHeader));
+  for (int s = 0; s < 4; s++) {
+    offsets[s] = (uint64_t)offset;
+    offset = align_up(offset + section_sizes[s]);
+  }
+  return offset;
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t flow_network_size(ptrdiff_t edge_count, ptrdiff_t node_count,
+                            unsigned int index32) {
+  uint64_t offsets[4];
+  return flow_network_layout(offsets, edge_count, node_count, index32);
+}
+
+static void write_indices(uint8_t *section, ptrdiff_t *indices,
+                          ptrdiff_t count, unsigned int index32) {
+  if (index32) {
+    uint32_t *output = (uint32_t *)section;
+    for (ptrdiff_t k = 0; k < count; k++) {
+      output[k] = (uint32_t)indices[k];
+    }
+  } else {
+    int64_t *output = (int64_t *)section;
+    for (ptrdiff_t k = 0; k < count; k++) {
+      output[k] = (int64_t)indices[k];
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+int flow_network_write(void *buffer, ptrdiff_t buffer_size, ptrdiff_t *source,
+                       ptrdiff_t *target, float *fraction, ptrdiff_t *node,
+                       ptrdiff_t edge_count, ptrdiff_t node_count,
+                       ptrdiff_t dims[2], unsigned int index32) {
+  FlowNetworkHeader header;
+  ptrdiff_t size =
+      flow_network_layout(header.offsets, edge_count, node_count, index32);
+  if (buffer_size < size || ((uintptr_t)buffer % sizeof(int64_t)) != 0) {
+    return -1;
+  }
+  if (dims[0] <= 0 || dims[1] <= 0 || dims[1] > node_count / dims[0] ||
+      dims[0] * dims[1] != node_count) {
+    return -2;
+  }
+  if (index32 && (uint64_t)dims[0] * (uint64_t)dims[1] > UINT32_MAX) {
+    return -2;
+  }
+
+  memcpy(header.magic, flow_network_magic, sizeof header.magic);
+  header.version = FLOW_NETWORK_VERSION;
+  header.flags = index32 ? FLOW_NETWORK_INDEX32 : 0;
+  header.byte_order = FLOW_NETWORK_BYTE_ORDER;
+  header.reserved = 0;
+  header.dims[0] = dims[0];
+  header.dims[1] = dims[1];
+  header.edge_count = edge_count;
+  header.node_count = node_count;
+
+  uint8_t *bytes = (uint8_t *)buffer;
+  // Zero the header and the padding between sections so that the
+  // output is deterministic
+  memset(bytes, 0, header.offsets[0]);
+  memcpy(bytes, &header, sizeof header);
+
+  write_indices(bytes + header.offsets[0], source, edge_count, index32);
+  write_indices(bytes + header.offsets[1], target, edge_count, index32);
+  if (edge_count > 0) {
+    memcpy(bytes + header.offsets[2], fraction, edge_count * sizeof(float));
+  }
+  write_indices(bytes + header.offsets[3], node, node_count, index32);
+
+  ptrdiff_t index_size = index32 ? sizeof(uint32_t) : sizeof(int64_t);
+  ptrdiff_t ends[4] = {
+      (ptrdiff_t)header.offsets[0] + edge_count * index_size,
+      (ptrdiff_t)header.offsets[1] + edge_count * index_size,
+      (ptrdiff_t)header.offsets[2] + edge_count * (ptrdiff_t)sizeof(float),
+      (ptrdiff_t)header.offsets[3] + node_count * index_size};
+  ptrdiff_t next[4] = {(ptrdiff_t)header.offsets[1],
+                       (ptrdiff_t)header.offsets[2],
+                       (ptrdiff_t)header.offsets[3], size};
+  for (int s = 0; s < 4; s++) {
+    memset(bytes + ends[s], 0, next[s] - ends[s]);
+  }
+  return 0;
+}
+
+TOPOTOOLBOX_API
+int flow_network_read(void **source, void **target, float **fraction,
+                      void **node, ptrdiff_t *edge_count,
+                      ptrdiff_t *node_count, ptrdiff_t dims[2],
+                      unsigned int *index32, void *buffer,
+                      ptrdiff_t buffer_size) {
+  FlowNetworkHeader header;
+  if (buffer_size < (ptrdiff_t)sizeof header) {
+    return -1;
+  }
+  memcpy(&header, buffer, sizeof header);
+
+  if (memcmp(header.magic, flow_network_magic, sizeof header.magic) != 0 ||
+      header.byte_order != FLOW_NETWORK_BYTE_ORDER) {
+    return -1;
+  }
+  if (header.version != FLOW_NETWORK_VERSION ||
+      (header.flags & ~(uint32_t)FLOW_NETWORK_INDEX32) != 0) {
+    return -2;
+  }
+
+  unsigned int is_index32 = (header.flags & FLOW_NETWORK_INDEX32) != 0;
+  if (!is_index32 && sizeof(ptrdiff_t) != sizeof(int64_t)) {
+    // The 64-bit index sections cannot be used as ptrdiff_t arrays
+    return -4;
+  }
+
+  // The section offsets must be exactly those written by
+  // flow_network_write for the stored counts.
+  if (header.edge_count < 0 || header.node_count < 0 ||
+      header.edge_count > buffer_size || header.node_count > buffer_size ||
+      (uintptr_t)buffer % sizeof(int64_t) != 0) {
+    return -3;
+  }
+  // node holds every pixel of the grid exactly once, and 32-bit
+  // indices must be able to address all of them.
+  if (header.dims[0] <= 0 || header.dims[1] <= 0 ||
+      header.dims[1] > header.node_count / header.dims[0] ||
+      header.dims[0] * header.dims[1] != header.node_count ||
+      (is_index32 && header.node_count > UINT32_MAX)) {
+    return -3;
+  }
+  uint64_t offsets[4];
+  ptrdiff_t size = flow_network_layout(offsets, (ptrdiff_t)header.edge_count,
+                                       (ptrdiff_t)header.node_count,
+                                       is_index32);
+  if (size > buffer_size || memcmp(offsets, header.offsets, sizeof offsets)) {
+    return -3;
+  }
+
+  uint8_t *bytes = (uint8_t *)buffer;
+  *source = bytes + header.offsets[0];
+  *target = bytes + header.offsets[1];
+  *fraction = (float *)(bytes + header.offsets[2]);
+  *node = bytes + header.offsets[3];
+  *edge_count = (ptrdiff_t)header.edge_count;
+  *node_count = (ptrdiff_t)header.node_count;
+  dims[0] = (ptrdiff_t)header.dims[0];
+  dims[1] = (ptrdiff_t)header.dims[1];
+  *index32 = is_index32;
+  return 0;
+}
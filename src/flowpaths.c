@@ -0,0 +1,130 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "helpers/math_constants.h"
+#include "topotoolbox.h"
+
+/*
+  Batch downstream flow path tracing
+
+  Flow paths from many starting pixels converge quickly, so tracing
+  each of them to its outlet separately repeats most of the work.
+  flowpaths_trace traces the paths one after the other on a receiver
+  array and stops each one at the first pixel that an earlier path
+  has already visited. Every pixel is therefore stored and visited
+  once, and the total work is proportional to the union of the paths
+  rather than to the sum of their lengths.
+
+  Path k is stored as a segment of the packed `path_nodes` array,
+  followed by a reference to the position at which it joins the
+  segment of an earlier path, its parent. The full path is recovered
+  by following these references, and the downstream distances and the
+  outlets are memoised along the same references.
+ */
+
+// The segment containing position p, given the offsets of the first
+// segment_count segments, by binary search
+static ptrdiff_t segment_of(ptrdiff_t *path_offsets, ptrdiff_t segment_count,
+                            ptrdiff_t p) {
+  ptrdiff_t lo = 0;
+  ptrdiff_t hi = segment_count - 1;
+  while (lo < hi) {
+    ptrdiff_t mid = lo + (hi - lo + 1) / 2;
+    if (path_offsets[mid] <= p) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t flowpaths_trace(ptrdiff_t *path_offsets, ptrdiff_t *path_nodes,
+                          ptrdiff_t *path_junction, ptrdiff_t *path_parent,
+                          ptrdiff_t *position, float *distance,
+                          float *path_length, float *path_drop,
+                          ptrdiff_t *starts, ptrdiff_t start_count,
+                          ptrdiff_t *receiver, float *dem, float cellsize,
+                          ptrdiff_t dims[2]) {
+  ptrdiff_t count = 0;
+  for (ptrdiff_t k = 0; k < start_count; k++) {
+    path_offsets[k] = count;
+    path_junction[k] = -1;
+    path_parent[k] = -1;
+
+    ptrdiff_t u = starts[k];
+    while (position[u] < 0) {
+      position[u] = count;
+      path_nodes[count++] = u;
+
+      ptrdiff_t v = receiver[u];
+      if (v == u) {
+        // u is an outlet
+        break;
+      }
+      u = v;
+    }
+
+    if (position[u] < path_offsets[k]) {
+      // The path joined an earlier one at u
+      path_junction[k] = position[u];
+      path_parent[k] = segment_of(path_offsets, k, position[u]);
+    }
+  }
+  path_offsets[start_count] = count;
+
+  // The parent of every segment precedes it, so the distances of the
+  // junctions are known when a segment is processed.
+  for (ptrdiff_t k = 0; k < start_count; k++) {
+    ptrdiff_t first = path_offsets[k];
+    ptrdiff_t last = path_offsets[k + 1] - 1;
+    if (last < first) {
+      continue;
+    }
+
+    ptrdiff_t v = -1;
+    float d = 0.0f;
+    if (path_junction[k] >= 0) {
+      v = path_nodes[path_junction[k]];
+      d = distance[path_junction[k]];
+    }
+    for (ptrdiff_t p = last; p >= first; p--) {
+      ptrdiff_t u = path_nodes[p];
+      if (v >= 0) {
+        // The step is diagonal if both grid coordinates change. The
+        // linear offset alone is ambiguous if dims[0] is 2.
+        int diagonal = (u % dims[0] != v % dims[0]) &&
+                       (u / dims[0] != v / dims[0]);
+        d += diagonal ? SQRT2f * cellsize : cellsize;
+      }
+      distance[p] = d;
+      v = u;
+    }
+  }
+
+  if (path_length != NULL) {
+    for (ptrdiff_t k = 0; k < start_count; k++) {
+      path_length[k] = distance[position[starts[k]]];
+    }
+  }
+
+  if (path_drop != NULL) {
+    // path_drop first receives the elevation of the outlet of every
+    // path, which is inherited from the parent if there is one.
+    for (ptrdiff_t k = 0; k < start_count; k++) {
+      if (path_parent[k] >= 0) {
+        path_drop[k] = path_drop[path_parent[k]];
+      } else {
+        path_drop[k] = dem[path_nodes[path_offsets[k + 1] - 1]];
+      }
+    }
+    for (ptrdiff_t k = 0; k < start_count; k++) {
+      path_drop[k] = dem[starts[k]] - path_drop[k];
+    }
+  }
+  return count;
+}
@@ -1,14 +1,18 @@
 #define TOPOTOOLBOX_BUILD
 
+#include <assert.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "helpers/math_constants.h"
+#include "helpers/parallel.h"
 #include "helpers/priority_queue.h"
+#include "helpers/union_find.h"
 #include "topotoolbox.h"
 
-#define SQRT2f 1.41421356237309504880f
-
 // Gray-weighted distance transforms for auxiliary topography
 
 /*
@@ -104,12 +108,13 @@ typedef struct {
 // pointers in the `labels` array until reaching a root, where the
 // pointer points to itself. Return the label of the root as well as
 // its corresponding weight.
+//
+// The path is halved along the way. Only the weights of roots are
+// ever read, so the weights along the path need not be updated.
 static labeldepth find_root(ptrdiff_t *labels, float *weights,
                             ptrdiff_t pixel) {
-  labeldepth r = {pixel, 0.0};
-  while (labels[r.label] != r.label) {
-    r.label = labels[r.label];
-  }
+  labeldepth r;
+  r.label = union_find_root(labels, pixel);
   r.weight = weights[r.label];
   return r;
 }
@@ -137,7 +142,7 @@ static void set_root(ptrdiff_t *labels, float *weights, ptrdiff_t pixel,
 // considering them part of the same /equivalence class/. This is done
 // by setting the roots of each pixel to point to the same pixel. The
 // pixel that is chosen to be the new root is that with the greatest
-// weight.
+// weight. Ties are broken in favor of the root of `pixel1`.
 static labeldepth unify(ptrdiff_t *labels, float *weights, ptrdiff_t pixel1,
                         ptrdiff_t pixel2) {
   labeldepth r = find_root(labels, weights, pixel1);
@@ -152,6 +157,29 @@ static labeldepth unify(ptrdiff_t *labels, float *weights, ptrdiff_t pixel1,
   return r;
 }
 
+// Compute the cost of a flat pixel from the maximum depth of its
+// connected component and its own depth.
+static float flat_cost(float max_depth, float current_depth) {
+  // If tweight is fixed to one, we do not need to apply the power.
+  // max_depth - current_depth should always be positive
+  // float tweight = 1.0f;
+
+  // CarveMinVal is a double to maintain consistency with the
+  // MATLAB implementation. The right hand side is of the cost
+  // computation below is performed in double precision and
+  // rounded back to single precision to store in the `costs`
+  // array. The magnitude of rounding error when CarveMinVal is a
+  // float depends on the values of costs, current_depth and
+  // CarveMinVal and is not always intuitive. If CarveMinVal can
+  // be exactly represented as a single precision float, then the
+  // results do not depend on whether it is a single or a
+  // double. Using a double CarveMinVal does have a minor
+  // performance cost.
+  double CarveMinVal = 0.1;
+
+  return (float)(max_depth - current_depth + CarveMinVal);
+}
+
 /*
   Cost computation
 
@@ -251,30 +279,225 @@ void gwdt_computecosts(float *costs, ptrdiff_t *conncomps, int32_t *flats,
         continue;
       }
 
-      float current_depth =
-          filled_dem[current_pixel] - original_dem[current_pixel];
+      costs[current_pixel] =
+          flat_cost(costs[current_pixel], filled_dem[current_pixel] -
+                                              original_dem[current_pixel]);
+    }
+  }
+}
+
+/*
+  Parallel cost computation
 
-      // If tweight is fixed to one, we do not need to apply the power.
-      // costs[current_pixel] - current_depth should always be positive
-      // float tweight = 1.0f;
-
-      // CarveMinVal is a double to maintain consistency with the
-      // MATLAB implementation. The right hand side is of the cost
-      // computation below is performed in double precision and
-      // rounded back to single precision to store in the `costs`
-      // array. The magnitude of rounding error when CarveMinVal is a
-      // float depends on the values of costs, current_depth and
-      // CarveMinVal and is not always intuitive. If CarveMinVal can
-      // be exactly represented as a single precision float, then the
-      // results do not depend on whether it is a single or a
-      // double. Using a double CarveMinVal does have a minor
-      // performance cost.
-      double CarveMinVal = 0.1;
+  The columns of the DEM are split into `num_threads` contiguous
+  blocks. Columns rather than rows are used because the arrays are
+  column-major, so every block is a contiguous range of memory that
+  is scanned in the same order as in `gwdt_computecosts`. Each block
+  is labeled independently with the union-find labeling of
+  `gwdt_computecosts`. Neighbors in the column preceding a block are
+  skipped, so every label in a block points to a pixel of the same
+  block and threads never touch each other's pixels. At the end of
+  this pass each label is compressed to point directly at the /local
+  root/ of its block.
 
-      costs[current_pixel] =
-          (float)(costs[current_pixel] - current_depth + CarveMinVal);
+  When several pixels of a connected component share its maximum
+  depth, `unify` keeps the root of its first argument, so the root
+  chosen by `gwdt_computecosts` depends on the order of the unify
+  calls. A component that lies entirely within one block sees the
+  same unify calls in the same order as in the serial scan, so its
+  local root is already the serial root. The components that cross
+  a seam are instead relabeled sequentially: their pixels are
+  inserted into the union-find again in the order of the serial
+  scan, which reproduces the serial roots exactly. Only these
+  components are processed sequentially; the rest of the labeling
+  and the cost computation run in parallel.
+ */
+TOPOTOOLBOX_API
+void gwdt_computecosts_parallel(float *costs, ptrdiff_t *conncomps,
+                                int32_t *flats, float *original_dem,
+                                float *filled_dem, ptrdiff_t dims[2],
+                                int num_threads) {
+  num_threads = resolve_threads(num_threads);
+  ptrdiff_t block_count = num_threads;
+  if (block_count > dims[1]) {
+    block_count = dims[1] > 0 ? dims[1] : 1;
+  }
+
+  // seam[p] is set if pixel p belongs to a component that crosses a
+  // seam between two blocks
+  uint8_t *seam = NULL;
+  if (block_count > 1) {
+    seam = (uint8_t *)calloc(dims[0] * dims[1], sizeof(uint8_t));
+    if (seam == NULL) {
+      gwdt_computecosts(costs, conncomps, flats, original_dem, filled_dem,
+                        dims);
+      return;
+    }
+  }
+
+  ptrdiff_t forward_j_offset[4] = {-1, -1, -1, 0};
+  ptrdiff_t forward_i_offset[4] = {-1, 0, 1, -1};
+
+  // First pass: label each block independently
+  ptrdiff_t block;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (block = 0; block < block_count; block++) {
+    ptrdiff_t j_start = block * dims[1] / block_count;
+    ptrdiff_t j_end = (block + 1) * dims[1] / block_count;
+
+    for (ptrdiff_t j = j_start; j < j_end; j++) {
+      for (ptrdiff_t i = 0; i < dims[0]; i++) {
+        ptrdiff_t current_pixel = j * dims[0] + i;
+        if (!(flats[current_pixel] & 1)) {
+          costs[current_pixel] = 0.0;
+          conncomps[current_pixel] = 0;
+          continue;
+        }
+        float current_depth =
+            filled_dem[current_pixel] - original_dem[current_pixel];
+        new_tree(conncomps, costs, current_pixel, current_depth);
+
+        for (int32_t neighbor = 0; neighbor < 4; neighbor++) {
+          ptrdiff_t neighbor_j = j + forward_j_offset[neighbor];
+          ptrdiff_t neighbor_i = i + forward_i_offset[neighbor];
+          ptrdiff_t neighbor_pixel = neighbor_j * dims[0] + neighbor_i;
+
+          if (neighbor_j < j_start || neighbor_i < 0 ||
+              neighbor_i >= dims[0]) {
+            // The neighbor belongs to the previous block or lies
+            // outside the DEM
+            continue;
+          }
+
+          if (flats[neighbor_pixel] & 1) {
+            unify(conncomps, costs, neighbor_pixel, current_pixel);
+          }
+        }
+      }
+    }
+
+    // Compress every label in the block to its local root
+    for (ptrdiff_t j = j_start; j < j_end; j++) {
+      for (ptrdiff_t i = 0; i < dims[0]; i++) {
+        ptrdiff_t current_pixel = j * dims[0] + i;
+        if (flats[current_pixel] & 1) {
+          conncomps[current_pixel] =
+              find_root(conncomps, costs, current_pixel).label;
+        }
+      }
+    }
+  }
+
+  if (block_count > 1) {
+    // Second pass: mark the local roots of flat pixels that are
+    // neighbors across a seam, and then every pixel whose local root
+    // is marked.
+    for (block = 1; block < block_count; block++) {
+      ptrdiff_t j = block * dims[1] / block_count;
+      for (ptrdiff_t i = 0; i < dims[0]; i++) {
+        ptrdiff_t current_pixel = j * dims[0] + i;
+        if (!(flats[current_pixel] & 1)) {
+          continue;
+        }
+        for (int32_t neighbor = 0; neighbor < 3; neighbor++) {
+          ptrdiff_t neighbor_i = i + forward_i_offset[neighbor];
+          ptrdiff_t neighbor_pixel = (j - 1) * dims[0] + neighbor_i;
+          if (neighbor_i < 0 || neighbor_i >= dims[0]) {
+            continue;
+          }
+          if (flats[neighbor_pixel] & 1) {
+            seam[conncomps[neighbor_pixel]] = 1;
+            seam[conncomps[current_pixel]] = 1;
+          }
+        }
+      }
+    }
+
+    // The local root of every pixel lies in the same block, so the
+    // blocks can be processed independently.
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (block = 0; block < block_count; block++) {
+      ptrdiff_t j_start = block * dims[1] / block_count;
+      ptrdiff_t j_end = (block + 1) * dims[1] / block_count;
+      for (ptrdiff_t j = j_start; j < j_end; j++) {
+        for (ptrdiff_t i = 0; i < dims[0]; i++) {
+          ptrdiff_t current_pixel = j * dims[0] + i;
+          if ((flats[current_pixel] & 1) && seam[conncomps[current_pixel]]) {
+            seam[current_pixel] = 1;
+          }
+        }
+      }
+    }
+
+    // Third pass: relabel the marked components in the order of the
+    // serial scan. All flat neighbors of a marked pixel are marked.
+    for (ptrdiff_t j = 0; j < dims[1]; j++) {
+      for (ptrdiff_t i = 0; i < dims[0]; i++) {
+        ptrdiff_t current_pixel = j * dims[0] + i;
+        if (!seam[current_pixel]) {
+          continue;
+        }
+        float current_depth =
+            filled_dem[current_pixel] - original_dem[current_pixel];
+        new_tree(conncomps, costs, current_pixel, current_depth);
+
+        for (int32_t neighbor = 0; neighbor < 4; neighbor++) {
+          ptrdiff_t neighbor_j = j + forward_j_offset[neighbor];
+          ptrdiff_t neighbor_i = i + forward_i_offset[neighbor];
+          ptrdiff_t neighbor_pixel = neighbor_j * dims[0] + neighbor_i;
+
+          if (neighbor_j < 0 || neighbor_i < 0 || neighbor_i >= dims[0]) {
+            continue;
+          }
+
+          if (flats[neighbor_pixel] & 1) {
+            unify(conncomps, costs, neighbor_pixel, current_pixel);
+          }
+        }
+      }
+    }
+
+    for (ptrdiff_t p = 0; p < dims[0] * dims[1]; p++) {
+      if (seam[p]) {
+        labeldepth r = find_root(conncomps, costs, p);
+        conncomps[p] = r.label;
+        costs[p] = r.weight;
+      }
+    }
+  }
+
+  // Fourth pass: give every other flat pixel the maximum depth of its
+  // connected component, which is held by its root. Only pixels that
+  // are not roots are written, so the pixels can be processed
+  // independently.
+  ptrdiff_t j;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t current_pixel = j * dims[0] + i;
+      ptrdiff_t root = conncomps[current_pixel];
+      if ((flats[current_pixel] & 1) && !(seam && seam[current_pixel]) &&
+          root != current_pixel) {
+        costs[current_pixel] = costs[root];
+      }
     }
   }
+
+  // Fifth pass: compute the costs using the max depth for each
+  // connected component
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t current_pixel = j * dims[0] + i;
+      if (flats[current_pixel] & 1) {
+        costs[current_pixel] =
+            flat_cost(costs[current_pixel], filled_dem[current_pixel] -
+                                                original_dem[current_pixel]);
+      }
+    }
+  }
+
+  free(seam);
 }
 
 /*
@@ -349,3 +572,500 @@ void gwdt(float *dist, ptrdiff_t *prev, float *costs, int32_t *flats,
     }
   }
 }
+
+/*
+  Gray-weighted distance transform with a bucket queue
+
+  Dijkstra's algorithm only ever removes the pixel with the smallest
+  tentative distance, so the distances removed from the queue never
+  decrease. This permits a monotone bucket queue (Dial, 1969) in
+  place of the binary heap used by `gwdt`. Tentative distances are
+  sorted into buckets of width `delta` that cover consecutive
+  intervals of the distance, and the pixels are removed one bucket at
+  a time.
+
+  Every edge weight is at least as large as the smallest cost of a
+  flat pixel. If `delta` is no larger than this minimum weight,
+  relaxing the edges of a pixel in the current bucket can only reach
+  later buckets, so the distances of all the pixels in the current
+  bucket are already final and they can be removed in any order. A
+  pending tentative distance also exceeds the current distance by at
+  most the largest edge weight, so only `bucket_count` buckets are
+  ever in use at once. They are stored in a circular array.
+
+  Each bucket is a doubly-linked list threaded through the `next` and
+  `link` arrays so that pixels can be moved between buckets in
+  constant time when their distance decreases. `link[pixel]` holds
+  the previous pixel in the list, BUCKET_HEAD(bucket) if the pixel is
+  at the head of a list or BUCKET_NONE if the pixel is not queued.
+
+  If the number of buckets has to be limited, `delta` is widened
+  beyond the smallest edge weight, and relaxing the edges of a pixel
+  can reach pixels in the current bucket. The pixels of the current
+  bucket are then removed in the order of their distances, found by a
+  linear scan of the bucket, so that every pixel is still settled
+  once. The buckets are sized so that they hold few pixels on
+  average.
+
+  Rounding can occasionally place a pixel in the current bucket or
+  decrease the distance of a pixel that has already been removed. In
+  either case the pixel is simply queued again in the current bucket,
+  which keeps the result correct at the cost of some extra work.
+
+  # References
+
+  Dial, R. B. (1969). Algorithm 360: Shortest-path forest with
+  topological ordering. Communications of the ACM, 12(11), 632-633.
+ */
+#define BUCKET_NONE -1
+#define BUCKET_HEAD(bucket) (-2 - (bucket))
+
+typedef struct {
+  ptrdiff_t *head;
+  ptrdiff_t *next;
+  ptrdiff_t *link;
+  ptrdiff_t bucket_count;
+  ptrdiff_t current;  // Absolute index of the current bucket
+  ptrdiff_t count;
+  float delta;
+  int widened;  // Nonzero if delta exceeds the smallest edge weight
+} BucketQueue;
+
+static void bq_remove(BucketQueue *q, ptrdiff_t pixel) {
+  ptrdiff_t before = q->link[pixel];
+  ptrdiff_t after = q->next[pixel];
+  if (before <= BUCKET_HEAD(0)) {
+    q->head[BUCKET_HEAD(0) - before] = after;
+  } else {
+    q->next[before] = after;
+  }
+  if (after >= 0) {
+    q->link[after] = before;
+  }
+  q->link[pixel] = BUCKET_NONE;
+  q->count--;
+}
+
+static void bq_insert(BucketQueue *q, ptrdiff_t pixel, float distance) {
+  // Distances below the current bucket are only possible through
+  // rounding. They go into the current bucket.
+  ptrdiff_t bucket = q->current;
+  double position = (double)distance / q->delta;
+  if (position > (double)q->current) {
+    bucket = (ptrdiff_t)position;
+  }
+  bucket %= q->bucket_count;
+
+  ptrdiff_t after = q->head[bucket];
+  q->next[pixel] = after;
+  q->link[pixel] = BUCKET_HEAD(bucket);
+  if (after >= 0) {
+    q->link[after] = pixel;
+  }
+  q->head[bucket] = pixel;
+  q->count++;
+}
+
+TOPOTOOLBOX_API
+void gwdt_bucketed(float *dist, ptrdiff_t *prev, float *costs, int32_t *flats,
+                   ptrdiff_t *heap, ptrdiff_t *back, ptrdiff_t dims[2],
+                   ptrdiff_t counters[4]) {
+  ptrdiff_t local_counters[4] = {0, 0, 0, 0};
+  if (counters == NULL) {
+    counters = local_counters;
+  }
+  counters[0] = counters[1] = counters[2] = counters[3] = 0;
+
+  // Find the range of costs over the flat pixels to size the buckets
+  float min_cost = INFINITY;
+  float max_cost = 0.0f;
+  ptrdiff_t flat_count = 0;
+  for (ptrdiff_t idx = 0; idx < dims[0] * dims[1]; idx++) {
+    if (flats[idx] & 1) {
+      min_cost = fminf(min_cost, costs[idx]);
+      max_cost = fmaxf(max_cost, costs[idx]);
+      flat_count++;
+    }
+  }
+
+  if (flat_count > 0 && !(min_cost > 0.0f && isfinite(max_cost))) {
+    // Zero, negative, infinite or NaN costs break the bucket
+    // structure, but not the binary heap.
+    gwdt(dist, prev, costs, flats, heap, back, dims);
+    return;
+  }
+
+  BucketQueue q = {0};
+  q.next = heap;
+  q.link = back;
+  q.delta = min_cost;
+
+  // The largest edge weight spans SQRT2f * max_cost / delta buckets.
+  // Two more buckets account for the partial buckets at either end.
+  double span = flat_count > 0 ? SQRT2f * (double)max_cost / q.delta : 0.0;
+  if (span > (double)flat_count) {
+    // Limit the buckets to one per flat pixel by widening delta
+    q.delta = (float)(SQRT2f * (double)max_cost / (double)flat_count);
+    q.widened = q.delta > min_cost;
+    span = SQRT2f * (double)max_cost / q.delta;
+  }
+
+  // No distance exceeds that of a path from a presill through every
+  // flat pixel. If tiny costs make the bucket index of that distance
+  // overflow a ptrdiff_t, the bucket queue cannot be used.
+  double max_distance = 1.0 + SQRT2f * (double)max_cost * (double)flat_count;
+  if (max_distance / q.delta >= (double)(PTRDIFF_MAX / 2)) {
+    gwdt(dist, prev, costs, flats, heap, back, dims);
+    return;
+  }
+
+  q.bucket_count = (ptrdiff_t)ceil(span) + 2;
+  q.head = (ptrdiff_t *)malloc(q.bucket_count * sizeof(ptrdiff_t));
+  if (q.head == NULL) {
+    gwdt(dist, prev, costs, flats, heap, back, dims);
+    return;
+  }
+  for (ptrdiff_t bucket = 0; bucket < q.bucket_count; bucket++) {
+    q.head[bucket] = -1;
+  }
+
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t idx = j * dims[0] + i;
+      // prev points to self for any pixel that doesn't have a lower neighbor
+      if (prev != NULL) {
+        prev[idx] = idx;
+      }
+      q.next[idx] = -1;
+      q.link[idx] = BUCKET_NONE;
+
+      dist[idx] = 0.0f;
+      if (flats[idx] & 1) {
+        // Presill pixels are the sources. Other flats start at
+        // infinity and are queued once their distance becomes finite.
+        if (flats[idx] & 4) {
+          dist[idx] = 1.0f;
+          bq_insert(&q, idx, dist[idx]);
+          counters[0]++;
+        } else {
+          dist[idx] = INFINITY;
+        }
+      }
+    }
+  }
+
+  ptrdiff_t i_offset[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  ptrdiff_t j_offset[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  float chamfer[8] = {SQRT2f, 1.0, SQRT2f, 1.0, 1.0, SQRT2f, 1.0, SQRT2f};
+
+  // Pixels removed from the queue are marked in `next`, which is
+  // otherwise unused for pixels that are not queued.
+  const ptrdiff_t removed = -2;
+
+  // The first presill determines the starting bucket
+  q.current = (ptrdiff_t)(1.0 / q.delta);
+
+  while (q.count > 0) {
+    ptrdiff_t bucket = q.current % q.bucket_count;
+    if (q.head[bucket] < 0) {
+      q.current++;
+      counters[2]++;
+      continue;
+    }
+
+    ptrdiff_t trial = q.head[bucket];
+    if (q.widened) {
+      // Relaxations within the current bucket are possible, so remove
+      // the pixel with the smallest distance
+      for (ptrdiff_t p = q.next[trial]; p >= 0; p = q.next[p]) {
+        if (dist[p] < dist[trial]) {
+          trial = p;
+        }
+      }
+    }
+    bq_remove(&q, trial);
+    q.next[trial] = removed;
+    counters[1]++;
+
+    float trial_distance = dist[trial];
+
+    ptrdiff_t j = trial / dims[0];
+    ptrdiff_t i = trial % dims[0];
+
+    for (ptrdiff_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+      ptrdiff_t neighbor_idx = neighbor_j * dims[0] + neighbor_i;
+
+      // Skip pixels outside the boundary or non-flat pixels
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1] || !(flats[neighbor_idx] & 1)) {
+        continue;
+      }
+
+      float proposal =
+          trial_distance +
+          chamfer[neighbor] * (costs[neighbor_idx] + costs[trial]) / 2;
+      if (proposal < dist[neighbor_idx]) {
+        if (q.link[neighbor_idx] != BUCKET_NONE) {
+          bq_remove(&q, neighbor_idx);
+        } else if (q.next[neighbor_idx] == removed) {
+          // Rounding decreased the distance of a removed pixel
+          counters[3]++;
+        }
+        dist[neighbor_idx] = proposal;
+        bq_insert(&q, neighbor_idx, proposal);
+        counters[0]++;
+        if (prev != NULL) {
+          prev[neighbor_idx] = trial;
+        }
+      }
+    }
+  }
+
+  free(q.head);
+}
+
+/*
+  Gray-weighted distance transform over independent flats
+
+  The connected components of flat pixels found by
+  `gwdt_computecosts` do not interact in the distance transform, so
+  each one can be solved with its own priority queue in a workspace
+  sized to the component. The workspace holds the component's pixels,
+  their tentative distances and the heap and back pointers of the
+  queue, all indexed by the position of the pixel in the component.
+
+  The map from a pixel to its position in the component is kept in
+  the `dist` array, which is not otherwise needed until the distances
+  of the component have been computed. Positions are stored as 32-bit
+  integers reinterpreted as floats. No two components share a pixel,
+  so threads working on different components never touch the same
+  elements of `dist` or `prev`.
+
+  The components are sorted by size and handed out to the threads
+  largest first with a dynamic schedule, which balances the load
+  when a few large flats dominate.
+ */
+typedef struct {
+  ptrdiff_t root;
+  ptrdiff_t size;
+} FlatComponent;
+
+static int flatcomponent_compare(const void *x, const void *y) {
+  const FlatComponent *a = (const FlatComponent *)x;
+  const FlatComponent *b = (const FlatComponent *)y;
+  if (a->size != b->size) {
+    return a->size < b->size ? 1 : -1;
+  }
+  return (a->root > b->root) - (a->root < b->root);
+}
+
+#define FLAT_UNVISITED -1
+
+static void position_set(float *dist, ptrdiff_t pixel, int32_t position) {
+  memcpy(dist + pixel, &position, sizeof position);
+}
+
+static int32_t position_get(const float *dist, ptrdiff_t pixel) {
+  int32_t position;
+  memcpy(&position, dist + pixel, sizeof position);
+  return position;
+}
+
+// Workspace for the distance transform of a single component. It is
+// reused for consecutive components on the same thread and grown
+// when necessary.
+typedef struct {
+  ptrdiff_t *pixels;
+  ptrdiff_t *heap;
+  ptrdiff_t *back;
+  float *distance;
+  ptrdiff_t capacity;
+} FlatWorkspace;
+
+static int flatworkspace_reserve(FlatWorkspace *ws, ptrdiff_t size) {
+  if (size <= ws->capacity) {
+    return 1;
+  }
+  free(ws->pixels);
+  free(ws->heap);
+  free(ws->back);
+  free(ws->distance);
+  ws->pixels = (ptrdiff_t *)malloc(size * sizeof(ptrdiff_t));
+  ws->heap = (ptrdiff_t *)malloc(size * sizeof(ptrdiff_t));
+  ws->back = (ptrdiff_t *)malloc(size * sizeof(ptrdiff_t));
+  ws->distance = (float *)malloc(size * sizeof(float));
+  if (!ws->pixels || !ws->heap || !ws->back || !ws->distance) {
+    ws->capacity = 0;
+    return 0;
+  }
+  ws->capacity = size;
+  return 1;
+}
+
+static void flatworkspace_free(FlatWorkspace *ws) {
+  free(ws->pixels);
+  free(ws->heap);
+  free(ws->back);
+  free(ws->distance);
+}
+
+static void gwdt_component(float *dist, ptrdiff_t *prev, float *costs,
+                           int32_t *flats, FlatWorkspace *ws,
+                           FlatComponent component, ptrdiff_t dims[2]) {
+  ptrdiff_t i_offset[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  ptrdiff_t j_offset[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  float chamfer[8] = {SQRT2f, 1.0, SQRT2f, 1.0, 1.0, SQRT2f, 1.0, SQRT2f};
+
+  // Collect the pixels of the component with a breadth-first search
+  // from its root. Flat neighbors always belong to the same
+  // component.
+  ptrdiff_t count = 1;
+  ws->pixels[0] = component.root;
+  position_set(dist, component.root, 0);
+  for (ptrdiff_t k = 0; k < count; k++) {
+    ptrdiff_t pixel = ws->pixels[k];
+    ptrdiff_t j = pixel / dims[0];
+    ptrdiff_t i = pixel % dims[0];
+    for (ptrdiff_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+      ptrdiff_t neighbor_idx = neighbor_j * dims[0] + neighbor_i;
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1] || !(flats[neighbor_idx] & 1) ||
+          position_get(dist, neighbor_idx) != FLAT_UNVISITED) {
+        continue;
+      }
+      assert(count < component.size);
+      position_set(dist, neighbor_idx, (int32_t)count);
+      ws->pixels[count++] = neighbor_idx;
+    }
+  }
+  assert(count == component.size);
+
+  PriorityQueue q = {0};
+  q.back = ws->back;
+  q.heap = ws->heap;
+  q.priorities = ws->distance;
+  q.max_size = count;
+  for (ptrdiff_t k = 0; k < count; k++) {
+    // Presill pixels are the sources. Other flats are initialized at
+    // infinity.
+    float d = (flats[ws->pixels[k]] & 4) ? 1.0f : INFINITY;
+    pq_insert(&q, k, d);
+  }
+
+  while (!pq_isempty(&q)) {
+    ptrdiff_t trial_position = pq_deletemin(&q);
+    float trial_distance = pq_get_priority(&q, trial_position);
+    ptrdiff_t trial = ws->pixels[trial_position];
+
+    ptrdiff_t j = trial / dims[0];
+    ptrdiff_t i = trial % dims[0];
+
+    for (ptrdiff_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+      ptrdiff_t neighbor_idx = neighbor_j * dims[0] + neighbor_i;
+
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1] || !(flats[neighbor_idx] & 1)) {
+        continue;
+      }
+      ptrdiff_t neighbor_position = position_get(dist, neighbor_idx);
+
+      float proposal =
+          trial_distance +
+          chamfer[neighbor] * (costs[neighbor_idx] + costs[trial]) / 2;
+      if (proposal < pq_get_priority(&q, neighbor_position)) {
+        pq_decrease_key(&q, neighbor_position, proposal);
+        if (prev != NULL) {
+          prev[neighbor_idx] = trial;
+        }
+      }
+    }
+  }
+
+  // The positions are no longer needed, so the distances can
+  // replace them.
+  for (ptrdiff_t k = 0; k < count; k++) {
+    dist[ws->pixels[k]] = ws->distance[k];
+  }
+}
+
+TOPOTOOLBOX_API
+int gwdt_parallel(float *dist, ptrdiff_t *prev, float *costs, int32_t *flats,
+                  ptrdiff_t *conncomps, ptrdiff_t dims[2], int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+  // Mark every flat pixel as unvisited and count the pixels of each
+  // component at its root.
+  ptrdiff_t component_count = 0;
+  for (ptrdiff_t idx = 0; idx < dims[0] * dims[1]; idx++) {
+    if (prev != NULL) {
+      prev[idx] = idx;
+    }
+    if (flats[idx] & 1) {
+      position_set(dist, idx, FLAT_UNVISITED);
+      component_count += conncomps[idx] == idx;
+    } else {
+      dist[idx] = 0.0f;
+    }
+  }
+  if (component_count == 0) {
+    return 0;
+  }
+
+  FlatComponent *components =
+      (FlatComponent *)malloc(component_count * sizeof(FlatComponent));
+  if (components == NULL) {
+    return -1;
+  }
+
+  // Temporarily number the roots so that the sizes can be
+  // accumulated in the components array
+  ptrdiff_t c = 0;
+  for (ptrdiff_t idx = 0; idx < dims[0] * dims[1]; idx++) {
+    if ((flats[idx] & 1) && conncomps[idx] == idx) {
+      components[c].root = idx;
+      components[c].size = 0;
+      position_set(dist, idx, (int32_t)c);
+      c++;
+    }
+  }
+  for (ptrdiff_t idx = 0; idx < dims[0] * dims[1]; idx++) {
+    if (flats[idx] & 1) {
+      components[position_get(dist, conncomps[idx])].size++;
+    }
+  }
+  for (c = 0; c < component_count; c++) {
+    if (components[c].size > INT32_MAX) {
+      free(components);
+      return -1;
+    }
+    position_set(dist, components[c].root, FLAT_UNVISITED);
+  }
+
+  qsort(components, component_count, sizeof(FlatComponent),
+        flatcomponent_compare);
+
+  int failed = 0;
+#pragma omp parallel num_threads(num_threads)
+  {
+    FlatWorkspace ws = {0};
+#pragma omp for schedule(dynamic)
+    for (c = 0; c < component_count; c++) {
+      if (!flatworkspace_reserve(&ws, components[c].size)) {
+#pragma omp atomic
+        failed |= 1;
+        continue;
+      }
+      gwdt_component(dist, prev, costs, flats, &ws, components[c], dims);
+    }
+    flatworkspace_free(&ws);
+  }
+
+  free(components);
+  return failed ? -1 : 0;
+}
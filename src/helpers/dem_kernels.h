@@ -0,0 +1,1045 @@
+/*
+  Type-generic DEM kernels
+
+  This file is a template that is included once for every supported
+  DEM data type by dem_types.c, including float, so that every type
+  shares a single implementation of each kernel. It deliberately has
+  no include guard. Before including it, define
+
+  DEM_T        the element type of the DEM, e.g. int16_t
+  DEM_NAME     a function-like macro mapping the base name of each
+               kernel to the name of the generated function
+  DEM_ACC      the floating point type used for differences of
+               elevations: double for 64-bit DEMs, float otherwise
+  DEM_MAX      the value given to pixels that cannot be drained by
+               fillsinks, e.g. INFINITY or INT16_MAX
+  DEM_FMIN     a function-like macro returning the minimum of two
+               elevations that ignores missing data like fminf
+  DEM_NODATA   for integer types only, the value that marks missing
+               data. Floating point types use NaN.
+  DEM_SIMD_F32 optionally, if DEM_T is float and SSE2 is available
+
+  and provide PixelQueue, carve_topological_sort, compute_hillshade,
+  SQRT2f and PI_2.
+
+  The following functions are generated:
+
+  reconstruct_erosion
+  reconstruct_erosion_hybrid
+  reconstruct_erosion_seeded
+  fillsinks
+  fillsinks_hybrid
+  identifyflats
+  identifyflats_parallel
+  gradient8
+  flow_routing_d8_carve
+  flow_routing_d8_carve_parallel
+  hillshade_fused
+
+  Integer DEMs mark missing data with DEM_NODATA, which must equal
+  DEM_MAX. Like a NaN, it is never smaller than any other elevation,
+  so the reconstruction needs no special cases for it, and all other
+  kernels test for it with DEM_ISNAN or convert it to a NaN with
+  DEM_LOAD.
+
+  All macros are undefined again at the end of this file.
+ */
+
+#ifdef DEM_NODATA
+#define DEM_ISNAN(x) ((x) == DEM_NODATA)
+#define DEM_LOAD(x) (DEM_ISNAN(x) ? (DEM_ACC)NAN : (DEM_ACC)(x))
+#else
+#define DEM_ISNAN(x) isnan(x)
+#define DEM_LOAD(x) ((DEM_ACC)(x))
+#endif
+
+// Number of pixels whose column minima are computed at once by the
+// interior paths of the erosion scans.
+#define DEM_SCAN_BLOCK 64
+
+/*
+  Minimum of the three neighbors of pixels i - 1, i and i + 1 in the
+  column `col`, which must be a column already visited by the current
+  scan. The result for pixel i is stored in colmin[i - first] for all
+  `first` <= i < `last`, where 1 <= first and last <= dims[0] - 1, so
+  that no bounds checks are necessary.
+
+  Missing data is ignored, as it is by fminf. If all three neighbors
+  are missing, the result is missing.
+ */
+static void DEM_NAME(column_min3)(DEM_T *colmin, const DEM_T *col,
+                                  ptrdiff_t first, ptrdiff_t last) {
+  ptrdiff_t i = first;
+#ifdef DEM_SIMD_F32
+  for (; i + 4 <= last; i += 4) {
+    __m128 up = _mm_loadu_ps(col + i - 1);
+    __m128 center = _mm_loadu_ps(col + i);
+    __m128 down = _mm_loadu_ps(col + i + 1);
+
+    // _mm_min_ps returns its second argument if either argument is a
+    // NaN. Select the first argument instead whenever the second is
+    // NaN to reproduce the behavior of fminf.
+    __m128 m = _mm_min_ps(center, up);
+    __m128 nan = _mm_cmpunord_ps(up, up);
+    m = _mm_or_ps(_mm_and_ps(nan, center), _mm_andnot_ps(nan, m));
+
+    __m128 m2 = _mm_min_ps(m, down);
+    nan = _mm_cmpunord_ps(down, down);
+    m2 = _mm_or_ps(_mm_and_ps(nan, m), _mm_andnot_ps(nan, m2));
+
+    _mm_storeu_ps(colmin + i - first, m2);
+  }
+#endif
+  for (; i < last; i++) {
+    colmin[i - first] = DEM_FMIN(DEM_FMIN(col[i - 1], col[i]), col[i + 1]);
+  }
+}
+
+/*
+  Update a single pixel with bounds checks on all of its neighbors.
+
+  This is used for pixels on the border of the image. The neighbors
+  are given by i_offset and j_offset.
+
+  Returns 1 if the pixel was modified, 0 otherwise.
+ */
+static ptrdiff_t DEM_NAME(scan_pixel_border_erosion)(
+    DEM_T *marker, const DEM_T *mask, ptrdiff_t dims[2], ptrdiff_t i,
+    ptrdiff_t j, const ptrdiff_t i_offset[4], const ptrdiff_t j_offset[4]) {
+  ptrdiff_t p = j * dims[0] + i;
+
+  DEM_T min_height = marker[p];
+  for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
+    ptrdiff_t neighbor_i = i + i_offset[neighbor];
+    ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+    ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+
+    if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+        neighbor_j >= dims[1]) {
+      continue;
+    }
+
+    min_height = DEM_FMIN(min_height, marker[q]);
+  }
+
+  // If mask[p] is NaN, this will set z = NaN
+  DEM_T z = min_height > mask[p] ? min_height : mask[p];
+
+  ptrdiff_t changed = z < marker[p];
+  marker[p] = z;
+  return changed;
+}
+
+/*
+  Perform a partial erosion reconstruction by scanning in the forward
+  direction.
+
+  Every pixel in `marker` is replaced by the minimum of a
+  neighborhood consisting of the 4 neighbors already visited by the
+  raster scan, denoted by 'x' in the diagram:
+
+  x x .
+   \|
+  x-o .
+   /
+  x . .
+
+  constrained to lie above the corresponding pixel in `mask`. `mask`
+  is not modified.
+
+  The three neighbors in the previous column are already final when a
+  column is scanned, so their minimum is computed for a block of
+  pixels at once with SIMD instructions where they are
+  available. Only the dependency on the previous pixel in the same
+  column is resolved sequentially. Pixels on the border of the image
+  take a slower path with bounds checks.
+
+  Returns the number of pixels that were modified in the current scan.
+ */
+static ptrdiff_t DEM_NAME(forward_scan_erosion)(DEM_T *marker,
+                                                const DEM_T *mask,
+                                                ptrdiff_t dims[2]) {
+  const ptrdiff_t j_offset[4] = {-1, -1, -1, 0};
+  const ptrdiff_t i_offset[4] = {1, 0, -1, -1};
+
+  ptrdiff_t count = 0;
+  DEM_T colmin[DEM_SCAN_BLOCK];
+
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    if (j == 0 || dims[0] < 3) {
+      for (ptrdiff_t i = 0; i < dims[0]; i++) {
+        count += DEM_NAME(scan_pixel_border_erosion)(marker, mask, dims, i, j,
+                                                     i_offset, j_offset);
+      }
+      continue;
+    }
+
+    DEM_T *col = marker + j * dims[0];
+    DEM_T *prev_col = col - dims[0];
+    const DEM_T *mask_col = mask + j * dims[0];
+
+    count += DEM_NAME(scan_pixel_border_erosion)(marker, mask, dims, 0, j,
+                                                 i_offset, j_offset);
+
+    for (ptrdiff_t block = 1; block < dims[0] - 1; block += DEM_SCAN_BLOCK) {
+      ptrdiff_t block_end = block + DEM_SCAN_BLOCK < dims[0] - 1
+                                ? block + DEM_SCAN_BLOCK
+                                : dims[0] - 1;
+      DEM_NAME(column_min3)(colmin, prev_col, block, block_end);
+
+      DEM_T above = col[block - 1];
+      for (ptrdiff_t i = block; i < block_end; i++) {
+        DEM_T min_height = DEM_FMIN(DEM_FMIN(col[i], colmin[i - block]), above);
+        DEM_T z = min_height > mask_col[i] ? min_height : mask_col[i];
+
+        if (z < col[i]) {
+          count++;
+        }
+        col[i] = z;
+        above = z;
+      }
+    }
+
+    count += DEM_NAME(scan_pixel_border_erosion)(marker, mask, dims,
+                                                 dims[0] - 1, j, i_offset,
+                                                 j_offset);
+  }
+  return count;
+}
+
+/*
+  Check whether any of the neighbors of p visited by the backward scan
+  can be lowered by p. If so, add p to the queue.
+
+  Returns 0 if the queue is full, 1 otherwise.
+ */
+static int32_t DEM_NAME(backward_enqueue_erosion)(
+    DEM_T *marker, PixelQueue *queue, const DEM_T *mask, ptrdiff_t dims[2],
+    ptrdiff_t i, ptrdiff_t j, const ptrdiff_t i_offset[4],
+    const ptrdiff_t j_offset[4]) {
+  ptrdiff_t p = j * dims[0] + i;
+
+  for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
+    ptrdiff_t neighbor_i = i + i_offset[neighbor];
+    ptrdiff_t neighbor_j = j + j_offset[neighbor];
+    ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+
+    if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+        neighbor_j >= dims[1]) {
+      continue;
+    }
+
+    if (marker[q] > marker[p] && marker[q] > mask[q]) {
+      if (enqueue(queue, p) == 0) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/*
+  Perform a partial erosion reconstruction by scanning in the backward
+  direction over the neighborhood
+
+  . . x
+     /
+  . o-x
+    |\
+  . x x
+
+  If `queue` is not NULL, pixels that can lower one of their already
+  visited neighbors are added to it, and -1 is returned if the queue
+  fills up.
+
+  Returns the number of pixels that were modified in the current scan.
+ */
+static ptrdiff_t DEM_NAME(backward_scan_erosion)(DEM_T *marker,
+                                                 PixelQueue *queue,
+                                                 const DEM_T *mask,
+                                                 ptrdiff_t dims[2]) {
+  const ptrdiff_t j_offset[4] = {1, 1, 1, 0};
+  const ptrdiff_t i_offset[4] = {-1, 0, 1, 1};
+
+  ptrdiff_t count = 0;
+  DEM_T colmin[DEM_SCAN_BLOCK];
+
+  // Note that the loop decreases. j must have a signed type for this
+  // to work correctly.
+  for (ptrdiff_t j = dims[1] - 1; j >= 0; j--) {
+    if (j == dims[1] - 1 || dims[0] < 3) {
+      for (ptrdiff_t i = dims[0] - 1; i >= 0; i--) {
+        count += DEM_NAME(scan_pixel_border_erosion)(marker, mask, dims, i, j,
+                                                     i_offset, j_offset);
+        if (queue && !DEM_NAME(backward_enqueue_erosion)(
+                         marker, queue, mask, dims, i, j, i_offset, j_offset)) {
+          // In hybrid mode, we don't need to count the changes:
+          // Instead, we use the return value to signal if we need
+          // to repeat the scan because the queue filled up.
+          return -1;
+        }
+      }
+      continue;
+    }
+
+    DEM_T *col = marker + j * dims[0];
+    DEM_T *next_col = col + dims[0];
+    const DEM_T *mask_col = mask + j * dims[0];
+
+    count += DEM_NAME(scan_pixel_border_erosion)(marker, mask, dims,
+                                                 dims[0] - 1, j, i_offset,
+                                                 j_offset);
+    if (queue && !DEM_NAME(backward_enqueue_erosion)(marker, queue, mask,
+                                                     dims, dims[0] - 1, j,
+                                                     i_offset, j_offset)) {
+      return -1;
+    }
+
+    for (ptrdiff_t block_end = dims[0] - 1; block_end > 1;
+         block_end -= DEM_SCAN_BLOCK) {
+      ptrdiff_t block =
+          block_end - DEM_SCAN_BLOCK > 1 ? block_end - DEM_SCAN_BLOCK : 1;
+      DEM_NAME(column_min3)(colmin, next_col, block, block_end);
+
+      DEM_T below = col[block_end];
+      for (ptrdiff_t i = block_end - 1; i >= block; i--) {
+        DEM_T min_height = DEM_FMIN(DEM_FMIN(col[i], colmin[i - block]), below);
+        DEM_T z = min_height > mask_col[i] ? min_height : mask_col[i];
+
+        if (z < col[i]) {
+          count++;
+        }
+        col[i] = z;
+        below = z;
+
+        if (queue) {
+          // Scan the neighborhood again to check if the pixel should
+          // be added to the queue. All four neighbors are in bounds.
+          ptrdiff_t p = j * dims[0] + i;
+          ptrdiff_t neighbors[4] = {p + dims[0] - 1, p + dims[0],
+                                    p + dims[0] + 1, p + 1};
+          for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
+            ptrdiff_t q = neighbors[neighbor];
+            if (marker[q] > z && marker[q] > mask[q]) {
+              if (enqueue(queue, p) == 0) {
+                return -1;
+              }
+            }
+          }
+        }
+      }
+    }
+
+    count += DEM_NAME(scan_pixel_border_erosion)(marker, mask, dims, 0, j,
+                                                 i_offset, j_offset);
+    if (queue && !DEM_NAME(backward_enqueue_erosion)(
+                     marker, queue, mask, dims, 0, j, i_offset, j_offset)) {
+      return -1;
+    }
+  }
+  return count;
+}
+
+/*
+  Propagates changes of an erosion reconstruction via a breadth-first
+  search of the image.
+
+  Returns 1 if a pixel could not be enqueued because the queue was
+  full, 0 otherwise.
+ */
+static int32_t DEM_NAME(propagate_erosion)(DEM_T *marker, PixelQueue *queue,
+                                           const DEM_T *mask,
+                                           ptrdiff_t dims[2]) {
+  int32_t repeat_flag = 0;
+
+  ptrdiff_t j_offset[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  ptrdiff_t i_offset[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+
+  // p will be NULL if the queue is empty
+  ptrdiff_t *p = dequeue(queue);
+  while (p) {
+    ptrdiff_t i = (*p) % dims[0];
+    ptrdiff_t j = (*p) / dims[0];
+    DEM_T pz = marker[*p];
+
+    for (ptrdiff_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+      ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1]) {
+        continue;
+      }
+
+      if ((marker[q] > pz) && (marker[q] > mask[q])) {
+        // Neither pz nor mask[q] is missing here
+        marker[q] = pz > mask[q] ? pz : mask[q];
+
+        if (enqueue(queue, q) == 0) {
+          // If enqueuing a pixel fails because the queue is full, set
+          // the repeat flag and skip this pixel.
+          repeat_flag = 1;
+        }
+      }
+    }
+
+    p = dequeue(queue);
+  }
+
+  return repeat_flag;
+}
+
+/*
+  Grayscale reconstruction by erosion
+
+  Performs a grayscale reconstruction by erosion of the `mask` image
+  from the `marker` image. This is the dual of reconstruct: the
+  `marker` is lowered towards the `mask` rather than raised. Filling
+  sinks with this reconstruction does not require negating the DEM, so
+  `mask` is never modified and may be shared between threads.
+
+  Returns the number of forward and backward scan pairs that were
+  performed.
+ */
+TOPOTOOLBOX_API
+int32_t DEM_NAME(reconstruct_erosion)(DEM_T *marker, const DEM_T *mask,
+                                      ptrdiff_t dims[2]) {
+  ptrdiff_t n = dims[0] * dims[1];
+
+  const int32_t max_iterations = 1000;
+  int32_t iteration = 0;
+  for (; iteration < max_iterations && n > 0; iteration++) {
+    n = DEM_NAME(forward_scan_erosion)(marker, mask, dims);
+    n += DEM_NAME(backward_scan_erosion)(marker, NULL, mask, dims);
+  }
+  return iteration;
+}
+
+/*
+  Grayscale reconstruction by erosion using the hybrid algorithm of
+  Vincent (1993).
+
+  This is the dual of reconstruct_hybrid and uses `queue` in the same
+  way.
+ */
+TOPOTOOLBOX_API
+int DEM_NAME(reconstruct_erosion_hybrid)(DEM_T *marker, ptrdiff_t *queue,
+                                         const DEM_T *mask,
+                                         ptrdiff_t dims[2]) {
+  PixelQueue q = {0};
+  q.buffer = queue;
+  q.length = dims[0] * dims[1];
+
+  int max_scans = 2;
+  int scans = 0;
+  int32_t repeat = 0;
+  do {
+    DEM_NAME(forward_scan_erosion)(marker, mask, dims);
+
+    repeat = 0;
+    // Backward scan returns -1 if the queue fills up, in which case
+    // we need to repeat the scan.
+    repeat |= (DEM_NAME(backward_scan_erosion)(marker, &q, mask, dims) == -1);
+    repeat |= DEM_NAME(propagate_erosion)(marker, &q, mask, dims);
+
+    scans++;
+  } while (repeat && scans < max_scans);
+  return (scans == max_scans) && repeat;
+}
+
+/*
+  Erosion reconstruction restricted to the neighborhood of a set of
+  seed pixels.
+
+  The first `seed_count` elements of `queue` hold the seeds. Each seed
+  is first lowered as far as its neighbors allow, and the changes are
+  then propagated with propagate_erosion, so the cost depends on the
+  number of pixels that are lowered rather than on the size of the
+  image. Every pixel that is not a seed must satisfy marker[p] <=
+  max(mask[p], marker[q]) for all of its neighbors q that are not
+  seeds. If the queue overflows, the reconstruction is completed with
+  reconstruct_erosion.
+ */
+TOPOTOOLBOX_API
+void DEM_NAME(reconstruct_erosion_seeded)(DEM_T *marker, ptrdiff_t *queue,
+                                          ptrdiff_t seed_count,
+                                          const DEM_T *mask,
+                                          ptrdiff_t dims[2]) {
+  ptrdiff_t j_offset[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  ptrdiff_t i_offset[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+
+  for (ptrdiff_t s = 0; s < seed_count; s++) {
+    ptrdiff_t p = queue[s];
+    ptrdiff_t i = p % dims[0];
+    ptrdiff_t j = p / dims[0];
+
+    DEM_T min_height = marker[p];
+    for (ptrdiff_t neighbor = 0; neighbor < 8; neighbor++) {
+      ptrdiff_t neighbor_i = i + i_offset[neighbor];
+      ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+      if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+          neighbor_j >= dims[1]) {
+        continue;
+      }
+      min_height =
+          DEM_FMIN(min_height, marker[neighbor_j * dims[0] + neighbor_i]);
+    }
+
+    DEM_T z = min_height > mask[p] ? min_height : mask[p];
+    if (z < marker[p]) {
+      marker[p] = z;
+    }
+  }
+
+  PixelQueue q = {0};
+  q.buffer = queue;
+  q.length = dims[0] * dims[1];
+  q.head = 0;
+  q.tail = seed_count;
+
+  if (seed_count >= q.length ||
+      DEM_NAME(propagate_erosion)(marker, &q, mask, dims)) {
+    DEM_NAME(reconstruct_erosion)(marker, mask, dims);
+  }
+}
+
+/*
+  Sinks are filled using grayscale morphological reconstruction by
+  erosion. The boundary pixels of the output are set equal to the DEM
+  and the interior pixels to DEM_MAX, and the output is then lowered
+  towards the DEM. `dem` is only read, so several fills may share the
+  same DEM concurrently.
+ */
+TOPOTOOLBOX_API
+void DEM_NAME(fillsinks)(DEM_T *output, const DEM_T *dem, uint8_t *bc,
+                         ptrdiff_t dims[2]) {
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t p = j * dims[0] + i;
+      output[p] = bc[p] == 1 ? dem[p] : DEM_MAX;
+    }
+  }
+
+  DEM_NAME(reconstruct_erosion)(output, dem, dims);
+}
+
+TOPOTOOLBOX_API
+void DEM_NAME(fillsinks_hybrid)(DEM_T *output, ptrdiff_t *queue,
+                                const DEM_T *dem, uint8_t *bc,
+                                ptrdiff_t dims[2]) {
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t p = j * dims[0] + i;
+      output[p] = bc[p] == 1 ? dem[p] : DEM_MAX;
+    }
+  }
+
+  DEM_NAME(reconstruct_erosion_hybrid)(output, queue, dem, dims);
+}
+
+/*
+  Flats, sills and presills are found in a single sweep over the
+  columns of the DEM. A flat is a pixel whose elevation is equal to
+  the minimum elevation of all of its neighbors. Pixels next to
+  missing data are never flats.
+
+  Whether a pixel is a sill or a presill depends only on its own
+  neighborhood:
+
+  - A sill is a pixel that is not a flat but touches a flat with the
+    same elevation.
+  - A presill is a flat that touches a sill with the same elevation,
+    which is the same as a flat that touches a pixel with the same
+    elevation that is not a flat.
+
+  The sweep therefore identifies the flats one column ahead of the
+  sills and presills. Each pixel is written only once the flats in
+  its three columns are known, and no pixel ever writes to its
+  neighbors. This lets the columns be split into blocks that are
+  processed independently: the flats in the columns bordering a block
+  are recomputed rather than read from the output of another block.
+ */
+
+// Flat test for a single pixel with bounds checks
+static int32_t DEM_NAME(is_flat)(const DEM_T *dem, ptrdiff_t dims[2],
+                                 ptrdiff_t i, ptrdiff_t j) {
+  // Border pixels are never flats
+  if (j <= 0 || j >= dims[1] - 1 || i <= 0 || i >= dims[0] - 1) {
+    return 0;
+  }
+
+  DEM_T dem_height = dem[j * dims[0] + i];
+  if (DEM_ISNAN(dem_height)) {
+    return 0;
+  }
+
+  for (ptrdiff_t nj = j - 1; nj <= j + 1; nj++) {
+    for (ptrdiff_t ni = i - 1; ni <= i + 1; ni++) {
+      DEM_T neighbor_height = dem[nj * dims[0] + ni];
+      if (DEM_ISNAN(neighbor_height) || neighbor_height < dem_height) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+#ifdef DEM_SIMD_F32
+// Minimum of col[i - 1], col[i] and col[i + 1] for four consecutive
+// pixels, with NaNs replaced by -INFINITY
+static __m128 DEM_NAME(column_min3_nan)(const float *col) {
+  __m128 neg_inf = _mm_set1_ps(-INFINITY);
+  __m128 m = _mm_set1_ps(INFINITY);
+  for (ptrdiff_t offset = -1; offset <= 1; offset++) {
+    __m128 v = _mm_loadu_ps(col + offset);
+    __m128 nan = _mm_cmpunord_ps(v, v);
+    v = _mm_or_ps(_mm_and_ps(nan, neg_inf), _mm_andnot_ps(nan, v));
+    m = _mm_min_ps(m, v);
+  }
+  return m;
+}
+#endif
+
+/*
+  Set output to 1 for the flats and 0 for all other pixels of column
+  j.
+
+  The SIMD path takes the minimum over the whole 3x3 neighborhood
+  including the pixel itself, with NaNs replaced by -INFINITY, and
+  compares it to the pixel. This matches is_flat: a NaN neighbor makes
+  the minimum smaller than the pixel, and a NaN pixel fails the
+  comparison.
+ */
+static ptrdiff_t DEM_NAME(flat_column)(int32_t *output, const DEM_T *dem,
+                                       ptrdiff_t dims[2], ptrdiff_t j) {
+  int32_t *out = output + j * dims[0];
+  if (j == 0 || j == dims[1] - 1 || dims[0] < 3) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      out[i] = 0;
+    }
+    return 0;
+  }
+
+  ptrdiff_t count = 0;
+  out[0] = 0;
+  out[dims[0] - 1] = 0;
+  ptrdiff_t i = 1;
+#ifdef DEM_SIMD_F32
+  const float *left = dem + (j - 1) * dims[0];
+  const float *center = dem + j * dims[0];
+  const float *right = dem + (j + 1) * dims[0];
+
+  for (; i + 4 <= dims[0] - 1; i += 4) {
+    __m128 m = _mm_min_ps(DEM_NAME(column_min3_nan)(left + i),
+                          DEM_NAME(column_min3_nan)(center + i));
+    m = _mm_min_ps(m, DEM_NAME(column_min3_nan)(right + i));
+    int mask = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(center + i), m));
+    for (ptrdiff_t k = 0; k < 4; k++) {
+      out[i + k] = (mask >> k) & 1;
+      count += (mask >> k) & 1;
+    }
+  }
+#endif
+  for (; i < dims[0] - 1; i++) {
+    out[i] = DEM_NAME(is_flat)(dem, dims, i, j);
+    count += out[i];
+  }
+  return count;
+}
+
+/*
+  Sill and presill bits of pixel (i, j), whose own flat bit is
+  `flat`, with bounds checks. The flats of the pixels in columns
+  outside [j_start, j_end) are recomputed from the DEM.
+ */
+static int32_t DEM_NAME(sill_bits)(int32_t *output, const DEM_T *dem,
+                                   ptrdiff_t dims[2], ptrdiff_t i, ptrdiff_t j,
+                                   int32_t flat, ptrdiff_t j_start,
+                                   ptrdiff_t j_end) {
+  DEM_T dem_height = dem[j * dims[0] + i];
+  for (ptrdiff_t nj = j - 1; nj <= j + 1; nj++) {
+    if (nj < 0 || nj >= dims[1]) {
+      continue;
+    }
+    for (ptrdiff_t ni = i - 1; ni <= i + 1; ni++) {
+      if (ni < 0 || ni >= dims[0] || (ni == i && nj == j)) {
+        continue;
+      }
+      ptrdiff_t neighbor = nj * dims[0] + ni;
+      if (dem[neighbor] != dem_height) {
+        continue;
+      }
+      int32_t neighbor_flat = (nj >= j_start && nj < j_end)
+                                  ? output[neighbor] & 1
+                                  : DEM_NAME(is_flat)(dem, dims, ni, nj);
+      if (neighbor_flat != flat) {
+        // A flat next to a sill is a presill and a nonflat next to a
+        // flat is a sill
+        return flat ? 4 : 2;
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+  Add the sill and presill bits to column j, whose flats and those of
+  its neighboring columns within [j_start, j_end) are already in
+  `output`.
+
+  Missing data needs no special care: two pixels with the same
+  elevation are either both missing or both not, and a missing pixel
+  is neither a flat nor next to one.
+ */
+static void DEM_NAME(sill_column)(int32_t *output, const DEM_T *dem,
+                                  ptrdiff_t dims[2], ptrdiff_t j,
+                                  ptrdiff_t j_start, ptrdiff_t j_end) {
+  int32_t *out = output + j * dims[0];
+
+  // Columns on the edges of the block or the DEM need bounds checks
+  // and recomputed flats.
+  if (j - 1 < j_start || j + 1 >= j_end || dims[0] < 3) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      out[i] |= DEM_NAME(sill_bits)(output, dem, dims, i, j, out[i] & 1,
+                                    j_start, j_end);
+    }
+    return;
+  }
+
+  const int32_t *left = out - dims[0];
+  const int32_t *right = out + dims[0];
+  const DEM_T *center = dem + j * dims[0];
+
+  out[0] |=
+      DEM_NAME(sill_bits)(output, dem, dims, 0, j, out[0] & 1, j_start, j_end);
+  ptrdiff_t i = 1;
+  while (i < dims[0] - 1) {
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    // Skip groups of four pixels without any flats in their
+    // neighborhood: they can be neither sills nor presills.
+    if (i + 4 <= dims[0] - 1) {
+      __m128i any = _mm_setzero_si128();
+      for (ptrdiff_t offset = -1; offset <= 1; offset += 2) {
+        any = _mm_or_si128(
+            any, _mm_loadu_si128((const __m128i *)(left + i + offset)));
+        any = _mm_or_si128(
+            any, _mm_loadu_si128((const __m128i *)(out + i + offset)));
+        any = _mm_or_si128(
+            any, _mm_loadu_si128((const __m128i *)(right + i + offset)));
+      }
+      any = _mm_and_si128(any, _mm_set1_epi32(1));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(any, _mm_setzero_si128())) ==
+          0xFFFF) {
+        i += 4;
+        continue;
+      }
+    }
+#endif
+    int32_t flat = out[i] & 1;
+    DEM_T dem_height = center[i];
+    for (ptrdiff_t ni = i - 1; ni <= i + 1; ni++) {
+      if ((ni != i && (out[ni] & 1) != flat && center[ni] == dem_height) ||
+          ((left[ni] & 1) != flat && center[ni - dims[0]] == dem_height) ||
+          ((right[ni] & 1) != flat && center[ni + dims[0]] == dem_height)) {
+        out[i] |= flat ? 4 : 2;
+        break;
+      }
+    }
+    i++;
+  }
+  out[dims[0] - 1] |= DEM_NAME(sill_bits)(
+      output, dem, dims, dims[0] - 1, j, out[dims[0] - 1] & 1, j_start, j_end);
+}
+
+// Identify the flats, sills and presills of columns [j_start, j_end)
+static ptrdiff_t DEM_NAME(identifyflats_block)(int32_t *output,
+                                               const DEM_T *dem,
+                                               ptrdiff_t dims[2],
+                                               ptrdiff_t j_start,
+                                               ptrdiff_t j_end) {
+  if (j_start >= j_end) {
+    return 0;
+  }
+  ptrdiff_t count_flats = DEM_NAME(flat_column)(output, dem, dims, j_start);
+  for (ptrdiff_t j = j_start; j < j_end; j++) {
+    if (j + 1 < j_end) {
+      count_flats += DEM_NAME(flat_column)(output, dem, dims, j + 1);
+    }
+    DEM_NAME(sill_column)(output, dem, dims, j, j_start, j_end);
+  }
+  return count_flats;
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t DEM_NAME(identifyflats)(int32_t *output, const DEM_T *dem,
+                                  ptrdiff_t dims[2]) {
+  return DEM_NAME(identifyflats_block)(output, dem, dims, 0, dims[1]);
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t DEM_NAME(identifyflats_parallel)(int32_t *output, const DEM_T *dem,
+                                           ptrdiff_t dims[2],
+                                           int num_threads) {
+  num_threads = resolve_threads(num_threads);
+  ptrdiff_t block_count = num_threads;
+  if (block_count > dims[1]) {
+    block_count = dims[1] > 0 ? dims[1] : 1;
+  }
+
+  ptrdiff_t count_flats = 0;
+  ptrdiff_t block;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    reduction(+ : count_flats)
+  for (block = 0; block < block_count; block++) {
+    count_flats += DEM_NAME(identifyflats_block)(
+        output, dem, dims, block * dims[1] / block_count,
+        (block + 1) * dims[1] / block_count);
+  }
+  return count_flats;
+}
+
+/*
+  The gradient is the maximum difference in elevation between a cell
+  and its 8 neighbors divided by their distance. Missing neighbors are
+  skipped, and the gradient of a missing cell is 0.
+ */
+TOPOTOOLBOX_API
+void DEM_NAME(gradient8)(float *output, const DEM_T *dem, float cellsize,
+                         int use_mp, ptrdiff_t dims[2]) {
+  ptrdiff_t i_offset[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  ptrdiff_t j_offset[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+
+#if TOPOTOOLBOX_OPENMP_VERSION < 30
+  ptrdiff_t j;
+#pragma omp parallel for if (use_mp)
+  for (j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+#else
+  ptrdiff_t i, j;
+#pragma omp parallel for collapse(2) if (use_mp)
+  for (j = 0; j < dims[1]; j++) {
+    for (i = 0; i < dims[0]; i++) {
+#endif
+      DEM_ACC max_gradient = 0;
+
+      for (int k = 0; k < 8; k++) {
+        ptrdiff_t neighbour_i = i + i_offset[k];
+        ptrdiff_t neighbour_j = j + j_offset[k];
+
+        if (neighbour_i >= 0 && neighbour_i < dims[0] && neighbour_j >= 0 &&
+            neighbour_j < dims[1]) {
+          DEM_ACC horizontal_dist =
+              (neighbour_i != i && neighbour_j != j) ? SQRT2f * cellsize
+                                                     : cellsize;
+          // Convert before subtracting so that unsigned elevations do
+          // not wrap around. Missing data yields a NaN, which fails
+          // the comparison below.
+          DEM_ACC vertical_dist =
+              DEM_LOAD(dem[j * dims[0] + i]) -
+              DEM_LOAD(dem[neighbour_j * dims[0] + neighbour_i]);
+
+          DEM_ACC local_gradient = vertical_dist / horizontal_dist;
+          if (local_gradient > max_gradient) {
+            max_gradient = local_gradient;
+          }
+        }
+      }
+      output[j * dims[0] + i] = (float)max_gradient;
+    }
+  }
+}
+
+/*
+  Steepest descent flow direction of pixel (i, j), with flow routed
+  over flat regions by the auxiliary topography in dist.
+
+  To index in the correct order, the direction of indexing is
+  reversed for row-major arrays (order == 1) by swapping the i and j
+  offsets: ij_offsets[order & 1] are the offsets in the first
+  dimension and ij_offsets[(order ^ 1) & 1] those in the second.
+ */
+static uint8_t DEM_NAME(compute_flowdirection)(ptrdiff_t i, ptrdiff_t j,
+                                               const DEM_T *dem, float *dist,
+                                               int32_t *flats,
+                                               ptrdiff_t dims[2],
+                                               unsigned int order) {
+  int32_t is_flat = flats[j * dims[0] + i] & 1;
+  DEM_ACC z = is_flat > 0 ? (DEM_ACC)dist[j * dims[0] + i]
+                          : DEM_LOAD(dem[j * dims[0] + i]);
+  uint8_t direction = 0;
+  DEM_ACC max_gradient = 0.0;
+
+  ptrdiff_t ij_offsets[2][8] = {{0, 1, 1, 1, 0, -1, -1, -1},
+                                {1, 1, 0, -1, -1, -1, 0, 1}};
+
+  DEM_ACC chamfer[8] = {1.0, SQRT2f, 1.0, SQRT2f, 1.0, SQRT2f, 1.0, SQRT2f};
+
+  for (int32_t neighbor = 0; neighbor < 8; neighbor++) {
+    ptrdiff_t neighbor_i = i + ij_offsets[order & 1][neighbor];
+    ptrdiff_t neighbor_j = j + ij_offsets[(order ^ 1) & 1][neighbor];
+
+    if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+        neighbor_j >= dims[1]) {
+      continue;
+    }
+
+    if (dem[neighbor_j * dims[0] + neighbor_i] > dem[j * dims[0] + i]) {
+      // This will skip any surrounding higher neighbors of flats,
+      // including sills that have higher elevations
+      continue;
+    }
+
+    DEM_ACC neighbor_z = is_flat > 0
+                             ? (DEM_ACC)dist[neighbor_j * dims[0] + neighbor_i]
+                             : DEM_LOAD(dem[neighbor_j * dims[0] + neighbor_i]);
+
+    // Missing data yields a NaN, which fails the comparison
+    DEM_ACC g = (z - neighbor_z) / chamfer[neighbor];
+    if (g > max_gradient) {
+      max_gradient = g;
+      direction = (uint8_t)(1 << neighbor);
+    }
+  }
+  return direction;
+}
+
+// Store the complemented flow direction of every pixel, see
+// carve_topological_sort in dem_types.c
+static void DEM_NAME(carve_directions)(uint8_t *direction, const DEM_T *dem,
+                                       float *dist, int32_t *flats,
+                                       ptrdiff_t dims[2], unsigned int order,
+                                       int num_threads) {
+  ptrdiff_t j;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      direction[j * dims[0] + i] = (uint8_t)~DEM_NAME(compute_flowdirection)(
+          i, j, dem, dist, flats, dims, order);
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void DEM_NAME(flow_routing_d8_carve)(ptrdiff_t *node, uint8_t *direction,
+                                     const DEM_T *dem, float *dist,
+                                     int32_t *flats, ptrdiff_t dims[2],
+                                     unsigned int order) {
+  // direction[i] is the bitfield-encoded flow direction for the
+  // pixel at i
+  //
+  // 1<<5 1<<6  1<<7
+  // 1<<4    0  1<<0
+  // 1<<3 1<<2  1<<1
+  DEM_NAME(carve_directions)(direction, dem, dist, flats, dims, order, 1);
+  carve_topological_sort(node, direction, dims, order);
+}
+
+TOPOTOOLBOX_API
+void DEM_NAME(flow_routing_d8_carve_parallel)(ptrdiff_t *node,
+                                              uint8_t *direction,
+                                              const DEM_T *dem, float *dist,
+                                              int32_t *flats,
+                                              ptrdiff_t dims[2],
+                                              unsigned int order,
+                                              int num_threads) {
+  num_threads = resolve_threads(num_threads);
+  DEM_NAME(carve_directions)(direction, dem, dist, flats, dims, order,
+                             num_threads);
+  carve_topological_sort(node, direction, dims, order);
+}
+
+/*
+  Derivative of the DEM along a line of pixels with the given stride
+  at z for hillshade_fused. The first pixel of a line (kind < 0) uses
+  a one-sided stencil of [-3 4 -1]/(2*cs), the last pixel (kind > 0)
+  a stencil of [1 -4 3]/(2*cs) and interior pixels (kind == 0) the
+  central difference [-1 0 1]/(2*cs), which is NaN wherever the pixel
+  itself is missing. Missing neighbors yield NaNs.
+
+  kind is a constant in every call, so the branches are resolved when
+  the function is inlined.
+ */
+static inline float DEM_NAME(hillshade_derivative)(const DEM_T *z,
+                                                   ptrdiff_t stride,
+                                                   float cellsize, int kind) {
+  if (kind < 0) {
+    return (float)((-DEM_LOAD(z[2 * stride]) + 4 * DEM_LOAD(z[stride]) -
+                    3 * DEM_LOAD(z[0])) /
+                   (2 * cellsize));
+  }
+  if (kind > 0) {
+    return (float)((DEM_LOAD(z[-2 * stride]) - 4 * DEM_LOAD(z[-stride]) +
+                    3 * DEM_LOAD(z[0])) /
+                   (2 * cellsize));
+  }
+  return DEM_ISNAN(z[0])
+             ? NAN
+             : (float)((DEM_LOAD(z[stride]) - DEM_LOAD(z[-stride])) /
+                       (2 * cellsize));
+}
+
+// Shade the column of m pixels starting at z, which is the first,
+// an interior or the last column according to column_kind
+static inline void DEM_NAME(hillshade_column)(float *output, const DEM_T *z,
+                                              ptrdiff_t m, int column_kind,
+                                              float sx, float sy, float sz,
+                                              float cellsize) {
+  output[0] = compute_hillshade(
+      DEM_NAME(hillshade_derivative)(z, 1, cellsize, -1),
+      DEM_NAME(hillshade_derivative)(z, m, cellsize, column_kind), sx, sy, sz);
+  for (ptrdiff_t i = 1; i < m - 1; i++) {
+    output[i] = compute_hillshade(
+        DEM_NAME(hillshade_derivative)(z + i, 1, cellsize, 0),
+        DEM_NAME(hillshade_derivative)(z + i, m, cellsize, column_kind), sx,
+        sy, sz);
+  }
+  output[m - 1] = compute_hillshade(
+      DEM_NAME(hillshade_derivative)(z + m - 1, 1, cellsize, 1),
+      DEM_NAME(hillshade_derivative)(z + m - 1, m, cellsize, column_kind), sx,
+      sy, sz);
+}
+
+/*
+  A lower memory version of hillshade fuses the loops together so
+  intermediate arrays can be avoided. The first and last pixels of
+  every column and the first and last columns are peeled off so that
+  the loops over the interior pixels need no branches.
+ */
+TOPOTOOLBOX_API
+void DEM_NAME(hillshade_fused)(float *output, const DEM_T *dem, float azimuth,
+                               float altitude, float cellsize,
+                               ptrdiff_t dims[2]) {
+  float sx = sinf(PI_2 - altitude) * cosf(azimuth);
+  float sy = sinf(PI_2 - altitude) * sinf(azimuth);
+  float sz = cosf(PI_2 - altitude);
+
+  ptrdiff_t m = dims[0];
+  ptrdiff_t n = dims[1];
+
+  DEM_NAME(hillshade_column)(output, dem, m, -1, sx, sy, sz, cellsize);
+  for (ptrdiff_t j = 1; j < n - 1; j++) {
+    DEM_NAME(hillshade_column)(output + j * m, dem + j * m, m, 0, sx, sy, sz,
+                               cellsize);
+  }
+  DEM_NAME(hillshade_column)(output + (n - 1) * m, dem + (n - 1) * m, m, 1, sx,
+                             sy, sz, cellsize);
+}
+
+#undef DEM_SCAN_BLOCK
+#undef DEM_LOAD
+#undef DEM_ISNAN
+#undef DEM_T
+#undef DEM_NAME
+#undef DEM_ACC
+#undef DEM_MAX
+#undef DEM_FMIN
+#ifdef DEM_NODATA
+#undef DEM_NODATA
+#endif
+#ifdef DEM_SIMD_F32
+#undef DEM_SIMD_F32
+#endif
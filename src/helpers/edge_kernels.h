@@ -0,0 +1,338 @@
+/*
+  Index-generic edge list kernels
+
+  This file is a template that is included once for every supported
+  node index type by index_types.c, including ptrdiff_t. It
+  deliberately has no include guard. Before including it, define
+
+  IDX_T        the element type of the node indices, e.g. uint32_t
+  IDX_NAME     a function-like macro mapping the base name of each
+               kernel to the name of the generated function
+
+  The following functions are generated:
+
+  flow_routing_d8_edgelist
+  flow_accumulation_edgelist
+  drainagebasins
+  streamquad_trapz_f32
+  streamquad_trapz_f64
+  traverse_<direction>_<type>_<op> for every traversal
+
+  Edge and node counts as well as dims remain ptrdiff_t. Only the
+  arrays that hold one index per node or per edge change type.
+  All macros are undefined again at the end of this file.
+ */
+
+TOPOTOOLBOX_API
+ptrdiff_t IDX_NAME(flow_routing_d8_edgelist)(IDX_T *source, IDX_T *target,
+                                             IDX_T *node, uint8_t *direction,
+                                             ptrdiff_t dims[2],
+                                             unsigned int order) {
+  // For an array of size {m,n}, strides is {n,1} if row-major, {1, m} if
+  // column-major Note dims = {m,n} for column-major, {n,m} for row-major
+  ptrdiff_t strides[2] = {0};
+  if (order & 1) {
+    // row-major
+    strides[0] = dims[0];
+    strides[1] = 1;
+  } else {
+    strides[0] = 1;
+    strides[1] = dims[0];
+  }
+
+  /*
+    These are the offsets of the linear addresses for each neighbor
+    of the central cell, regardless of the memory order,
+
+    ---------------------------------------
+    | -s[0] - s[1] | -s[0] | -s[0] + s[1] |
+    |       - s[1] |   0   |         s[1] |
+    |  s[0] - s[1] |  s[0] |  s[0] + s[1] |
+    ---------------------------------------
+
+    assuming that s[0] is the stride between rows and s[1] is the
+    stride between columns.
+   */
+  ptrdiff_t offsets[8] = {strides[1],  strides[0] + strides[1],
+                          strides[0],  strides[0] - strides[1],
+                          -strides[1], -strides[0] - strides[1],
+                          -strides[0], -strides[0] + strides[1]};
+
+  ptrdiff_t edge_count = 0;
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t u = node[j * dims[0] + i];
+
+      uint8_t flowdir = direction[u];
+
+      if (flowdir != 0) {
+        uint8_t v = flowdir;
+        uint8_t r = 0;
+        while (v >>= 1) {
+          r++;
+        }
+
+        source[edge_count] = (IDX_T)u;
+        target[edge_count++] = (IDX_T)(u + offsets[r]);
+      }
+    }
+  }
+  return edge_count;
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(flow_accumulation_edgelist)(float *acc, IDX_T *source,
+                                          IDX_T *target, float *fraction,
+                                          float *weights, ptrdiff_t edge_count,
+                                          ptrdiff_t dims[2]) {
+  // Initialize with the weights
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      acc[j * dims[0] + i] =
+          (weights == NULL) ? 1.0f : weights[j * dims[0] + i];
+    }
+  }
+
+  for (ptrdiff_t edge = 0; edge < edge_count; edge++) {
+    ptrdiff_t src = source[edge];
+    ptrdiff_t tgt = target[edge];
+
+    acc[tgt] += fraction[edge] * acc[src];
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(drainagebasins)(IDX_T *basins, IDX_T *source, IDX_T *target,
+                              ptrdiff_t edge_count, ptrdiff_t dims[2]) {
+  // Initialize the basins array
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      basins[j * dims[0] + i] = 0;
+    }
+  }
+
+  IDX_T basin_count = 1;  // Start the basin labels at one.
+
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t src = source[e];
+    ptrdiff_t tgt = target[e];
+
+    if (basins[tgt] == 0) {
+      // If tgt does not yet belong to a drainage basin, create a new one
+      basins[tgt] = basin_count++;
+    }
+    basins[src] = basins[tgt];
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(streamquad_trapz_f32)(float *integral, float *integrand,
+                                    IDX_T *source, IDX_T *target, float *weight,
+                                    ptrdiff_t edge_count) {
+  // Iterate over the edges in reverse topological order (upstream)
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    integral[u] = integral[v] + weight[e] * (integrand[u] + integrand[v]) / 2;
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(streamquad_trapz_f64)(double *integral, double *integrand,
+                                    IDX_T *source, IDX_T *target, float *weight,
+                                    ptrdiff_t edge_count) {
+  // Iterate over the edges in reverse topological order (upstream)
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    integral[u] = integral[v] + weight[e] * (integrand[u] + integrand[v]) / 2;
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_up_u32_or_and)(uint32_t *output, uint32_t *input,
+                                      IDX_T *source, IDX_T *target,
+                                      ptrdiff_t edge_count) {
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[u] = output[u] | (output[v] & input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_u32_or_and)(uint32_t *output, uint32_t *input,
+                                        IDX_T *source, IDX_T *target,
+                                        ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[v] = output[v] | (output[u] & input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_up_u8_or_and)(uint8_t *output, uint8_t *input,
+                                     IDX_T *source, IDX_T *target,
+                                     ptrdiff_t edge_count) {
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[u] = output[u] | (output[v] & input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_u8_or_and)(uint8_t *output, uint8_t *input,
+                                       IDX_T *source, IDX_T *target,
+                                       ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[v] = output[v] | (output[u] & input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_f32_max_add)(float *output, float *input,
+                                         IDX_T *source, IDX_T *target,
+                                         ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[v] = fmaxf(output[v], output[u] + input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_up_f32_max_add)(float *output, float *input,
+                                       IDX_T *source, IDX_T *target,
+                                       ptrdiff_t edge_count) {
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[u] = fmaxf(output[u], output[v] + input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_f32_max_mul)(float *output, float *input,
+                                         IDX_T *source, IDX_T *target,
+                                         ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[v] = fmaxf(output[v], output[u] * input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_f32_max_mul_arg)(float *output, int64_t *idx,
+                                             float *input, IDX_T *source,
+                                             IDX_T *target,
+                                             ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    float q = output[u] * input[e];
+    if (output[v] < q) {
+      output[v] = q;
+      idx[v] = idx[u];
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_up_f32_max_mul)(float *output, float *input,
+                                       IDX_T *source, IDX_T *target,
+                                       ptrdiff_t edge_count) {
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[u] = fmaxf(output[u], output[v] * input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_up_f32_max_mul_arg)(float *output, int64_t *idx,
+                                           float *input, IDX_T *source,
+                                           IDX_T *target,
+                                           ptrdiff_t edge_count) {
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    float q = output[v] * input[e];
+    if (output[u] < q) {
+      output[u] = q;
+      idx[u] = idx[v];
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_f32_min_add)(float *output, float *input,
+                                         IDX_T *source, IDX_T *target,
+                                         ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[v] = fminf(output[v], output[u] + input[e]);
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_f32_add_mul)(float *output, float *input,
+                                         IDX_T *source, IDX_T *target,
+                                         ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[v] = output[v] + output[u] * input[e];
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_f64_add_mul)(double *output, double *input,
+                                         IDX_T *source, IDX_T *target,
+                                         ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    output[v] = output[v] + output[u] * input[e];
+  }
+}
+
+TOPOTOOLBOX_API
+void IDX_NAME(traverse_down_f32_strahler)(float *output, float *input,
+                                          IDX_T *source, IDX_T *target,
+                                          ptrdiff_t edge_count) {
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    if (output[u] < output[v]) {
+    } else if (output[u] == output[v]) {
+      output[v] = output[v] + 1;
+    } else {
+      output[v] = output[u];
+    }
+  }
+}
+
+#undef IDX_NAME
+#undef IDX_T
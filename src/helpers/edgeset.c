@@ -1,5 +1,11 @@
 #define TOPOTOOLBOX_BUILD
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parallel.h"
 #include "topotoolbox.h"
 
 /////////////////////////////////////////
@@ -27,11 +33,47 @@
 // the bitmap. The edges for each pixel are stored in the order of the
 // edge numbering (counterclockwise from right).
 
-// Count the number of bits set in a byte.
+// Count the number of bits set in a byte. The POPCNT instruction is
+// used if the compiler targets it (e.g. -mpopcnt or -march=native
+// with GCC or Clang), otherwise the bits are summed in parallel
+// within the byte.
 static int bitcount(uint8_t v) {
-  int c;
-  for (c = 0; v; c++) v &= v - 1;
-  return c;
+#if defined(__POPCNT__) && (defined(__GNUC__) || defined(__clang__))
+  return __builtin_popcount(v);
+#else
+  v = v - ((v >> 1) & 0x55);
+  v = (v & 0x33) + ((v >> 2) & 0x33);
+  return (v + (v >> 4)) & 0x0F;
+#endif
+}
+
+// Count the number of bits set in eight consecutive bytes
+static int bitcount64(uint64_t v) {
+#if defined(__POPCNT__) && (defined(__GNUC__) || defined(__clang__))
+  return __builtin_popcountll(v);
+#else
+  v = v - ((v >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Count the bits set in bitmap[begin] to bitmap[end - 1], eight
+// pixels at a time
+static ptrdiff_t bitcount_range(uint8_t *bitmap, ptrdiff_t begin,
+                                ptrdiff_t end) {
+  ptrdiff_t n = 0;
+  ptrdiff_t k = begin;
+  for (; k + 8 <= end; k += 8) {
+    uint64_t word;
+    memcpy(&word, bitmap + k, sizeof word);
+    n += bitcount64(word);
+  }
+  for (; k < end; k++) {
+    n += bitcount(bitmap[k]);
+  }
+  return n;
 }
 
 // Count all the edges in the bitmap. This is used to preallocate
@@ -116,3 +158,183 @@ ptrdiff_t edgeset_merge(float *w0, ptrdiff_t *s0, uint8_t *b1, float *w1,
   }
   return n;
 }
+
+/////////////////////////////////////////
+// Parallel scans
+//
+// The parallel versions split the bitmap into blocks of
+// EDGESET_BLOCK_SIZE pixels in memory order. A first parallel pass
+// counts the edges of every block, an exclusive scan of the block
+// totals gives the offset of the first edge of every block, and a
+// second parallel pass computes the per-pixel offsets and emits the
+// weights of each block starting from its offset. The results are
+// identical to those of the serial functions.
+
+#define EDGESET_BLOCK_SIZE 65536
+
+TOPOTOOLBOX_API
+ptrdiff_t edgeset_count_parallel(uint8_t *bitmap, ptrdiff_t dims[2],
+                                 int num_threads) {
+  ptrdiff_t pixel_count = dims[0] * dims[1];
+  ptrdiff_t block_count =
+      (pixel_count + EDGESET_BLOCK_SIZE - 1) / EDGESET_BLOCK_SIZE;
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t n = 0;
+  ptrdiff_t b;
+#pragma omp parallel for schedule(static) reduction(+ : n) \
+    num_threads(num_threads)
+  for (b = 0; b < block_count; b++) {
+    ptrdiff_t begin = b * EDGESET_BLOCK_SIZE;
+    ptrdiff_t end = begin + EDGESET_BLOCK_SIZE;
+    if (end > pixel_count) {
+      end = pixel_count;
+    }
+    n += bitcount_range(bitmap, begin, end);
+  }
+  return n;
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t edgeset_scan_parallel(ptrdiff_t *scan, uint8_t *bitmap,
+                                ptrdiff_t dims[2], int num_threads) {
+  ptrdiff_t pixel_count = dims[0] * dims[1];
+  ptrdiff_t block_count =
+      (pixel_count + EDGESET_BLOCK_SIZE - 1) / EDGESET_BLOCK_SIZE;
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t *offsets = (ptrdiff_t *)malloc((block_count + 1) *
+                                           sizeof(ptrdiff_t));
+  if (offsets == NULL) {
+    return -1;
+  }
+
+  ptrdiff_t b;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (b = 0; b < block_count; b++) {
+    ptrdiff_t begin = b * EDGESET_BLOCK_SIZE;
+    ptrdiff_t end = begin + EDGESET_BLOCK_SIZE;
+    if (end > pixel_count) {
+      end = pixel_count;
+    }
+    offsets[b] = bitcount_range(bitmap, begin, end);
+  }
+
+  ptrdiff_t n = exclusive_scan(offsets, block_count);
+
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (b = 0; b < block_count; b++) {
+    ptrdiff_t begin = b * EDGESET_BLOCK_SIZE;
+    ptrdiff_t end = begin + EDGESET_BLOCK_SIZE;
+    if (end > pixel_count) {
+      end = pixel_count;
+    }
+    ptrdiff_t offset = offsets[b];
+    for (ptrdiff_t k = begin; k < end; k++) {
+      scan[k] = offset;
+      offset += bitcount(bitmap[k]);
+    }
+  }
+
+  free(offsets);
+  return n;
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t edgeset_count_merged_parallel(uint8_t *b1, uint8_t *b2,
+                                        ptrdiff_t dims[2], int num_threads) {
+  ptrdiff_t pixel_count = dims[0] * dims[1];
+  ptrdiff_t block_count =
+      (pixel_count + EDGESET_BLOCK_SIZE - 1) / EDGESET_BLOCK_SIZE;
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t n = 0;
+  ptrdiff_t b;
+#pragma omp parallel for schedule(static) reduction(+ : n) \
+    num_threads(num_threads)
+  for (b = 0; b < block_count; b++) {
+    ptrdiff_t begin = b * EDGESET_BLOCK_SIZE;
+    ptrdiff_t end = begin + EDGESET_BLOCK_SIZE;
+    if (end > pixel_count) {
+      end = pixel_count;
+    }
+    ptrdiff_t k = begin;
+    for (; k + 8 <= end; k += 8) {
+      uint64_t w1, w2;
+      memcpy(&w1, b1 + k, sizeof w1);
+      memcpy(&w2, b2 + k, sizeof w2);
+      n += bitcount64(w1 | w2);
+    }
+    for (; k < end; k++) {
+      n += bitcount(b1[k] | b2[k]);
+    }
+  }
+  return n;
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t edgeset_merge_parallel(float *w0, ptrdiff_t *s0, uint8_t *b1,
+                                 float *w1, uint8_t *b2, float *w2,
+                                 ptrdiff_t dims[2], int num_threads) {
+  ptrdiff_t pixel_count = dims[0] * dims[1];
+  ptrdiff_t block_count =
+      (pixel_count + EDGESET_BLOCK_SIZE - 1) / EDGESET_BLOCK_SIZE;
+  num_threads = resolve_threads(num_threads);
+
+  // Offsets of the first edge of every block in w0, w1 and w2
+  ptrdiff_t *offsets = (ptrdiff_t *)malloc(3 * (block_count + 1) *
+                                           sizeof(ptrdiff_t));
+  if (offsets == NULL) {
+    return -1;
+  }
+  ptrdiff_t *offsets1 = offsets + block_count + 1;
+  ptrdiff_t *offsets2 = offsets1 + block_count + 1;
+
+  ptrdiff_t b;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (b = 0; b < block_count; b++) {
+    ptrdiff_t begin = b * EDGESET_BLOCK_SIZE;
+    ptrdiff_t end = begin + EDGESET_BLOCK_SIZE;
+    if (end > pixel_count) {
+      end = pixel_count;
+    }
+    ptrdiff_t merged = 0;
+    for (ptrdiff_t k = begin; k < end; k++) {
+      merged += bitcount(b1[k] | b2[k]);
+    }
+    offsets[b] = merged;
+    offsets1[b] = bitcount_range(b1, begin, end);
+    offsets2[b] = bitcount_range(b2, begin, end);
+  }
+
+  ptrdiff_t n = exclusive_scan(offsets, block_count);
+  exclusive_scan(offsets1, block_count);
+  exclusive_scan(offsets2, block_count);
+
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (b = 0; b < block_count; b++) {
+    ptrdiff_t begin = b * EDGESET_BLOCK_SIZE;
+    ptrdiff_t end = begin + EDGESET_BLOCK_SIZE;
+    if (end > pixel_count) {
+      end = pixel_count;
+    }
+    ptrdiff_t n0 = offsets[b];
+    ptrdiff_t n1 = offsets1[b];
+    ptrdiff_t n2 = offsets2[b];
+    for (ptrdiff_t p = begin; p < end; p++) {
+      s0[p] = n0;
+      for (ptrdiff_t k = 0; k < 8; k++) {
+        if (b1[p] & (1 << k)) {
+          w0[n0++] = w1[n1++];
+          if (b2[p] & (1 << k)) n2++;
+        } else if (b2[p] & (1 << k)) {
+          w0[n0++] = w2[n2++];
+          b1[p] |= (1 << k);
+        }
+      }
+    }
+  }
+
+  free(offsets);
+  return n;
+}
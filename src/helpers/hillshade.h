@@ -0,0 +1,18 @@
+#ifndef HILLSHADE_H
+#define HILLSHADE_H
+
+#include <math.h>
+
+// Compute hillshade value from gradient and illumination vector
+static inline float compute_hillshade(float dx, float dy, float sx, float sy,
+                                      float sz) {
+  float inorm = 1.0f / sqrtf(dx * dx + dy * dy + 1.0f);
+
+  float nx = -dx * inorm;
+  float ny = -dy * inorm;
+  float nz = inorm;
+
+  return nx * sx + ny * sy + nz * sz;
+}
+
+#endif  // HILLSHADE_H
@@ -0,0 +1,8 @@
+#ifndef MATH_CONSTANTS_H
+#define MATH_CONSTANTS_H
+
+// Length of the diagonal of a unit cell, the distance between
+// diagonal neighbors on a grid with unit spacing
+#define SQRT2f 1.41421356237309504880f
+
+#endif  // MATH_CONSTANTS_H
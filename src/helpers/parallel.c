@@ -0,0 +1,28 @@
+#include "parallel.h"
+
+#include <stddef.h>
+
+#if TOPOTOOLBOX_OPENMP_VERSION > 0
+#include <omp.h>
+#endif
+
+int resolve_threads(int num_threads) {
+#if TOPOTOOLBOX_OPENMP_VERSION > 0
+  if (num_threads <= 0) {
+    num_threads = omp_get_max_threads();
+  }
+#else
+  num_threads = 1;
+#endif
+  return num_threads;
+}
+
+ptrdiff_t exclusive_scan(ptrdiff_t *offsets, ptrdiff_t count) {
+  ptrdiff_t n = 0;
+  for (ptrdiff_t b = 0; b < count; b++) {
+    ptrdiff_t total = offsets[b];
+    offsets[b] = n;
+    n += total;
+  }
+  return n;
+}
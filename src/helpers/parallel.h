@@ -0,0 +1,23 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+// Shared helpers of the *_parallel functions
+
+// Return the number of threads to use for a num_threads argument:
+// num_threads itself if it is positive and the default number of
+// OpenMP threads otherwise. Always 1 without OpenMP.
+int resolve_threads(int num_threads);
+
+// Replace the counts in offsets[0] to offsets[count - 1] with their
+// exclusive prefix sum and return the sum of all counts.
+//
+// This is the middle step of the count/scan/emit scheme used to
+// compact or generate arrays in parallel: the output elements of
+// fixed-size blocks are counted in parallel, the scan yields the
+// position of the first output element of every block, and the
+// blocks are then written in parallel.
+ptrdiff_t exclusive_scan(ptrdiff_t *offsets, ptrdiff_t count);
+
+#endif  // PARALLEL_H
@@ -0,0 +1,27 @@
+#include "pixel_queue.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+int32_t enqueue(PixelQueue *q, ptrdiff_t v) {
+  int32_t res = 0;
+  ptrdiff_t next = (q->tail + 1) % q->length;
+  if (next != q->head) {
+    // Queue is not full
+    q->buffer[q->tail] = v;
+    q->tail = next;
+    res = 1;
+  }
+  return res;
+}
+
+ptrdiff_t *dequeue(PixelQueue *q) {
+  ptrdiff_t *p = 0;
+  if (q->head == q->tail) {
+    // Queue is empty
+    return p;
+  }
+  p = &q->buffer[q->head];
+  q->head = (q->head + 1) % q->length;
+  return p;
+}
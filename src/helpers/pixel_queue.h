@@ -0,0 +1,27 @@
+#ifndef PIXEL_QUEUE_H
+#define PIXEL_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// FIFO circular queue of pixel indices used by the hybrid
+// reconstruction algorithms.
+//
+// The queue can hold a maximum of length - 1 elements.
+typedef struct {
+  ptrdiff_t *buffer;
+  ptrdiff_t length;
+  ptrdiff_t head;
+  ptrdiff_t tail;
+} PixelQueue;
+
+// Add v to the queue.
+// Returns 1 if successful, 0 if the queue is full.
+int32_t enqueue(PixelQueue *q, ptrdiff_t v);
+
+// Remove and return the first element of the queue.
+//
+// Returns a pointer to that element or NULL if the queue is empty.
+ptrdiff_t *dequeue(PixelQueue *q);
+
+#endif  // PIXEL_QUEUE_H
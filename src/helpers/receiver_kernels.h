@@ -0,0 +1,145 @@
+/*
+  Index-generic single flow direction kernels
+
+  This file is a template that is included once for every supported
+  node index type by receivers.c. It deliberately has no include
+  guard. Before including it, define
+
+  RCV_T        the element type of the node indices, e.g. uint32_t
+  RCV_NAME     a function-like macro mapping the base name of each
+               kernel to the name of the generated function
+
+  The following functions are generated:
+
+  flow_routing_d8_receivers
+  flow_accumulation_receivers
+  drainagebasins_receivers
+  propagatevaluesupstream_f32_receivers
+  traverse_up_f32_add_receivers
+  traverse_down_f32_max_add_receivers
+
+  A single flow direction network is represented by two arrays of
+  node_count elements: `receiver`, where receiver[u] is the pixel
+  that u drains to, or u itself if u is a sink, and `node`, the
+  pixels in topological order as produced by flow_routing_d8_carve.
+  Every edge of the network is identified with its source pixel, so
+  that edge attributes are stored in node attribute lists.
+
+  All macros are undefined again at the end of this file.
+ */
+
+TOPOTOOLBOX_API
+void RCV_NAME(flow_routing_d8_receivers)(RCV_T *receiver, uint8_t *direction,
+                                         ptrdiff_t dims[2],
+                                         unsigned int order) {
+  ptrdiff_t strides[2] = {0};
+  if (order & 1) {
+    // row-major
+    strides[0] = dims[0];
+    strides[1] = 1;
+  } else {
+    strides[0] = 1;
+    strides[1] = dims[0];
+  }
+
+  // Offsets of the downstream neighbor indexed by the bitfield-encoded
+  // flow direction, so that the inner loop needs no bit scan. See
+  // flow_routing_d8_edgelist in helpers/edge_kernels.h for the layout.
+  ptrdiff_t offsets[256] = {0};
+  offsets[1] = strides[1];
+  offsets[2] = strides[0] + strides[1];
+  offsets[4] = strides[0];
+  offsets[8] = strides[0] - strides[1];
+  offsets[16] = -strides[1];
+  offsets[32] = -strides[0] - strides[1];
+  offsets[64] = -strides[0];
+  offsets[128] = -strides[0] + strides[1];
+
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t u = j * dims[0] + i;
+      receiver[u] = (RCV_T)(u + offsets[direction[u]]);
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void RCV_NAME(flow_accumulation_receivers)(float *acc, RCV_T *receiver,
+                                           RCV_T *node, float *weights,
+                                           ptrdiff_t node_count) {
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    acc[u] = (weights == NULL) ? 1.0f : weights[u];
+  }
+
+  for (ptrdiff_t k = 0; k < node_count; k++) {
+    ptrdiff_t u = node[k];
+    ptrdiff_t v = receiver[u];
+    if (u != v) {
+      acc[v] += acc[u];
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void RCV_NAME(drainagebasins_receivers)(RCV_T *basins, RCV_T *receiver,
+                                        RCV_T *node, ptrdiff_t node_count) {
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    basins[u] = 0;
+  }
+
+  // Labels are assigned in the same order as drainagebasins assigns
+  // them on the corresponding edge list. Sinks without any upstream
+  // pixels are left unlabeled.
+  RCV_T basin_count = 1;
+  for (ptrdiff_t k = node_count - 1; k >= 0; k--) {
+    ptrdiff_t u = node[k];
+    ptrdiff_t v = receiver[u];
+    if (u != v) {
+      if (basins[v] == 0) {
+        basins[v] = basin_count++;
+      }
+      basins[u] = basins[v];
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void RCV_NAME(propagatevaluesupstream_f32_receivers)(float *data,
+                                                     RCV_T *receiver,
+                                                     RCV_T *node,
+                                                     ptrdiff_t node_count) {
+  for (ptrdiff_t k = node_count - 1; k >= 0; k--) {
+    ptrdiff_t u = node[k];
+    data[u] = data[receiver[u]];
+  }
+}
+
+TOPOTOOLBOX_API
+void RCV_NAME(traverse_up_f32_add_receivers)(float *output, float *input,
+                                             RCV_T *receiver, RCV_T *node,
+                                             ptrdiff_t node_count) {
+  for (ptrdiff_t k = node_count - 1; k >= 0; k--) {
+    ptrdiff_t u = node[k];
+    ptrdiff_t v = receiver[u];
+    if (u != v) {
+      output[u] = output[v] + input[u];
+    }
+  }
+}
+
+TOPOTOOLBOX_API
+void RCV_NAME(traverse_down_f32_max_add_receivers)(float *output, float *input,
+                                                   RCV_T *receiver,
+                                                   RCV_T *node,
+                                                   ptrdiff_t node_count) {
+  for (ptrdiff_t k = 0; k < node_count; k++) {
+    ptrdiff_t u = node[k];
+    ptrdiff_t v = receiver[u];
+    if (u != v) {
+      output[v] = fmaxf(output[v], output[u] + input[u]);
+    }
+  }
+}
+
+#undef RCV_T
+#undef RCV_NAME
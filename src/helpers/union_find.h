@@ -0,0 +1,22 @@
+#ifndef UNION_FIND_H
+#define UNION_FIND_H
+
+#include <stddef.h>
+
+// Disjoint sets stored as an array of parent pointers, where the root
+// of every set points to itself.
+
+// Return the root of the set containing u.
+//
+// Every other element on the path is pointed at its grandparent
+// (/path halving/), which roughly halves the length of the path for
+// the next search.
+static inline ptrdiff_t union_find_root(ptrdiff_t *parent, ptrdiff_t u) {
+  while (parent[u] != u) {
+    parent[u] = parent[parent[u]];
+    u = parent[u];
+  }
+  return u;
+}
+
+#endif  // UNION_FIND_H
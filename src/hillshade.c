@@ -2,23 +2,12 @@
 
 #include <math.h>
 
+#include "helpers/hillshade.h"
 #include "topotoolbox.h"
 
 #define PI 3.14159265358979323846f
 #define PI_2 1.57079632679489661923f
 
-// Compute hillshade value from gradient and illumination vector
-static inline float compute_hillshade(float dx, float dy, float sx, float sy,
-                                      float sz) {
-  float inorm = 1.0f / sqrtf(dx * dx + dy * dy + 1.0f);
-
-  float nx = -dx * inorm;
-  float ny = -dy * inorm;
-  float nz = inorm;
-
-  return nx * sx + ny * sy + nz * sz;
-}
-
 TOPOTOOLBOX_API
 void gradient_secondorder(float *restrict p0, float *restrict p1, float *dem,
                           float cellsize, ptrdiff_t dims[2]) {
@@ -93,121 +82,3 @@ void hillshade(float *output, float *dx, float *dy, float *dem, float azimuth,
     }
   }
 }
-
-////////////////////
-// A lower memory version of hillshade fuses the loops together so
-// intermediate arrays can be avoided
-
-TOPOTOOLBOX_API
-void hillshade_fused(float *output, float *dem, float azimuth, float altitude,
-                     float cellsize, ptrdiff_t dims[2]) {
-  float sx = sinf(PI_2 - altitude) * cosf(azimuth);
-  float sy = sinf(PI_2 - altitude) * sinf(azimuth);
-  float sz = cosf(PI_2 - altitude);
-
-  ptrdiff_t m = dims[0];
-  ptrdiff_t n = dims[1];
-
-  ptrdiff_t i, j;
-
-  j = 0;
-  {
-    i = 0;
-    float dx =
-        (-dem[j * m + i + 2] + 4 * dem[j * m + i + 1] - 3 * dem[j * m + i]) /
-        (2 * cellsize);
-    float dy = (-dem[(j + 2) * m + i] + 4 * dem[(j + 1) * m + i] -
-                3 * dem[(j + 0) * m + i]) /
-               (2 * cellsize);
-    output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-  }
-  for (i = 1; i < (m - 1); i++) {
-    float dx = isnan(dem[j * m + i])
-                   ? NAN
-                   : (dem[j * m + i + 1] - dem[j * m + i - 1]) / (2 * cellsize);
-    float dy = (-dem[(j + 2) * m + i] + 4 * dem[(j + 1) * m + i] -
-                3 * dem[(j + 0) * m + i]) /
-               (2 * cellsize);
-
-    output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-  }
-  {
-    i = m - 1;
-    float dx =
-        (dem[j * m + i - 2] - 4 * dem[j * m + i - 1] + 3 * dem[j * m + i]) /
-        (2 * cellsize);
-    float dy = (-dem[(j + 2) * m + i] + 4 * dem[(j + 1) * m + i] -
-                3 * dem[(j + 0) * m + i]) /
-               (2 * cellsize);
-    output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-  }
-
-  for (j = 1; j < (n - 1); j++) {
-    {
-      i = 0;
-      float dx =
-          (-dem[j * m + i + 2] + 4 * dem[j * m + i + 1] - 3 * dem[j * m + i]) /
-          (2 * cellsize);
-      float dy =
-          isnan(dem[j * m + i])
-              ? NAN
-              : (dem[(j + 1) * m + i] - dem[(j - 1) * m + i]) / (2 * cellsize);
-      output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-    }
-    for (i = 1; i < (m - 1); i++) {
-      float dx =
-          isnan(dem[j * m + i])
-              ? NAN
-              : (dem[j * m + i + 1] - dem[j * m + i - 1]) / (2 * cellsize);
-      float dy =
-          isnan(dem[j * m + i])
-              ? NAN
-              : (dem[(j + 1) * m + i] - dem[(j - 1) * m + i]) / (2 * cellsize);
-
-      output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-    }
-    {
-      i = m - 1;
-      float dx =
-          (dem[j * m + i - 2] - 4 * dem[j * m + i - 1] + 3 * dem[j * m + i]) /
-          (2 * cellsize);
-      float dy =
-          isnan(dem[j * m + i])
-              ? NAN
-              : (dem[(j + 1) * m + i] - dem[(j - 1) * m + i]) / (2 * cellsize);
-      output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-    }
-  }
-
-  j = n - 1;
-  {
-    i = 0;
-    float dx =
-        (-dem[j * m + i + 2] + 4 * dem[j * m + i + 1] - 3 * dem[j * m + i]) /
-        (2 * cellsize);
-    float dy =
-        (dem[(j - 2) * m + i] - 4 * dem[(j - 1) * m + i] + 3 * dem[j * m + i]) /
-        (2 * cellsize);
-    output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-  }
-  for (i = 1; i < (m - 1); i++) {
-    float dx = isnan(dem[j * m + i])
-                   ? NAN
-                   : (dem[j * m + i + 1] - dem[j * m + i - 1]) / (2 * cellsize);
-    float dy =
-        (dem[(j - 2) * m + i] - 4 * dem[(j - 1) * m + i] + 3 * dem[j * m + i]) /
-        (2 * cellsize);
-
-    output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-  }
-  {
-    i = m - 1;
-    float dx =
-        (dem[j * m + i - 2] - 4 * dem[j * m + i - 1] + 3 * dem[j * m + i]) /
-        (2 * cellsize);
-    float dy =
-        (dem[(j - 2) * m + i] - 4 * dem[(j - 1) * m + i] + 3 * dem[j * m + i]) /
-        (2 * cellsize);
-    output[j * m + i] = compute_hillshade(dx, dy, sx, sy, sz);
-  }
-}
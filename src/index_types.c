@@ -0,0 +1,27 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "topotoolbox.h"
+
+/*
+  Edge list routines
+
+  The routines are generated from the kernels in
+  helpers/edge_kernels.h, once with ptrdiff_t node indices and once
+  with 32-bit unsigned indices. The 32-bit variants halve the size of
+  the source, target, node and basin arrays and therefore the memory
+  traffic of the traversals, and can be used for any grid with fewer
+  than 2^32 pixels. Other index types can be added by defining the
+  macros described there and including the file once more.
+ */
+
+#define IDX_T ptrdiff_t
+#define IDX_NAME(name) name
+#include "helpers/edge_kernels.h"
+
+#define IDX_T uint32_t
+#define IDX_NAME(name) name##_idx32
+#include "helpers/edge_kernels.h"
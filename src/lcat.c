@@ -1,9 +1,8 @@
 #define TOPOTOOLBOX_BUILD
 
+#include "helpers/math_constants.h"
 #include "topotoolbox.h"
 
-#define SQRT2 1.41421356237309504880f
-
 void resolve_flats_lcat(uint8_t *direction, uint8_t *resolved, float *aux,
                         float *dem, ptrdiff_t dims[2], int order) {
   // Least cost auxiliary topography carving. The hard part is
@@ -13,7 +12,7 @@ void resolve_flats_lcat(uint8_t *direction, uint8_t *resolved, float *aux,
   ptrdiff_t e[2][8] = {{0, -1, -1, -1, 0, 1, 1, 1},
                        {1, 1, 0, -1, -1, -1, 0, 1}};
 
-  float chamfer[8] = {1.0f, SQRT2, 1.0f, SQRT2, 1.0f, SQRT2, 1.0f, SQRT2};
+  float chamfer[8] = {1.0f, SQRT2f, 1.0f, SQRT2f, 1.0f, SQRT2f, 1.0f, SQRT2f};
 
   for (ptrdiff_t j = 0; j < dims[1]; j++) {
     for (ptrdiff_t i = 0; i < dims[0]; i++) {
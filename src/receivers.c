@@ -0,0 +1,30 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "topotoolbox.h"
+
+/*
+  Single flow direction networks stored as receiver arrays.
+
+  D8 flow routing yields exactly one receiver per pixel, so the
+  source, target and fraction arrays of the edge list are redundant:
+  the receiver array together with the topologically sorted node
+  array is enough to traverse the network in either direction.
+  Unlike flow_accumulation, the kernels neither decode flow
+  directions nor compute Cartesian indices in their inner loops.
+
+  The kernels are generated from helpers/receiver_kernels.h, once
+  with ptrdiff_t indices and once with 32-bit indices, which halves
+  the size of the receiver and node arrays.
+ */
+
+#define RCV_T ptrdiff_t
+#define RCV_NAME(name) name
+#include "helpers/receiver_kernels.h"
+
+#define RCV_T uint32_t
+#define RCV_NAME(name) name##_idx32
+#include "helpers/receiver_kernels.h"
@@ -5,44 +5,99 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+#include "helpers/pixel_queue.h"
 #include "topotoolbox.h"
 
-// FIFO circular queue implementation
-//
-// The queue can hold a maximum of length - 1 elements.
-typedef struct {
-  ptrdiff_t *buffer;
-  ptrdiff_t length;
-  ptrdiff_t head;
-  ptrdiff_t tail;
-} PixelQueue;
-
-// Add v to the queue.
-// Returns 1 if successful, 0 if the queue is full.
-int32_t enqueue(PixelQueue *q, ptrdiff_t v) {
-  int32_t res = 0;
-  ptrdiff_t next = (q->tail + 1) % q->length;
-  if (next != q->head) {
-    // Queue is not full
-    q->buffer[q->tail] = v;
-    q->tail = next;
-    res = 1;
+/*
+  Maximum of the three neighbors of pixels i - 1, i and i + 1 in the
+  column `col`, which must be a column already visited by the current
+  scan. The result for pixel i is stored in colmax[i - first] for all
+  `first` <= i < `last`, where 1 <= first and last <= dims[0] - 1, so
+  that no bounds checks are necessary.
+
+  NaNs are ignored, as they are by fmaxf. If all three neighbors are
+  NaN, the result is NaN.
+ */
+static void column_max3(float *colmax, float *col, ptrdiff_t first,
+                        ptrdiff_t last) {
+  ptrdiff_t i = first;
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  for (; i + 4 <= last; i += 4) {
+    __m128 up = _mm_loadu_ps(col + i - 1);
+    __m128 center = _mm_loadu_ps(col + i);
+    __m128 down = _mm_loadu_ps(col + i + 1);
+
+    // _mm_max_ps returns its second argument if either argument is a
+    // NaN. Select the first argument instead whenever the second is
+    // NaN to reproduce the behavior of fmaxf.
+    __m128 m = _mm_max_ps(center, up);
+    __m128 nan = _mm_cmpunord_ps(up, up);
+    m = _mm_or_ps(_mm_and_ps(nan, center), _mm_andnot_ps(nan, m));
+
+    __m128 m2 = _mm_max_ps(m, down);
+    nan = _mm_cmpunord_ps(down, down);
+    m2 = _mm_or_ps(_mm_and_ps(nan, m), _mm_andnot_ps(nan, m2));
+
+    _mm_storeu_ps(colmax + i - first, m2);
+  }
+#endif
+  for (; i < last; i++) {
+    colmax[i - first] = fmaxf(fmaxf(col[i - 1], col[i]), col[i + 1]);
   }
-  return res;
 }
 
-// Remove and return the first element of the queue.
-//
-// Returns a pointer to that element or NULL if the queue is empty.
-ptrdiff_t *dequeue(PixelQueue *q) {
-  ptrdiff_t *p = 0;
-  if (q->head == q->tail) {
-    // Queue is empty
-    return p;
+// Number of pixels whose column maxima are computed at once by the
+// interior paths of the scans.
+#define SCAN_BLOCK 64
+
+/*
+  Update a single pixel with bounds checks on all of its neighbors.
+
+  This is used for pixels on the border of the image. The neighbors
+  are given by i_offset and j_offset.
+
+  Returns 1 if the pixel was modified, 0 otherwise.
+ */
+static ptrdiff_t scan_pixel_border(float *marker, float *mask,
+                                   ptrdiff_t dims[2], ptrdiff_t i, ptrdiff_t j,
+                                   const ptrdiff_t i_offset[4],
+                                   const ptrdiff_t j_offset[4]) {
+  ptrdiff_t p = j * dims[0] + i;
+
+  // Compute the maximum of the marker at the current pixel and all
+  // of its previously visited neighbors
+  float max_height = marker[p];
+  for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
+    ptrdiff_t neighbor_i = i + i_offset[neighbor];
+    ptrdiff_t neighbor_j = j + j_offset[neighbor];
+
+    ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+
+    // Skip pixels outside the boundary
+    if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+        neighbor_j >= dims[1]) {
+      continue;
+    }
+
+    max_height = fmaxf(max_height, marker[q]);
   }
-  p = &q->buffer[q->head];
-  q->head = (q->head + 1) % q->length;
-  return p;
+
+  // Set the marker at the current pixel to the minimum of the
+  // maximum height of the neighborhood and the mask at the current
+  // pixel.
+
+  // If mask[p] is NaN, this will set z = NaN
+  float z = max_height < mask[p] ? max_height : mask[p];
+
+  ptrdiff_t changed = z > marker[p];
+  marker[p] = z;
+  return changed;
 }
 
 /*
@@ -64,53 +119,96 @@ ptrdiff_t *dequeue(PixelQueue *q) {
 
   The new marker pixel value is constrained to lie below the
   corresponding pixel in `mask`.
+
+  The three neighbors in the previous column are already final when a
+  column is scanned, so their maximum is computed for a block of
+  pixels at once with SIMD instructions where they are
+  available. Only the dependency on the previous pixel in the same
+  column is resolved sequentially. Pixels on the border of the image
+  take a slower path with bounds checks.
  */
 ptrdiff_t forward_scan(float *marker, float *mask, ptrdiff_t dims[2]) {
   // Offsets for the four neighbors
-  ptrdiff_t j_offset[4] = {-1, -1, -1, 0};
-  ptrdiff_t i_offset[4] = {1, 0, -1, -1};
+  const ptrdiff_t j_offset[4] = {-1, -1, -1, 0};
+  const ptrdiff_t i_offset[4] = {1, 0, -1, -1};
 
   ptrdiff_t count = 0;  // Number of modified pixels
+  float colmax[SCAN_BLOCK];
 
   for (ptrdiff_t j = 0; j < dims[1]; j++) {
-    for (ptrdiff_t i = 0; i < dims[0]; i++) {
-      ptrdiff_t p = j * dims[0] + i;
-
-      // Compute the maximum of the marker at the current pixel and all
-      // of its previously visited neighbors
-      float max_height = marker[p];
-      for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
-        ptrdiff_t neighbor_i = i + i_offset[neighbor];
-        ptrdiff_t neighbor_j = j + j_offset[neighbor];
-
-        ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
-
-        // Skip pixels outside the boundary
-        if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
-            neighbor_j >= dims[1]) {
-          continue;
-        }
-
-        max_height = fmaxf(max_height, marker[q]);
+    if (j == 0 || dims[0] < 3) {
+      for (ptrdiff_t i = 0; i < dims[0]; i++) {
+        count += scan_pixel_border(marker, mask, dims, i, j, i_offset,
+                                   j_offset);
       }
+      continue;
+    }
+
+    float *col = marker + j * dims[0];
+    float *prev_col = col - dims[0];
+    float *mask_col = mask + j * dims[0];
+
+    count += scan_pixel_border(marker, mask, dims, 0, j, i_offset, j_offset);
 
-      // Set the marker at the current pixel to the minimum of the
-      // maximum height of the neighborhood and the mask at the current
-      // pixel.
+    for (ptrdiff_t block = 1; block < dims[0] - 1; block += SCAN_BLOCK) {
+      ptrdiff_t block_end =
+          block + SCAN_BLOCK < dims[0] - 1 ? block + SCAN_BLOCK : dims[0] - 1;
+      column_max3(colmax, prev_col, block, block_end);
 
-      // If mask[p] is NaN, this will set z = NaN
-      float z = max_height < mask[p] ? max_height : mask[p];
+      float above = col[block - 1];
+      for (ptrdiff_t i = block; i < block_end; i++) {
+        float max_height = fmaxf(fmaxf(col[i], colmax[i - block]), above);
 
-      if (z > marker[p]) {
-        // Increment count only if we change the current pixel
-        count++;
+        // If mask[p] is NaN, this will set z = NaN
+        float z = max_height < mask_col[i] ? max_height : mask_col[i];
+
+        if (z > col[i]) {
+          // Increment count only if we change the current pixel
+          count++;
+        }
+        col[i] = z;
+        above = z;
       }
-      marker[p] = z;
     }
+
+    count += scan_pixel_border(marker, mask, dims, dims[0] - 1, j, i_offset,
+                               j_offset);
   }
   return count;
 }
 
+/*
+  Check whether any of the neighbors of p visited by the backward scan
+  can be raised by p. If so, add p to the queue.
+
+  Returns 0 if the queue is full, 1 otherwise.
+ */
+static int32_t backward_enqueue(float *marker, PixelQueue *queue, float *mask,
+                                ptrdiff_t dims[2], ptrdiff_t i, ptrdiff_t j,
+                                const ptrdiff_t i_offset[4],
+                                const ptrdiff_t j_offset[4]) {
+  ptrdiff_t p = j * dims[0] + i;
+
+  for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
+    ptrdiff_t neighbor_i = i + i_offset[neighbor];
+    ptrdiff_t neighbor_j = j + j_offset[neighbor];
+    ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
+
+    // Skip pixels outside the boundary
+    if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
+        neighbor_j >= dims[1]) {
+      continue;
+    }
+
+    if (marker[q] < marker[p] && marker[q] < mask[q]) {
+      if (enqueue(queue, p) == 0) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
 /*
   Perform a partial reconstruction by scanning in the backward
   direction.
@@ -130,73 +228,89 @@ ptrdiff_t forward_scan(float *marker, float *mask, ptrdiff_t dims[2]) {
 
   The new marker pixel value is constrained to lie below the
   corresponding pixel in `mask`.
+
+  Like forward_scan, the maximum over the next column is computed
+  for a block of pixels at once, and the border pixels take a slower
+  path with bounds checks.
  */
 ptrdiff_t backward_scan(float *marker, PixelQueue *queue, float *mask,
                         ptrdiff_t dims[2]) {
   // Offsets for the four neighbors
-  ptrdiff_t j_offset[4] = {1, 1, 1, 0};
-  ptrdiff_t i_offset[4] = {-1, 0, 1, 1};
+  const ptrdiff_t j_offset[4] = {1, 1, 1, 0};
+  const ptrdiff_t i_offset[4] = {-1, 0, 1, 1};
 
   ptrdiff_t count = 0;  // Number of modified pixels
+  float colmax[SCAN_BLOCK];
 
   // Note that the loop decreases. p must have a signed type for this
   // to work correctly.
   for (ptrdiff_t j = dims[1] - 1; j >= 0; j--) {
-    for (ptrdiff_t i = dims[0] - 1; i >= 0; i--) {
-      ptrdiff_t p = j * dims[0] + i;
-
-      // Compute the maximum of the marker at the current pixel and all
-      // of its previously visited neighbors
-      float max_height = marker[p];
-      for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
-        ptrdiff_t neighbor_i = i + i_offset[neighbor];
-        ptrdiff_t neighbor_j = j + j_offset[neighbor];
-        ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
-
-        // Skip pixels outside the boundary
-        if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
-            neighbor_j >= dims[1]) {
-          continue;
+    if (j == dims[1] - 1 || dims[0] < 3) {
+      for (ptrdiff_t i = dims[0] - 1; i >= 0; i--) {
+        count += scan_pixel_border(marker, mask, dims, i, j, i_offset,
+                                   j_offset);
+        if (queue && !backward_enqueue(marker, queue, mask, dims, i, j,
+                                       i_offset, j_offset)) {
+          // In hybrid mode, we don't need to count the changes:
+          // Instead, we use the return value to signal if we need
+          // to repeat the scan because the queue filled up.
+          return -1;
         }
-        max_height = fmaxf(max_height, marker[q]);
       }
+      continue;
+    }
 
-      // Set the marker at the current pixel to the minimum of the
-      // maximum height of the neighborhood and the mask at the current
-      // pixel.
-      float z = max_height < mask[p] ? max_height : mask[p];
+    float *col = marker + j * dims[0];
+    float *next_col = col + dims[0];
+    float *mask_col = mask + j * dims[0];
 
-      if (z > marker[p]) {
-        // Increment count only if we change the current pixel
-        count++;
-      }
-      marker[p] = z;
-
-      if (queue) {
-        // Scan the neighborhood again to check if the pixel should be
-        // added to the queue
-        for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
-          ptrdiff_t neighbor_i = i + i_offset[neighbor];
-          ptrdiff_t neighbor_j = j + j_offset[neighbor];
-          ptrdiff_t q = neighbor_j * dims[0] + neighbor_i;
-
-          // Skip pixels outside the boundary
-          if (neighbor_i < 0 || neighbor_i >= dims[0] || neighbor_j < 0 ||
-              neighbor_j >= dims[1]) {
-            continue;
-          }
+    count += scan_pixel_border(marker, mask, dims, dims[0] - 1, j, i_offset,
+                               j_offset);
+    if (queue && !backward_enqueue(marker, queue, mask, dims, dims[0] - 1, j,
+                                   i_offset, j_offset)) {
+      return -1;
+    }
+
+    for (ptrdiff_t block_end = dims[0] - 1; block_end > 1;
+         block_end -= SCAN_BLOCK) {
+      ptrdiff_t block = block_end - SCAN_BLOCK > 1 ? block_end - SCAN_BLOCK : 1;
+      column_max3(colmax, next_col, block, block_end);
 
-          if (marker[q] < marker[p] && marker[q] < mask[q]) {
-            if (enqueue(queue, p) == 0) {
-              // In hybrid mode, we don't need to count the changes:
-              // Instead, we use the return value to signal if we need
-              // to repeat the scan because the queue filled up.
-              return -1;
-            };
+      float below = col[block_end];
+      for (ptrdiff_t i = block_end - 1; i >= block; i--) {
+        float max_height = fmaxf(fmaxf(col[i], colmax[i - block]), below);
+        float z = max_height < mask_col[i] ? max_height : mask_col[i];
+
+        if (z > col[i]) {
+          // Increment count only if we change the current pixel
+          count++;
+        }
+        col[i] = z;
+        below = z;
+
+        if (queue) {
+          // Scan the neighborhood again to check if the pixel should
+          // be added to the queue. All four neighbors are in bounds.
+          ptrdiff_t p = j * dims[0] + i;
+          ptrdiff_t neighbors[4] = {p + dims[0] - 1, p + dims[0],
+                                    p + dims[0] + 1, p + 1};
+          for (ptrdiff_t neighbor = 0; neighbor < 4; neighbor++) {
+            ptrdiff_t q = neighbors[neighbor];
+            if (marker[q] < z && marker[q] < mask[q]) {
+              if (enqueue(queue, p) == 0) {
+                return -1;
+              }
+            }
           }
         }
       }
     }
+
+    count += scan_pixel_border(marker, mask, dims, 0, j, i_offset, j_offset);
+    if (queue && !backward_enqueue(marker, queue, mask, dims, 0, j, i_offset,
+                                   j_offset)) {
+      return -1;
+    }
   }
   return count;
 }
@@ -262,20 +376,25 @@ int32_t propagate(float *marker, PixelQueue *queue, float *mask,
   direction. It repeats these scans until no change is detected or
   until a maximum iteration threshold (currently 1000) is reached.
 
+  Returns the number of forward and backward scan pairs that were
+  performed. A return value equal to the iteration threshold indicates
+  that the reconstruction may not have converged.
+
   Vincent, Luc. (1993). Morphological grayscale reconstruction in
   image analysis: applications and efficient algorithms. IEEE
   Transactions on Image Processing, Vol. 2, No. 2.
   https://doi.org/10.1109/83.217222
  */
-void reconstruct(float *marker, float *mask, ptrdiff_t dims[2]) {
+int32_t reconstruct(float *marker, float *mask, ptrdiff_t dims[2]) {
   ptrdiff_t n = dims[0] * dims[1];
 
   const int32_t max_iterations = 1000;
-  for (int32_t iteration = 0; iteration < max_iterations && n > 0;
-       iteration++) {
+  int32_t iteration = 0;
+  for (; iteration < max_iterations && n > 0; iteration++) {
     n = forward_scan(marker, mask, dims);
     n += backward_scan(marker, NULL, mask, dims);
   }
+  return iteration;
 }
 
 /*
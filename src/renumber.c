@@ -0,0 +1,236 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "topotoolbox.h"
+
+/*
+  Cache-friendly renumbering of flow networks
+
+  The traversal kernels visit the edges in topological order but
+  read and write node attributes indexed by raster position, which
+  on large grids turns most accesses into cache misses. Renumbering
+  the nodes in the order in which the edge list first uses them makes
+  these accesses nearly sequential: D8 flow paths appear as
+  contiguous runs in the node order produced by flow_routing_d8_carve,
+  so the target of an edge is usually the next node.
+
+  Pure topological numbering scatters spatially adjacent pixels,
+  however, which hurts kernels that also access grid neighbors. As a
+  compromise, the grid is divided into square blocks that are
+  visited along a Morton (Z-order) curve, and the nodes within each
+  block are numbered topologically.
+
+  Renumbering only relabels the nodes. The edges keep their order, so
+  they remain topologically sorted.
+ */
+
+// Spread the bits of x so that bit b moves to bit 2b
+static uint64_t spread_bits(uint32_t x) {
+  uint64_t v = x;
+  v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+  v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+  v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v | (v << 2)) & 0x3333333333333333ULL;
+  v = (v | (v << 1)) & 0x5555555555555555ULL;
+  return v;
+}
+
+// Interleave the bits of i and j
+static uint64_t morton_key(uint32_t i, uint32_t j) {
+  return spread_bits(i) | (spread_bits(j) << 1);
+}
+
+typedef struct {
+  uint64_t key;
+  ptrdiff_t block;
+} MortonBlock;
+
+static int mortonblock_compare(const void *x, const void *y) {
+  const MortonBlock *a = (const MortonBlock *)x;
+  const MortonBlock *b = (const MortonBlock *)y;
+  return (a->key > b->key) - (a->key < b->key);
+}
+
+// Index of the block containing pixel u
+static ptrdiff_t node_block(ptrdiff_t u, ptrdiff_t dims[2],
+                            ptrdiff_t block_dims[2], ptrdiff_t block_size) {
+  ptrdiff_t i = u % dims[0];
+  ptrdiff_t j = u / dims[0];
+  return (j / block_size) * block_dims[0] + i / block_size;
+}
+
+TOPOTOOLBOX_API
+int edgelist_renumber(ptrdiff_t *new_to_old, ptrdiff_t *old_to_new,
+                      ptrdiff_t *new_source, ptrdiff_t *new_target,
+                      ptrdiff_t *source, ptrdiff_t *target,
+                      ptrdiff_t edge_count, ptrdiff_t dims[2],
+                      ptrdiff_t block_size) {
+  ptrdiff_t node_count = dims[0] * dims[1];
+
+  if (block_size < 1) {
+    block_size = 1;
+  }
+  ptrdiff_t block_dims[2] = {(dims[0] + block_size - 1) / block_size,
+                             (dims[1] + block_size - 1) / block_size};
+  ptrdiff_t block_count = block_dims[0] * block_dims[1];
+
+  MortonBlock *blocks =
+      (MortonBlock *)malloc(block_count * sizeof(MortonBlock));
+  ptrdiff_t *block_position =
+      (ptrdiff_t *)malloc(block_count * sizeof(ptrdiff_t));
+  ptrdiff_t *block_offsets =
+      (ptrdiff_t *)malloc((block_count + 1) * sizeof(ptrdiff_t));
+  if (blocks == NULL || block_position == NULL || block_offsets == NULL) {
+    free(blocks);
+    free(block_position);
+    free(block_offsets);
+    return -1;
+  }
+
+  // Position of every block along the Morton curve
+  for (ptrdiff_t bj = 0; bj < block_dims[1]; bj++) {
+    for (ptrdiff_t bi = 0; bi < block_dims[0]; bi++) {
+      ptrdiff_t b = bj * block_dims[0] + bi;
+      blocks[b].key = morton_key((uint32_t)bi, (uint32_t)bj);
+      blocks[b].block = b;
+    }
+  }
+  qsort(blocks, block_count, sizeof(MortonBlock), mortonblock_compare);
+  for (ptrdiff_t k = 0; k < block_count; k++) {
+    block_position[blocks[k].block] = k;
+  }
+  free(blocks);
+
+  // Order of first use in the edge list. Nodes without edges follow
+  // in raster order. new_to_old temporarily holds the nodes in this
+  // order, and old_to_new marks the nodes that have been used.
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    old_to_new[u] = -1;
+  }
+  ptrdiff_t rank = 0;
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    if (old_to_new[source[e]] < 0) {
+      old_to_new[source[e]] = rank;
+      new_to_old[rank++] = source[e];
+    }
+    if (old_to_new[target[e]] < 0) {
+      old_to_new[target[e]] = rank;
+      new_to_old[rank++] = target[e];
+    }
+  }
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    if (old_to_new[u] < 0) {
+      old_to_new[u] = rank;
+      new_to_old[rank++] = u;
+    }
+  }
+
+  // Stable counting sort of the nodes, in order of first use, by the
+  // position of their block along the curve
+  for (ptrdiff_t k = 0; k <= block_count; k++) {
+    block_offsets[k] = 0;
+  }
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    ptrdiff_t k = block_position[node_block(u, dims, block_dims, block_size)];
+    block_offsets[k + 1]++;
+  }
+  for (ptrdiff_t k = 0; k < block_count; k++) {
+    block_offsets[k + 1] += block_offsets[k];
+  }
+  for (ptrdiff_t r = 0; r < node_count; r++) {
+    ptrdiff_t u = new_to_old[r];
+    ptrdiff_t k = block_position[node_block(u, dims, block_dims, block_size)];
+    old_to_new[u] = block_offsets[k]++;
+  }
+
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    new_to_old[old_to_new[u]] = u;
+  }
+
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    new_source[e] = old_to_new[source[e]];
+    new_target[e] = old_to_new[target[e]];
+  }
+
+  free(block_position);
+  free(block_offsets);
+  return 0;
+}
+
+/*
+  Gather and scatter helpers move node attributes between the grid
+  and a renumbered network:
+
+  permute_gather_<type>(output, input, new_to_old, count)
+    output[k] = input[new_to_old[k]], grid to renumbered network
+
+  permute_scatter_<type>(output, input, new_to_old, count)
+    output[new_to_old[k]] = input[k], renumbered network to grid
+ */
+
+TOPOTOOLBOX_API
+void permute_gather_f32(float *output, float *input, ptrdiff_t *new_to_old,
+                        ptrdiff_t count) {
+  for (ptrdiff_t k = 0; k < count; k++) {
+    output[k] = input[new_to_old[k]];
+  }
+}
+
+TOPOTOOLBOX_API
+void permute_scatter_f32(float *output, float *input, ptrdiff_t *new_to_old,
+                         ptrdiff_t count) {
+  for (ptrdiff_t k = 0; k < count; k++) {
+    output[new_to_old[k]] = input[k];
+  }
+}
+
+TOPOTOOLBOX_API
+void permute_gather_f64(double *output, double *input, ptrdiff_t *new_to_old,
+                        ptrdiff_t count) {
+  for (ptrdiff_t k = 0; k < count; k++) {
+    output[k] = input[new_to_old[k]];
+  }
+}
+
+TOPOTOOLBOX_API
+void permute_scatter_f64(double *output, double *input, ptrdiff_t *new_to_old,
+                         ptrdiff_t count) {
+  for (ptrdiff_t k = 0; k < count; k++) {
+    output[new_to_old[k]] = input[k];
+  }
+}
+
+TOPOTOOLBOX_API
+void permute_gather_u8(uint8_t *output, uint8_t *input, ptrdiff_t *new_to_old,
+                       ptrdiff_t count) {
+  for (ptrdiff_t k = 0; k < count; k++) {
+    output[k] = input[new_to_old[k]];
+  }
+}
+
+TOPOTOOLBOX_API
+void permute_scatter_u8(uint8_t *output, uint8_t *input,
+                        ptrdiff_t *new_to_old, ptrdiff_t count) {
+  for (ptrdiff_t k = 0; k < count; k++) {
+    output[new_to_old[k]] = input[k];
+  }
+}
+
+TOPOTOOLBOX_API
+void permute_gather_u32(uint32_t *output, uint32_t *input,
+                        ptrdiff_t *new_to_old, ptrdiff_t count) {
+  for (ptrdiff_t k = 0; k < count; k++) {
+    output[k] = input[new_to_old[k]];
+  }
+}
+
+TOPOTOOLBOX_API
+void permute_scatter_u32(uint32_t *output, uint32_t *input,
+                         ptrdiff_t *new_to_old, ptrdiff_t count) {
+  for (ptrdiff_t k = 0; k < count; k++) {
+    output[new_to_old[k]] = input[k];
+  }
+}
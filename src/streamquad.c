@@ -6,205 +6,6 @@
 
 #include "topotoolbox.h"
 
-TOPOTOOLBOX_API
-void streamquad_trapz_f32(float *integral, float *integrand, ptrdiff_t *source,
-                          ptrdiff_t *target, float *weight,
-                          ptrdiff_t edge_count) {
-  // Iterate over the edges in reverse topological order (upstream)
-  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
-    // NOTE: source and target are 1-based indices into the node attribute
-    // list, so we must subtract 1 here
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-    integral[u] = integral[v] + weight[e] * (integrand[u] + integrand[v]) / 2;
-  }
-}
-
-TOPOTOOLBOX_API
-void streamquad_trapz_f64(double *integral, double *integrand,
-                          ptrdiff_t *source, ptrdiff_t *target, float *weight,
-                          ptrdiff_t edge_count) {
-  // Iterate over the edges in reverse topological order (upstream)
-  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
-    // NOTE: source and target are 1-based indices into the node attribute
-    // list, so we must subtract 1 here
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-    integral[u] = integral[v] + weight[e] * (integrand[u] + integrand[v]) / 2;
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_up_u32_or_and(uint32_t *output, uint32_t *input,
-                            ptrdiff_t *source, ptrdiff_t *target,
-                            ptrdiff_t edge_count) {
-  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[u] = output[u] | (output[v] & input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_u32_or_and(uint32_t *output, uint32_t *input,
-                              ptrdiff_t *source, ptrdiff_t *target,
-                              ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[v] = output[v] | (output[u] & input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_up_u8_or_and(uint8_t *output, uint8_t *input, ptrdiff_t *source,
-                           ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[u] = output[u] | (output[v] & input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_u8_or_and(uint8_t *output, uint8_t *input, ptrdiff_t *source,
-                             ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[v] = output[v] | (output[u] & input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_f32_max_add(float *output, float *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[v] = fmaxf(output[v], output[u] + input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_up_f32_max_add(float *output, float *input, ptrdiff_t *source,
-                             ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[u] = fmaxf(output[u], output[v] + input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_f32_max_mul(float *output, float *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[v] = fmaxf(output[v], output[u] * input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_f32_max_mul_arg(float *output, int64_t *idx, float *input,
-                                   ptrdiff_t *source, ptrdiff_t *target,
-                                   ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    float q = output[u] * input[e];
-    if (output[v] < q) {
-      output[v] = q;
-      idx[v] = idx[u];
-    }
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_up_f32_max_mul(float *output, float *input, ptrdiff_t *source,
-                             ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[u] = fmaxf(output[u], output[v] * input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_up_f32_max_mul_arg(float *output, int64_t *idx, float *input,
-                                 ptrdiff_t *source, ptrdiff_t *target,
-                                 ptrdiff_t edge_count) {
-  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    float q = output[v] * input[e];
-    if (output[u] < q) {
-      output[u] = q;
-      idx[u] = idx[v];
-    }
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_f32_min_add(float *output, float *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[v] = fminf(output[v], output[u] + input[e]);
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_f32_add_mul(float *output, float *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[v] = output[v] + output[u] * input[e];
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_f64_add_mul(double *output, double *input, ptrdiff_t *source,
-                               ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    output[v] = output[v] + output[u] * input[e];
-  }
-}
-
-TOPOTOOLBOX_API
-void traverse_down_f32_strahler(float *output, float *input, ptrdiff_t *source,
-                                ptrdiff_t *target, ptrdiff_t edge_count) {
-  for (ptrdiff_t e = 0; e < edge_count; e++) {
-    ptrdiff_t u = source[e];
-    ptrdiff_t v = target[e];
-
-    if (output[u] < output[v]) {
-    } else if (output[u] == output[v]) {
-      output[v] = output[v] + 1;
-    } else {
-      output[v] = output[u];
-    }
-  }
-}
-
 TOPOTOOLBOX_API
 void edgelist_degree(uint8_t *indegree, uint8_t *outdegree, ptrdiff_t *source,
                      ptrdiff_t *target, ptrdiff_t node_count,
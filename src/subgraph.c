@@ -0,0 +1,129 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "helpers/parallel.h"
+#include "topotoolbox.h"
+
+/*
+  Subgraph extraction
+
+  Stream network analyses run on the part of the flow network whose
+  pixels satisfy some criterion, typically a minimum flow
+  accumulation. edgelist_extract_subgraph compacts the masked nodes
+  and the edges between them into dense arrays, so that the
+  traversal kernels only touch the selected nodes.
+
+  Both the nodes and the edges are compacted with the two-pass scheme
+  of edgeset_scan_parallel: the selected elements of fixed-size blocks
+  are counted in parallel, an exclusive scan of the block counts gives
+  the first output position of every block, and the blocks are then
+  written in parallel. The relative order of the nodes and edges is
+  preserved, so the subgraph edges are still topologically sorted and
+  the result does not depend on the number of threads.
+ */
+
+#define SUBGRAPH_BLOCK_SIZE 65536
+
+TOPOTOOLBOX_API
+ptrdiff_t edgelist_extract_subgraph(ptrdiff_t *subgraph_source,
+                                    ptrdiff_t *subgraph_target,
+                                    ptrdiff_t *edge_map, ptrdiff_t *node_map,
+                                    ptrdiff_t *node_index,
+                                    ptrdiff_t *subgraph_edge_count,
+                                    uint8_t *mask, ptrdiff_t *source,
+                                    ptrdiff_t *target, ptrdiff_t edge_count,
+                                    ptrdiff_t node_count, int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t node_blocks =
+      (node_count + SUBGRAPH_BLOCK_SIZE - 1) / SUBGRAPH_BLOCK_SIZE;
+  ptrdiff_t edge_blocks =
+      (edge_count + SUBGRAPH_BLOCK_SIZE - 1) / SUBGRAPH_BLOCK_SIZE;
+  ptrdiff_t *node_offsets = (ptrdiff_t *)malloc(
+      (node_blocks + edge_blocks + 2) * sizeof(ptrdiff_t));
+  if (node_offsets == NULL) {
+    return -1;
+  }
+  ptrdiff_t *edge_offsets = node_offsets + node_blocks + 1;
+
+  // Dense node indices in the order of the pixels
+  ptrdiff_t b;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (b = 0; b < node_blocks; b++) {
+    ptrdiff_t begin = b * SUBGRAPH_BLOCK_SIZE;
+    ptrdiff_t end = begin + SUBGRAPH_BLOCK_SIZE;
+    if (end > node_count) {
+      end = node_count;
+    }
+    ptrdiff_t count = 0;
+    for (ptrdiff_t u = begin; u < end; u++) {
+      count += mask[u] != 0;
+    }
+    node_offsets[b] = count;
+  }
+
+  ptrdiff_t subgraph_node_count = exclusive_scan(node_offsets, node_blocks);
+
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (b = 0; b < node_blocks; b++) {
+    ptrdiff_t begin = b * SUBGRAPH_BLOCK_SIZE;
+    ptrdiff_t end = begin + SUBGRAPH_BLOCK_SIZE;
+    if (end > node_count) {
+      end = node_count;
+    }
+    ptrdiff_t k = node_offsets[b];
+    for (ptrdiff_t u = begin; u < end; u++) {
+      if (mask[u]) {
+        node_map[k] = u;
+        node_index[u] = k++;
+      } else {
+        node_index[u] = -1;
+      }
+    }
+  }
+
+  // Edges with both ends in the subgraph, in their original order
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (b = 0; b < edge_blocks; b++) {
+    ptrdiff_t begin = b * SUBGRAPH_BLOCK_SIZE;
+    ptrdiff_t end = begin + SUBGRAPH_BLOCK_SIZE;
+    if (end > edge_count) {
+      end = edge_count;
+    }
+    ptrdiff_t count = 0;
+    for (ptrdiff_t e = begin; e < end; e++) {
+      count += mask[source[e]] && mask[target[e]];
+    }
+    edge_offsets[b] = count;
+  }
+
+  *subgraph_edge_count = exclusive_scan(edge_offsets, edge_blocks);
+
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (b = 0; b < edge_blocks; b++) {
+    ptrdiff_t begin = b * SUBGRAPH_BLOCK_SIZE;
+    ptrdiff_t end = begin + SUBGRAPH_BLOCK_SIZE;
+    if (end > edge_count) {
+      end = edge_count;
+    }
+    ptrdiff_t k = edge_offsets[b];
+    for (ptrdiff_t e = begin; e < end; e++) {
+      ptrdiff_t u = source[e];
+      ptrdiff_t v = target[e];
+      if (mask[u] && mask[v]) {
+        subgraph_source[k] = node_index[u];
+        subgraph_target[k] = node_index[v];
+        if (edge_map != NULL) {
+          edge_map[k] = e;
+        }
+        k++;
+      }
+    }
+  }
+
+  free(node_offsets);
+  return subgraph_node_count;
+}
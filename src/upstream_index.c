@@ -0,0 +1,140 @@
+#define TOPOTOOLBOX_BUILD
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "helpers/parallel.h"
+#include "topotoolbox.h"
+
+/*
+  Interval index of a single flow direction network
+
+  In a single flow direction network, the nodes upstream of any node v
+  form a tree rooted at v. Numbering the nodes in depth-first preorder
+  of these trees, starting from the outlets, places every node v and
+  all of its upstream nodes in the contiguous range
+
+    preorder[v] <= preorder[u] < preorder[v] + subtree_size[v]
+
+  so that testing whether u is upstream of v takes two comparisons, and
+  the catchment of v is the range of the preorder permutation starting
+  at preorder[v].
+
+  The numbering does not need an explicit depth-first search. The
+  subtree sizes are accumulated in a single downstream traversal of
+  the topologically sorted edge list. An upstream traversal then
+  assigns each node the next free position within the range of its
+  receiver, which has already been numbered because it lies
+  downstream. The ranges of the donors of a node are therefore
+  disjoint and lie directly after the node itself, which is exactly
+  the preorder of some depth-first search.
+ */
+
+TOPOTOOLBOX_API
+int upstream_index(ptrdiff_t *preorder, ptrdiff_t *subtree_size,
+                   ptrdiff_t *order, ptrdiff_t *source, ptrdiff_t *target,
+                   ptrdiff_t edge_count, ptrdiff_t node_count) {
+  // preorder is -1 for the outlets, which have no outgoing edge, and 0
+  // for all other nodes until the final numbering is assigned.
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    preorder[u] = -1;
+    subtree_size[u] = 1;
+  }
+
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    ptrdiff_t u = source[e];
+    if (preorder[u] == 0) {
+      // u has more than one receiver
+      return -1;
+    }
+    preorder[u] = 0;
+    subtree_size[target[e]] += subtree_size[u];
+  }
+
+  // order holds node_count elements, so it is used to store the next
+  // free position within the range of each node before it receives
+  // the preorder permutation.
+  ptrdiff_t position = 0;
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    if (preorder[u] == -1) {
+      preorder[u] = position;
+      order[u] = position + 1;
+      position += subtree_size[u];
+    }
+  }
+
+  for (ptrdiff_t e = edge_count - 1; e >= 0; e--) {
+    ptrdiff_t u = source[e];
+    ptrdiff_t v = target[e];
+
+    preorder[u] = order[v];
+    order[v] += subtree_size[u];
+    order[u] = preorder[u] + 1;
+  }
+
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    order[preorder[u]] = u;
+  }
+  return 0;
+}
+
+TOPOTOOLBOX_API
+void upstream_index_query(uint8_t *upstream, ptrdiff_t *nodes,
+                          ptrdiff_t *outlets, ptrdiff_t query_count,
+                          ptrdiff_t *preorder, ptrdiff_t *subtree_size,
+                          int num_threads) {
+  num_threads = resolve_threads(num_threads);
+
+  ptrdiff_t k;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (k = 0; k < query_count; k++) {
+    ptrdiff_t p = preorder[nodes[k]];
+    ptrdiff_t v = outlets[k];
+    upstream[k] = p >= preorder[v] && p < preorder[v] + subtree_size[v];
+  }
+}
+
+static int ptrdiff_compare(const void *x, const void *y) {
+  ptrdiff_t a = *(const ptrdiff_t *)x;
+  ptrdiff_t b = *(const ptrdiff_t *)y;
+  return (a > b) - (a < b);
+}
+
+TOPOTOOLBOX_API
+ptrdiff_t upstream_index_catchment(ptrdiff_t *catchment, ptrdiff_t *outlets,
+                                   ptrdiff_t outlet_count,
+                                   ptrdiff_t *preorder,
+                                   ptrdiff_t *subtree_size, ptrdiff_t *order) {
+  if (outlet_count == 0) {
+    return 0;
+  }
+
+  ptrdiff_t *starts = (ptrdiff_t *)malloc(outlet_count * sizeof(ptrdiff_t));
+  if (starts == NULL) {
+    return -1;
+  }
+  for (ptrdiff_t k = 0; k < outlet_count; k++) {
+    starts[k] = preorder[outlets[k]];
+  }
+  qsort(starts, outlet_count, sizeof(ptrdiff_t), ptrdiff_compare);
+
+  // The ranges of two nodes are either nested or disjoint, so after
+  // sorting by their start, a range is covered by the previous one
+  // exactly if it starts before the previous one ends.
+  ptrdiff_t count = 0;
+  ptrdiff_t end = 0;
+  for (ptrdiff_t k = 0; k < outlet_count; k++) {
+    ptrdiff_t begin = starts[k];
+    if (begin < end) {
+      continue;
+    }
+    end = begin + subtree_size[order[begin]];
+    for (ptrdiff_t p = begin; p < end; p++) {
+      catchment[count++] = order[p];
+    }
+  }
+
+  free(starts);
+  return count;
+}
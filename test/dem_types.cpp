@@ -0,0 +1,213 @@
+#undef NDEBUG
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "utils.hpp"
+
+/*
+  The typed kernels are checked against the float32 routines on a
+  random DEM with integer elevations, which every type represents
+  exactly. The hybrid and parallel variants of every type must
+  reproduce its serial results.
+ */
+
+// The float32 routing together with the float32 terrain attributes
+struct FloatResults : D8Routing {
+  std::vector<float> gradient;
+  std::vector<float> hillshade;
+};
+
+FloatResults float_results(std::vector<float> &dem, std::vector<uint8_t> &bc,
+                           ptrdiff_t dims[2]) {
+  ptrdiff_t n = dims[0] * dims[1];
+  FloatResults r;
+  static_cast<D8Routing &>(r) = route_d8_carve(dem, bc, dims, 0);
+  r.gradient.resize(n);
+  r.hillshade.resize(n);
+  gradient8(r.gradient.data(), dem.data(), 1.0f, 0, dims);
+  hillshade_fused(r.hillshade.data(), dem.data(), 0.7f, 0.6f, 1.0f, dims);
+  return r;
+}
+
+// The functions generated for one type from helpers/dem_kernels.h
+template <typename T>
+struct DemFunctions {
+  void (*fill)(T *, const T *, uint8_t *, ptrdiff_t *);
+  void (*fill_hybrid)(T *, ptrdiff_t *, const T *, uint8_t *, ptrdiff_t *);
+  ptrdiff_t (*flats)(int32_t *, const T *, ptrdiff_t *);
+  ptrdiff_t (*flats_parallel)(int32_t *, const T *, ptrdiff_t *, int);
+  void (*gradient)(float *, const T *, float, int, ptrdiff_t *);
+  void (*hillshade)(float *, const T *, float, float, float, ptrdiff_t *);
+  void (*carve)(ptrdiff_t *, uint8_t *, const T *, float *, int32_t *,
+                ptrdiff_t *, unsigned int);
+  void (*carve_parallel)(ptrdiff_t *, uint8_t *, const T *, float *,
+                         int32_t *, ptrdiff_t *, unsigned int, int);
+};
+
+// Floating point types mark missing data with NaN, integer types with
+// their largest value.
+template <typename T>
+T missing() {
+  return std::numeric_limits<T>::has_quiet_NaN
+             ? std::numeric_limits<T>::quiet_NaN()
+             : std::numeric_limits<T>::max();
+}
+
+template <typename T>
+bool is_missing(T x) {
+  return std::numeric_limits<T>::has_quiet_NaN
+             ? std::isnan((double)x)
+             : x == std::numeric_limits<T>::max();
+}
+
+bool close(float x, float expected) {
+  return std::isnan(expected) ? std::isnan(x)
+                              : std::fabs(x - expected) <= 1e-5f;
+}
+
+// Assumes that every filled elevation that is not missing is finite
+template <typename T>
+int32_t test_dem_type(FloatResults &expected, std::vector<float> &dem,
+                      std::vector<uint8_t> &bc, ptrdiff_t dims[2],
+                      DemFunctions<T> fn) {
+  ptrdiff_t n = dims[0] * dims[1];
+  std::vector<T> typed_dem(n);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    typed_dem[p] = std::isnan(dem[p]) ? missing<T>() : (T)dem[p];
+  }
+
+  std::vector<T> filled(n);
+  fn.fill(filled.data(), typed_dem.data(), bc.data(), dims);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    if (std::isnan(expected.filled[p])) {
+      assert(is_missing(filled[p]));
+    } else {
+      assert((float)filled[p] == expected.filled[p]);
+    }
+  }
+
+  std::vector<T> filled_hybrid(n);
+  std::vector<ptrdiff_t> queue(n);
+  fn.fill_hybrid(filled_hybrid.data(), queue.data(), typed_dem.data(),
+                 bc.data(), dims);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(filled_hybrid[p] == filled[p] ||
+           (is_missing(filled_hybrid[p]) && is_missing(filled[p])));
+  }
+
+  std::vector<int32_t> flats(n);
+  ptrdiff_t count = fn.flats(flats.data(), filled.data(), dims);
+  ptrdiff_t expected_count = 0;
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(flats[p] == expected.flats[p]);
+    expected_count += expected.flats[p] & 1;
+  }
+  assert(count == expected_count);
+
+  std::vector<int32_t> flats_parallel(n);
+  assert(fn.flats_parallel(flats_parallel.data(), filled.data(), dims, 4) ==
+         expected_count);
+  assert(flats_parallel == flats);
+
+  std::vector<float> gradient(n);
+  fn.gradient(gradient.data(), typed_dem.data(), 1.0f, 0, dims);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(close(gradient[p], expected.gradient[p]));
+  }
+
+  std::vector<float> hillshade(n);
+  fn.hillshade(hillshade.data(), typed_dem.data(), 0.7f, 0.6f, 1.0f, dims);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(close(hillshade[p], expected.hillshade[p]));
+  }
+
+  std::vector<uint8_t> direction(n);
+  std::vector<ptrdiff_t> node(n);
+  fn.carve(node.data(), direction.data(), filled.data(), expected.dist.data(),
+           flats.data(), dims, 0);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(direction[p] == expected.direction[p]);
+    assert(node[p] == expected.node[p]);
+  }
+
+  std::vector<uint8_t> direction_parallel(n);
+  std::vector<ptrdiff_t> node_parallel(n);
+  fn.carve_parallel(node_parallel.data(), direction_parallel.data(),
+                    filled.data(), expected.dist.data(), flats.data(), dims, 0,
+                    4);
+  assert(direction_parallel == direction);
+  assert(node_parallel == node);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  ptrdiff_t dims_list[][2] = {{50, 80}, {3, 40}, {101, 7}};
+
+  DemFunctions<float> f32 = {fillsinks,
+                             fillsinks_hybrid,
+                             identifyflats,
+                             identifyflats_parallel,
+                             gradient8,
+                             hillshade_fused,
+                             flow_routing_d8_carve,
+                             flow_routing_d8_carve_parallel};
+  DemFunctions<double> f64 = {fillsinks_f64,
+                              fillsinks_hybrid_f64,
+                              identifyflats_f64,
+                              identifyflats_parallel_f64,
+                              gradient8_f64,
+                              hillshade_fused_f64,
+                              flow_routing_d8_carve_f64,
+                              flow_routing_d8_carve_parallel_f64};
+  DemFunctions<int16_t> i16 = {fillsinks_i16,
+                               fillsinks_hybrid_i16,
+                               identifyflats_i16,
+                               identifyflats_parallel_i16,
+                               gradient8_i16,
+                               hillshade_fused_i16,
+                               flow_routing_d8_carve_i16,
+                               flow_routing_d8_carve_parallel_i16};
+  DemFunctions<uint16_t> u16 = {fillsinks_u16,
+                                fillsinks_hybrid_u16,
+                                identifyflats_u16,
+                                identifyflats_parallel_u16,
+                                gradient8_u16,
+                                hillshade_fused_u16,
+                                flow_routing_d8_carve_u16,
+                                flow_routing_d8_carve_parallel_u16};
+
+  for (auto &dims : dims_list) {
+    // The second pass marks isolated interior pixels as missing, which
+    // are NaNs in the float32 DEM.
+    for (int with_missing = 0; with_missing < 2; with_missing++) {
+      ptrdiff_t n = dims[0] * dims[1];
+      std::vector<float> dem(n);
+      std::vector<uint8_t> bc(n);
+      for (ptrdiff_t j = 0; j < dims[1]; j++) {
+        for (ptrdiff_t i = 0; i < dims[0]; i++) {
+          ptrdiff_t p = j * dims[0] + i;
+          // Coarse integer elevations produce many flats
+          dem[p] = std::floor(20.0f * pcg4d(i, j, 7, 0)) + (float)(i + j);
+          bc[p] = i == 0 || i == dims[0] - 1 || j == 0 || j == dims[1] - 1;
+          if (with_missing && !bc[p] && i % 5 == 2 && j % 7 == 3) {
+            dem[p] = NAN;
+          }
+        }
+      }
+
+      FloatResults expected = float_results(dem, bc, dims);
+
+      std::cout << "dem_types " << dims[0] << "x" << dims[1]
+                << (with_missing ? " with missing data" : "") << std::endl;
+      test_dem_type(expected, dem, bc, dims, f32);
+      test_dem_type(expected, dem, bc, dims, f64);
+      test_dem_type(expected, dem, bc, dims, i16);
+      test_dem_type(expected, dem, bc, dims, u16);
+    }
+  }
+}
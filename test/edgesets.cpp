@@ -0,0 +1,134 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "utils.hpp"
+
+/*
+  The parallel edge emission and bitmap edge set scans are checked
+  against their serial counterparts on grids that span several
+  blocks, with different numbers of threads.
+ */
+
+// Random bitmap in which every edge is present with probability
+// `density`
+std::vector<uint8_t> random_bitmap(ptrdiff_t n, uint32_t seed,
+                                   float density) {
+  std::vector<uint8_t> bitmap(n);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    uint8_t b = 0;
+    for (uint32_t k = 0; k < 8; k++) {
+      if (pcg4d(p, k, seed, 0) < density) {
+        b |= (uint8_t)(1 << k);
+      }
+    }
+    bitmap[p] = b;
+  }
+  return bitmap;
+}
+
+std::vector<float> random_weights(ptrdiff_t n, uint32_t seed) {
+  std::vector<float> w(n);
+  for (ptrdiff_t k = 0; k < n; k++) {
+    w[k] = pcg4d(k, 0, seed, 0);
+  }
+  return w;
+}
+
+void test_d8_edgelist(ptrdiff_t dims[2], unsigned int order,
+                      int num_threads) {
+  ptrdiff_t n = dims[0] * dims[1];
+
+  // The edge list routines only decode the directions, so neither the
+  // directions nor the node order need to come from a DEM. Every
+  // pixel gets a single direction bit or none.
+  std::vector<ptrdiff_t> node(n);
+  std::vector<uint8_t> direction(n);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    node[p] = (p * 7919) % n;
+    uint32_t r = (uint32_t)(9.0f * pcg4d(p, 0, 31, 0));
+    direction[p] = r < 8 ? (uint8_t)(1 << r) : 0;
+  }
+
+  std::vector<ptrdiff_t> source(n);
+  std::vector<ptrdiff_t> target(n);
+  ptrdiff_t edge_count =
+      flow_routing_d8_edgelist(source.data(), target.data(), node.data(),
+                               direction.data(), dims, order);
+
+  std::vector<ptrdiff_t> parallel_source(n);
+  std::vector<ptrdiff_t> parallel_target(n);
+  ptrdiff_t parallel_edge_count = flow_routing_d8_edgelist_parallel(
+      parallel_source.data(), parallel_target.data(), node.data(),
+      direction.data(), dims, order, num_threads);
+
+  assert(parallel_edge_count == edge_count);
+  source.resize(edge_count);
+  target.resize(edge_count);
+  parallel_source.resize(edge_count);
+  parallel_target.resize(edge_count);
+  assert_equal(parallel_source, source);
+  assert_equal(parallel_target, target);
+}
+
+void test_edgeset(ptrdiff_t dims[2], int num_threads) {
+  ptrdiff_t n = dims[0] * dims[1];
+
+  std::vector<uint8_t> b1 = random_bitmap(n, 41, 0.2f);
+  std::vector<uint8_t> b2 = random_bitmap(n, 42, 0.1f);
+
+  ptrdiff_t count1 = edgeset_count(b1.data(), dims);
+  ptrdiff_t count2 = edgeset_count(b2.data(), dims);
+  assert(edgeset_count_parallel(b1.data(), dims, num_threads) == count1);
+  assert(edgeset_count_parallel(b2.data(), dims, num_threads) == count2);
+
+  std::vector<ptrdiff_t> scan(n);
+  std::vector<ptrdiff_t> parallel_scan(n);
+  assert(edgeset_scan(scan.data(), b1.data(), dims) == count1);
+  assert(edgeset_scan_parallel(parallel_scan.data(), b1.data(), dims,
+                               num_threads) == count1);
+  assert_equal(parallel_scan, scan);
+
+  ptrdiff_t merged_count = edgeset_count_merged(b1.data(), b2.data(), dims);
+  assert(edgeset_count_merged_parallel(b1.data(), b2.data(), dims,
+                                       num_threads) == merged_count);
+
+  std::vector<float> w1 = random_weights(count1, 43);
+  std::vector<float> w2 = random_weights(count2, 44);
+
+  std::vector<uint8_t> merged(b1);
+  std::vector<float> w0(merged_count);
+  std::vector<ptrdiff_t> s0(n);
+  assert(edgeset_merge(w0.data(), s0.data(), merged.data(), w1.data(),
+                       b2.data(), w2.data(), dims) == merged_count);
+
+  std::vector<uint8_t> parallel_merged(b1);
+  std::vector<float> parallel_w0(merged_count);
+  std::vector<ptrdiff_t> parallel_s0(n);
+  assert(edgeset_merge_parallel(parallel_w0.data(), parallel_s0.data(),
+                                parallel_merged.data(), w1.data(), b2.data(),
+                                w2.data(), dims, num_threads) == merged_count);
+  assert_equal(parallel_merged, merged);
+  assert_equal(parallel_w0, w0);
+  assert_equal(parallel_s0, s0);
+}
+
+int main(int argc, char *argv[]) {
+  // The parallel routines work on blocks of 65536 pixels, so the
+  // larger grids span several blocks that are not multiples of eight
+  ptrdiff_t dims_list[][2] = {{50, 80}, {317, 411}, {1, 200003}};
+
+  for (auto &dims : dims_list) {
+    for (int num_threads : {1, 2, 3, 0}) {
+      std::cout << "edgesets " << dims[0] << "x" << dims[1] << " threads "
+                << num_threads << std::endl;
+      test_d8_edgelist(dims, 0, num_threads);
+      test_d8_edgelist(dims, 1, num_threads);
+      test_edgeset(dims, num_threads);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,124 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "utils.hpp"
+
+/*
+  Flow networks are stored in a container with both index widths and
+  opened again. The traversal kernels must give the same results on
+  the arrays inside the container as on the original arrays, and
+  damaged containers must be rejected.
+ */
+int main(int argc, char *argv[]) {
+  ptrdiff_t dims[2] = {60, 90};
+  ptrdiff_t n = dims[0] * dims[1];
+
+  FlowNetwork net = random_flow_network(dims, 81, 0);
+  std::vector<ptrdiff_t> &node = net.node;
+  std::vector<ptrdiff_t> &source = net.source;
+  std::vector<ptrdiff_t> &target = net.target;
+  ptrdiff_t edge_count = source.size();
+
+  std::vector<float> fraction(edge_count);
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    fraction[e] = pcg4d(e, 0, 82, 0);
+  }
+
+  std::vector<float> expected(n);
+  flow_accumulation_edgelist(expected.data(), source.data(), target.data(),
+                             fraction.data(), NULL, edge_count, dims);
+
+  for (unsigned int index32 = 0; index32 < 2; index32++) {
+    std::cout << "flow_network index32 " << index32 << std::endl;
+
+    ptrdiff_t size = flow_network_size(edge_count, n, index32);
+    // uint64_t elements keep the buffer aligned to 8 bytes
+    std::vector<uint64_t> storage((size + 7) / 8 + 1);
+    void *buffer = storage.data();
+
+    assert(flow_network_write(buffer, size - 1, source.data(), target.data(),
+                              fraction.data(), node.data(), edge_count, n,
+                              dims, index32) == -1);
+    assert(flow_network_write(buffer, size, source.data(), target.data(),
+                              fraction.data(), node.data(), edge_count, n - 1,
+                              dims, index32) == -2);
+    assert(flow_network_write(buffer, size, source.data(), target.data(),
+                              fraction.data(), node.data(), edge_count, n,
+                              dims, index32) == 0);
+
+    void *c_source, *c_target, *c_node;
+    float *c_fraction;
+    ptrdiff_t c_edge_count, c_node_count;
+    ptrdiff_t c_dims[2];
+    unsigned int c_index32;
+    int result = flow_network_read(&c_source, &c_target, &c_fraction, &c_node,
+                                   &c_edge_count, &c_node_count, c_dims,
+                                   &c_index32, buffer, size);
+    assert(result == 0);
+    assert(c_edge_count == edge_count);
+    assert(c_node_count == n);
+    assert(c_dims[0] == dims[0] && c_dims[1] == dims[1]);
+    assert(c_index32 == index32);
+    assert(std::memcmp(c_fraction, fraction.data(),
+                       edge_count * sizeof(float)) == 0);
+
+    // The kernels run directly on the arrays inside the container
+    std::vector<float> acc(n);
+    if (index32) {
+      flow_accumulation_edgelist_idx32(
+          acc.data(), (uint32_t *)c_source, (uint32_t *)c_target, c_fraction,
+          NULL, c_edge_count, c_dims);
+      uint32_t *nodes = (uint32_t *)c_node;
+      assert_equal(std::vector<uint32_t>(nodes, nodes + n),
+                   std::vector<uint32_t>(node.begin(), node.end()));
+    } else {
+      flow_accumulation_edgelist(acc.data(), (ptrdiff_t *)c_source,
+                                 (ptrdiff_t *)c_target, c_fraction, NULL,
+                                 c_edge_count, c_dims);
+      ptrdiff_t *nodes = (ptrdiff_t *)c_node;
+      assert_equal(std::vector<ptrdiff_t>(nodes, nodes + n), node);
+    }
+    assert_equal(acc, expected);
+
+    // Truncated containers are rejected
+    result = flow_network_read(&c_source, &c_target, &c_fraction, &c_node,
+                               &c_edge_count, &c_node_count, c_dims,
+                               &c_index32, buffer, size - 1);
+    assert(result == -3);
+
+    // So are grid dimensions that do not match the node count
+    uint8_t *bytes = (uint8_t *)buffer;
+    int64_t stored_dims[2];
+    std::memcpy(stored_dims, bytes + 24, sizeof stored_dims);
+    int64_t bad_dims[3][2] = {{0, stored_dims[1]},
+                              {-stored_dims[0], -stored_dims[1]},
+                              {stored_dims[0] + 1, stored_dims[1]}};
+    for (int k = 0; k < 3; k++) {
+      std::memcpy(bytes + 24, bad_dims[k], sizeof bad_dims[k]);
+      result = flow_network_read(&c_source, &c_target, &c_fraction, &c_node,
+                                 &c_edge_count, &c_node_count, c_dims,
+                                 &c_index32, buffer, size);
+      assert(result == -3);
+    }
+    std::memcpy(bytes + 24, stored_dims, sizeof stored_dims);
+
+    // So are unsupported versions and damaged headers
+    bytes[8] ^= 0xFF;
+    result = flow_network_read(&c_source, &c_target, &c_fraction, &c_node,
+                               &c_edge_count, &c_node_count, c_dims,
+                               &c_index32, buffer, size);
+    assert(result == -2);
+    bytes[8] ^= 0xFF;
+    bytes[0] = 'X';
+    result = flow_network_read(&c_source, &c_target, &c_fraction, &c_node,
+                               &c_edge_count, &c_node_count, c_dims,
+                               &c_index32, buffer, size);
+    assert(result == -1);
+  }
+  return 0;
+}
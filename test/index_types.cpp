@@ -0,0 +1,179 @@
+#undef NDEBUG
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "utils.hpp"
+
+/*
+  The 32-bit index variants are checked against the ptrdiff_t
+  routines on the flow network of a random DEM.
+ */
+template <typename T, typename Ref, typename Test>
+void test_traverse(std::vector<T> init, std::vector<T> &input,
+                   std::vector<ptrdiff_t> &source,
+                   std::vector<ptrdiff_t> &target,
+                   std::vector<uint32_t> &source32,
+                   std::vector<uint32_t> &target32, Ref ref_fn,
+                   Test test_fn) {
+  ptrdiff_t edge_count = source.size();
+  std::vector<T> expected(init);
+  ref_fn(expected.data(), input.data(), source.data(), target.data(),
+         edge_count);
+  test_fn(init.data(), input.data(), source32.data(), target32.data(),
+          edge_count);
+  assert_equal(init, expected);
+}
+
+template <typename Ref, typename Test>
+void test_traverse_arg(std::vector<float> &init, std::vector<float> &input,
+                       std::vector<ptrdiff_t> &source,
+                       std::vector<ptrdiff_t> &target,
+                       std::vector<uint32_t> &source32,
+                       std::vector<uint32_t> &target32, Ref ref_fn,
+                       Test test_fn) {
+  ptrdiff_t edge_count = source.size();
+  std::vector<float> expected(init);
+  std::vector<float> output(init);
+  std::vector<int64_t> expected_idx(init.size());
+  std::vector<int64_t> idx(init.size());
+  for (size_t k = 0; k < init.size(); k++) {
+    expected_idx[k] = idx[k] = k;
+  }
+  ref_fn(expected.data(), expected_idx.data(), input.data(), source.data(),
+         target.data(), edge_count);
+  test_fn(output.data(), idx.data(), input.data(), source32.data(),
+          target32.data(), edge_count);
+  assert_equal(output, expected);
+  assert_equal(idx, expected_idx);
+}
+
+int main(int argc, char *argv[]) {
+  ptrdiff_t dims_list[][2] = {{50, 80}, {3, 40}, {101, 7}};
+
+  for (auto &dims : dims_list) {
+    ptrdiff_t n = dims[0] * dims[1];
+    std::cout << "index_types " << dims[0] << "x" << dims[1] << std::endl;
+
+    FlowNetwork net = random_flow_network(dims, 11, 0);
+    std::vector<ptrdiff_t> &node = net.node;
+    std::vector<uint8_t> &direction = net.direction;
+    std::vector<ptrdiff_t> &source = net.source;
+    std::vector<ptrdiff_t> &target = net.target;
+    ptrdiff_t edge_count = source.size();
+
+    std::vector<uint32_t> node32(node.begin(), node.end());
+    std::vector<uint32_t> source32(n);
+    std::vector<uint32_t> target32(n);
+    ptrdiff_t edge_count32 = flow_routing_d8_edgelist_idx32(
+        source32.data(), target32.data(), node32.data(), direction.data(), dims,
+        0);
+    assert(edge_count32 == edge_count);
+    source32.resize(edge_count);
+    target32.resize(edge_count);
+    assert_equal(source32, std::vector<uint32_t>(source.begin(), source.end()));
+    assert_equal(target32, std::vector<uint32_t>(target.begin(), target.end()));
+
+    std::vector<float> fraction(edge_count);
+    std::vector<float> weights(n);
+    std::vector<float> f32(n);
+    std::vector<double> f64(n);
+    std::vector<uint32_t> u32(n);
+    std::vector<uint8_t> u8(n);
+    for (ptrdiff_t p = 0; p < n; p++) {
+      weights[p] = pcg4d(p, 0, 12, 0);
+      f32[p] = pcg4d(p, 0, 13, 0);
+      f64[p] = pcg4d(p, 0, 14, 0);
+      u32[p] = (uint32_t)(pcg4d(p, 0, 15, 0) * 4) & 1;
+      u8[p] = (uint8_t)u32[p];
+    }
+    std::vector<float> input_f32(edge_count);
+    std::vector<double> input_f64(edge_count);
+    std::vector<uint32_t> input_u32(edge_count);
+    std::vector<uint8_t> input_u8(edge_count);
+    for (ptrdiff_t e = 0; e < edge_count; e++) {
+      fraction[e] = 1.0f;
+      input_f32[e] = 2.0f * pcg4d(e, 0, 16, 0);
+      input_f64[e] = input_f32[e];
+      input_u32[e] = pcg4d(e, 0, 17, 0) < 0.8f;
+      input_u8[e] = (uint8_t)input_u32[e];
+    }
+
+    std::vector<float> acc(n);
+    std::vector<float> acc32(n);
+    flow_accumulation_edgelist(acc.data(), source.data(), target.data(),
+                               fraction.data(), weights.data(), edge_count,
+                               dims);
+    flow_accumulation_edgelist_idx32(acc32.data(), source32.data(),
+                                     target32.data(), fraction.data(),
+                                     weights.data(), edge_count, dims);
+    assert_equal(acc32, acc);
+
+    std::vector<ptrdiff_t> basins(n);
+    std::vector<uint32_t> basins32(n);
+    drainagebasins(basins.data(), source.data(), target.data(), edge_count,
+                   dims);
+    drainagebasins_idx32(basins32.data(), source32.data(), target32.data(),
+                         edge_count, dims);
+    assert_equal(basins32, std::vector<uint32_t>(basins.begin(), basins.end()));
+
+    {
+      std::vector<float> expected(n);
+      std::vector<float> integral(n);
+      streamquad_trapz_f32(expected.data(), f32.data(), source.data(),
+                           target.data(), input_f32.data(), edge_count);
+      streamquad_trapz_f32_idx32(integral.data(), f32.data(), source32.data(),
+                                 target32.data(), input_f32.data(),
+                                 edge_count);
+      assert_equal(integral, expected);
+    }
+    {
+      std::vector<double> expected(n);
+      std::vector<double> integral(n);
+      streamquad_trapz_f64(expected.data(), f64.data(), source.data(),
+                           target.data(), input_f32.data(), edge_count);
+      streamquad_trapz_f64_idx32(integral.data(), f64.data(), source32.data(),
+                                 target32.data(), input_f32.data(),
+                                 edge_count);
+      assert_equal(integral, expected);
+    }
+
+    test_traverse(u32, input_u32, source, target, source32, target32,
+                  traverse_up_u32_or_and, traverse_up_u32_or_and_idx32);
+    test_traverse(u32, input_u32, source, target, source32, target32,
+                  traverse_down_u32_or_and, traverse_down_u32_or_and_idx32);
+    test_traverse(u8, input_u8, source, target, source32, target32,
+                  traverse_up_u8_or_and, traverse_up_u8_or_and_idx32);
+    test_traverse(u8, input_u8, source, target, source32, target32,
+                  traverse_down_u8_or_and, traverse_down_u8_or_and_idx32);
+    test_traverse(f32, input_f32, source, target, source32, target32,
+                  traverse_down_f32_max_add, traverse_down_f32_max_add_idx32);
+    test_traverse(f32, input_f32, source, target, source32, target32,
+                  traverse_up_f32_max_add, traverse_up_f32_max_add_idx32);
+    test_traverse(f32, input_f32, source, target, source32, target32,
+                  traverse_down_f32_max_mul, traverse_down_f32_max_mul_idx32);
+    test_traverse(f32, input_f32, source, target, source32, target32,
+                  traverse_up_f32_max_mul, traverse_up_f32_max_mul_idx32);
+    test_traverse(f32, input_f32, source, target, source32, target32,
+                  traverse_down_f32_min_add, traverse_down_f32_min_add_idx32);
+    test_traverse(f32, input_f32, source, target, source32, target32,
+                  traverse_down_f32_add_mul, traverse_down_f32_add_mul_idx32);
+    test_traverse(f64, input_f64, source, target, source32, target32,
+                  traverse_down_f64_add_mul, traverse_down_f64_add_mul_idx32);
+
+    std::vector<float> order(n, 1.0f);
+    test_traverse(order, input_f32, source, target, source32, target32,
+                  traverse_down_f32_strahler,
+                  traverse_down_f32_strahler_idx32);
+
+    test_traverse_arg(f32, input_f32, source, target, source32, target32,
+                      traverse_down_f32_max_mul_arg,
+                      traverse_down_f32_max_mul_arg_idx32);
+    test_traverse_arg(f32, input_f32, source, target, source32, target32,
+                      traverse_up_f32_max_mul_arg,
+                      traverse_up_f32_max_mul_arg_idx32);
+  }
+}
@@ -0,0 +1,192 @@
+#undef NDEBUG
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "topotoolbox.h"
+#include "utils.h"
+}
+
+/*
+  Raw, column-major float32 rasters on local disk that are read and
+  written one tile column at a time.
+
+  The callback with the index `fail_at` among all callback calls fails
+  as if the disk had returned an error.
+ */
+struct DiskRaster {
+  std::fstream dem;
+  std::fstream output;
+  ptrdiff_t dims[2];
+  ptrdiff_t tiles_written;
+  ptrdiff_t calls;
+  ptrdiff_t fail_at;
+};
+
+int read_tile(float *dem, uint8_t *bc, ptrdiff_t offset[2],
+              ptrdiff_t tile_dims[2], void *context) {
+  DiskRaster *raster = static_cast<DiskRaster *>(context);
+  if (raster->calls++ == raster->fail_at) {
+    return -1;
+  }
+
+  for (ptrdiff_t tj = 0; tj < tile_dims[1]; tj++) {
+    ptrdiff_t j = offset[1] + tj;
+    raster->dem.seekg((j * raster->dims[0] + offset[0]) * sizeof(float));
+    raster->dem.read(reinterpret_cast<char *>(dem + tj * tile_dims[0]),
+                     tile_dims[0] * sizeof(float));
+    if (!raster->dem) {
+      return -1;
+    }
+
+    for (ptrdiff_t ti = 0; ti < tile_dims[0]; ti++) {
+      ptrdiff_t i = offset[0] + ti;
+      bc[tj * tile_dims[0] + ti] = i == 0 || i == raster->dims[0] - 1 ||
+                                   j == 0 || j == raster->dims[1] - 1;
+    }
+  }
+  return 0;
+}
+
+int write_tile(float *output, ptrdiff_t offset[2], ptrdiff_t tile_dims[2],
+               void *context) {
+  DiskRaster *raster = static_cast<DiskRaster *>(context);
+  if (raster->calls++ == raster->fail_at) {
+    return -1;
+  }
+
+  for (ptrdiff_t tj = 0; tj < tile_dims[1]; tj++) {
+    ptrdiff_t j = offset[1] + tj;
+    raster->output.seekp((j * raster->dims[0] + offset[0]) * sizeof(float));
+    raster->output.write(
+        reinterpret_cast<const char *>(output + tj * tile_dims[0]),
+        tile_dims[0] * sizeof(float));
+    if (!raster->output) {
+      return -1;
+    }
+  }
+  raster->tiles_written++;
+  return 0;
+}
+
+/*
+  Fill a random DEM stored on disk with fillsinks_outofcore using a
+  memory budget smaller than the DEM and compare the result to the
+  in-memory fillsinks.
+
+  If `fail_at` is not negative, the callback call with that index
+  fails and fillsinks_outofcore must stop there and report it.
+
+  Returns the number of callback calls.
+ */
+ptrdiff_t test_outofcore(ptrdiff_t dims[2], size_t memory_budget,
+                         uint32_t seed, ptrdiff_t fail_at) {
+  ptrdiff_t n = dims[0] * dims[1];
+  assert(n * sizeof(float) > memory_budget);
+
+  std::vector<float> dem(n);
+  std::vector<uint8_t> bc(n);
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t p = j * dims[0] + i;
+      dem[p] = 100.0f * pcg4d(i, j, seed, 0);
+      if (pcg4d(i, j, seed, 1) < 0.05f) {
+        dem[p] = NAN;
+      }
+      bc[p] = i == 0 || i == dims[0] - 1 || j == 0 || j == dims[1] - 1;
+    }
+  }
+
+  std::string dem_path = "outofcore_dem_" + std::to_string(seed) + ".bin";
+  std::string output_path =
+      "outofcore_output_" + std::to_string(seed) + ".bin";
+  {
+    std::ofstream file(dem_path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(dem.data()), n * sizeof(float));
+    // Preallocate the output raster
+    std::ofstream output(output_path, std::ios::binary);
+    output.write(reinterpret_cast<const char *>(dem.data()),
+                 n * sizeof(float));
+  }
+
+  DiskRaster raster;
+  raster.dem.open(dem_path, std::ios::in | std::ios::binary);
+  raster.output.open(output_path,
+                     std::ios::in | std::ios::out | std::ios::binary);
+  raster.dims[0] = dims[0];
+  raster.dims[1] = dims[1];
+  raster.tiles_written = 0;
+  raster.calls = 0;
+  raster.fail_at = fail_at;
+  assert(raster.dem && raster.output);
+
+  int result =
+      fillsinks_outofcore(read_tile, write_tile, &raster, dims, memory_budget);
+  if (fail_at >= 0) {
+    assert(result == -2);
+    // No callback is called after the failed one
+    assert(raster.calls == fail_at + 1);
+    raster.dem.close();
+    raster.output.close();
+    std::remove(dem_path.c_str());
+    std::remove(output_path.c_str());
+    return raster.calls;
+  }
+  assert(result == 0);
+  // The budget must actually force the DEM into several tiles
+  assert(raster.tiles_written > 1);
+
+  std::vector<float> filled(n);
+  raster.output.seekg(0);
+  raster.output.read(reinterpret_cast<char *>(filled.data()),
+                     n * sizeof(float));
+  assert(raster.output);
+  raster.dem.close();
+  raster.output.close();
+  std::remove(dem_path.c_str());
+  std::remove(output_path.c_str());
+
+  std::vector<float> expected(n);
+  fillsinks(expected.data(), dem.data(), bc.data(), dims);
+
+  for (ptrdiff_t p = 0; p < n; p++) {
+    if (std::isnan(expected[p])) {
+      assert(std::isnan(filled[p]));
+    } else {
+      assert(filled[p] == expected[p]);
+    }
+  }
+  return raster.calls;
+}
+
+int main(int argc, char *argv[]) {
+  ptrdiff_t dims[][2] = {{200, 300}, {301, 97}, {64, 512}, {3, 1000}};
+  size_t budgets[] = {16384, 65536, 2048, 1024};
+
+  for (uint32_t test = 0; test < 4; test++) {
+    std::cout << "test_outofcore " << dims[test][0] << "x" << dims[test][1]
+              << " budget " << budgets[test] << std::endl;
+    ptrdiff_t calls = test_outofcore(dims[test], budgets[test], test, -1);
+
+    // Every tile is read twice and written once. Fail the first read,
+    // the first write and the last write.
+    ptrdiff_t tile_count = calls / 3;
+    assert(calls == 3 * tile_count);
+    test_outofcore(dims[test], budgets[test], test, 0);
+    test_outofcore(dims[test], budgets[test], test, tile_count + 1);
+    test_outofcore(dims[test], budgets[test], test, calls - 1);
+  }
+
+  // A budget that cannot hold a single pixel is rejected without
+  // touching the callbacks.
+  ptrdiff_t small_dims[2] = {10, 10};
+  assert(fillsinks_outofcore(read_tile, write_tile, NULL, small_dims, 1) ==
+         -1);
+}
@@ -1,4 +1,5 @@
 #undef NDEBUG
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
@@ -52,6 +53,181 @@ int32_t test_fillsinks_filled(Grid filled) {
   return 0;
 }
 
+/*
+  The alternative fill algorithms should produce exactly the same
+  filled DEM as the reconstruction-based ones.
+ */
+int32_t test_fillsinks_eq(Grid filled, Grid filled_other) {
+  assert(GridEq(filled, filled_other));
+  return 0;
+}
+
+/*
+  Reconstructing the negated DEM from its boundary should reproduce the
+  negated filled DEM in fewer passes than the iteration limit.
+ */
+int32_t test_reconstruct_passes(Grid dem, Grid bc, Grid filled) {
+  ptrdiff_t n = dem.dims[0] * dem.dims[1];
+  std::vector<float> marker(n);
+  std::vector<float> mask(n);
+
+  for (ptrdiff_t p = 0; p < n; p++) {
+    mask[p] = -((float *)dem.data)[p];
+    marker[p] = ((uint8_t *)bc.data)[p] == 1 ? mask[p] : -INFINITY;
+  }
+
+  int32_t passes = tt::reconstruct(marker.data(), mask.data(), dem.dims);
+  assert(passes > 0 && passes < 1000);
+
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(-marker[p] == ((float *)filled.data)[p]);
+  }
+  return 0;
+}
+
+/*
+  Repairing the fill after editing part of the DEM should give the same
+  result as filling the edited DEM from scratch. The edits raise a
+  rectangle, lower a few scattered pixels and turn a pixel into a NaN,
+  and the flags must be cleared again after every repair.
+ */
+int32_t test_fillsinks_incremental(Grid dem, Grid bc, Grid filled,
+                                   uint32_t seed) {
+  ptrdiff_t *dims = dem.dims;
+  ptrdiff_t n = dims[0] * dims[1];
+
+  std::vector<float> edited((float *)dem.data, (float *)dem.data + n);
+  std::vector<float> output((float *)filled.data, (float *)filled.data + n);
+  std::vector<float> expected(n);
+  std::vector<ptrdiff_t> queue(n);
+  std::vector<uint8_t> flags(n, 0);
+
+  // Raise a rectangle in the middle of the DEM like an embankment
+  ptrdiff_t rect[4] = {dims[0] / 3, dims[0] / 2, dims[1] / 4, dims[1] / 3};
+  for (ptrdiff_t j = rect[2]; j < rect[3]; j++) {
+    for (ptrdiff_t i = rect[0]; i < rect[1]; i++) {
+      edited[j * dims[0] + i] += 5.0f;
+    }
+  }
+  tt::fillsinks_incremental_rect(output.data(), queue.data(), flags.data(),
+                                 edited.data(), (uint8_t *)bc.data, rect,
+                                 dims);
+  tt::fillsinks(expected.data(), edited.data(), (uint8_t *)bc.data, dims);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(flags[p] == 0);
+    assert(output[p] == expected[p] ||
+           (std::isnan(output[p]) && std::isnan(expected[p])));
+  }
+
+  // Lower scattered pixels like culverts and add a NaN
+  std::vector<ptrdiff_t> changed;
+  for (uint32_t k = 0; k < 20; k++) {
+    ptrdiff_t p = (ptrdiff_t)(pcg4d(k, seed, 2, 0) * n) % n;
+    edited[p] -= 2.0f;
+    changed.push_back(p);
+  }
+  edited[n / 2] = NAN;
+  changed.push_back(n / 2);
+
+  tt::fillsinks_incremental(output.data(), queue.data(), flags.data(),
+                            edited.data(), (uint8_t *)bc.data, changed.data(),
+                            changed.size(), dims);
+  tt::fillsinks(expected.data(), edited.data(), (uint8_t *)bc.data, dims);
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(flags[p] == 0);
+    assert(output[p] == expected[p] ||
+           (std::isnan(output[p]) && std::isnan(expected[p])));
+  }
+  return 0;
+}
+
+/*
+  The depression hierarchy should fill the DEM exactly like fillsinks,
+  parents should come after their children and contain them, and the
+  depressions draining to the outlet should account for every filled
+  pixel and the total fill volume.
+ */
+int32_t test_depression_hierarchy(Grid dem, Grid bc, Grid filled) {
+  ptrdiff_t *dims = dem.dims;
+  ptrdiff_t n = dims[0] * dims[1];
+  float *z = (float *)dem.data;
+
+  ptrdiff_t size = tt::depression_hierarchy_size(z, (uint8_t *)bc.data, dims);
+  std::vector<float> output(n);
+  std::vector<ptrdiff_t> labels(n);
+  std::vector<ptrdiff_t> queue(n);
+  std::vector<ptrdiff_t> pour_point(size);
+  std::vector<ptrdiff_t> parent(size);
+  std::vector<ptrdiff_t> cell_count(size);
+  std::vector<double> volume(size);
+  std::vector<float> max_depth(size);
+
+  ptrdiff_t node_count = tt::depression_hierarchy(
+      output.data(), labels.data(), queue.data(), pour_point.data(),
+      parent.data(), cell_count.data(), volume.data(), max_depth.data(), z,
+      (uint8_t *)bc.data, dims);
+  assert(node_count > 0 && node_count <= size);
+
+  double filled_volume = 0.0;
+  ptrdiff_t filled_count = 0;
+  for (ptrdiff_t p = 0; p < n; p++) {
+    assert(output[p] == ((float *)filled.data)[p]);
+    assert(labels[p] >= 0 && labels[p] < node_count);
+    if (output[p] > z[p]) {
+      filled_volume += output[p] - z[p];
+      filled_count++;
+    }
+  }
+
+  double root_volume = 0.0;
+  ptrdiff_t root_count = 0;
+  for (ptrdiff_t d = 1; d < node_count; d++) {
+    assert(max_depth[d] >= 0.0f);
+    assert(volume[d] >= 0.0);
+    if (parent[d] > 0) {
+      assert(parent[d] > d);
+      assert(cell_count[parent[d]] >= cell_count[d]);
+      assert(volume[parent[d]] >= volume[d]);
+    } else if (parent[d] == 0) {
+      assert(z[pour_point[d]] == output[pour_point[d]]);
+      root_volume += volume[d];
+      root_count += cell_count[d];
+    }
+  }
+  assert(root_count == filled_count);
+  assert(std::fabs(root_volume - filled_volume) <=
+         1e-4 * (1.0 + filled_volume));
+  return 0;
+}
+
+/*
+  A filled DEM has no pits. Its flats all drain, so the hierarchy must
+  consist of the outlet alone, even though the interior pixels of the
+  flats have no lower neighbor.
+ */
+int32_t test_depression_hierarchy_filled(Grid bc, Grid filled) {
+  ptrdiff_t *dims = filled.dims;
+  ptrdiff_t n = dims[0] * dims[1];
+  float *z = (float *)filled.data;
+
+  ptrdiff_t size = tt::depression_hierarchy_size(z, (uint8_t *)bc.data, dims);
+  std::vector<float> output(n);
+  std::vector<ptrdiff_t> labels(n);
+  std::vector<ptrdiff_t> queue(n);
+  std::vector<ptrdiff_t> pour_point(size);
+  std::vector<ptrdiff_t> parent(size);
+  std::vector<ptrdiff_t> cell_count(size);
+  std::vector<double> volume(size);
+  std::vector<float> max_depth(size);
+
+  ptrdiff_t node_count = tt::depression_hierarchy(
+      output.data(), labels.data(), queue.data(), pour_point.data(),
+      parent.data(), cell_count.data(), volume.data(), max_depth.data(), z,
+      (uint8_t *)bc.data, dims);
+  assert(node_count == 1);
+  return 0;
+}
+
 /*
   Every pixel not on the boundary with no lower neighbors and fewer than
   8 higher neighbors should be labeled a flat. Likewise, every flat
@@ -579,6 +755,713 @@ int32_t test_db_traverse(uint32_t *basins, ptrdiff_t *source, ptrdiff_t *target,
   return 0;
 }
 
+/*
+  A fused traversal must reproduce the individual kernels exactly.
+ */
+int32_t test_fused(ptrdiff_t *source, ptrdiff_t *target, float *fraction,
+                   ptrdiff_t edge_count, ptrdiff_t node_count) {
+  std::vector<float> length(edge_count);
+  std::vector<uint32_t> mask(edge_count);
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    length[e] = pcg4d(e, 0, 71, 0);
+    mask[e] = e % 3 ? 0xFFFFFFFFu : 0x0000FFFFu;
+  }
+  std::vector<float> init(node_count);
+  std::vector<uint32_t> bits(node_count);
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    init[u] = pcg4d(u, 0, 72, 0);
+    bits[u] = (uint32_t)1 << (u % 32);
+  }
+
+  std::vector<float> acc(init), max_add(init), min_add(init);
+  std::vector<float> strahler(node_count, 1.0f);
+  std::vector<uint32_t> or_and(bits);
+  tt::traverse_down_f32_add_mul(acc.data(), fraction, source, target,
+                                edge_count);
+  tt::traverse_down_f32_max_add(max_add.data(), length.data(), source, target,
+                                edge_count);
+  tt::traverse_down_f32_min_add(min_add.data(), length.data(), source, target,
+                                edge_count);
+  tt::traverse_down_f32_strahler(strahler.data(), NULL, source, target,
+                                 edge_count);
+  tt::traverse_down_u32_or_and(or_and.data(), mask.data(), source, target,
+                               edge_count);
+
+  std::vector<float> f_acc(init), f_max_add(init), f_min_add(init);
+  std::vector<float> f_strahler(node_count, 1.0f);
+  std::vector<uint32_t> f_or_and(bits);
+  void *output[5] = {f_acc.data(), f_max_add.data(), f_min_add.data(),
+                     f_strahler.data(), f_or_and.data()};
+  void *input[5] = {fraction, length.data(), length.data(), NULL,
+                    mask.data()};
+  uint8_t ops[5] = {tt::TRAVERSE_ADD_MUL, tt::TRAVERSE_MAX_ADD,
+                    tt::TRAVERSE_MIN_ADD, tt::TRAVERSE_STRAHLER,
+                    tt::TRAVERSE_OR_AND};
+  int result = tt::traverse_down_fused(output, input, ops, 5, source, target,
+                                       edge_count);
+  assert(result == 0);
+  assert(f_acc == acc);
+  assert(f_max_add == max_add);
+  assert(f_min_add == min_add);
+  assert(f_strahler == strahler);
+  assert(f_or_and == or_and);
+
+  std::vector<float> up_max_add(init);
+  std::vector<uint32_t> up_or_and(bits);
+  tt::traverse_up_f32_max_add(up_max_add.data(), length.data(), source, target,
+                              edge_count);
+  tt::traverse_up_u32_or_and(up_or_and.data(), mask.data(), source, target,
+                             edge_count);
+
+  std::vector<float> f_up_max_add(init);
+  std::vector<uint32_t> f_up_or_and(bits);
+  void *up_output[2] = {f_up_max_add.data(), f_up_or_and.data()};
+  void *up_input[2] = {length.data(), mask.data()};
+  uint8_t up_ops[2] = {tt::TRAVERSE_MAX_ADD, tt::TRAVERSE_OR_AND};
+  result = tt::traverse_up_fused(up_output, up_input, up_ops, 2, source,
+                                 target, edge_count);
+  assert(result == 0);
+  assert(f_up_max_add == up_max_add);
+  assert(f_up_or_and == up_or_and);
+
+  // Invalid programs are rejected without touching the outputs
+  void *missing_input[1] = {NULL};
+  uint8_t invalid_ops[1] = {tt::TRAVERSE_MAX_ADD};
+  result = tt::traverse_down_fused(up_output, missing_input, invalid_ops, 1,
+                                   source, target, edge_count);
+  assert(result == -1);
+  invalid_ops[0] = 255;
+  result = tt::traverse_up_fused(up_output, up_input, invalid_ops, 1, source,
+                                 target, edge_count);
+  assert(result == -1);
+  assert(f_up_max_add == up_max_add);
+  return 0;
+}
+
+/*
+  The batched kernels must match one call of the unbatched kernel per
+  plane. The comparison allows for rounding differences in case the
+  compiler contracts the scalar kernels into fused multiply-adds.
+ */
+static bool batch_close(float a, float b) {
+  return std::fabs(a - b) <= 1e-5f * std::max(1.0f, std::fabs(b));
+}
+
+int32_t test_batch(ptrdiff_t *source, ptrdiff_t *target, float *fraction,
+                   ptrdiff_t edge_count, ptrdiff_t node_count) {
+  // Not a multiple of the vector width, to exercise the scalar tail
+  const ptrdiff_t plane_count = 7;
+  ptrdiff_t node_dims[2] = {node_count, 1};
+
+  std::vector<float> planes(node_count * plane_count);
+  for (ptrdiff_t k = 0; k < plane_count; k++) {
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      planes[k * node_count + u] = pcg4d(u, k, 61, 0);
+    }
+  }
+  std::vector<float> interleaved(node_count * plane_count);
+  tt::interleave_planes_f32(interleaved.data(), planes.data(), node_count,
+                            plane_count);
+  std::vector<float> roundtrip(node_count * plane_count);
+  tt::deinterleave_planes_f32(roundtrip.data(), interleaved.data(),
+                              node_count, plane_count);
+  assert(roundtrip == planes);
+
+  std::vector<float> acc(node_count * plane_count);
+  tt::flow_accumulation_edgelist_batch(acc.data(), source, target, fraction,
+                                       interleaved.data(), edge_count,
+                                       node_count, plane_count);
+
+  std::vector<float> integral(node_count * plane_count, 0.0f);
+  tt::streamquad_trapz_f32_batch(integral.data(), interleaved.data(), source,
+                                 target, fraction, edge_count, plane_count);
+
+  std::vector<float> add_mul(interleaved);
+  tt::traverse_down_f32_add_mul_batch(add_mul.data(), fraction, source,
+                                      target, edge_count, plane_count);
+
+  std::vector<float> expected(node_count);
+  for (ptrdiff_t k = 0; k < plane_count; k++) {
+    float *plane = planes.data() + k * node_count;
+
+    tt::flow_accumulation_edgelist(expected.data(), source, target, fraction,
+                                   plane, edge_count, node_dims);
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      assert(batch_close(acc[u * plane_count + k], expected[u]));
+    }
+
+    std::fill(expected.begin(), expected.end(), 0.0f);
+    tt::streamquad_trapz_f32(expected.data(), plane, source, target, fraction,
+                             edge_count);
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      assert(batch_close(integral[u * plane_count + k], expected[u]));
+    }
+
+    std::copy(plane, plane + node_count, expected.begin());
+    tt::traverse_down_f32_add_mul(expected.data(), fraction, source, target,
+                                  edge_count);
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      assert(batch_close(add_mul[u * plane_count + k], expected[u]));
+    }
+  }
+  return 0;
+}
+
+/*
+  Renumbering must produce a permutation of the nodes under which the
+  traversal kernels give the same results as on the original
+  numbering.
+ */
+int32_t test_renumber(ptrdiff_t *source, ptrdiff_t *target, float *fraction,
+                      ptrdiff_t edge_count, ptrdiff_t dims[2]) {
+  ptrdiff_t node_count = dims[0] * dims[1];
+
+  std::vector<float> init(node_count);
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    init[u] = pcg4d(u, 0, 51, 0);
+  }
+  std::vector<float> expected(init);
+  tt::traverse_down_f32_add_mul(expected.data(), fraction, source, target,
+                                edge_count);
+
+  for (ptrdiff_t block_size : {(ptrdiff_t)1, (ptrdiff_t)8,
+                               std::max(dims[0], dims[1])}) {
+    std::vector<ptrdiff_t> new_to_old(node_count);
+    std::vector<ptrdiff_t> old_to_new(node_count);
+    std::vector<ptrdiff_t> new_source(edge_count);
+    std::vector<ptrdiff_t> new_target(edge_count);
+    int result = tt::edgelist_renumber(
+        new_to_old.data(), old_to_new.data(), new_source.data(),
+        new_target.data(), source, target, edge_count, dims, block_size);
+    assert(result == 0);
+
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      assert(old_to_new[u] >= 0 && old_to_new[u] < node_count);
+      assert(new_to_old[old_to_new[u]] == u);
+    }
+    for (ptrdiff_t e = 0; e < edge_count; e++) {
+      assert(new_to_old[new_source[e]] == source[e]);
+      assert(new_to_old[new_target[e]] == target[e]);
+    }
+
+    std::vector<float> permuted(node_count);
+    tt::permute_gather_f32(permuted.data(), init.data(), new_to_old.data(),
+                           node_count);
+    tt::traverse_down_f32_add_mul(permuted.data(), fraction,
+                                  new_source.data(), new_target.data(),
+                                  edge_count);
+    std::vector<float> output(node_count);
+    tt::permute_scatter_f32(output.data(), permuted.data(), new_to_old.data(),
+                            node_count);
+    assert(output == expected);
+  }
+  return 0;
+}
+
+/*
+  The level-scheduled kernels must reproduce the serial kernels
+  exactly, on single as well as multiple flow direction networks.
+ */
+int32_t test_level_schedule(ptrdiff_t *source, ptrdiff_t *target,
+                            float *fraction, ptrdiff_t edge_count,
+                            ptrdiff_t node_count) {
+  std::vector<ptrdiff_t> level_offsets(node_count + 1);
+  std::vector<ptrdiff_t> level_nodes(node_count);
+  std::vector<ptrdiff_t> edge_offsets(node_count + 1);
+  std::vector<ptrdiff_t> edges(edge_count);
+
+  std::vector<float> input(edge_count);
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    input[e] = pcg4d(e, 0, 41, 0);
+  }
+  std::vector<float> init(node_count);
+  std::vector<float> order(node_count, 1.0f);
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    init[u] = pcg4d(u, 0, 42, 0);
+  }
+
+  ptrdiff_t node_dims[2] = {node_count, 1};
+  std::vector<float> acc(node_count);
+  tt::flow_accumulation_edgelist(acc.data(), source, target, fraction,
+                                 init.data(), edge_count, node_dims);
+  std::vector<float> down_max_add(init);
+  tt::traverse_down_f32_max_add(down_max_add.data(), input.data(), source,
+                                target, edge_count);
+  std::vector<float> down_min_add(init);
+  tt::traverse_down_f32_min_add(down_min_add.data(), input.data(), source,
+                                target, edge_count);
+  std::vector<float> strahler(order);
+  tt::traverse_down_f32_strahler(strahler.data(), NULL, source, target,
+                                 edge_count);
+  std::vector<float> up_max_add(init);
+  tt::traverse_up_f32_max_add(up_max_add.data(), input.data(), source, target,
+                              edge_count);
+
+  ptrdiff_t level_count = tt::edgelist_level_schedule(
+      level_offsets.data(), level_nodes.data(), edge_offsets.data(),
+      edges.data(), source, target, edge_count, node_count, 0);
+  assert(level_count >= 0);
+
+  for (int num_threads : {1, 2, 3}) {
+    std::vector<float> output(node_count);
+    tt::flow_accumulation_edgelist_levels(
+        output.data(), source, fraction, init.data(), level_offsets.data(),
+        level_nodes.data(), edge_offsets.data(), edges.data(), level_count,
+        node_count, num_threads);
+    assert(output == acc);
+
+    output = init;
+    tt::traverse_down_f32_max_add_levels(
+        output.data(), input.data(), source, level_offsets.data(),
+        level_nodes.data(), edge_offsets.data(), edges.data(), level_count,
+        num_threads);
+    assert(output == down_max_add);
+
+    output = init;
+    tt::traverse_down_f32_min_add_levels(
+        output.data(), input.data(), source, level_offsets.data(),
+        level_nodes.data(), edge_offsets.data(), edges.data(), level_count,
+        num_threads);
+    assert(output == down_min_add);
+
+    output = order;
+    tt::traverse_down_f32_strahler_levels(
+        output.data(), source, level_offsets.data(), level_nodes.data(),
+        edge_offsets.data(), edges.data(), level_count, num_threads);
+    assert(output == strahler);
+  }
+
+  level_count = tt::edgelist_level_schedule(
+      level_offsets.data(), level_nodes.data(), edge_offsets.data(),
+      edges.data(), source, target, edge_count, node_count, 1);
+  assert(level_count >= 0);
+
+  for (int num_threads : {1, 2, 3}) {
+    std::vector<float> output(init);
+    tt::traverse_up_f32_max_add_levels(
+        output.data(), input.data(), target, level_offsets.data(),
+        level_nodes.data(), edge_offsets.data(), edges.data(), level_count,
+        num_threads);
+    assert(output == up_max_add);
+  }
+  return 0;
+}
+
+/*
+  A random multiple flow direction network on node_count nodes. Edges
+  always point to a node with a larger index and are emitted in order
+  of their source, which is a topological order.
+ */
+void random_multiflow(std::vector<ptrdiff_t> &source,
+                      std::vector<ptrdiff_t> &target,
+                      std::vector<float> &fraction, ptrdiff_t node_count,
+                      uint32_t seed) {
+  for (ptrdiff_t u = 0; u < node_count - 1; u++) {
+    ptrdiff_t degree = 1 + (ptrdiff_t)(3 * pcg4d(u, seed, 43, 0));
+    for (ptrdiff_t d = 0; d < degree; d++) {
+      ptrdiff_t span = std::min<ptrdiff_t>(50, node_count - 1 - u);
+      ptrdiff_t v = u + 1 + (ptrdiff_t)(span * pcg4d(u, seed, 44, d));
+      source.push_back(u);
+      target.push_back(std::min(v, node_count - 1));
+      fraction.push_back(1.0f / degree);
+    }
+  }
+}
+
+/*
+  The interval index must answer upstream and catchment queries
+  exactly as an upstream traversal with traverse_up_u32_or_and, and it
+  must reject networks in which a node has more than one receiver.
+ */
+int32_t test_upstream_index(ptrdiff_t *source, ptrdiff_t *target,
+                            ptrdiff_t edge_count, ptrdiff_t node_count) {
+  std::vector<ptrdiff_t> preorder(node_count);
+  std::vector<ptrdiff_t> subtree_size(node_count);
+  std::vector<ptrdiff_t> order(node_count);
+
+  bool single_flow = true;
+  {
+    std::vector<uint8_t> has_receiver(node_count, 0);
+    for (ptrdiff_t e = 0; e < edge_count; e++) {
+      single_flow = single_flow && !has_receiver[source[e]];
+      has_receiver[source[e]] = 1;
+    }
+  }
+  int result = tt::upstream_index(preorder.data(), subtree_size.data(),
+                                  order.data(), source, target, edge_count,
+                                  node_count);
+  if (!single_flow) {
+    assert(result == -1);
+    return 0;
+  }
+  assert(result == 0);
+
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    assert(order[preorder[u]] == u);
+  }
+
+  // Each bit of the traversal output marks the catchment of one of
+  // the gauges
+  const ptrdiff_t gauge_count = 8;
+  std::vector<ptrdiff_t> gauges(gauge_count);
+  std::vector<uint32_t> upstream(node_count, 0);
+  for (ptrdiff_t k = 0; k < gauge_count; k++) {
+    gauges[k] = (ptrdiff_t)(pcg4d(k, 0, 61, 0) * node_count) % node_count;
+    upstream[gauges[k]] |= 1u << k;
+  }
+  std::vector<uint32_t> ones(edge_count, 0xFFFFFFFFu);
+  tt::traverse_up_u32_or_and(upstream.data(), ones.data(), source, target,
+                             edge_count);
+
+  for (ptrdiff_t k = 0; k < gauge_count; k++) {
+    std::vector<ptrdiff_t> nodes(node_count);
+    std::vector<ptrdiff_t> outlets(node_count, gauges[k]);
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      nodes[u] = u;
+    }
+    for (int num_threads : {1, 2, 3}) {
+      std::vector<uint8_t> answer(node_count);
+      tt::upstream_index_query(answer.data(), nodes.data(), outlets.data(),
+                               node_count, preorder.data(),
+                               subtree_size.data(), num_threads);
+      for (ptrdiff_t u = 0; u < node_count; u++) {
+        assert(answer[u] == ((upstream[u] >> k) & 1));
+      }
+    }
+
+    std::vector<ptrdiff_t> catchment(node_count);
+    ptrdiff_t count = tt::upstream_index_catchment(
+        catchment.data(), &gauges[k], 1, preorder.data(), subtree_size.data(),
+        order.data());
+    assert(count == subtree_size[gauges[k]]);
+    for (ptrdiff_t i = 0; i < count; i++) {
+      assert((upstream[catchment[i]] >> k) & 1);
+    }
+  }
+
+  // The catchment of all gauges together is their union, without
+  // duplicates
+  std::vector<ptrdiff_t> catchment(node_count);
+  ptrdiff_t count = tt::upstream_index_catchment(
+      catchment.data(), gauges.data(), gauge_count, preorder.data(),
+      subtree_size.data(), order.data());
+  ptrdiff_t expected_count = 0;
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    expected_count += upstream[u] != 0;
+  }
+  assert(count == expected_count);
+  for (ptrdiff_t i = 0; i < count; i++) {
+    assert(upstream[catchment[i]] != 0);
+    assert(i == 0 || preorder[catchment[i]] > preorder[catchment[i - 1]]);
+  }
+  return 0;
+}
+
+/*
+  Batch flow path tracing must reproduce the paths, lengths and drops
+  obtained by following the receivers from every starting pixel
+  separately, while storing every pixel only once.
+ */
+int32_t test_flowpaths(uint8_t *direction, float *dem, float cellsize,
+                       ptrdiff_t dims[2]) {
+  ptrdiff_t node_count = dims[0] * dims[1];
+  std::vector<ptrdiff_t> receiver(node_count);
+  tt::flow_routing_d8_receivers(receiver.data(), direction, dims, 0);
+
+  // Include a duplicate start to exercise empty segments
+  const ptrdiff_t start_count = 64;
+  std::vector<ptrdiff_t> starts(start_count);
+  for (ptrdiff_t k = 0; k < start_count; k++) {
+    starts[k] = (ptrdiff_t)(pcg4d(k, 0, 91, 0) * node_count) % node_count;
+  }
+  starts[start_count - 1] = starts[0];
+
+  std::vector<ptrdiff_t> path_offsets(start_count + 1);
+  std::vector<ptrdiff_t> path_nodes(node_count);
+  std::vector<ptrdiff_t> path_junction(start_count);
+  std::vector<ptrdiff_t> path_parent(start_count);
+  std::vector<ptrdiff_t> position(node_count, -1);
+  std::vector<float> distance(node_count);
+  std::vector<float> path_length(start_count);
+  std::vector<float> path_drop(start_count);
+
+  for (int pass = 0; pass < 2; pass++) {
+    ptrdiff_t count = tt::flowpaths_trace(
+        path_offsets.data(), path_nodes.data(), path_junction.data(),
+        path_parent.data(), position.data(), distance.data(),
+        path_length.data(), path_drop.data(), starts.data(), start_count,
+        receiver.data(), dem, cellsize, dims);
+    assert(count == path_offsets[start_count]);
+
+    std::vector<uint8_t> on_path(node_count, 0);
+    ptrdiff_t union_count = 0;
+
+    for (ptrdiff_t k = 0; k < start_count; k++) {
+      // Expand the packed path
+      std::vector<ptrdiff_t> packed;
+      ptrdiff_t segment = k;
+      ptrdiff_t p = path_offsets[k];
+      while (true) {
+        for (; p < path_offsets[segment + 1]; p++) {
+          packed.push_back(path_nodes[p]);
+        }
+        if (path_junction[segment] < 0) {
+          break;
+        }
+        p = path_junction[segment];
+        segment = path_parent[segment];
+        assert(p >= path_offsets[segment] && p < path_offsets[segment + 1]);
+      }
+
+      // Follow the receivers directly
+      std::vector<ptrdiff_t> traced;
+      float length = 0.0f;
+      ptrdiff_t u = starts[k];
+      while (true) {
+        traced.push_back(u);
+        if (!on_path[u]) {
+          on_path[u] = 1;
+          union_count++;
+        }
+        ptrdiff_t v = receiver[u];
+        if (v == u) {
+          break;
+        }
+        bool diagonal =
+            u % dims[0] != v % dims[0] && u / dims[0] != v / dims[0];
+        length += diagonal ? SQRT2f * cellsize : cellsize;
+        u = v;
+      }
+
+      assert(packed == traced);
+      assert(std::abs(path_length[k] - length) <= 1e-4f * (1.0f + length));
+      assert(path_drop[k] == dem[starts[k]] - dem[u]);
+    }
+    assert(count == union_count);
+
+    // Reset only the traced pixels for the next pass
+    for (ptrdiff_t p = 0; p < count; p++) {
+      position[path_nodes[p]] = -1;
+    }
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      assert(position[u] == -1);
+    }
+  }
+  return 0;
+}
+
+/*
+  On a grid with two rows, the linear offset of a diagonal step from
+  the second row to the first row of the next column is 1, the same
+  as that of a vertical step.
+ */
+int32_t test_flowpaths_narrow() {
+  ptrdiff_t dims[2] = {2, 3};
+  std::vector<ptrdiff_t> receiver = {0, 2, 2, 2, 4, 5};
+  std::vector<float> dem = {0.0f, 2.0f, 1.0f, 3.0f, 4.0f, 5.0f};
+  ptrdiff_t starts[2] = {1, 3};
+
+  std::vector<ptrdiff_t> path_offsets(3);
+  std::vector<ptrdiff_t> path_nodes(6);
+  std::vector<ptrdiff_t> path_junction(2);
+  std::vector<ptrdiff_t> path_parent(2);
+  std::vector<ptrdiff_t> position(6, -1);
+  std::vector<float> distance(6);
+  std::vector<float> path_length(2);
+  tt::flowpaths_trace(path_offsets.data(), path_nodes.data(),
+                      path_junction.data(), path_parent.data(),
+                      position.data(), distance.data(), path_length.data(),
+                      NULL, starts, 2, receiver.data(), dem.data(), 1.0f,
+                      dims);
+  assert(path_length[0] == SQRT2f);
+  assert(path_length[1] == 1.0f);
+  return 0;
+}
+
+/*
+  Extracting the stream network with edgelist_extract_subgraph must
+  select the same nodes and edges as the serial extraction in
+  streamnetwork, for any number of threads. The subgraph numbers the
+  nodes in pixel order rather than topological order, so the two are
+  compared through the node maps.
+ */
+int32_t test_extract_subgraph(ptrdiff_t *source, ptrdiff_t *target,
+                              ptrdiff_t edge_count, float *accum,
+                              float threshold, ptrdiff_t *stream_source,
+                              ptrdiff_t *stream_target, ptrdiff_t *stream_grid,
+                              ptrdiff_t stream_edge_count,
+                              ptrdiff_t stream_node_count,
+                              ptrdiff_t node_count) {
+  std::vector<uint8_t> mask(node_count);
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    mask[u] = accum[u] >= threshold;
+  }
+
+  for (int num_threads : {1, 2, 3}) {
+    std::vector<ptrdiff_t> sub_source(edge_count);
+    std::vector<ptrdiff_t> sub_target(edge_count);
+    std::vector<ptrdiff_t> edge_map(edge_count);
+    std::vector<ptrdiff_t> node_map(node_count);
+    std::vector<ptrdiff_t> node_index(node_count);
+    ptrdiff_t sub_edge_count = -1;
+    ptrdiff_t sub_node_count = tt::edgelist_extract_subgraph(
+        sub_source.data(), sub_target.data(), edge_map.data(),
+        node_map.data(), node_index.data(), &sub_edge_count, mask.data(),
+        source, target, edge_count, node_count, num_threads);
+
+    assert(sub_node_count == stream_node_count);
+    assert(sub_edge_count == stream_edge_count);
+
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      assert((node_index[u] >= 0) == (stream_grid[u] >= 0));
+      if (node_index[u] >= 0) {
+        assert(node_map[node_index[u]] == u);
+      }
+    }
+    for (ptrdiff_t k = 0; k < sub_edge_count; k++) {
+      assert(k == 0 || edge_map[k] > edge_map[k - 1]);
+      assert(node_map[sub_source[k]] == source[edge_map[k]]);
+      assert(node_map[sub_target[k]] == target[edge_map[k]]);
+      assert(stream_grid[node_map[sub_source[k]]] == stream_source[k]);
+      assert(stream_grid[node_map[sub_target[k]]] == stream_target[k]);
+    }
+  }
+  return 0;
+}
+
+/*
+  Partitioning the edge list by drainage basin must preserve the
+  topological order within each basin, so that the parallel kernels
+  reproduce the serial ones exactly.
+ */
+int32_t test_edgelist_partition(ptrdiff_t *source, ptrdiff_t *target,
+                                float *fraction, ptrdiff_t edge_count,
+                                ptrdiff_t dims[2]) {
+  ptrdiff_t node_count = dims[0] * dims[1];
+
+  std::vector<ptrdiff_t> offsets(edge_count + 1);
+  std::vector<ptrdiff_t> permutation(edge_count);
+  std::vector<ptrdiff_t> psource(edge_count);
+  std::vector<ptrdiff_t> ptarget(edge_count);
+  std::vector<ptrdiff_t> basins(node_count);
+  ptrdiff_t segment_count = tt::edgelist_partition_basins(
+      offsets.data(), permutation.data(), psource.data(), ptarget.data(),
+      basins.data(), source, target, edge_count, node_count);
+  assert(segment_count >= 0);
+  assert(offsets[0] == 0);
+  assert(offsets[segment_count] == edge_count);
+
+  bool single_flow = true;
+  {
+    std::vector<uint8_t> has_receiver(node_count, 0);
+    for (ptrdiff_t e = 0; e < edge_count; e++) {
+      single_flow = single_flow && !has_receiver[source[e]];
+      has_receiver[source[e]] = 1;
+    }
+  }
+
+  if (single_flow) {
+    std::vector<ptrdiff_t> expected_basins(node_count);
+    tt::drainagebasins(expected_basins.data(), source, target, edge_count,
+                       dims);
+    for (ptrdiff_t u = 0; u < node_count; u++) {
+      assert(basins[u] == expected_basins[u]);
+    }
+  }
+
+  // Both endpoints of every edge lie in the same basin
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    assert(basins[source[e]] > 0);
+    assert(basins[source[e]] == basins[target[e]]);
+  }
+
+  for (ptrdiff_t s = 0; s < segment_count; s++) {
+    assert(offsets[s + 1] > offsets[s]);
+    if (s > 0) {
+      // Largest segments first
+      assert(offsets[s + 1] - offsets[s] <= offsets[s] - offsets[s - 1]);
+    }
+    ptrdiff_t label = basins[psource[offsets[s]]];
+    for (ptrdiff_t e = offsets[s]; e < offsets[s + 1]; e++) {
+      assert(psource[e] == source[permutation[e]]);
+      assert(ptarget[e] == target[permutation[e]]);
+      assert(basins[psource[e]] == label);
+      if (e > offsets[s]) {
+        assert(permutation[e] > permutation[e - 1]);
+      }
+    }
+  }
+
+  std::vector<float> pfraction(edge_count);
+  std::vector<float> input(edge_count);
+  std::vector<float> pinput(edge_count);
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    input[e] = pcg4d(e, 0, 31, 0);
+  }
+  for (ptrdiff_t e = 0; e < edge_count; e++) {
+    pfraction[e] = fraction[permutation[e]];
+    pinput[e] = input[permutation[e]];
+  }
+
+  std::vector<float> init(node_count);
+  for (ptrdiff_t u = 0; u < node_count; u++) {
+    init[u] = pcg4d(u, 0, 32, 0);
+  }
+
+  std::vector<float> acc(node_count);
+  tt::flow_accumulation_edgelist(acc.data(), source, target, fraction,
+                                 init.data(), edge_count, dims);
+  std::vector<float> down_max_add(init);
+  tt::traverse_down_f32_max_add(down_max_add.data(), input.data(), source,
+                                target, edge_count);
+  std::vector<float> up_max_add(init);
+  tt::traverse_up_f32_max_add(up_max_add.data(), input.data(), source, target,
+                              edge_count);
+  std::vector<float> down_add_mul(init);
+  tt::traverse_down_f32_add_mul(down_add_mul.data(), input.data(), source,
+                                target, edge_count);
+  std::vector<float> integral(init);
+  tt::streamquad_trapz_f32(integral.data(), init.data(), source, target,
+                           input.data(), edge_count);
+
+  for (int num_threads : {1, 2, 3}) {
+    std::vector<float> output(node_count);
+    tt::flow_accumulation_edgelist_parallel(
+        output.data(), psource.data(), ptarget.data(), pfraction.data(),
+        init.data(), offsets.data(), segment_count, node_count, num_threads);
+    assert(output == acc);
+
+    output = init;
+    tt::traverse_down_f32_max_add_parallel(output.data(), pinput.data(),
+                                           psource.data(), ptarget.data(),
+                                           offsets.data(), segment_count,
+                                           num_threads);
+    assert(output == down_max_add);
+
+    output = init;
+    tt::traverse_up_f32_max_add_parallel(output.data(), pinput.data(),
+                                         psource.data(), ptarget.data(),
+                                         offsets.data(), segment_count,
+                                         num_threads);
+    assert(output == up_max_add);
+
+    output = init;
+    tt::traverse_down_f32_add_mul_parallel(output.data(), pinput.data(),
+                                           psource.data(), ptarget.data(),
+                                           offsets.data(), segment_count,
+                                           num_threads);
+    assert(output == down_add_mul);
+
+    output = init;
+    tt::streamquad_trapz_f32_parallel(output.data(), init.data(),
+                                      psource.data(), ptarget.data(),
+                                      pinput.data(), offsets.data(),
+                                      segment_count, num_threads);
+    assert(output == integral);
+  }
+  return 0;
+}
+
 struct FlowRoutingData {
   std::array<ptrdiff_t, 2> dims;
   float cellsize;
@@ -679,6 +1562,119 @@ struct FlowRoutingData {
                   (uint8_t *)bc.data, dims.data());
   }
 
+  void fillsinks_parallel(ptrdiff_t tile_dims[2], Grid &output) {
+    ProfileFunction(prof);
+    output = GridCreate(GridF32, NULL, dem.cellsize, dem.dims);
+
+    tt::fillsinks_parallel((float *)output.data, (float *)dem.data,
+                           (uint8_t *)bc.data, dims.data(), tile_dims, 2);
+  }
+
+  void fillsinks_priorityflood(Grid &output) {
+    ProfileFunction(prof);
+    output = GridCreate(GridF32, NULL, dem.cellsize, dem.dims);
+    Grid queue = GridCreate(GridIdx, NULL, dem.cellsize, dem.dims);
+
+    tt::fillsinks_priorityflood((float *)output.data, (ptrdiff_t *)queue.data,
+                                (float *)dem.data, (uint8_t *)bc.data,
+                                dims.data());
+    GridFree(&queue);
+  }
+
+  void gwdt_computecosts_parallel(int num_threads, Grid &output_costs,
+                                  Grid &output_conncomps) {
+    ProfileFunction(prof);
+    output_costs = GridZerosLike(dem);
+    output_conncomps = GridCreate(GridIdx, NULL, dem.cellsize, dem.dims);
+
+    tt::gwdt_computecosts_parallel(
+        (float *)output_costs.data, (ptrdiff_t *)output_conncomps.data,
+        (int32_t *)flats.data, (float *)dem.data, (float *)filled_dem.data,
+        dims.data(), num_threads);
+  }
+
+  void gwdt_bucketed(Grid &output_dist, Grid &output_prev) {
+    ProfileFunction(prof);
+    output_dist = GridZerosLike(costs);
+    output_prev = GridCreate(GridIdx, NULL, dist.cellsize, dist.dims);
+
+    ptrdiff_t counters[4];
+    tt::gwdt_bucketed((float *)output_dist.data, (ptrdiff_t *)output_prev.data,
+                      (float *)costs.data, (int32_t *)flats.data,
+                      (ptrdiff_t *)heap.data, (ptrdiff_t *)back.data,
+                      dims.data(), counters);
+
+    // Moves between buckets count as insertions, so there are at
+    // least as many insertions as removals
+    assert(counters[1] <= counters[0]);
+  }
+
+  /*
+    A single expensive flat pixel makes the range of costs too wide
+    for one bucket per flat pixel, so gwdt_bucketed has to widen its
+    buckets. The distances must still match those of gwdt, and no
+    pixel may be removed from the queue more than once.
+   */
+  void test_gwdt_bucketed_widened() {
+    ptrdiff_t n = dims[0] * dims[1];
+    std::vector<float> wide_costs((float *)costs.data,
+                                  (float *)costs.data + n);
+    for (ptrdiff_t p = 0; p < n; p++) {
+      if (((int32_t *)flats.data)[p] & 1) {
+        wide_costs[p] *= 1e6f;
+        break;
+      }
+    }
+
+    std::vector<float> expected(n);
+    std::vector<float> wide_dist(n);
+    tt::gwdt(expected.data(), NULL, wide_costs.data(), (int32_t *)flats.data,
+             (ptrdiff_t *)heap.data, (ptrdiff_t *)back.data, dims.data());
+
+    ptrdiff_t counters[4];
+    tt::gwdt_bucketed(wide_dist.data(), NULL, wide_costs.data(),
+                      (int32_t *)flats.data, (ptrdiff_t *)heap.data,
+                      (ptrdiff_t *)back.data, dims.data(), counters);
+    for (ptrdiff_t p = 0; p < n; p++) {
+      assert(wide_dist[p] == expected[p]);
+    }
+    assert(counters[3] == 0);
+  }
+
+  // Costs so small that the bucket index of a distance would
+  // overflow must fall back to the binary heap
+  void test_gwdt_bucketed_tiny_costs() {
+    ptrdiff_t n = dims[0] * dims[1];
+    std::vector<float> tiny_costs((float *)costs.data,
+                                  (float *)costs.data + n);
+    for (ptrdiff_t p = 0; p < n; p++) {
+      tiny_costs[p] *= 1e-40f;
+    }
+
+    std::vector<float> expected(n);
+    std::vector<float> tiny_dist(n);
+    tt::gwdt(expected.data(), NULL, tiny_costs.data(), (int32_t *)flats.data,
+             (ptrdiff_t *)heap.data, (ptrdiff_t *)back.data, dims.data());
+    tt::gwdt_bucketed(tiny_dist.data(), NULL, tiny_costs.data(),
+                      (int32_t *)flats.data, (ptrdiff_t *)heap.data,
+                      (ptrdiff_t *)back.data, dims.data(), NULL);
+    for (ptrdiff_t p = 0; p < n; p++) {
+      assert(tiny_dist[p] == expected[p]);
+    }
+  }
+
+  void gwdt_parallel(int num_threads, Grid &output_dist, Grid &output_prev) {
+    ProfileFunction(prof);
+    output_dist = GridZerosLike(costs);
+    output_prev = GridCreate(GridIdx, NULL, dist.cellsize, dist.dims);
+
+    int result = tt::gwdt_parallel(
+        (float *)output_dist.data, (ptrdiff_t *)output_prev.data,
+        (float *)costs.data, (int32_t *)flats.data,
+        (ptrdiff_t *)conncomps.data, dims.data(), num_threads);
+    assert(result == 0);
+  }
+
   void route_flow(bool hybrid) {
     ProfileFunction(prof);
 
@@ -784,20 +1780,95 @@ struct FlowRoutingData {
   }
 
   void runtests(bool hybrid) {
+    Grid original_dem = GridCopy(dem);
     route_flow(hybrid);
 
+    // fillsinks and fillsinks_hybrid must leave the DEM untouched
+    assert(GridEq(dem, original_dem));
+    GridFree(&original_dem);
+
     test_fillsinks_ge(dem, filled_dem);
     test_fillsinks_filled(filled_dem);
 
+    // Tiles that do and do not evenly divide the DEM, including tiles
+    // too thin to have an interior
+    ptrdiff_t tile_sizes[4][2] = {{16, 16}, {7, 33}, {2, 50}, {0, 0}};
+    for (auto &tile_dims : tile_sizes) {
+      Grid filled_parallel;
+      fillsinks_parallel(tile_dims, filled_parallel);
+      test_fillsinks_eq(filled_dem, filled_parallel);
+      GridFree(&filled_parallel);
+    }
+
+    test_reconstruct_passes(dem, bc, filled_dem);
+
+    Grid filled_pf;
+    fillsinks_priorityflood(filled_pf);
+    test_fillsinks_eq(filled_dem, filled_pf);
+    GridFree(&filled_pf);
+
+    test_fillsinks_incremental(dem, bc, filled_dem, dims[0] + dims[1]);
+    test_depression_hierarchy(dem, bc, filled_dem);
+    test_depression_hierarchy_filled(bc, filled_dem);
+
     test_identifyflats_flats(flats, filled_dem);
     test_identifyflats_sills(flats, filled_dem);
     test_identifyflats_presills(flats, filled_dem);
 
+    for (int num_threads : {2, 3, (int)dims[1]}) {
+      std::vector<int32_t> flats_parallel(dims[0] * dims[1]);
+      ptrdiff_t count = tt::identifyflats_parallel(
+          flats_parallel.data(), (float *)filled_dem.data, dims.data(),
+          num_threads);
+      ptrdiff_t expected_count = 0;
+      for (ptrdiff_t p = 0; p < dims[0] * dims[1]; p++) {
+        assert(flats_parallel[p] == ((int32_t *)flats.data)[p]);
+        expected_count += flats_parallel[p] & 1;
+      }
+      assert(count == expected_count);
+    }
+
     test_gwdt_costs(costs, flats);
     test_gwdt_conncomps(conncomps, flats);
 
+    // Block counts that do and do not evenly divide the DEM, including
+    // blocks one column wide
+    for (int num_threads : {1, 2, 3, 7, (int)dims[1]}) {
+      Grid costs_parallel;
+      Grid conncomps_parallel;
+      gwdt_computecosts_parallel(num_threads, costs_parallel,
+                                 conncomps_parallel);
+      assert(GridEq(costs, costs_parallel));
+      for (ptrdiff_t p = 0; p < dims[0] * dims[1]; p++) {
+        assert(((ptrdiff_t *)conncomps.data)[p] ==
+               ((ptrdiff_t *)conncomps_parallel.data)[p]);
+      }
+      GridFree(&costs_parallel);
+      GridFree(&conncomps_parallel);
+    }
+
     test_gwdt(dist, prev, costs, flats);
 
+    Grid dist_bucketed;
+    Grid prev_bucketed;
+    gwdt_bucketed(dist_bucketed, prev_bucketed);
+    test_gwdt(dist_bucketed, prev_bucketed, costs, flats);
+    assert(GridEq(dist, dist_bucketed));
+    GridFree(&dist_bucketed);
+    GridFree(&prev_bucketed);
+    test_gwdt_bucketed_widened();
+    test_gwdt_bucketed_tiny_costs();
+
+    for (int num_threads : {1, 3}) {
+      Grid dist_parallel;
+      Grid prev_parallel;
+      gwdt_parallel(num_threads, dist_parallel, prev_parallel);
+      test_gwdt(dist_parallel, prev_parallel, costs, flats);
+      assert(GridEq(dist, dist_parallel));
+      GridFree(&dist_parallel);
+      GridFree(&prev_parallel);
+    }
+
     // route_flow and route_flow_hybrid do not compute gradients
     gradient8();
     gradient8_mp();
@@ -807,6 +1878,19 @@ struct FlowRoutingData {
 
     test_routeflowd8_direction(direction, filled_dem);
 
+    for (int num_threads : {2, 3}) {
+      std::vector<ptrdiff_t> node_parallel(dims[0] * dims[1]);
+      std::vector<uint8_t> direction_parallel(dims[0] * dims[1]);
+      tt::flow_routing_d8_carve_parallel(
+          node_parallel.data(), direction_parallel.data(),
+          (float *)filled_dem.data, (float *)dist.data, (int32_t *)flats.data,
+          dims.data(), 0, num_threads);
+      for (ptrdiff_t p = 0; p < dims[0] * dims[1]; p++) {
+        assert(node_parallel[p] == ((ptrdiff_t *)fd.stream)[p]);
+        assert(direction_parallel[p] == ((uint8_t *)direction.data)[p]);
+      }
+    }
+
     test_tsort(fd);
 
     test_flow_routing_targets((ptrdiff_t *)fd.target, (ptrdiff_t *)fd.source,
@@ -821,8 +1905,49 @@ struct FlowRoutingData {
 
     test_flow_accumulation_max(accum);
 
+    test_edgelist_partition((ptrdiff_t *)fd.source, (ptrdiff_t *)fd.target,
+                            fd.fraction, fd.count, dims.data());
+
+    test_level_schedule((ptrdiff_t *)fd.source, (ptrdiff_t *)fd.target,
+                        fd.fraction, fd.count, dims[0] * dims[1]);
+    test_renumber((ptrdiff_t *)fd.source, (ptrdiff_t *)fd.target, fd.fraction,
+                  fd.count, dims.data());
+    test_batch((ptrdiff_t *)fd.source, (ptrdiff_t *)fd.target, fd.fraction,
+               fd.count, dims[0] * dims[1]);
+    test_fused((ptrdiff_t *)fd.source, (ptrdiff_t *)fd.target, fd.fraction,
+               fd.count, dims[0] * dims[1]);
+    test_upstream_index((ptrdiff_t *)fd.source, (ptrdiff_t *)fd.target,
+                        fd.count, dims[0] * dims[1]);
+    test_flowpaths((uint8_t *)direction.data, (float *)filled_dem.data,
+                   cellsize, dims.data());
+    {
+      std::vector<ptrdiff_t> mf_source;
+      std::vector<ptrdiff_t> mf_target;
+      std::vector<float> mf_fraction;
+      random_multiflow(mf_source, mf_target, mf_fraction, dims[0] * dims[1],
+                       (uint32_t)dims[0]);
+      test_edgelist_partition(mf_source.data(), mf_target.data(),
+                              mf_fraction.data(), mf_source.size(),
+                              dims.data());
+      test_level_schedule(mf_source.data(), mf_target.data(),
+                          mf_fraction.data(), mf_source.size(),
+                          dims[0] * dims[1]);
+      test_batch(mf_source.data(), mf_target.data(), mf_fraction.data(),
+                 mf_source.size(), dims[0] * dims[1]);
+      test_fused(mf_source.data(), mf_target.data(), mf_fraction.data(),
+                 mf_source.size(), dims[0] * dims[1]);
+      test_upstream_index(mf_source.data(), mf_target.data(),
+                          mf_source.size(), dims[0] * dims[1]);
+    }
+
     // Generate stream network
     streamnetwork(dims[0] * dims[1] / 20.0f);
+    test_extract_subgraph((ptrdiff_t *)fd.source, (ptrdiff_t *)fd.target,
+                          fd.count, (float *)accum.data,
+                          dims[0] * dims[1] / 20.0f, stream_source.data(),
+                          stream_target.data(), stream_grid.data(),
+                          stream_source.size(), stream_node_count,
+                          dims[0] * dims[1]);
 
     std::vector<float> integrand(stream_node_count, 1.0f);
     std::vector<float> integral(stream_node_count, 0.0f);
@@ -925,6 +2050,19 @@ int main(int argc, char *argv[]) {
     dims[1] = std::stoll(argv[2]);
   }
 
+  {
+    // Node 2 drains the basins of both node 0 and node 7, which are
+    // only joined by the edge 0 -> 2.
+    std::vector<ptrdiff_t> source = {5, 0, 6, 0, 1, 7, 2};
+    std::vector<ptrdiff_t> target = {6, 1, 7, 2, 3, 2, 4};
+    std::vector<float> fraction = {1.0f, 0.5f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f};
+    ptrdiff_t merge_dims[2] = {8, 1};
+    test_edgelist_partition(source.data(), target.data(), fraction.data(),
+                            source.size(), merge_dims);
+  }
+
+  test_flowpaths_narrow();
+
   for (uint32_t test = 0; test < 100; test++) {
     FlowRoutingData frd(dims, 10.0, test);
 
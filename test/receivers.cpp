@@ -0,0 +1,141 @@
+#undef NDEBUG
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "utils.hpp"
+
+/*
+  The receiver array kernels are checked against the edge list
+  routines on the flow network of a random DEM, in both memory
+  orders and with both index types.
+ */
+int main(int argc, char *argv[]) {
+  ptrdiff_t dims_list[][2] = {{50, 80}, {3, 40}, {101, 7}};
+
+  for (auto &dims : dims_list) {
+    for (unsigned int order = 0; order < 2; order++) {
+      ptrdiff_t n = dims[0] * dims[1];
+      std::cout << "receivers " << dims[0] << "x" << dims[1] << " order "
+                << order << std::endl;
+
+      FlowNetwork net = random_flow_network(dims, 21, order);
+      std::vector<ptrdiff_t> &node = net.node;
+      std::vector<uint8_t> &direction = net.direction;
+      std::vector<ptrdiff_t> &source = net.source;
+      std::vector<ptrdiff_t> &target = net.target;
+      ptrdiff_t edge_count = source.size();
+
+      std::vector<ptrdiff_t> receiver(n);
+      flow_routing_d8_receivers(receiver.data(), direction.data(), dims,
+                                order);
+      std::vector<uint32_t> receiver32(n);
+      flow_routing_d8_receivers_idx32(receiver32.data(), direction.data(),
+                                      dims, order);
+      assert_equal(receiver32,
+                   std::vector<uint32_t>(receiver.begin(), receiver.end()));
+      std::vector<uint32_t> node32(node.begin(), node.end());
+
+      ptrdiff_t receiver_edges = 0;
+      for (ptrdiff_t u = 0; u < n; u++) {
+        receiver_edges += receiver[u] != u;
+      }
+      assert(receiver_edges == edge_count);
+      for (ptrdiff_t e = 0; e < edge_count; e++) {
+        assert(receiver[source[e]] == target[e]);
+      }
+
+      std::vector<float> weights(n);
+      std::vector<float> values(n);
+      std::vector<float> edge_input(edge_count);
+      std::vector<float> fraction(edge_count, 1.0f);
+      for (ptrdiff_t p = 0; p < n; p++) {
+        weights[p] = pcg4d(p, 0, 22, 0);
+        values[p] = pcg4d(p, 0, 23, 0);
+      }
+      for (ptrdiff_t e = 0; e < edge_count; e++) {
+        edge_input[e] = values[source[e]];
+      }
+
+      std::vector<float> expected_acc(n);
+      flow_accumulation_edgelist(expected_acc.data(), source.data(),
+                                 target.data(), fraction.data(),
+                                 weights.data(), edge_count, dims);
+      std::vector<float> acc(n);
+      flow_accumulation_receivers(acc.data(), receiver.data(), node.data(),
+                                  weights.data(), n);
+      assert_equal(acc, expected_acc);
+      flow_accumulation_receivers_idx32(acc.data(), receiver32.data(),
+                                        node32.data(), weights.data(), n);
+      assert_equal(acc, expected_acc);
+
+      if (order == 0) {
+        std::vector<float> d8_acc(n);
+        flow_accumulation(d8_acc.data(), node.data(), direction.data(), NULL,
+                          dims);
+        flow_accumulation_receivers(acc.data(), receiver.data(), node.data(),
+                                    NULL, n);
+        assert_equal(acc, d8_acc);
+      }
+
+      std::vector<ptrdiff_t> expected_basins(n);
+      drainagebasins(expected_basins.data(), source.data(), target.data(),
+                     edge_count, dims);
+      std::vector<ptrdiff_t> basins(n);
+      drainagebasins_receivers(basins.data(), receiver.data(), node.data(), n);
+      assert_equal(basins, expected_basins);
+      std::vector<uint32_t> basins32(n);
+      drainagebasins_receivers_idx32(basins32.data(), receiver32.data(),
+                                     node32.data(), n);
+      assert_equal(basins32, std::vector<uint32_t>(expected_basins.begin(),
+                                                   expected_basins.end()));
+
+      std::vector<float> expected_values(values);
+      propagatevaluesupstream_f32(expected_values.data(), source.data(),
+                                  target.data(), edge_count);
+      std::vector<float> propagated(values);
+      propagatevaluesupstream_f32_receivers(propagated.data(), receiver.data(),
+                                            node.data(), n);
+      assert_equal(propagated, expected_values);
+      propagated = values;
+      propagatevaluesupstream_f32_receivers_idx32(
+          propagated.data(), receiver32.data(), node32.data(), n);
+      assert_equal(propagated, expected_values);
+
+      // traverse_up_f32_max_add takes the maximum with the current
+      // value, so start from values that are always smaller than the
+      // nonnegative sums
+      std::vector<float> expected_up(n);
+      std::vector<float> up(n);
+      for (ptrdiff_t p = 0; p < n; p++) {
+        up[p] = receiver[p] == p ? weights[p] : -1.0f;
+        expected_up[p] = up[p];
+      }
+      traverse_up_f32_max_add(expected_up.data(), edge_input.data(),
+                              source.data(), target.data(), edge_count);
+      std::vector<float> up_init(up);
+      traverse_up_f32_add_receivers(up.data(), values.data(), receiver.data(),
+                                    node.data(), n);
+      assert_equal(up, expected_up);
+      up = up_init;
+      traverse_up_f32_add_receivers_idx32(up.data(), values.data(),
+                                          receiver32.data(), node32.data(), n);
+      assert_equal(up, expected_up);
+
+      std::vector<float> expected_down(weights);
+      traverse_down_f32_max_add(expected_down.data(), edge_input.data(),
+                                source.data(), target.data(), edge_count);
+      std::vector<float> down(weights);
+      traverse_down_f32_max_add_receivers(down.data(), values.data(),
+                                          receiver.data(), node.data(), n);
+      assert_equal(down, expected_down);
+      down = weights;
+      traverse_down_f32_max_add_receivers_idx32(
+          down.data(), values.data(), receiver32.data(), node32.data(), n);
+      assert_equal(down, expected_down);
+    }
+  }
+}
@@ -3,6 +3,7 @@
 
 #include <gdal_priv.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
@@ -360,6 +361,57 @@ struct SnapshotData {
     return 0;
   }
 
+  /*
+    Time `run(parameter)` with the profiler for every parameter, e.g.
+    a number of threads, and verify its result with `check()` after
+    each run. `prepare(parameter)` runs before the timed block. Every
+    run is recorded as `name`_<parameter>, and its speedup relative to
+    the profiler entry `reference`, or to the first run if `reference`
+    is empty, is reported as a TAP diagnostic.
+
+    Returns -1 as soon as a step fails and 0 otherwise.
+   */
+  template <typename Prepare, typename Run, typename Check>
+  int benchmark_sweep(const std::string& name,
+                      const std::vector<ptrdiff_t>& parameters,
+                      const std::string& reference, Prepare prepare, Run run,
+                      Check check) {
+    std::vector<std::string> labels;
+    for (ptrdiff_t parameter : parameters) {
+      if (prepare(parameter) != 0) {
+        return -1;
+      }
+      labels.push_back(name + "_" + std::to_string(parameter));
+      int result;
+      {
+        ProfileBlock(prof, labels.back().c_str());
+        result = run(parameter);
+      }
+      if (result != 0 || !check()) {
+        return -1;
+      }
+    }
+
+    double base = prof[reference.empty() ? labels[0] : reference].elapsed;
+    for (const auto& label : labels) {
+      std::cout << "    # " << label << " speedup: "
+                << base / prof[label].elapsed << std::endl;
+    }
+    return 0;
+  }
+
+  template <typename Run, typename Check>
+  int benchmark_sweep(const std::string& name,
+                      const std::vector<ptrdiff_t>& parameters,
+                      const std::string& reference, Run run, Check check) {
+    return benchmark_sweep(
+        name, parameters, reference, [](ptrdiff_t) { return 0; }, run, check);
+  }
+
+  // The thread counts used by the benchmark_sweep of the parallel
+  // routines
+  const std::vector<ptrdiff_t> thread_counts = {1, 2, 4, 8};
+
   int test_fillsinks() {
     // Initialize bcs
     for (ptrdiff_t j = 0; j < dims[1]; j++) {
@@ -397,6 +449,226 @@ struct SnapshotData {
     return 0;
   }
 
+  /*
+    fillsinks_parallel should produce the same result as fillsinks for
+    any number of threads. The speedup is reported relative to a
+    single thread.
+   */
+  int test_fillsinks_parallel() {
+    // test_dem and bc have been initialized by test_fillsinks
+    std::vector<float> output(dims[0] * dims[1]);
+
+    return benchmark_sweep(
+        "fillsinks_parallel", thread_counts, "",
+        [&](ptrdiff_t threads) {
+          tt::fillsinks_parallel(output.data(), test_dem.data(), bc.data(),
+                                 dims.data(), NULL, (int)threads);
+          return 0;
+        },
+        [&]() {
+          for (ptrdiff_t j = 0; j < dims[1]; j++) {
+            for (ptrdiff_t i = 0; i < dims[0]; i++) {
+              if (!isnan(filled_dem[j * dims[0] + i]) &&
+                  output[j * dims[0] + i] != filled_dem[j * dims[0] + i]) {
+                write_data_to_file<float, GDT_Float32>(
+                    path / "test_fillsinks_parallel.tif",
+                    path / "fillsinks.tif", output, dims);
+                return false;
+              }
+            }
+          }
+          return true;
+        });
+  }
+
+  /*
+    fillsinks_priorityflood should reproduce the fillsinks snapshot.
+
+    This also benchmarks the three fill algorithms against each other
+    on the same input and reports their running times relative to
+    fillsinks as TAP diagnostics.
+   */
+  int test_fillsinks_priorityflood() {
+    // test_dem and bc have been initialized by test_fillsinks
+    std::vector<float> output(dims[0] * dims[1]);
+    std::vector<ptrdiff_t> queue(dims[0] * dims[1]);
+
+    {
+      ProfileBlock(prof, "fillsinks");
+      tt::fillsinks(output.data(), test_dem.data(), bc.data(), dims.data());
+    }
+    {
+      ProfileBlock(prof, "fillsinks_hybrid");
+      tt::fillsinks_hybrid(output.data(), queue.data(), test_dem.data(),
+                           bc.data(), dims.data());
+    }
+    {
+      ProfileBlock(prof, "fillsinks_priorityflood");
+      tt::fillsinks_priorityflood(output.data(), queue.data(),
+                                  test_dem.data(), bc.data(), dims.data());
+    }
+
+    for (ptrdiff_t j = 0; j < dims[1]; j++) {
+      for (ptrdiff_t i = 0; i < dims[0]; i++) {
+        if (!isnan(filled_dem[j * dims[0] + i]) &&
+            output[j * dims[0] + i] != filled_dem[j * dims[0] + i]) {
+          write_data_to_file<float, GDT_Float32>(
+              path / "test_fillsinks_priorityflood.tif",
+              path / "fillsinks.tif", output, dims);
+          return -1;
+        }
+      }
+    }
+
+    double reference = prof["fillsinks"].elapsed;
+    for (const char* label :
+         {"fillsinks", "fillsinks_hybrid", "fillsinks_priorityflood"}) {
+      std::cout << "    # " << label
+                << " relative time: " << prof[label].elapsed / reference
+                << std::endl;
+    }
+    return 0;
+  }
+
+  /*
+    gwdt_computecosts_parallel should produce the same costs and
+    connected components as gwdt_computecosts for any number of
+    threads. The speedup is reported relative to gwdt_computecosts.
+   */
+  int test_gwdt_computecosts_parallel() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    std::vector<int32_t> flats_all(dims[0] * dims[1]);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(dims[0] * dims[1]);
+    std::vector<ptrdiff_t> conncomps(dims[0] * dims[1]);
+    {
+      ProfileBlock(prof, "gwdt_computecosts");
+      tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                            dem.data(), filled_dem.data(), dims.data());
+    }
+
+    std::vector<float> test_costs(dims[0] * dims[1]);
+    std::vector<ptrdiff_t> test_conncomps(dims[0] * dims[1]);
+    return benchmark_sweep(
+        "gwdt_computecosts_parallel", thread_counts, "gwdt_computecosts",
+        [&](ptrdiff_t threads) {
+          tt::gwdt_computecosts_parallel(
+              test_costs.data(), test_conncomps.data(), flats_all.data(),
+              dem.data(), filled_dem.data(), dims.data(), (int)threads);
+          return 0;
+        },
+        [&]() {
+          if (test_costs != costs || test_conncomps != conncomps) {
+            write_data_to_file<float, GDT_Float32>(
+                path / "test_gwdt_computecosts_parallel.tif",
+                path / "dem.tif", test_costs, dims);
+            return false;
+          }
+          return true;
+        });
+  }
+
+  /*
+    gwdt_bucketed should reproduce the distances of gwdt.
+
+    This also benchmarks the two priority queues against each other
+    and reports the running time of gwdt_bucketed relative to gwdt
+    and its queue operation counts as TAP diagnostics.
+   */
+  int test_gwdt_bucketed() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    std::vector<int32_t> flats_all(dims[0] * dims[1]);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(dims[0] * dims[1]);
+    std::vector<ptrdiff_t> conncomps(dims[0] * dims[1]);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(dims[0] * dims[1]);
+    std::vector<ptrdiff_t> heap(dims[0] * dims[1]);
+    std::vector<ptrdiff_t> back(dims[0] * dims[1]);
+    {
+      ProfileBlock(prof, "gwdt");
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+
+    std::vector<float> test_dist(dims[0] * dims[1]);
+    ptrdiff_t counters[4];
+    {
+      ProfileBlock(prof, "gwdt_bucketed");
+      tt::gwdt_bucketed(test_dist.data(), NULL, costs.data(),
+                        flats_all.data(), heap.data(), back.data(),
+                        dims.data(), counters);
+    }
+
+    for (ptrdiff_t j = 0; j < dims[1]; j++) {
+      for (ptrdiff_t i = 0; i < dims[0]; i++) {
+        float d = dist[j * dims[0] + i];
+        float test_d = test_dist[j * dims[0] + i];
+        if (!(d == test_d || std::fabs(d - test_d) <= 1e-5f * std::fabs(d))) {
+          write_data_to_file<float, GDT_Float32>(
+              path / "test_gwdt_bucketed.tif", path / "dem.tif", test_dist,
+              dims);
+          return -1;
+        }
+      }
+    }
+
+    double reference = prof["gwdt"].elapsed;
+    std::cout << "    # gwdt_bucketed relative time: "
+              << prof["gwdt_bucketed"].elapsed / reference << std::endl;
+    std::cout << "    # gwdt_bucketed insertions: " << counters[0]
+              << " removals: " << counters[1]
+              << " empty buckets: " << counters[2]
+              << " reopened: " << counters[3] << std::endl;
+    return 0;
+  }
+
+  /*
+    gwdt_parallel should reproduce the distances of gwdt for any
+    number of threads. The speedup is reported relative to gwdt.
+   */
+  int test_gwdt_parallel() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    std::vector<int32_t> flats_all(dims[0] * dims[1]);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(dims[0] * dims[1]);
+    std::vector<ptrdiff_t> conncomps(dims[0] * dims[1]);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(dims[0] * dims[1]);
+    {
+      std::vector<ptrdiff_t> heap(dims[0] * dims[1]);
+      std::vector<ptrdiff_t> back(dims[0] * dims[1]);
+      ProfileBlock(prof, "gwdt_serial");
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+
+    std::vector<float> test_dist(dims[0] * dims[1]);
+    return benchmark_sweep(
+        "gwdt_parallel", thread_counts, "gwdt_serial",
+        [&](ptrdiff_t threads) {
+          return tt::gwdt_parallel(test_dist.data(), NULL, costs.data(),
+                                   flats_all.data(), conncomps.data(),
+                                   dims.data(), (int)threads);
+        },
+        [&]() {
+          if (test_dist != dist) {
+            write_data_to_file<float, GDT_Float32>(
+                path / "test_gwdt_parallel.tif", path / "dem.tif", test_dist,
+                dims);
+            return false;
+          }
+          return true;
+        });
+  }
+
   int test_identifyflats() {
     // identifyflats
     //
@@ -424,6 +696,552 @@ struct SnapshotData {
     return 0;
   }
 
+  /*
+    identifyflats_parallel should produce the same labels as
+    identifyflats for any number of threads. The speedup is reported
+    relative to identifyflats.
+   */
+  int test_identifyflats_parallel() {
+    std::vector<int32_t> expected(dims[0] * dims[1]);
+    ptrdiff_t expected_count;
+    {
+      ProfileBlock(prof, "identifyflats");
+      expected_count =
+          tt::identifyflats(expected.data(), filled_dem.data(), dims.data());
+    }
+
+    std::vector<int32_t> output(dims[0] * dims[1]);
+    ptrdiff_t count = 0;
+    return benchmark_sweep(
+        "identifyflats_parallel", thread_counts, "identifyflats",
+        [&](ptrdiff_t threads) {
+          count = tt::identifyflats_parallel(output.data(), filled_dem.data(),
+                                             dims.data(), (int)threads);
+          return 0;
+        },
+        [&]() {
+          if (count != expected_count || output != expected) {
+            write_data_to_file<int32_t, GDT_Int32>(
+                path / "test_identifyflats_parallel.tif",
+                path / "identifyflats_flats.tif", output, dims);
+            return false;
+          }
+          return true;
+        });
+  }
+
+  /*
+    flow_routing_d8_carve_parallel should produce the same node
+    ordering and flow directions as flow_routing_d8_carve for any
+    number of threads. The speedup is reported relative to
+    flow_routing_d8_carve.
+   */
+  int test_flow_routing_d8_carve_parallel() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    std::vector<int32_t> flats_all(dims[0] * dims[1]);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(dims[0] * dims[1]);
+    std::vector<ptrdiff_t> conncomps(dims[0] * dims[1]);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(dims[0] * dims[1]);
+    {
+      std::vector<ptrdiff_t> heap(dims[0] * dims[1]);
+      std::vector<ptrdiff_t> back(dims[0] * dims[1]);
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+
+    std::vector<ptrdiff_t> node(dims[0] * dims[1]);
+    std::vector<uint8_t> direction(dims[0] * dims[1]);
+    {
+      ProfileBlock(prof, "flow_routing_d8_carve");
+      tt::flow_routing_d8_carve(node.data(), direction.data(),
+                                filled_dem.data(), dist.data(),
+                                flats_all.data(), dims.data(), 0);
+    }
+
+    std::vector<ptrdiff_t> test_node(dims[0] * dims[1]);
+    std::vector<uint8_t> test_direction(dims[0] * dims[1]);
+    return benchmark_sweep(
+        "flow_routing_d8_carve_parallel", thread_counts,
+        "flow_routing_d8_carve",
+        [&](ptrdiff_t threads) {
+          tt::flow_routing_d8_carve_parallel(
+              test_node.data(), test_direction.data(), filled_dem.data(),
+              dist.data(), flats_all.data(), dims.data(), 0, (int)threads);
+          return 0;
+        },
+        [&]() { return test_node == node && test_direction == direction; });
+  }
+
+  /*
+    The basin-partitioned flow accumulation should reproduce
+    flow_accumulation_edgelist for any number of threads. The speedup
+    is reported relative to flow_accumulation_edgelist.
+   */
+  int test_flow_accumulation_edgelist_parallel() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    ptrdiff_t node_count = dims[0] * dims[1];
+    std::vector<int32_t> flats_all(node_count);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(node_count);
+    std::vector<ptrdiff_t> conncomps(node_count);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(node_count);
+    std::vector<ptrdiff_t> node(node_count);
+    std::vector<uint8_t> direction(node_count);
+    {
+      std::vector<ptrdiff_t> heap(node_count);
+      std::vector<ptrdiff_t> back(node_count);
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+    tt::flow_routing_d8_carve(node.data(), direction.data(), filled_dem.data(),
+                              dist.data(), flats_all.data(), dims.data(), 0);
+
+    std::vector<ptrdiff_t> source(node_count);
+    std::vector<ptrdiff_t> target(node_count);
+    ptrdiff_t edge_count = tt::flow_routing_d8_edgelist(
+        source.data(), target.data(), node.data(), direction.data(),
+        dims.data(), 0);
+    std::vector<float> fraction(edge_count, 1.0f);
+
+    std::vector<float> acc(node_count);
+    {
+      ProfileBlock(prof, "flow_accumulation_edgelist");
+      tt::flow_accumulation_edgelist(acc.data(), source.data(), target.data(),
+                                     fraction.data(), NULL, edge_count,
+                                     dims.data());
+    }
+
+    std::vector<ptrdiff_t> offsets(edge_count + 1);
+    std::vector<ptrdiff_t> permutation(edge_count);
+    std::vector<ptrdiff_t> psource(edge_count);
+    std::vector<ptrdiff_t> ptarget(edge_count);
+    std::vector<ptrdiff_t> basins(node_count);
+    ptrdiff_t segment_count;
+    {
+      ProfileBlock(prof, "edgelist_partition_basins");
+      segment_count = tt::edgelist_partition_basins(
+          offsets.data(), permutation.data(), psource.data(), ptarget.data(),
+          basins.data(), source.data(), target.data(), edge_count,
+          node_count);
+    }
+    if (segment_count < 0) {
+      return -1;
+    }
+
+    std::cout << "    # basins: " << segment_count << " largest: "
+              << (segment_count > 0 ? offsets[1] : 0) << " of " << edge_count
+              << " edges" << std::endl;
+
+    std::vector<float> test_acc(node_count);
+    return benchmark_sweep(
+        "flow_accumulation_edgelist_parallel", thread_counts,
+        "flow_accumulation_edgelist",
+        [&](ptrdiff_t threads) {
+          tt::flow_accumulation_edgelist_parallel(
+              test_acc.data(), psource.data(), ptarget.data(), fraction.data(),
+              NULL, offsets.data(), segment_count, node_count, (int)threads);
+          return 0;
+        },
+        [&]() { return test_acc == acc; });
+  }
+
+  /*
+    The level-scheduled flow accumulation should reproduce
+    flow_accumulation_edgelist for any number of threads. The speedup
+    is reported relative to flow_accumulation_edgelist.
+   */
+  int test_flow_accumulation_edgelist_levels() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    ptrdiff_t node_count = dims[0] * dims[1];
+    std::vector<int32_t> flats_all(node_count);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(node_count);
+    std::vector<ptrdiff_t> conncomps(node_count);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(node_count);
+    std::vector<ptrdiff_t> node(node_count);
+    std::vector<uint8_t> direction(node_count);
+    {
+      std::vector<ptrdiff_t> heap(node_count);
+      std::vector<ptrdiff_t> back(node_count);
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+    tt::flow_routing_d8_carve(node.data(), direction.data(), filled_dem.data(),
+                              dist.data(), flats_all.data(), dims.data(), 0);
+
+    std::vector<ptrdiff_t> source(node_count);
+    std::vector<ptrdiff_t> target(node_count);
+    ptrdiff_t edge_count = tt::flow_routing_d8_edgelist(
+        source.data(), target.data(), node.data(), direction.data(),
+        dims.data(), 0);
+    std::vector<float> fraction(edge_count, 1.0f);
+
+    std::vector<float> acc(node_count);
+    {
+      ProfileBlock(prof, "flow_accumulation_edgelist_serial");
+      tt::flow_accumulation_edgelist(acc.data(), source.data(), target.data(),
+                                     fraction.data(), NULL, edge_count,
+                                     dims.data());
+    }
+
+    std::vector<ptrdiff_t> level_offsets(node_count + 1);
+    std::vector<ptrdiff_t> level_nodes(node_count);
+    std::vector<ptrdiff_t> edge_offsets(node_count + 1);
+    std::vector<ptrdiff_t> edges(edge_count);
+    ptrdiff_t level_count;
+    {
+      ProfileBlock(prof, "edgelist_level_schedule");
+      level_count = tt::edgelist_level_schedule(
+          level_offsets.data(), level_nodes.data(), edge_offsets.data(),
+          edges.data(), source.data(), target.data(), edge_count, node_count,
+          0);
+    }
+    if (level_count < 0) {
+      return -1;
+    }
+
+    std::cout << "    # levels: " << level_count << std::endl;
+
+    std::vector<float> test_acc(node_count);
+    return benchmark_sweep(
+        "flow_accumulation_edgelist_levels", thread_counts,
+        "flow_accumulation_edgelist_serial",
+        [&](ptrdiff_t threads) {
+          tt::flow_accumulation_edgelist_levels(
+              test_acc.data(), source.data(), fraction.data(), NULL,
+              level_offsets.data(), level_nodes.data(), edge_offsets.data(),
+              edges.data(), level_count, node_count, (int)threads);
+          return 0;
+        },
+        [&]() { return test_acc == acc; });
+  }
+
+  /*
+    Renumbering the flow network should not change the result of a
+    traversal. traverse_down_f32_add_mul is timed for several block
+    sizes, and the speedup is reported relative to the raster
+    numbering.
+   */
+  int test_edgelist_renumber() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    ptrdiff_t node_count = dims[0] * dims[1];
+    std::vector<int32_t> flats_all(node_count);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(node_count);
+    std::vector<ptrdiff_t> conncomps(node_count);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(node_count);
+    std::vector<ptrdiff_t> node(node_count);
+    std::vector<uint8_t> direction(node_count);
+    {
+      std::vector<ptrdiff_t> heap(node_count);
+      std::vector<ptrdiff_t> back(node_count);
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+    tt::flow_routing_d8_carve(node.data(), direction.data(), filled_dem.data(),
+                              dist.data(), flats_all.data(), dims.data(), 0);
+
+    std::vector<ptrdiff_t> source(node_count);
+    std::vector<ptrdiff_t> target(node_count);
+    ptrdiff_t edge_count = tt::flow_routing_d8_edgelist(
+        source.data(), target.data(), node.data(), direction.data(),
+        dims.data(), 0);
+    std::vector<float> fraction(edge_count, 1.0f);
+
+    std::vector<float> acc(node_count, 1.0f);
+    {
+      ProfileBlock(prof, "traverse_down_f32_add_mul_raster");
+      tt::traverse_down_f32_add_mul(acc.data(), fraction.data(), source.data(),
+                                    target.data(), edge_count);
+    }
+
+    std::vector<ptrdiff_t> new_to_old(node_count);
+    std::vector<ptrdiff_t> old_to_new(node_count);
+    std::vector<ptrdiff_t> new_source(edge_count);
+    std::vector<ptrdiff_t> new_target(edge_count);
+    std::vector<float> permuted(node_count);
+    std::vector<float> test_acc(node_count);
+    return benchmark_sweep(
+        "traverse_down_f32_add_mul_block", {16, 256, node_count},
+        "traverse_down_f32_add_mul_raster",
+        [&](ptrdiff_t block_size) {
+          std::fill(permuted.begin(), permuted.end(), 1.0f);
+          return tt::edgelist_renumber(new_to_old.data(), old_to_new.data(),
+                                       new_source.data(), new_target.data(),
+                                       source.data(), target.data(),
+                                       edge_count, dims.data(), block_size);
+        },
+        [&](ptrdiff_t) {
+          tt::traverse_down_f32_add_mul(permuted.data(), fraction.data(),
+                                        new_source.data(), new_target.data(),
+                                        edge_count);
+          return 0;
+        },
+        [&]() {
+          tt::permute_scatter_f32(test_acc.data(), permuted.data(),
+                                  new_to_old.data(), node_count);
+          return test_acc == acc;
+        });
+  }
+
+  int test_flow_accumulation_edgelist_batch() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    ptrdiff_t node_count = dims[0] * dims[1];
+    std::vector<int32_t> flats_all(node_count);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(node_count);
+    std::vector<ptrdiff_t> conncomps(node_count);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(node_count);
+    std::vector<ptrdiff_t> node(node_count);
+    std::vector<uint8_t> direction(node_count);
+    {
+      std::vector<ptrdiff_t> heap(node_count);
+      std::vector<ptrdiff_t> back(node_count);
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+    tt::flow_routing_d8_carve(node.data(), direction.data(), filled_dem.data(),
+                              dist.data(), flats_all.data(), dims.data(), 0);
+
+    std::vector<ptrdiff_t> source(node_count);
+    std::vector<ptrdiff_t> target(node_count);
+    ptrdiff_t edge_count = tt::flow_routing_d8_edgelist(
+        source.data(), target.data(), node.data(), direction.data(),
+        dims.data(), 0);
+    std::vector<float> fraction(edge_count, 1.0f);
+
+    // Weight grids that differ between the planes, e.g. the members of
+    // a precipitation ensemble
+    const ptrdiff_t plane_count = 16;
+    std::vector<float> planes(node_count * plane_count);
+    for (ptrdiff_t k = 0; k < plane_count; k++) {
+      for (ptrdiff_t u = 0; u < node_count; u++) {
+        planes[k * node_count + u] = 1.0f + 0.125f * ((u + k) % 8);
+      }
+    }
+
+    std::vector<float> acc(node_count * plane_count);
+    {
+      ProfileBlock(prof, "flow_accumulation_edgelist_planes");
+      for (ptrdiff_t k = 0; k < plane_count; k++) {
+        tt::flow_accumulation_edgelist(
+            acc.data() + k * node_count, source.data(), target.data(),
+            fraction.data(), planes.data() + k * node_count, edge_count,
+            dims.data());
+      }
+    }
+
+    std::vector<float> interleaved(node_count * plane_count);
+    tt::interleave_planes_f32(interleaved.data(), planes.data(), node_count,
+                              plane_count);
+    std::vector<float> batch_acc(node_count * plane_count);
+    {
+      ProfileBlock(prof, "flow_accumulation_edgelist_batch");
+      tt::flow_accumulation_edgelist_batch(
+          batch_acc.data(), source.data(), target.data(), fraction.data(),
+          interleaved.data(), edge_count, node_count, plane_count);
+    }
+    std::vector<float> test_acc(node_count * plane_count);
+    tt::deinterleave_planes_f32(test_acc.data(), batch_acc.data(), node_count,
+                                plane_count);
+
+    // All fractions are one, so both versions add the same values in
+    // the same order
+    if (test_acc != acc) {
+      return -1;
+    }
+
+    std::cout << "    # flow_accumulation_edgelist_batch speedup: "
+              << prof["flow_accumulation_edgelist_planes"].elapsed /
+                     prof["flow_accumulation_edgelist_batch"].elapsed
+              << std::endl;
+    return 0;
+  }
+
+  int test_traverse_down_fused() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    ptrdiff_t node_count = dims[0] * dims[1];
+    std::vector<int32_t> flats_all(node_count);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(node_count);
+    std::vector<ptrdiff_t> conncomps(node_count);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(node_count);
+    std::vector<ptrdiff_t> node(node_count);
+    std::vector<uint8_t> direction(node_count);
+    {
+      std::vector<ptrdiff_t> heap(node_count);
+      std::vector<ptrdiff_t> back(node_count);
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+    tt::flow_routing_d8_carve(node.data(), direction.data(), filled_dem.data(),
+                              dist.data(), flats_all.data(), dims.data(), 0);
+
+    std::vector<ptrdiff_t> source(node_count);
+    std::vector<ptrdiff_t> target(node_count);
+    ptrdiff_t edge_count = tt::flow_routing_d8_edgelist(
+        source.data(), target.data(), node.data(), direction.data(),
+        dims.data(), 0);
+    std::vector<float> fraction(edge_count, 1.0f);
+    std::vector<float> length(edge_count);
+    for (ptrdiff_t e = 0; e < edge_count; e++) {
+      ptrdiff_t offset = std::abs(source[e] - target[e]);
+      length[e] = (offset == 1 || offset == dims[0]) ? 1.0f : std::sqrt(2.0f);
+    }
+
+    // Flow accumulation, Strahler order and maximum upstream flow
+    // length, first separately and then in one fused pass
+    std::vector<float> acc(node_count, 1.0f);
+    std::vector<float> strahler(node_count, 1.0f);
+    std::vector<float> flow_length(node_count, 0.0f);
+    {
+      ProfileBlock(prof, "traverse_down_separate");
+      tt::traverse_down_f32_add_mul(acc.data(), fraction.data(), source.data(),
+                                    target.data(), edge_count);
+      tt::traverse_down_f32_strahler(strahler.data(), NULL, source.data(),
+                                     target.data(), edge_count);
+      tt::traverse_down_f32_max_add(flow_length.data(), length.data(),
+                                    source.data(), target.data(), edge_count);
+    }
+
+    std::vector<float> fused_acc(node_count, 1.0f);
+    std::vector<float> fused_strahler(node_count, 1.0f);
+    std::vector<float> fused_flow_length(node_count, 0.0f);
+    void *output[3] = {fused_acc.data(), fused_strahler.data(),
+                       fused_flow_length.data()};
+    void *input[3] = {NULL, NULL, length.data()};
+    uint8_t ops[3] = {tt::TRAVERSE_ADD_MUL, tt::TRAVERSE_STRAHLER,
+                      tt::TRAVERSE_MAX_ADD};
+    {
+      ProfileBlock(prof, "traverse_down_fused");
+      if (tt::traverse_down_fused(output, input, ops, 3, source.data(),
+                                  target.data(), edge_count) != 0) {
+        return -1;
+      }
+    }
+
+    if (fused_acc != acc || fused_strahler != strahler ||
+        fused_flow_length != flow_length) {
+      return -1;
+    }
+
+    std::cout << "    # traverse_down_fused speedup: "
+              << prof["traverse_down_separate"].elapsed /
+                     prof["traverse_down_fused"].elapsed
+              << std::endl;
+    return 0;
+  }
+
+  int test_upstream_index() {
+    // Use the snapshot filled DEM in case fillsinks fails.
+    ptrdiff_t node_count = dims[0] * dims[1];
+    std::vector<int32_t> flats_all(node_count);
+    tt::identifyflats(flats_all.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> costs(node_count);
+    std::vector<ptrdiff_t> conncomps(node_count);
+    tt::gwdt_computecosts(costs.data(), conncomps.data(), flats_all.data(),
+                          dem.data(), filled_dem.data(), dims.data());
+
+    std::vector<float> dist(node_count);
+    std::vector<ptrdiff_t> node(node_count);
+    std::vector<uint8_t> direction(node_count);
+    {
+      std::vector<ptrdiff_t> heap(node_count);
+      std::vector<ptrdiff_t> back(node_count);
+      tt::gwdt(dist.data(), NULL, costs.data(), flats_all.data(), heap.data(),
+               back.data(), dims.data());
+    }
+    tt::flow_routing_d8_carve(node.data(), direction.data(), filled_dem.data(),
+                              dist.data(), flats_all.data(), dims.data(), 0);
+
+    std::vector<ptrdiff_t> source(node_count);
+    std::vector<ptrdiff_t> target(node_count);
+    ptrdiff_t edge_count = tt::flow_routing_d8_edgelist(
+        source.data(), target.data(), node.data(), direction.data(),
+        dims.data(), 0);
+
+    // Catchments of a set of gauges, first with one upstream traversal
+    // per gauge and then from the interval index
+    const ptrdiff_t gauge_count = 32;
+    std::vector<ptrdiff_t> gauges(gauge_count);
+    for (ptrdiff_t k = 0; k < gauge_count; k++) {
+      gauges[k] = node[(k + 1) * node_count / (gauge_count + 1)];
+    }
+
+    std::vector<uint32_t> ones(edge_count, 1);
+    std::vector<ptrdiff_t> traversal_counts(gauge_count);
+    {
+      ProfileBlock(prof, "upstream_traversal");
+      std::vector<uint32_t> upstream(node_count);
+      for (ptrdiff_t k = 0; k < gauge_count; k++) {
+        std::fill(upstream.begin(), upstream.end(), 0);
+        upstream[gauges[k]] = 1;
+        tt::traverse_up_u32_or_and(upstream.data(), ones.data(), source.data(),
+                                   target.data(), edge_count);
+        ptrdiff_t count = 0;
+        for (ptrdiff_t u = 0; u < node_count; u++) {
+          count += upstream[u];
+        }
+        traversal_counts[k] = count;
+      }
+    }
+
+    std::vector<ptrdiff_t> preorder(node_count);
+    std::vector<ptrdiff_t> subtree_size(node_count);
+    std::vector<ptrdiff_t> order(node_count);
+    std::vector<ptrdiff_t> index_counts(gauge_count);
+    {
+      ProfileBlock(prof, "upstream_index");
+      if (tt::upstream_index(preorder.data(), subtree_size.data(),
+                             order.data(), source.data(), target.data(),
+                             edge_count, node_count) != 0) {
+        return -1;
+      }
+      std::vector<ptrdiff_t> catchment(node_count);
+      for (ptrdiff_t k = 0; k < gauge_count; k++) {
+        index_counts[k] = tt::upstream_index_catchment(
+            catchment.data(), &gauges[k], 1, preorder.data(),
+            subtree_size.data(), order.data());
+      }
+    }
+
+    if (index_counts != traversal_counts) {
+      return -1;
+    }
+
+    std::cout << "    # upstream_index speedup: "
+              << prof["upstream_traversal"].elapsed /
+                     prof["upstream_index"].elapsed
+              << std::endl;
+    return 0;
+  }
+
   int test_hillshade() {
     // Azimuth and altitude are 315 and 60 degrees in radians
     // tt::hillshade requires azimuth to be in radians from the first
@@ -516,7 +1334,7 @@ struct SnapshotData {
   }
 
   int runtests() {
-    std::cout << "    1..9" << std::endl;
+    std::cout << "    1..23" << std::endl;
 
     int result = 0;
     if (erode3x3.size() > 0) {
@@ -613,6 +1431,130 @@ struct SnapshotData {
       }
     }
 
+    if (test_filled_dem.size() > 0) {
+      if (test_fillsinks_parallel() < 0) {
+        result = -1;
+        std::cout << "    not ok 11 - fillsinks_parallel" << std::endl;
+      } else {
+        std::cout << "    ok 11 - fillsinks_parallel" << std::endl;
+      }
+    }
+
+    if (test_filled_dem.size() > 0) {
+      if (test_fillsinks_priorityflood() < 0) {
+        result = -1;
+        std::cout << "    not ok 12 - fillsinks_priorityflood" << std::endl;
+      } else {
+        std::cout << "    ok 12 - fillsinks_priorityflood" << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_gwdt_computecosts_parallel() < 0) {
+        result = -1;
+        std::cout << "    not ok 13 - gwdt_computecosts_parallel" << std::endl;
+      } else {
+        std::cout << "    ok 13 - gwdt_computecosts_parallel" << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_gwdt_bucketed() < 0) {
+        result = -1;
+        std::cout << "    not ok 14 - gwdt_bucketed" << std::endl;
+      } else {
+        std::cout << "    ok 14 - gwdt_bucketed" << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_gwdt_parallel() < 0) {
+        result = -1;
+        std::cout << "    not ok 15 - gwdt_parallel" << std::endl;
+      } else {
+        std::cout << "    ok 15 - gwdt_parallel" << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_identifyflats_parallel() < 0) {
+        result = -1;
+        std::cout << "    not ok 16 - identifyflats_parallel" << std::endl;
+      } else {
+        std::cout << "    ok 16 - identifyflats_parallel" << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_flow_routing_d8_carve_parallel() < 0) {
+        result = -1;
+        std::cout << "    not ok 17 - flow_routing_d8_carve_parallel"
+                  << std::endl;
+      } else {
+        std::cout << "    ok 17 - flow_routing_d8_carve_parallel" << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_flow_accumulation_edgelist_parallel() < 0) {
+        result = -1;
+        std::cout << "    not ok 18 - flow_accumulation_edgelist_parallel"
+                  << std::endl;
+      } else {
+        std::cout << "    ok 18 - flow_accumulation_edgelist_parallel"
+                  << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_flow_accumulation_edgelist_levels() < 0) {
+        result = -1;
+        std::cout << "    not ok 19 - flow_accumulation_edgelist_levels"
+                  << std::endl;
+      } else {
+        std::cout << "    ok 19 - flow_accumulation_edgelist_levels"
+                  << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_edgelist_renumber() < 0) {
+        result = -1;
+        std::cout << "    not ok 20 - edgelist_renumber" << std::endl;
+      } else {
+        std::cout << "    ok 20 - edgelist_renumber" << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_flow_accumulation_edgelist_batch() < 0) {
+        result = -1;
+        std::cout << "    not ok 21 - flow_accumulation_edgelist_batch"
+                  << std::endl;
+      } else {
+        std::cout << "    ok 21 - flow_accumulation_edgelist_batch"
+                  << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_traverse_down_fused() < 0) {
+        result = -1;
+        std::cout << "    not ok 22 - traverse_down_fused" << std::endl;
+      } else {
+        std::cout << "    ok 22 - traverse_down_fused" << std::endl;
+      }
+    }
+
+    if (filled_dem.size() > 0) {
+      if (test_upstream_index() < 0) {
+        result = -1;
+        std::cout << "    not ok 23 - upstream_index" << std::endl;
+      } else {
+        std::cout << "    ok 23 - upstream_index" << std::endl;
+      }
+    }
+
     return result;
   }
 };
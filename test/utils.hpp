@@ -0,0 +1,101 @@
+#ifndef TT3_TEST_UTILS_HPP
+#define TT3_TEST_UTILS_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include "topotoolbox.h"
+#include "utils.h"
+}
+
+/*
+  Shared helpers for the C++ tests that compare kernels on the flow
+  network of a random DEM.
+ */
+
+template <typename T>
+void assert_equal(const std::vector<T> &a, const std::vector<T> &b) {
+  assert(a.size() == b.size());
+  for (size_t k = 0; k < a.size(); k++) {
+    assert(a[k] == b[k]);
+  }
+}
+
+// The intermediate results and outputs of the carved D8 flow routing
+struct D8Routing {
+  std::vector<float> filled;
+  std::vector<int32_t> flats;
+  std::vector<float> dist;
+  std::vector<ptrdiff_t> node;
+  std::vector<uint8_t> direction;
+};
+
+// Fill the sinks of `dem`, compute the auxiliary topography in the
+// flats and carve the D8 flow directions through them
+inline D8Routing route_d8_carve(std::vector<float> &dem,
+                                std::vector<uint8_t> &bc, ptrdiff_t dims[2],
+                                unsigned int order) {
+  ptrdiff_t n = dims[0] * dims[1];
+  D8Routing r;
+  r.filled.resize(n);
+  r.flats.resize(n);
+  r.dist.resize(n);
+  r.node.resize(n);
+  r.direction.resize(n);
+
+  std::vector<float> costs(n);
+  std::vector<ptrdiff_t> conncomps(n);
+  std::vector<ptrdiff_t> heap(n);
+  std::vector<ptrdiff_t> back(n);
+  fillsinks(r.filled.data(), dem.data(), bc.data(), dims);
+  identifyflats(r.flats.data(), r.filled.data(), dims);
+  gwdt_computecosts(costs.data(), conncomps.data(), r.flats.data(), dem.data(),
+                    r.filled.data(), dims);
+  gwdt(r.dist.data(), NULL, costs.data(), r.flats.data(), heap.data(),
+       back.data(), dims);
+  flow_routing_d8_carve(r.node.data(), r.direction.data(), r.filled.data(),
+                        r.dist.data(), r.flats.data(), dims, order);
+  return r;
+}
+
+// The D8 flow network of a random DEM whose boundary pixels are
+// outlets. `source` and `target` hold exactly the edges.
+struct FlowNetwork {
+  std::vector<ptrdiff_t> node;
+  std::vector<uint8_t> direction;
+  std::vector<ptrdiff_t> source;
+  std::vector<ptrdiff_t> target;
+};
+
+inline FlowNetwork random_flow_network(ptrdiff_t dims[2], uint32_t seed,
+                                       unsigned int order) {
+  ptrdiff_t n = dims[0] * dims[1];
+  std::vector<float> dem(n);
+  std::vector<uint8_t> bc(n);
+  for (ptrdiff_t j = 0; j < dims[1]; j++) {
+    for (ptrdiff_t i = 0; i < dims[0]; i++) {
+      ptrdiff_t p = j * dims[0] + i;
+      dem[p] = 100.0f * pcg4d(i, j, seed, 0);
+      bc[p] = i == 0 || i == dims[0] - 1 || j == 0 || j == dims[1] - 1;
+    }
+  }
+
+  D8Routing r = route_d8_carve(dem, bc, dims, order);
+
+  FlowNetwork f;
+  f.node.swap(r.node);
+  f.direction.swap(r.direction);
+  f.source.resize(n);
+  f.target.resize(n);
+  ptrdiff_t edge_count =
+      flow_routing_d8_edgelist(f.source.data(), f.target.data(), f.node.data(),
+                               f.direction.data(), dims, order);
+  f.source.resize(edge_count);
+  f.target.resize(edge_count);
+  return f;
+}
+
+#endif